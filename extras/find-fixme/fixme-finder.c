@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -55,6 +55,12 @@ size_t option_filesort_ramsize=0;
 /*+ The number of threads to use for filesorting. +*/
 int option_filesort_threads=1;
 
+/*+ Set to non-zero to compress the temporary files used for filesorting. +*/
+int option_filesort_compress=0;
+
+/*+ The number of threads to use for decoding PBF files. +*/
+int option_parse_threads=1;
+
 
 /* Local functions */
 
@@ -74,6 +80,7 @@ int main(int argc,char** argv)
  char       *dirname=NULL,*prefix=NULL,*tagging=NULL;
  int         option_keep=1;
  int         option_filenames=0;
+ int         option_async_io=0;
  int         arg;
 
  printf_program_start();
@@ -93,7 +100,13 @@ int main(int argc,char** argv)
 #if defined(USE_PTHREADS) && USE_PTHREADS
     else if(!strncmp(argv[arg],"--sort-threads=",15))
        option_filesort_threads=atoi(&argv[arg][15]);
+    else if(!strncmp(argv[arg],"--parse-threads=",16))
+       option_parse_threads=atoi(&argv[arg][16]);
+    else if(!strcmp(argv[arg],"--async-io"))
+       option_async_io=1;
 #endif
+    else if(!strcmp(argv[arg],"--sort-compress"))
+       option_filesort_compress=1;
     else if(!strncmp(argv[arg],"--tmpdir=",9))
        option_tmpdirname=&argv[arg][9];
     else if(!strncmp(argv[arg],"--tagging=",10))
@@ -123,6 +136,11 @@ int main(int argc,char** argv)
  else
     option_filesort_ramsize*=1024*1024;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ if(option_async_io)
+    SetFileBufferedAsync(1);
+#endif
+
  if(!option_tmpdirname)
    {
     if(!dirname)
@@ -307,9 +325,11 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "                    [--dir=<dirname>]\n"
 #if defined(USE_PTHREADS) && USE_PTHREADS
             "                    [--sort-ram-size=<size>] [--sort-threads=<number>]\n"
+            "                    [--parse-threads=<number>] [--async-io]\n"
 #else
             "                    [--sort-ram-size=<size>]\n"
 #endif
+            "                    [--sort-compress]\n"
             "                    [--tmpdir=<dirname>]\n"
             "                    [--tagging=<filename>]\n"
             "                    [--loggable] [--logtime] [--logmemory]\n"
@@ -355,7 +375,12 @@ static void print_usage(int detail,const char *argerr,const char *err)
 #endif
 #if defined(USE_PTHREADS) && USE_PTHREADS
             "--sort-threads=<number>   The number of threads to use for data sorting.\n"
+            "--parse-threads=<number>  The number of threads to use for decoding PBF files\n"
+            "                          and uncompressing bzip2 files.\n"
+            "--async-io                Read and write the temporary files using a separate\n"
+            "                          thread so that processing and disk I/O overlap.\n"
 #endif
+            "--sort-compress           Compress the temporary files used for data sorting.\n"
             "\n"
             "--tmpdir=<dirname>        The directory name for temporary files.\n"
             "                          (defaults to the '--dir' option directory.)\n"
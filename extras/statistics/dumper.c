@@ -47,6 +47,9 @@ size_t option_filesort_ramsize=0;
 /*+ The number of threads to use for filesorting. +*/
 int option_filesort_threads=1;
 
+/*+ Set to non-zero to compress the temporary files used for filesorting. +*/
+int option_filesort_compress=0;
+
 /* Local types */
 
 typedef struct _crossing
@@ -138,7 +141,7 @@ int main(int argc,char** argv)
 
  /* Load in the data */
 
- OSMNodes=LoadNodeList(nodes_filename=FileName(dirname,prefix,"nodes.mem"));
+ OSMNodes=LoadNodeList(nodes_filename=FileName(dirname,prefix,"nodes.mem"),0);
 
  if(!OSMNodes)
    {
@@ -146,7 +149,7 @@ int main(int argc,char** argv)
     return(1);
    }
 
- OSMSegments=LoadSegmentList(segments_filename=FileName(dirname,prefix,"segments.mem"));
+ OSMSegments=LoadSegmentList(segments_filename=FileName(dirname,prefix,"segments.mem"),0);
 
  if(!OSMSegments)
    {
@@ -154,7 +157,7 @@ int main(int argc,char** argv)
     return(1);
    }
 
- OSMWays=LoadWayList(ways_filename=FileName(dirname,prefix,"ways.mem"));
+ OSMWays=LoadWayList(ways_filename=FileName(dirname,prefix,"ways.mem"),0);
 
  if(!OSMWays)
    {
@@ -36,6 +36,12 @@
 #include "uncompress.h"
 
 
+/* Global variables */
+
+/*+ The number of threads to use for uncompressing bzip2 files. +*/
+int option_parse_threads=1;
+
+
 /* Local variables (re-initialised for each file) */
 
 static uint64_t nnodes,nways,nrelations;
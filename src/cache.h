@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2013-2015 Andrew M. Bishop
+ This file Copyright 2013-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -26,14 +26,161 @@
 #define CACHE_H    /*+ To stop multiple inclusions. +*/
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "types.h"
 
 
 /* Macros for constants */
 
-#define CACHEWIDTH 8192         /*+ The width of the cache. +*/
-#define CACHEDEPTH   16         /*+ The depth of the cache. +*/
+#define CACHEDEFAULTITEMS 131072 /*+ The default number of items in a cache. +*/
+#define CACHEMINITEMS        256 /*+ The minimum number of items in a cache. +*/
+
+#define CACHEBLOCKSIZE      4096 /*+ The amount of data to read from the file when an item is not cached. +*/
+
+
+/* Data structures */
+
+/*+ A structure containing the type independent part of a cache (the index and the statistics). +*/
+typedef struct _CacheSlots
+{
+ index_t  nitems;               /*+ The number of items that can be stored in the cache. +*/
+ index_t  hand;                 /*+ The next item to consider for replacement (the clock hand). +*/
+
+ index_t *indices;              /*+ The index of the data stored in each item (or NO_NODE). +*/
+ uint8_t *used;                 /*+ A flag for each item that is set when it is used (for the clock). +*/
+
+ index_t *hash;                 /*+ The hash table of items (or NO_NODE) searched by index. +*/
+ uint32_t hashmask;             /*+ The mask for the hash table size (a power of 2). +*/
+ int      hashbits;             /*+ The number of bits in a hash table position. +*/
+
+ size_t   hits;                 /*+ The number of fetches of data that was already cached. +*/
+ size_t   misses;               /*+ The number of fetches of data that had to be read from file. +*/
+ size_t   evictions;            /*+ The number of items that were replaced by other data. +*/
+}
+ CacheSlots;
+
+
+/* Inline functions */
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the position in the hash table for an index (small groups of
+  sequential indexes are kept together since the data is often accessed in
+  that order but the groups are scattered to avoid long runs of used entries).
+
+  uint32_t CacheHash Returns the hash table position.
+
+  CacheSlots *slots The cache slots.
+
+  index_t index The index of the data.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline uint32_t CacheHash(CacheSlots *slots,index_t index)
+{
+ uint32_t group=((uint32_t)(index>>3)*2654435761U)>>(35-slots->hashbits);
+
+ return((group<<3)|(index&7));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the item in the cache that holds the data for an index (without marking it as used).
+
+  index_t FindCacheSlot Returns the item number or NO_NODE if not cached.
+
+  CacheSlots *slots The cache slots.
+
+  index_t index The index of the data.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline index_t FindCacheSlot(CacheSlots *slots,index_t index)
+{
+ uint32_t h=CacheHash(slots,index);
+ index_t item;
+
+ while((item=slots->hash[h])!=NO_NODE)
+   {
+    if(slots->indices[item]==index)
+       return(item);
+
+    h=(h+1)&slots->hashmask;
+   }
+
+ return(NO_NODE);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Choose an item in the cache to hold the data for an index (removing the existing data).
+
+  index_t NewCacheSlot Returns the item number.
+
+  CacheSlots *slots The cache slots.
+
+  index_t index The index of the data.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline index_t NewCacheSlot(CacheSlots *slots,index_t index)
+{
+ index_t item;
+ uint32_t h;
+
+ /* Move the clock hand past the recently used items */
+
+ while(slots->used[slots->hand])
+   {
+    slots->used[slots->hand]=0;
+
+    if(++slots->hand==slots->nitems)
+       slots->hand=0;
+   }
+
+ item=slots->hand;
+
+ if(++slots->hand==slots->nitems)
+    slots->hand=0;
+
+ /* Remove the old data from the hash table (moving the following entries back) */
+
+ if(slots->indices[item]!=NO_NODE)
+   {
+    uint32_t j;
+
+    slots->evictions++;
+
+    h=CacheHash(slots,slots->indices[item]);
+
+    while(slots->hash[h]!=item)
+       h=(h+1)&slots->hashmask;
+
+    for(j=(h+1)&slots->hashmask;slots->hash[j]!=NO_NODE;j=(j+1)&slots->hashmask)
+      {
+       uint32_t k=CacheHash(slots,slots->indices[slots->hash[j]]);
+
+       if(h<=j ? (h<k && k<=j) : (h<k || k<=j)) /* Entry j is not before the empty entry h */
+          continue;
+
+       slots->hash[h]=slots->hash[j];
+       h=j;
+      }
+
+    slots->hash[h]=NO_NODE;
+   }
+
+ /* Add the new data to the hash table */
+
+ h=CacheHash(slots,index);
+
+ while(slots->hash[h]!=NO_NODE)
+    h=(h+1)&slots->hashmask;
+
+ slots->hash[h]=item;
+
+ slots->indices[item]=index;
+ slots->used[item]=1;
+
+ return(item);
+}
 
 
 /* Macro for structure forward declaration */
@@ -46,12 +193,16 @@
 /*+ A macro to create a cache structure. +*/
 #define CACHE_STRUCTURE(type) \
                               \
-struct _##type##Cache                                                     \
-{                                                                         \
- int     first  [CACHEWIDTH];             /*+ The first entry to fill +*/ \
-                                                                          \
- type    data   [CACHEWIDTH][CACHEDEPTH]; /*+ The array of type##s. +*/   \
- index_t indices[CACHEWIDTH][CACHEDEPTH]; /*+ The array of indexes. +*/   \
+struct _##type##Cache                                                        \
+{                                                                            \
+ size_t     size;                 /*+ The size of the allocated memory. +*/  \
+                                                                             \
+ CacheSlots slots;                /*+ The index of the cached items. +*/     \
+                                                                             \
+ type      *data;                 /*+ The array of type##s. +*/              \
+                                                                             \
+ type      *block;                /*+ A block of type##s read from file. +*/ \
+ index_t    nblock;               /*+ The number of items in a block. +*/    \
 };
 
 
@@ -70,18 +221,64 @@ struct _##type##Cache                                                     \
 
 /* Macros for function definitions */
 
-/*+ A macro to create a function that creates a new cache data structure. +*/
+/*+ A macro to create a function that creates a new cache data structure (sized using SlimCacheSize()). +*/
 #define CACHE_NEWCACHE(type) \
                              \
-static inline type##Cache *New##type##Cache(void)       \
-{                                                       \
- type##Cache *cache;                                    \
-                                                        \
- cache=(type##Cache*)malloc(sizeof(type##Cache));       \
-                                                        \
- Invalidate##type##Cache(cache);                        \
-                                                        \
- return(cache);                                         \
+static inline type##Cache *New##type##Cache(void)                                     \
+{                                                                                     \
+ type##Cache *cache;                                                                  \
+ size_t itemsize=sizeof(type)+sizeof(index_t)+sizeof(uint8_t)+4*sizeof(index_t);      \
+ size_t nitems=CACHEDEFAULTITEMS,nhash=1,nblock,size;                                 \
+ int hashbits=0;                                                                      \
+                                                                                      \
+ if(SlimCacheSize())                                                                  \
+    nitems=SlimCacheSize()/itemsize;                                                  \
+                                                                                      \
+ if(nitems<CACHEMINITEMS)                                                             \
+    nitems=CACHEMINITEMS;                                                             \
+                                                                                      \
+ if(nitems>(NO_NODE/4))                                                               \
+    nitems=NO_NODE/4;                                                                 \
+                                                                                      \
+ while(nhash<2*nitems)                                                                \
+   {                                                                                  \
+    nhash*=2;                                                                         \
+    hashbits++;                                                                       \
+   }                                                                                  \
+                                                                                      \
+ nblock=CACHEBLOCKSIZE/sizeof(type);                                                  \
+                                                                                      \
+ if(nblock>nitems/8)                                                                  \
+    nblock=nitems/8;                                                                  \
+                                                                                      \
+ if(nblock<1)                                                                         \
+    nblock=1;                                                                         \
+                                                                                      \
+ size=sizeof(type##Cache)+nitems*(sizeof(type)+sizeof(index_t)+sizeof(uint8_t));      \
+ size+=nblock*sizeof(type)+nhash*sizeof(index_t);                                     \
+                                                                                      \
+ cache=(type##Cache*)malloc(size);                                                    \
+                                                                                      \
+ cache->size=size;                                                                    \
+                                                                                      \
+ cache->data=(type*)(cache+1);                                                        \
+                                                                                      \
+ cache->block=cache->data+nitems;                                                     \
+ cache->nblock=(index_t)nblock;                                                       \
+                                                                                      \
+ cache->slots.nitems=(index_t)nitems;                                                 \
+ cache->slots.indices=(index_t*)(cache->block+nblock);                                \
+ cache->slots.hash=cache->slots.indices+nitems;                                       \
+ cache->slots.used=(uint8_t*)(cache->slots.hash+nhash);                               \
+                                                                                      \
+ cache->slots.hashmask=(uint32_t)(nhash-1);                                           \
+ cache->slots.hashbits=hashbits;                                                      \
+                                                                                      \
+ cache->slots.hits=cache->slots.misses=cache->slots.evictions=0;                      \
+                                                                                      \
+ Invalidate##type##Cache(cache);                                                      \
+                                                                                      \
+ return(cache);                                                                       \
 }
 
 
@@ -99,22 +296,51 @@ static inline void Delete##type##Cache(type##Cache *cache)      \
                                \
 static inline type *FetchCached##type(type##Cache *cache,index_t index,int fd,offset_t offset) \
 {                                                                                           \
- int row=index%CACHEWIDTH;                                                                  \
- int col;                                                                                   \
+ index_t item=FindCacheSlot(&cache->slots,index);                                           \
+ index_t first,i,n;                                                                         \
+ ssize_t length;                                                                            \
+                                                                                            \
+ if(item!=NO_NODE)                                                                          \
+   {                                                                                        \
+    cache->slots.hits++;                                                                    \
+    cache->slots.used[item]=1;                                                              \
+                                                                                            \
+    return(&cache->data[item]);                                                             \
+   }                                                                                        \
+                                                                                            \
+ cache->slots.misses++;                                                                     \
+                                                                                            \
+ /* Read the whole block containing the item and keep the neighbours that are not cached */ \
+                                                                                            \
+ first=index-index%cache->nblock;                                                           \
+                                                                                            \
+ length=SlimFetchBlock(fd,cache->block,cache->nblock*sizeof(type),offset+(offset_t)first*sizeof(type)); \
+                                                                                            \
+ n=(length>0)?(index_t)(length/sizeof(type)):0;                                             \
                                                                                             \
- for(col=0;col<CACHEDEPTH;col++)                                                            \
-    if(cache->indices[row][col]==index)                                                     \
-       return(&cache->data[row][col]);                                                      \
+ if(n<=(index-first))                                                                       \
+   {                                                                                        \
+    item=NewCacheSlot(&cache->slots,index);                                                 \
                                                                                             \
- col=cache->first[row];                                                                     \
+    SlimFetch(fd,&cache->data[item],sizeof(type),offset+(offset_t)index*sizeof(type));      \
                                                                                             \
- cache->first[row]=(cache->first[row]+1)%CACHEDEPTH;                                        \
+    return(&cache->data[item]);                                                             \
+   }                                                                                        \
                                                                                             \
- SlimFetch(fd,&cache->data[row][col],sizeof(type),offset+(offset_t)index*sizeof(type));     \
+ for(i=0;i<n;i++)                                                                           \
+    if((first+i)!=index && FindCacheSlot(&cache->slots,first+i)==NO_NODE)                   \
+      {                                                                                     \
+       item=NewCacheSlot(&cache->slots,first+i);                                            \
                                                                                             \
- cache->indices[row][col]=index;                                                            \
+       cache->data[item]=cache->block[i];                                                   \
+       cache->slots.used[item]=0;                                                           \
+      }                                                                                     \
                                                                                             \
- return(&cache->data[row][col]);                                                            \
+ item=NewCacheSlot(&cache->slots,index);                                                    \
+                                                                                            \
+ cache->data[item]=cache->block[index-first];                                               \
+                                                                                            \
+ return(&cache->data[item]);                                                                \
 }
 
 
@@ -123,25 +349,16 @@ static inline type *FetchCached##type(type##Cache *cache,index_t index,int fd,of
                                  \
 static inline void ReplaceCached##type(type##Cache *cache,type *value,index_t index,int fd,offset_t offset) \
 {                                                                                                        \
- int row=index%CACHEWIDTH;                                                                               \
- int col;                                                                                                \
-                                                                                                         \
- for(col=0;col<CACHEDEPTH;col++)                                                                         \
-    if(cache->indices[row][col]==index)                                                                  \
-       break;                                                                                            \
-                                                                                                         \
- if(col==CACHEDEPTH)                                                                                     \
-   {                                                                                                     \
-    col=cache->first[row];                                                                               \
+ index_t item=FindCacheSlot(&cache->slots,index);                                                        \
                                                                                                          \
-    cache->first[row]=(cache->first[row]+1)%CACHEDEPTH;                                                  \
-   }                                                                                                     \
+ if(item==NO_NODE)                                                                                       \
+    item=NewCacheSlot(&cache->slots,index);                                                              \
+ else                                                                                                    \
+    cache->slots.used[item]=1;                                                                           \
                                                                                                          \
- cache->indices[row][col]=index;                                                                         \
+ cache->data[item]=*value;                                                                               \
                                                                                                          \
- cache->data[row][col]=*value;                                                                           \
-                                                                                                         \
- SlimReplace(fd,&cache->data[row][col],sizeof(type),offset+(offset_t)index*sizeof(type));                \
+ SlimReplace(fd,&cache->data[item],sizeof(type),offset+(offset_t)index*sizeof(type));                   \
 }
 
 
@@ -150,15 +367,18 @@ static inline void ReplaceCached##type(type##Cache *cache,type *value,index_t in
                                     \
 static inline void Invalidate##type##Cache(type##Cache *cache) \
 {                                                              \
- int row,col;                                                  \
+ index_t i;                                                    \
                                                                \
- for(row=0;row<CACHEWIDTH;row++)                               \
+ for(i=0;i<cache->slots.nitems;i++)                            \
    {                                                           \
-    cache->first[row]=0;                                       \
-                                                               \
-    for(col=0;col<CACHEDEPTH;col++)                            \
-       cache->indices[row][col]=NO_NODE;                       \
+    cache->slots.indices[i]=NO_NODE;                           \
+    cache->slots.used[i]=0;                                    \
    }                                                           \
+                                                               \
+ for(i=0;i<=cache->slots.hashmask;i++)                         \
+    cache->slots.hash[i]=NO_NODE;                              \
+                                                               \
+ cache->slots.hand=0;                                          \
 }
 
 
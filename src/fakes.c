@@ -31,19 +31,19 @@
 #define MINSEGMENT 0.005
 
 
-/* Local variables (re-initialised by DeleteFakeNodes() function) */
+/* Local variables (re-initialised by DeleteFakeNodes() function, separate for each thread in the library) */
 
 /*+ A set of fake segments to allow start/finish in the middle of a segment. +*/
-static Segment fake_segments[4*NWAYPOINTS+1];
+static THREAD_LOCAL Segment fake_segments[4*NWAYPOINTS+1];
 
 /*+ A set of pointers to the real segments underlying the fake segments. +*/
-static index_t real_segments[4*NWAYPOINTS+1];
+static THREAD_LOCAL index_t real_segments[4*NWAYPOINTS+1];
 
 /*+ A set of fake node latitudes and longitudes. +*/
-static double fake_lon[NWAYPOINTS+1],fake_lat[NWAYPOINTS+1];
+static THREAD_LOCAL double fake_lon[NWAYPOINTS+1],fake_lat[NWAYPOINTS+1];
 
 /*+ The previous waypoint. +*/
-static int prevpoint=0;
+static THREAD_LOCAL int prevpoint=0;
 
 
 /*++++++++++++++++++++++++++++++++++++++
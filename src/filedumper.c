@@ -81,6 +81,8 @@ int main(int argc,char** argv)
  int       arg;
  char     *dirname=NULL,*prefix=NULL;
  char     *nodes_filename,*segments_filename,*ways_filename,*relations_filename,*errorlogs_filename;
+ char     *container_filename;
+ void     *container=NULL;
  int       option_statistics=0;
  int       option_visualiser=0,coordcount=0;
  double    latmin=0,latmax=0,lonmin=0,lonmax=0;
@@ -142,13 +144,20 @@ int main(int argc,char** argv)
 
  /* Load in the data - Note: No error checking because Load*List() will call exit() in case of an error. */
 
- OSMNodes=LoadNodeList(nodes_filename=FileName(dirname,prefix,"nodes.mem"));
+ container_filename=FileName(dirname,prefix,"database.mem");
 
- OSMSegments=LoadSegmentList(segments_filename=FileName(dirname,prefix,"segments.mem"));
+#if !SLIM
+ if(ExistsFile(container_filename))
+    container=MapContainerFile(container_filename,dirname,prefix,MAPFILE_VERIFY);
+#endif
+
+ OSMNodes=LoadNodeList(nodes_filename=FileName(dirname,prefix,"nodes.mem"),0);
 
- OSMWays=LoadWayList(ways_filename=FileName(dirname,prefix,"ways.mem"));
+ OSMSegments=LoadSegmentList(segments_filename=FileName(dirname,prefix,"segments.mem"),0);
 
- OSMRelations=LoadRelationList(relations_filename=FileName(dirname,prefix,"relations.mem"));
+ OSMWays=LoadWayList(ways_filename=FileName(dirname,prefix,"ways.mem"),0);
+
+ OSMRelations=LoadRelationList(relations_filename=FileName(dirname,prefix,"relations.mem"),0);
 
  if(ExistsFile(errorlogs_filename=FileName(dirname,prefix,"errorlogs.mem")))
     OSMErrorLogs=LoadErrorLogs(errorlogs_filename);
@@ -210,6 +219,7 @@ int main(int argc,char** argv)
  if(option_statistics)
    {
     struct stat buf;
+    Transport transport;
 
     /* Examine the files */
 
@@ -217,37 +227,49 @@ int main(int argc,char** argv)
     printf("-----\n");
     printf("\n");
 
-    stat(nodes_filename,&buf);
-
-    printf("'%s%snodes.mem'     - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
-    printf("%s\n",RFC822Date(buf.st_mtime));
-    printf("\n");
+    if(container)
+      {
+       stat(container_filename,&buf);
 
-    stat(segments_filename,&buf);
+       printf("'%s%sdatabase.mem'  - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
+       printf("%s\n",RFC822Date(buf.st_mtime));
+       printf("Build ID %016"PRIx64"\n",((ContainerHeader*)container)->buildid);
+       printf("\n");
+      }
+    else
+      {
+       stat(nodes_filename,&buf);
 
-    printf("'%s%ssegments.mem'  - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
-    printf("%s\n",RFC822Date(buf.st_mtime));
-    printf("\n");
+       printf("'%s%snodes.mem'     - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
+       printf("%s\n",RFC822Date(buf.st_mtime));
+       printf("\n");
 
-    stat(ways_filename,&buf);
+       stat(segments_filename,&buf);
 
-    printf("'%s%sways.mem'      - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
-    printf("%s\n",RFC822Date(buf.st_mtime));
-    printf("\n");
+       printf("'%s%ssegments.mem'  - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
+       printf("%s\n",RFC822Date(buf.st_mtime));
+       printf("\n");
 
-    stat(relations_filename,&buf);
+       stat(ways_filename,&buf);
 
-    printf("'%s%srelations.mem' - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
-    printf("%s\n",RFC822Date(buf.st_mtime));
-    printf("\n");
+       printf("'%s%sways.mem'      - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
+       printf("%s\n",RFC822Date(buf.st_mtime));
+       printf("\n");
 
-    if(errorlogs_filename)
-      {
-       stat(errorlogs_filename,&buf);
+       stat(relations_filename,&buf);
 
-       printf("'%s%serrorlogs.mem' - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
+       printf("'%s%srelations.mem' - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
        printf("%s\n",RFC822Date(buf.st_mtime));
        printf("\n");
+
+       if(errorlogs_filename)
+         {
+          stat(errorlogs_filename,&buf);
+
+          printf("'%s%serrorlogs.mem' - %9"PRIu64" Bytes\n",prefix?prefix:"",prefix?"-":"",(uint64_t)buf.st_size);
+          printf("%s\n",RFC822Date(buf.st_mtime));
+          printf("\n");
+         }
       }
 
     /* Examine the nodes */
@@ -259,6 +281,7 @@ int main(int argc,char** argv)
     printf("sizeof(Node) =%9zu Bytes\n",sizeof(Node));
     printf("Number       =%9"Pindex_t"\n",OSMNodes->file.number);
     printf("Number(super)=%9"Pindex_t"\n",OSMNodes->file.snumber);
+    printf("Number(super2)=%8"Pindex_t"\n",OSMNodes->file.s2number);
     printf("\n");
 
     printf("Lat bins= %4d\n",(int)OSMNodes->file.latbins);
@@ -267,6 +290,13 @@ int main(int argc,char** argv)
 
     printf("Lat zero=%5d (%8.4f deg)\n",(int)OSMNodes->file.latzero,radians_to_degrees(latlong_to_radians(bin_to_latlong(OSMNodes->file.latzero))));
     printf("Lon zero=%5d (%8.4f deg)\n",(int)OSMNodes->file.lonzero,radians_to_degrees(latlong_to_radians(bin_to_latlong(OSMNodes->file.lonzero))));
+    printf("\n");
+
+    for(transport=Transport_None+1;transport<Transport_Count;transport++)
+       printf("Not in largest component (%-10s) =%9"Pindex_t"\n",TransportName(transport),OSMNodes->file.ncomponents[transport]);
+    printf("\n");
+
+    printf("Landmarks=%2"Pindex_t"\n",OSMNodes->file.nlandmarks);
 
     /* Examine the segments */
 
@@ -511,6 +541,8 @@ static void print_node(Nodes *nodes,index_t item)
  printf("  allow=%02x (%s)\n",nodep->allow,AllowedNameList(nodep->allow));
  if(IsSuperNode(nodep))
     printf("  Super-Node\n");
+ if(IsSuper2Node(nodep))
+    printf("  Second Level Super-Node\n");
  if(nodep->flags & NODE_MINIRNDBT)
     printf("  Mini-roundabout\n");
 }
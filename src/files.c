@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -20,6 +20,11 @@
  ***************************************/
 
 
+/* Needed for the Linux specific mmap() and madvise() options. */
+#if defined(__linux__)
+#define _DEFAULT_SOURCE
+#endif
+
 #if defined(_MSC_VER)
 #include <io.h>
 #include <basetsd.h>
@@ -38,6 +43,10 @@
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+#include <pthread.h>
+#endif
 #include <sys/stat.h>
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -66,7 +75,8 @@ struct mmapinfo
  const char  *filename;         /*+ The name of the file (the index of the list). +*/
        int    fd;               /*+ The file descriptor used when it was opened. +*/
        char  *address;          /*+ The address the file was mapped to. +*/
-       size_t length;           /*+ The length of the file. +*/
+       size_t length;           /*+ The length of the mapped memory. +*/
+     offset_t size;             /*+ The size of the file (the mapped memory can be longer). +*/
 };
 
 /*+ The list of memory mapped files. +*/
@@ -75,16 +85,89 @@ static struct mmapinfo *mappedfiles;
 /*+ The number of mapped files. +*/
 static int nmappedfiles=0;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+/*+ The mutex for the list of mapped files (the library can load and unload database files in different threads). +*/
+static pthread_mutex_t mappedfiles_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#endif
+
+/*+ A structure to contain the list of sections of mapped container files that have not been opened yet. +*/
+struct containersection
+{
+       char  *filename;         /*+ The name of the file that the section replaces. +*/
+ const char  *container;        /*+ The address of the mapped container file. +*/
+       char  *address;          /*+ The address of the section in memory. +*/
+       size_t length;           /*+ The length of the section. +*/
+};
+
+/*+ The list of sections of mapped container files (protected by the same mutex as the mapped files). +*/
+static struct containersection *containersections=NULL;
+
+/*+ The number of sections of mapped container files. +*/
+static int ncontainersections=0;
+
+/*+ The size of the blocks of a container file section that are checksummed separately. +*/
+#define CHECKSUM_BLOCKSIZE (1024*1024)
+
+/*+ The number of threads used to calculate the checksums of a container file section. +*/
+#define CHECKSUM_THREADS 4
+
+/*+ The initial value and multiplier of the checksum (from the 64-bit FNV-1a hash). +*/
+#define CHECKSUM_BASIS UINT64_C(0xcbf29ce484222325)
+#define CHECKSUM_PRIME UINT64_C(0x100000001b3)
+
+/*+ A structure to contain the blocks of a container file section to be checksummed by one thread. +*/
+struct checksum
+{
+ const char     *address;       /*+ The start of the memory to checksum. +*/
+       size_t    length;        /*+ The length of the memory to checksum. +*/
+       uint64_t *sums;          /*+ The checksums of the blocks. +*/
+};
+
+/*+ The page size used when touching mapped files to load them into memory. +*/
+#define PREFAULT_PAGESIZE 4096
+
+/*+ The number of threads used to touch mapped files to load them into memory. +*/
+#define PREFAULT_THREADS 4
+
+/*+ The alignment and size multiple of memory that can use transparent huge pages. +*/
+#define HUGEPAGE_SIZE (2*1024*1024)
+
+/*+ A structure to contain the part of a mapped file to be touched by one thread. +*/
+struct prefault
+{
+ const char *address;           /*+ The start of the memory to touch. +*/
+       size_t length;           /*+ The length of the memory to touch. +*/
+};
+
 
 #define BUFFLEN 4096
 
+/*+ The size of each of the two buffers used for asynchronous I/O. +*/
+#define ASYNC_BUFFLEN 65536
+
 /*+ A structure to contain the list of file buffers. +*/
 struct filebuffer
 {
- char   buffer[BUFFLEN];        /*+ The data buffer. +*/
+ char  *buffer;                 /*+ The data buffer. +*/
+ size_t size;                   /*+ The size of the data buffer. +*/
  size_t pointer;                /*+ The read/write pointer for the file buffer. +*/
  size_t length;                 /*+ The read pointer for the file buffer. +*/
  int    reading;                /*+ A flag to indicate if the file is for reading. +*/
+
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+
+ char  *buffer2;                /*+ The second data buffer used by the I/O thread (or NULL if not asynchronous). +*/
+ size_t length2;                /*+ The length of data to write from or that was read into the second buffer. +*/
+ int    fd;                     /*+ The file descriptor (for the I/O thread). +*/
+ int    pending;                /*+ Set to non-zero while the I/O thread is using the second buffer. +*/
+ int    ready;                  /*+ Set to non-zero when the second buffer contains data that was read ahead. +*/
+ int    error;                  /*+ Set to non-zero if an asynchronous write failed. +*/
+
+ struct filebuffer *next;       /*+ The next file buffer in the I/O thread's queue. +*/
+
+#endif
 };
 
 /*+ The list of file buffers. +*/
@@ -93,6 +176,45 @@ static struct filebuffer **filebuffers=NULL;
 /*+ The number of allocated file buffer pointers. +*/
 static int nfilebuffers=0;
 
+/*+ The amount of memory to use for each slim mode cache (or zero for the default). +*/
+static size_t slimcachesize=0;
+
+
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+
+/*+ Set to non-zero if newly opened buffered files use asynchronous I/O. +*/
+static int async_enabled=0;
+
+/*+ Set to non-zero while the I/O thread is running. +*/
+static int async_running=0;
+
+/*+ The I/O thread. +*/
+static pthread_t async_thread;
+
+/*+ The queue of file buffers waiting for the I/O thread. +*/
+static struct filebuffer *async_head=NULL,*async_tail=NULL;
+
+/*+ The mutex and conditions for the queue and the file buffers' pending flags. +*/
+static pthread_mutex_t async_mutex      = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  async_queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  async_done_cond  = PTHREAD_COND_INITIALIZER;
+
+#endif
+
+
+/*+ A structure to contain the list of functions that replace read() and close() for files opened in simple mode. +*/
+struct filereader
+{
+ ssize_t (*readfn)(int fd,void *address,size_t length); /*+ The function to read the data. +*/
+ void    (*closefn)(int fd);                             /*+ The function to call when the file is closed. +*/
+};
+
+/*+ The list of file readers. +*/
+static struct filereader **filereaders=NULL;
+
+/*+ The number of allocated file reader pointers. +*/
+static int nfilereaders=0;
+
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
 
@@ -116,6 +238,26 @@ static int nopenedfiles=0;
 
 static void CreateFileBuffer(int fd,int read_write);
 
+static void *CopyFileToMemory(int fd,offset_t size,size_t *length);
+static void LoadMappedFile(const char *filename,void *address,size_t length,int options);
+static void PrefaultMemory(const void *address,size_t length);
+static void *PrefaultThread(void *arg);
+
+static void *ClaimContainerSection(const char *filename);
+static uint64_t ChecksumMemory(const void *address,size_t length);
+static void *ChecksumThread(void *arg);
+static uint64_t ChecksumBlock(uint64_t hash,const char *address,size_t length);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+
+static void *AsyncIOThread(void *arg);
+static void AsyncSubmit(struct filebuffer *filebuffer);
+static void AsyncWait(struct filebuffer *filebuffer);
+static int AsyncFlush(struct filebuffer *filebuffer);
+static void AsyncRefill(struct filebuffer *filebuffer);
+
+#endif
+
 #if defined(_MSC_VER) || defined(__MINGW32__)
 
 static void CreateOpenedFile(int fd,const char *filename);
@@ -154,12 +296,34 @@ char *FileName(const char *dirname,const char *prefix, const char *name)
   ++++++++++++++++++++++++++++++++++++++*/
 
 void *MapFile(const char *filename)
+{
+ return(MapFileOptions(filename,0));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Open a file read-only and map it into memory using options that control how it is loaded.
+
+  void *MapFileOptions Returns the address of the file or exits in case of an error.
+
+  const char *filename The name of the file to open.
+
+  int options A combination of the MAPFILE_* options.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void *MapFileOptions(const char *filename,int options)
 {
  int fd;
  struct stat buf;
  offset_t size;
+ size_t length;
  void *address;
 
+ /* Use the section of a mapped container file if there is one */
+
+ if((address=ClaimContainerSection(filename)))
+    return(address);
+
  /* Open the file */
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -191,10 +355,14 @@ void *MapFile(const char *filename)
    }
 
  size=buf.st_size;
+ length=size;
 
- /* Map the file */
+ /* Map the file (or copy it into memory) */
 
- address=mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
+ if(options&MAPFILE_HUGEPAGES)
+    address=CopyFileToMemory(fd,size,&length);
+ else
+    address=mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0);
 
  if(address==MAP_FAILED)
    {
@@ -209,20 +377,34 @@ void *MapFile(const char *filename)
    }
 
 #ifndef LIBROUTINO
- log_mmap(size);
+ log_mmap(length);
 #endif
 
+ /* Load the data into memory */
+
+ if(options)
+    LoadMappedFile(filename,address,length,options);
+
  /* Store the information about the mapped file */
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
  mappedfiles=(struct mmapinfo*)realloc((void*)mappedfiles,(nmappedfiles+1)*sizeof(struct mmapinfo));
 
  mappedfiles[nmappedfiles].filename=filename;
  mappedfiles[nmappedfiles].fd=fd;
  mappedfiles[nmappedfiles].address=address;
- mappedfiles[nmappedfiles].length=size;
+ mappedfiles[nmappedfiles].length=length;
+ mappedfiles[nmappedfiles].size=size;
 
  nmappedfiles++;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
  return(address);
 }
 
@@ -296,21 +478,30 @@ void *MapFileWriteable(const char *filename)
 
  /* Store the information about the mapped file */
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
  mappedfiles=(struct mmapinfo*)realloc((void*)mappedfiles,(nmappedfiles+1)*sizeof(struct mmapinfo));
 
  mappedfiles[nmappedfiles].filename=filename;
  mappedfiles[nmappedfiles].fd=fd;
  mappedfiles[nmappedfiles].address=address;
  mappedfiles[nmappedfiles].length=size;
+ mappedfiles[nmappedfiles].size=size;
 
  nmappedfiles++;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
  return(address);
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Unmap a file and close it.
+  Unmap a file and close it (the sections of a container file must be unmapped before the container file).
 
   void *UnmapFile Returns NULL (for similarity to the MapFile function).
 
@@ -319,14 +510,23 @@ void *MapFileWriteable(const char *filename)
 
 void *UnmapFile(const void *address)
 {
+ struct mmapinfo mappedfile;
  int i;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
  for(i=0;i<nmappedfiles;i++)
     if(mappedfiles[i].address==address)
        break;
 
  if(i==nmappedfiles)
    {
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
 #ifdef LIBROUTINO
     return(NULL);
 #else
@@ -335,26 +535,298 @@ void *UnmapFile(const void *address)
 #endif
    }
 
+ mappedfile=mappedfiles[i];
+
+ /* Shuffle the list of files */
+
+ nmappedfiles--;
+
+ if(nmappedfiles>i)
+    memmove(&mappedfiles[i],&mappedfiles[i+1],(nmappedfiles-i)*sizeof(struct mmapinfo));
+
+ /* Forget the sections of a container file that were not used */
+
+ for(i=0;i<ncontainersections;)
+    if(containersections[i].container==mappedfile.address)
+      {
+       free(containersections[i].filename);
+
+       ncontainersections--;
+
+       if(ncontainersections>i)
+          memmove(&containersections[i],&containersections[i+1],(ncontainersections-i)*sizeof(struct containersection));
+      }
+    else
+       i++;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
+ /* A section of a container file is unmapped with the container file */
+
+ if(mappedfile.fd==-1)
+    return(NULL);
+
  /* Close the file */
 
- close(mappedfiles[i].fd);
+ close(mappedfile.fd);
 
  /* Unmap the file */
 
- munmap(mappedfiles[i].address,mappedfiles[i].length);
+ munmap(mappedfile.address,mappedfile.length);
 
 #ifndef LIBROUTINO
- log_munmap(mappedfiles[i].length);
+ log_munmap(mappedfile.length);
 #endif
 
- /* Shuffle the list of files */
+ return(NULL);
+}
 
- nmappedfiles--;
 
- if(nmappedfiles>i)
-    memmove(&mappedfiles[i],&mappedfiles[i+1],(nmappedfiles-i)*sizeof(struct mmapinfo));
+/*++++++++++++++++++++++++++++++++++++++
+  Get the size of a file that has been mapped into memory.
 
- return(NULL);
+  offset_t SizeMappedFile Returns the size of the file or -1 if it was not mapped using MapFile().
+
+  const void *address The address of the mapped file in memory.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+offset_t SizeMappedFile(const void *address)
+{
+ offset_t size=-1;
+ int i;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
+ for(i=0;i<nmappedfiles;i++)
+    if(mappedfiles[i].address==address)
+      {
+       size=mappedfiles[i].size;
+       break;
+      }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
+ return(size);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Create a container file that holds a copy of several database files in page aligned sections
+  with a checksum for each section and a build identifier for the whole set.
+
+  uint64_t CreateContainerFile Returns the build identifier of the container file or exits in case of an error.
+
+  const char *filename The name of the container file to create.
+
+  const char *dirname The directory name of the files to store.
+
+  const char *prefix The file prefix of the files to store.
+
+  const char * const *names The main part of the names of the files to store.
+
+  int nnames The number of files to store.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+uint64_t CreateContainerFile(const char *filename,const char *dirname,const char *prefix,const char * const *names,int nnames)
+{
+ static const char zeros[CONTAINER_ALIGNMENT]={0};
+ ContainerHeader header={CONTAINER_MAGIC,CONTAINER_VERSION,0,0};
+ ContainerSection *sections=(ContainerSection*)calloc(nnames,sizeof(ContainerSection));
+ uint64_t offset;
+ int fd,i;
+
+ header.nsections=nnames;
+
+ offset=sizeof(ContainerHeader)+nnames*sizeof(ContainerSection);
+
+ /* Calculate the layout and the checksums of the sections */
+
+ for(i=0;i<nnames;i++)
+   {
+    char *sectionfilename=FileName(dirname,prefix,names[i]);
+    void *data;
+
+    if(strlen(names[i])>=sizeof(sections[i].name))
+      {
+#ifdef LIBROUTINO
+       free(sectionfilename);
+       free(sections);
+       return(0);
+#else
+       fprintf(stderr,"Cannot store file '%s' in a container file (name too long).\n",sectionfilename);
+       exit(EXIT_FAILURE);
+#endif
+      }
+
+    strcpy(sections[i].name,names[i]);
+
+    offset=(offset+CONTAINER_ALIGNMENT-1)/CONTAINER_ALIGNMENT*CONTAINER_ALIGNMENT;
+
+    sections[i].offset=offset;
+    sections[i].length=SizeFile(sectionfilename);
+
+    data=MapFile(sectionfilename);
+
+    sections[i].checksum=ChecksumMemory(data,sections[i].length);
+
+    data=UnmapFile(data);
+
+    offset+=sections[i].length;
+
+    free(sectionfilename);
+   }
+
+ /* The build identifier is the checksum of the table of sections */
+
+ header.buildid=ChecksumMemory(sections,nnames*sizeof(ContainerSection));
+
+ /* Write the header, the table and the sections */
+
+ fd=OpenFileBufferedNew(filename);
+
+ WriteFileBuffered(fd,&header,sizeof(ContainerHeader));
+ WriteFileBuffered(fd,sections,nnames*sizeof(ContainerSection));
+
+ offset=sizeof(ContainerHeader)+nnames*sizeof(ContainerSection);
+
+ for(i=0;i<nnames;i++)
+   {
+    char *sectionfilename=FileName(dirname,prefix,names[i]);
+    void *data;
+
+    WriteFileBuffered(fd,zeros,sections[i].offset-offset);
+
+    data=MapFile(sectionfilename);
+
+    WriteFileBuffered(fd,data,sections[i].length);
+
+    data=UnmapFile(data);
+
+    offset=sections[i].offset+sections[i].length;
+
+    free(sectionfilename);
+   }
+
+ CloseFileBuffered(fd);
+
+ free(sections);
+
+ return(header.buildid);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Map a container file into memory and check it so that the files that it holds are
+  used by MapFile() (instead of the separate files) until the container file is unmapped.
+  Only the header and the table of sections are checked unless the MAPFILE_VERIFY option
+  is used since checking the section checksums needs to read the whole file.
+
+  void *MapContainerFile Returns the address of the container file or exits in case of an error.
+
+  const char *filename The name of the container file to open.
+
+  const char *dirname The directory name of the files that are replaced by the sections.
+
+  const char *prefix The file prefix of the files that are replaced by the sections.
+
+  int options A combination of the MAPFILE_* options (applied to the whole container file).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void *MapContainerFile(const char *filename,const char *dirname,const char *prefix,int options)
+{
+ const char *error=NULL;
+ const ContainerHeader *header;
+ const ContainerSection *sections=NULL;
+ uint64_t size;
+ char *address;
+ uint32_t i;
+
+ size=SizeFile(filename);
+
+ if(size<sizeof(ContainerHeader))
+   {
+#ifdef LIBROUTINO
+    return(NULL);
+#else
+    fprintf(stderr,"Container file '%s' is not valid [too short].\n",filename);
+    exit(EXIT_FAILURE);
+#endif
+   }
+
+ address=(char*)MapFileOptions(filename,options);
+
+ if(!address)
+    return(NULL);
+
+ /* Check the header and the table of sections */
+
+ header=(const ContainerHeader*)address;
+
+ if(memcmp(header->magic,CONTAINER_MAGIC,sizeof(header->magic)))
+    error="not a container file";
+ else if(header->version!=CONTAINER_VERSION)
+    error="wrong version";
+ else if((size-sizeof(ContainerHeader))/sizeof(ContainerSection)<header->nsections)
+    error="table of sections is truncated";
+ else
+   {
+    sections=(const ContainerSection*)(address+sizeof(ContainerHeader));
+
+    if(header->buildid!=ChecksumMemory(sections,header->nsections*sizeof(ContainerSection)))
+       error="table of sections is corrupted";
+   }
+
+ /* Check the sections */
+
+ for(i=0;!error && i<header->nsections;i++)
+   {
+    if(!memchr(sections[i].name,0,sizeof(sections[i].name)))
+       error="section name is not valid";
+    else if(sections[i].offset%CONTAINER_ALIGNMENT || sections[i].offset>size || sections[i].length>(size-sections[i].offset))
+       error="section is outside of the file";
+    else if(options&MAPFILE_VERIFY && sections[i].checksum!=ChecksumMemory(address+sections[i].offset,sections[i].length))
+       error="section checksum does not match";
+   }
+
+ if(error)
+   {
+#ifdef LIBROUTINO
+    return(UnmapFile(address));
+#else
+    fprintf(stderr,"Container file '%s' is not valid [%s].\n",filename,error);
+    exit(EXIT_FAILURE);
+#endif
+   }
+
+ /* Store the information about the sections */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
+ containersections=(struct containersection*)realloc((void*)containersections,(ncontainersections+header->nsections)*sizeof(struct containersection));
+
+ for(i=0;i<header->nsections;i++)
+   {
+    containersections[ncontainersections].filename=FileName(dirname,prefix,sections[i].name);
+    containersections[ncontainersections].container=address;
+    containersections[ncontainersections].address=address+sections[i].offset;
+    containersections[ncontainersections].length=sections[i].length;
+
+    ncontainersections++;
+   }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
+ return(address);
 }
 
 
@@ -394,6 +866,38 @@ int SlimMapFile(const char *filename)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Open an existing file on disk for reading using options that control how it is loaded
+  (only the access pattern advice and reading ahead apply to slim mode files).
+
+  int SlimMapFileOptions Returns the file descriptor if OK or exits in case of an error.
+
+  const char *filename The name of the file to open.
+
+  int options A combination of the MAPFILE_* options.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int SlimMapFileOptions(const char *filename,int options)
+{
+ int fd=SlimMapFile(filename);
+
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+
+ if(fd<0)
+    return(fd);
+
+ if(options&MAPFILE_RANDOM)
+    posix_fadvise(fd,0,0,POSIX_FADV_RANDOM);
+
+ if(options&(MAPFILE_WILLNEED|MAPFILE_PREFAULT))
+    posix_fadvise(fd,0,0,POSIX_FADV_WILLNEED);
+
+#endif
+
+ return(fd);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Open an existing file on disk for reading or writing.
 
@@ -447,9 +951,34 @@ int SlimUnmapFile(int fd)
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Open a new file on disk for writing (with buffering).
+  Set the amount of memory to use for each of the caches of data read from
+  files in slim mode (applies to caches that are created after this point).
 
-  int OpenFileBufferedNew Returns the file descriptor if OK or exits in case of an error.
+  size_t size The amount of memory in bytes (or zero for the default).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void SetSlimCacheSize(size_t size)
+{
+ slimcachesize=size;
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Get the amount of memory to use for each of the caches of data read from files in slim mode.
+
+  size_t SlimCacheSize Returns the amount of memory in bytes (or zero for the default).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+size_t SlimCacheSize(void)
+{
+ return(slimcachesize);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Open a new file on disk for writing (with buffering).
+
+  int OpenFileBufferedNew Returns the file descriptor if OK or exits in case of an error.
 
   const char *filename The name of the file to create.
   ++++++++++++++++++++++++++++++++++++++*/
@@ -632,16 +1161,34 @@ int WriteFileBuffered(int fd,const void *address,size_t length)
 
  /* Write the data */
 
- if((filebuffers[fd]->pointer+length)>BUFFLEN)
+ if((filebuffers[fd]->pointer+length)>filebuffers[fd]->size)
    {
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+    if(filebuffers[fd]->buffer2)
+      {
+       if(AsyncFlush(filebuffers[fd]))
+          return(-1);
+      }
+    else
+#endif
     if(write(fd,filebuffers[fd]->buffer,filebuffers[fd]->pointer)!=(ssize_t)filebuffers[fd]->pointer)
        return(-1);
 
     filebuffers[fd]->pointer=0;
    }
 
- if(length>=BUFFLEN)
+ if(length>=filebuffers[fd]->size)
    {
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+    if(filebuffers[fd]->buffer2)
+      {
+       AsyncWait(filebuffers[fd]);
+
+       if(filebuffers[fd]->error)
+          return(-1);
+      }
+#endif
+
     if(write(fd,address,length)!=(ssize_t)length)
        return(-1);
 
@@ -680,6 +1227,42 @@ int ReadFileBuffered(int fd,void *address,size_t length)
 
  /* Read the data */
 
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+
+ if(filebuffers[fd]->buffer2)
+   {
+    /* The file position is after the data read ahead so all data must come via the buffers */
+
+    while(length>0)
+      {
+       size_t n;
+
+       if(filebuffers[fd]->pointer==filebuffers[fd]->length)
+         {
+          AsyncRefill(filebuffers[fd]);
+
+          if(filebuffers[fd]->length==0)
+             return(-1);
+         }
+
+       n=filebuffers[fd]->length-filebuffers[fd]->pointer;
+
+       if(n>length)
+          n=length;
+
+       memcpy(address,filebuffers[fd]->buffer+filebuffers[fd]->pointer,n);
+
+       address=(char*)address+n;
+       length-=n;
+
+       filebuffers[fd]->pointer+=n;
+      }
+
+    return(0);
+   }
+
+#endif
+
  if((filebuffers[fd]->pointer+length)>filebuffers[fd]->length)
     if(filebuffers[fd]->pointer<filebuffers[fd]->length)
       {
@@ -692,7 +1275,7 @@ int ReadFileBuffered(int fd,void *address,size_t length)
        filebuffers[fd]->length=0;
       }
 
- if(length>=BUFFLEN)
+ if(length>=filebuffers[fd]->size)
    {
     if(read(fd,address,length)!=(ssize_t)length)
        return(-1);
@@ -702,7 +1285,7 @@ int ReadFileBuffered(int fd,void *address,size_t length)
 
  if(filebuffers[fd]->pointer==filebuffers[fd]->length)
    {
-    ssize_t len=read(fd,filebuffers[fd]->buffer,BUFFLEN);
+    ssize_t len=read(fd,filebuffers[fd]->buffer,filebuffers[fd]->size);
 
     if(len<=0)
        return(-1);
@@ -742,6 +1325,18 @@ int SeekFileBuffered(int fd,offset_t position)
 
  /* Seek the data - doesn't need to be highly optimised */
 
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+ if(filebuffers[fd]->buffer2)
+   {
+    AsyncWait(filebuffers[fd]);
+
+    filebuffers[fd]->ready=0;
+
+    if(filebuffers[fd]->error)
+       return(-1);
+   }
+#endif
+
  if(!filebuffers[fd]->reading)
     if(write(fd,filebuffers[fd]->buffer,filebuffers[fd]->pointer)!=(ssize_t)filebuffers[fd]->pointer)
        return(-1);
@@ -785,6 +1380,20 @@ int SkipFileBuffered(int fd,offset_t skip)
     filebuffers[fd]->pointer=0;
     filebuffers[fd]->length=0;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+    if(filebuffers[fd]->buffer2)
+      {
+       /* The file position is after any data that was read ahead */
+
+       AsyncWait(filebuffers[fd]);
+
+       if(filebuffers[fd]->ready)
+          skip-=(offset_t)filebuffers[fd]->length2;
+
+       filebuffers[fd]->ready=0;
+      }
+#endif
+
     if(lseek(fd,skip,SEEK_CUR)==-1)
        return(-1);
    }
@@ -833,6 +1442,11 @@ offset_t SizeFileFD(int fd)
 {
  struct stat buf;
 
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+ if(fd<nfilebuffers && filebuffers[fd] && filebuffers[fd]->buffer2)
+    AsyncWait(filebuffers[fd]);
+#endif
+
  if(fstat(fd,&buf))
    {
 #ifdef LIBROUTINO
@@ -848,7 +1462,7 @@ offset_t SizeFileFD(int fd)
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Check if a file exists.
+  Check if a file exists (on disk or as an unused section of a mapped container file).
 
   int ExistsFile Returns 1 if the file exists and 0 if not.
 
@@ -858,11 +1472,24 @@ offset_t SizeFileFD(int fd)
 int ExistsFile(const char *filename)
 {
  struct stat buf;
+ int i;
 
- if(stat(filename,&buf))
-    return(0);
- else
+ if(!stat(filename,&buf))
     return(1);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
+ for(i=0;i<ncontainersections;i++)
+    if(!strcmp(containersections[i].filename,filename))
+       break;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
+ return(i<ncontainersections);
 }
 
 
@@ -880,6 +1507,16 @@ int CloseFileBuffered(int fd)
  logassert(fd<nfilebuffers && filebuffers[fd],"File descriptor has no buffer - report a bug");
 #endif
 
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+ if(filebuffers[fd]->buffer2)
+   {
+    AsyncWait(filebuffers[fd]);
+
+    if(filebuffers[fd]->error)
+       return(-1);
+   }
+#endif
+
  if(!filebuffers[fd]->reading)
     if(write(fd,filebuffers[fd]->buffer,filebuffers[fd]->pointer)!=(ssize_t)filebuffers[fd]->pointer)
        return(-1);
@@ -945,6 +1582,59 @@ int OpenFile(const char *filename)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Replace the functions that are used to read and close a file (that was opened in simple mode).
+
+  int fd The file descriptor of the file.
+
+  ssize_t (*readfn)(int,void*,size_t) The function that replaces read() for this file.
+
+  void (*closefn)(int) The function to call before the file is closed.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void SetFileReader(int fd,ssize_t (*readfn)(int,void*,size_t),void (*closefn)(int))
+{
+ if(nfilereaders<=fd)
+   {
+    int i;
+
+    filereaders=(struct filereader**)realloc((void*)filereaders,(fd+1)*sizeof(struct filereader*));
+
+    for(i=nfilereaders;i<=fd;i++)
+       filereaders[i]=NULL;
+
+    nfilereaders=fd+1;
+   }
+
+ if(!filereaders[fd])
+    filereaders[fd]=(struct filereader*)calloc(sizeof(struct filereader),1);
+
+ filereaders[fd]->readfn=readfn;
+ filereaders[fd]->closefn=closefn;
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Read some data from a file (that was opened in simple mode).
+
+  ssize_t ReadFile Returns the number of bytes read, 0 at the end of file or negative in case of an error.
+
+  int fd The file descriptor to read from.
+
+  void *address The address of the data to be read.
+
+  size_t length The maximum amount of data to read.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+ssize_t ReadFile(int fd,void *address,size_t length)
+{
+ if(fd<nfilereaders && filereaders[fd])
+    return(filereaders[fd]->readfn(fd,address,length));
+
+ return(read(fd,address,length));
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Close a file on disk (that was opened in simple mode).
 
@@ -953,6 +1643,15 @@ int OpenFile(const char *filename)
 
 void CloseFile(int fd)
 {
+ if(fd<nfilereaders && filereaders[fd])
+   {
+    if(filereaders[fd]->closefn)
+       filereaders[fd]->closefn(fd);
+
+    free(filereaders[fd]);
+    filereaders[fd]=NULL;
+   }
+
  close(fd);
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -1018,6 +1717,347 @@ int RenameFile(const char *oldfilename,const char *newfilename)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Copy the contents of a file into anonymous memory that is aligned so that it
+  can use transparent huge pages (or map the file if this is not possible).
+
+  void *CopyFileToMemory Returns the address of the memory or MAP_FAILED in case of an error.
+
+  int fd The file descriptor of the file (positioned at the start).
+
+  offset_t size The size of the file.
+
+  size_t *length Returns the length of the memory.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *CopyFileToMemory(int fd,offset_t size,size_t *length)
+{
+#if defined(MAP_ANONYMOUS)
+
+ char *area,*address;
+ size_t done=0;
+
+ *length=(size+HUGEPAGE_SIZE-1)/HUGEPAGE_SIZE*HUGEPAGE_SIZE;
+
+ /* Map more memory than is needed and trim it so that the start is aligned */
+
+ area=(char*)mmap(NULL,*length+HUGEPAGE_SIZE,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+
+ if(area==MAP_FAILED)
+    return(MAP_FAILED);
+
+ address=area+(HUGEPAGE_SIZE-(uintptr_t)area%HUGEPAGE_SIZE)%HUGEPAGE_SIZE;
+
+ if(address>area)
+    munmap(area,address-area);
+
+ munmap(address+*length,area+HUGEPAGE_SIZE-address);
+
+#if defined(MADV_HUGEPAGE)
+ madvise(address,*length,MADV_HUGEPAGE);
+#endif
+
+ /* Read the file into the memory */
+
+ while(done<(size_t)size)
+   {
+    ssize_t n=read(fd,address+done,size-done);
+
+    if(n<=0)
+      {
+       munmap(address,*length);
+       return(MAP_FAILED);
+      }
+
+    done+=n;
+   }
+
+ mprotect(address,*length,PROT_READ);
+
+ return(address);
+
+#else
+
+ *length=size;
+
+ return(mmap(NULL,size,PROT_READ,MAP_SHARED,fd,0));
+
+#endif
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Apply the options that control how a mapped file is loaded into memory.
+
+  const char *filename The name of the file (for error messages).
+
+  void *address The address of the mapped file.
+
+  size_t length The length of the mapped memory.
+
+  int options A combination of the MAPFILE_* options.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void LoadMappedFile(const char *filename,void *address,size_t length,int options)
+{
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+
+ if(options&MAPFILE_RANDOM)
+    posix_madvise(address,length,POSIX_MADV_RANDOM);
+
+ if(options&(MAPFILE_WILLNEED|MAPFILE_PREFAULT) && !(options&MAPFILE_HUGEPAGES))
+    posix_madvise(address,length,POSIX_MADV_WILLNEED);
+
+#endif
+
+ if(options&MAPFILE_PREFAULT && !(options&MAPFILE_HUGEPAGES))
+    PrefaultMemory(address,length);
+
+ if(options&MAPFILE_LOCK)
+    if(mlock(address,length))
+      {
+#ifndef LIBROUTINO
+       fprintf(stderr,"Cannot lock file '%s' into memory [%s].\n",filename,strerror(errno));
+#endif
+      }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Touch every page of some memory so that it is loaded (using several threads
+  so that the reads from disk for different parts of the file can overlap).
+
+  const void *address The address of the memory.
+
+  size_t length The length of the memory.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void PrefaultMemory(const void *address,size_t length)
+{
+ struct prefault parts[PREFAULT_THREADS];
+ size_t chunk=(length/PREFAULT_THREADS+PREFAULT_PAGESIZE-1)/PREFAULT_PAGESIZE*PREFAULT_PAGESIZE;
+ int i;
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_t threads[PREFAULT_THREADS];
+ int started[PREFAULT_THREADS];
+#endif
+
+ for(i=0;i<PREFAULT_THREADS;i++)
+   {
+    size_t start=i*chunk;
+
+    parts[i].address=(const char*)address+start;
+    parts[i].length=(start<length)?((length-start)<chunk?(length-start):chunk):0;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    started[i]=(parts[i].length>0 && !pthread_create(&threads[i],NULL,PrefaultThread,&parts[i]));
+
+    if(!started[i])
+#endif
+       PrefaultThread(&parts[i]);
+   }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ for(i=0;i<PREFAULT_THREADS;i++)
+    if(started[i])
+       pthread_join(threads[i],NULL);
+#endif
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Touch every page of part of a mapped file.
+
+  void *PrefaultThread Returns NULL (required to return void*).
+
+  void *arg The part of the memory to touch.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *PrefaultThread(void *arg)
+{
+ struct prefault *part=(struct prefault*)arg;
+ volatile char sum=0;
+ size_t i;
+
+ for(i=0;i<part->length;i+=PREFAULT_PAGESIZE)
+    sum+=part->address[i];
+
+ return(NULL);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the section of a mapped container file that replaces a file and record it as a mapped file.
+
+  void *ClaimContainerSection Returns the address of the section or NULL if there is no section for the file.
+
+  const char *filename The name of the file.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *ClaimContainerSection(const char *filename)
+{
+ void *address=NULL;
+ int i;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&mappedfiles_mutex);
+#endif
+
+ /* Search the most recently mapped container file first */
+
+ for(i=ncontainersections-1;i>=0;i--)
+    if(!strcmp(containersections[i].filename,filename))
+       break;
+
+ if(i>=0)
+   {
+    address=containersections[i].address;
+
+    mappedfiles=(struct mmapinfo*)realloc((void*)mappedfiles,(nmappedfiles+1)*sizeof(struct mmapinfo));
+
+    mappedfiles[nmappedfiles].filename=filename;
+    mappedfiles[nmappedfiles].fd=-1;
+    mappedfiles[nmappedfiles].address=address;
+    mappedfiles[nmappedfiles].length=containersections[i].length;
+    mappedfiles[nmappedfiles].size=containersections[i].length;
+
+    nmappedfiles++;
+
+    /* Each section can only be used once */
+
+    free(containersections[i].filename);
+
+    ncontainersections--;
+
+    if(ncontainersections>i)
+       memmove(&containersections[i],&containersections[i+1],(ncontainersections-i)*sizeof(struct containersection));
+   }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&mappedfiles_mutex);
+#endif
+
+ return(address);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the checksum of some memory (the blocks are checksummed using several threads
+  and the result does not depend on the number of threads).
+
+  uint64_t ChecksumMemory Returns the checksum.
+
+  const void *address The address of the memory.
+
+  size_t length The length of the memory.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static uint64_t ChecksumMemory(const void *address,size_t length)
+{
+ struct checksum parts[CHECKSUM_THREADS];
+ size_t nblocks=(length+CHECKSUM_BLOCKSIZE-1)/CHECKSUM_BLOCKSIZE;
+ size_t chunk=(nblocks+CHECKSUM_THREADS-1)/CHECKSUM_THREADS*CHECKSUM_BLOCKSIZE;
+ uint64_t *sums=(uint64_t*)malloc((nblocks+1)*sizeof(uint64_t));
+ uint64_t checksum,length64=length;
+ int i;
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_t threads[CHECKSUM_THREADS];
+ int started[CHECKSUM_THREADS];
+#endif
+
+ for(i=0;i<CHECKSUM_THREADS;i++)
+   {
+    size_t start=i*chunk;
+
+    parts[i].address=(const char*)address+start;
+    parts[i].length=(start<length)?((length-start)<chunk?(length-start):chunk):0;
+    parts[i].sums=sums+start/CHECKSUM_BLOCKSIZE;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    started[i]=(parts[i].length>CHECKSUM_BLOCKSIZE && !pthread_create(&threads[i],NULL,ChecksumThread,&parts[i]));
+
+    if(!started[i])
+#endif
+       ChecksumThread(&parts[i]);
+   }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ for(i=0;i<CHECKSUM_THREADS;i++)
+    if(started[i])
+       pthread_join(threads[i],NULL);
+#endif
+
+ /* Combine the length and the checksums of the blocks */
+
+ checksum=ChecksumBlock(CHECKSUM_BASIS,(const char*)&length64,sizeof(uint64_t));
+
+ checksum=ChecksumBlock(checksum,(const char*)sums,nblocks*sizeof(uint64_t));
+
+ free(sums);
+
+ return(checksum);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the checksums of the blocks of part of some memory.
+
+  void *ChecksumThread Returns NULL (required to return void*).
+
+  void *arg The part of the memory to checksum.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *ChecksumThread(void *arg)
+{
+ struct checksum *part=(struct checksum*)arg;
+ size_t i;
+
+ for(i=0;i<part->length;i+=CHECKSUM_BLOCKSIZE)
+    part->sums[i/CHECKSUM_BLOCKSIZE]=ChecksumBlock(CHECKSUM_BASIS,part->address+i,(part->length-i)<CHECKSUM_BLOCKSIZE?(part->length-i):CHECKSUM_BLOCKSIZE);
+
+ return(NULL);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Continue the checksum of some memory (a 64-bit FNV-1a hash of 64-bit words with the high bits folded down).
+
+  uint64_t ChecksumBlock Returns the updated checksum.
+
+  uint64_t hash The checksum so far.
+
+  const char *address The address of the memory.
+
+  size_t length The length of the memory.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static uint64_t ChecksumBlock(uint64_t hash,const char *address,size_t length)
+{
+ uint64_t word;
+ size_t i;
+
+ for(i=0;(i+sizeof(uint64_t))<=length;i+=sizeof(uint64_t))
+   {
+    memcpy(&word,address+i,sizeof(uint64_t));
+
+    hash=(hash^word)*CHECKSUM_PRIME;
+    hash^=hash>>32;
+   }
+
+ if(i<length)
+   {
+    word=0;
+
+    memcpy(&word,address+i,length-i);
+
+    hash=(hash^word)*CHECKSUM_PRIME;
+    hash^=hash>>32;
+   }
+
+ return(hash);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Create a file buffer.
 
@@ -1042,7 +2082,25 @@ static void CreateFileBuffer(int fd,int read_write)
 
  if(read_write)
    {
-    filebuffers[fd]=(struct filebuffer*)calloc(sizeof(struct filebuffer),1);
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+    if(async_enabled)
+      {
+       filebuffers[fd]=(struct filebuffer*)calloc(sizeof(struct filebuffer)+2*ASYNC_BUFFLEN,1);
+
+       filebuffers[fd]->buffer=(char*)(filebuffers[fd]+1);
+       filebuffers[fd]->size=ASYNC_BUFFLEN;
+
+       filebuffers[fd]->buffer2=filebuffers[fd]->buffer+ASYNC_BUFFLEN;
+       filebuffers[fd]->fd=fd;
+      }
+    else
+#endif
+      {
+       filebuffers[fd]=(struct filebuffer*)calloc(sizeof(struct filebuffer)+BUFFLEN,1);
+
+       filebuffers[fd]->buffer=(char*)(filebuffers[fd]+1);
+       filebuffers[fd]->size=BUFFLEN;
+      }
 
     filebuffers[fd]->reading=(read_write==1);
    }
@@ -1080,3 +2138,225 @@ static void CreateOpenedFile(int fd,const char *filename)
 }
 
 #endif
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Select whether files that are opened for buffered reading or writing after
+  this point use asynchronous I/O.  A separate thread reads ahead or writes
+  one buffer while the other one is being used so that the processing and the
+  disk I/O overlap.  Disabling it waits for the outstanding I/O to finish (any
+  files that are still open continue to use two buffers but without the thread).
+
+  int enable Set to non-zero to enable asynchronous I/O or zero to disable it.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void SetFileBufferedAsync(int enable)
+{
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+
+ if(enable && !async_running)
+   {
+    async_running=1;
+
+    pthread_create(&async_thread,NULL,AsyncIOThread,NULL);
+   }
+ else if(!enable && async_running)
+   {
+    pthread_mutex_lock(&async_mutex);
+
+    async_running=0;
+
+    pthread_cond_signal(&async_queue_cond);
+
+    pthread_mutex_unlock(&async_mutex);
+
+    pthread_join(async_thread,NULL);
+   }
+
+ async_enabled=enable;
+
+#endif
+}
+
+
+#if defined(USE_PTHREADS) && USE_PTHREADS && !defined(LIBROUTINO)
+
+/*++++++++++++++++++++++++++++++++++++++
+  The thread that performs the asynchronous reads and writes.
+
+  void *AsyncIOThread Returns NULL (required to return void*).
+
+  void *arg Not used.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *AsyncIOThread(void *arg)
+{
+ pthread_mutex_lock(&async_mutex);
+
+ while(1)
+   {
+    struct filebuffer *filebuffer;
+
+    while(!async_head && async_running)
+       pthread_cond_wait(&async_queue_cond,&async_mutex);
+
+    if(!async_head)
+       break;
+
+    filebuffer=async_head;
+
+    async_head=filebuffer->next;
+
+    if(!async_head)
+       async_tail=NULL;
+
+    pthread_mutex_unlock(&async_mutex);
+
+    /* Perform the I/O without holding the lock */
+
+    if(filebuffer->reading)
+      {
+       ssize_t len=read(filebuffer->fd,filebuffer->buffer2,filebuffer->size);
+
+       filebuffer->length2=(len>0)?(size_t)len:0;
+      }
+    else
+       if(write(filebuffer->fd,filebuffer->buffer2,filebuffer->length2)!=(ssize_t)filebuffer->length2)
+          filebuffer->error=1;
+
+    pthread_mutex_lock(&async_mutex);
+
+    filebuffer->pending=0;
+    filebuffer->ready=filebuffer->reading;
+
+    pthread_cond_broadcast(&async_done_cond);
+   }
+
+ pthread_mutex_unlock(&async_mutex);
+
+ return(NULL);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Pass the second buffer of a file to the I/O thread (or perform the I/O directly if there is no thread).
+
+  struct filebuffer *filebuffer The file buffer to read into or write from.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void AsyncSubmit(struct filebuffer *filebuffer)
+{
+ pthread_mutex_lock(&async_mutex);
+
+ if(async_running)
+   {
+    filebuffer->pending=1;
+    filebuffer->next=NULL;
+
+    if(async_tail)
+       async_tail->next=filebuffer;
+    else
+       async_head=filebuffer;
+
+    async_tail=filebuffer;
+
+    pthread_cond_signal(&async_queue_cond);
+
+    pthread_mutex_unlock(&async_mutex);
+   }
+ else
+   {
+    pthread_mutex_unlock(&async_mutex);
+
+    if(filebuffer->reading)
+      {
+       ssize_t len=read(filebuffer->fd,filebuffer->buffer2,filebuffer->size);
+
+       filebuffer->length2=(len>0)?(size_t)len:0;
+       filebuffer->ready=1;
+      }
+    else
+       if(write(filebuffer->fd,filebuffer->buffer2,filebuffer->length2)!=(ssize_t)filebuffer->length2)
+          filebuffer->error=1;
+   }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Wait until the I/O thread has finished with the second buffer of a file.
+
+  struct filebuffer *filebuffer The file buffer to wait for.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void AsyncWait(struct filebuffer *filebuffer)
+{
+ pthread_mutex_lock(&async_mutex);
+
+ while(filebuffer->pending)
+    pthread_cond_wait(&async_done_cond,&async_mutex);
+
+ pthread_mutex_unlock(&async_mutex);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Swap the buffers of a file that is being written and write the full one asynchronously.
+
+  int AsyncFlush Returns 0 if OK or something else if a previous write failed.
+
+  struct filebuffer *filebuffer The file buffer to flush.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int AsyncFlush(struct filebuffer *filebuffer)
+{
+ char *temp;
+
+ AsyncWait(filebuffer);
+
+ if(filebuffer->error)
+    return(-1);
+
+ temp=filebuffer->buffer;
+ filebuffer->buffer=filebuffer->buffer2;
+ filebuffer->buffer2=temp;
+
+ filebuffer->length2=filebuffer->pointer;
+
+ AsyncSubmit(filebuffer);
+
+ return(0);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Refill the buffer of a file that is being read using the data read ahead
+  (waiting for it if necessary) and start reading ahead the next data.
+
+  struct filebuffer *filebuffer The file buffer to refill (the length is zero at the end of the file).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void AsyncRefill(struct filebuffer *filebuffer)
+{
+ char *temp;
+
+ AsyncWait(filebuffer);
+
+ if(!filebuffer->ready)
+   {
+    AsyncSubmit(filebuffer);
+    AsyncWait(filebuffer);
+   }
+
+ temp=filebuffer->buffer;
+ filebuffer->buffer=filebuffer->buffer2;
+ filebuffer->buffer2=temp;
+
+ filebuffer->length=filebuffer->length2;
+ filebuffer->pointer=0;
+ filebuffer->ready=0;
+
+ if(filebuffer->length>0)
+    AsyncSubmit(filebuffer);
+}
+
+#endif
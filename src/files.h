@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -54,6 +54,20 @@
 #include "logging.h"
 
 
+/* Constants */
+
+#define MAPFILE_RANDOM     1    /*+ Advise that the file will be accessed randomly (no read-ahead). +*/
+#define MAPFILE_WILLNEED   2    /*+ Advise that all of the file will be needed (start reading it). +*/
+#define MAPFILE_PREFAULT   4    /*+ Read all of the file into memory before returning. +*/
+#define MAPFILE_LOCK       8    /*+ Lock the file into memory so that it cannot be paged out. +*/
+#define MAPFILE_HUGEPAGES 16    /*+ Copy the file into anonymous memory that can use transparent huge pages. +*/
+#define MAPFILE_VERIFY    32    /*+ Check the checksum of every section of a container file (not just the table of sections). +*/
+
+#define CONTAINER_MAGIC     "Routino"   /*+ The identification string at the start of a database container file. +*/
+#define CONTAINER_VERSION   1           /*+ The version number of the database container file format. +*/
+#define CONTAINER_ALIGNMENT 4096        /*+ The alignment of the sections in a database container file. +*/
+
+
 /* Types */
 
 /*+ A 64-bit file offset since a 32-bit off_t (which is signed) is smaller than a
@@ -61,20 +75,52 @@
 typedef int64_t offset_t;
 
 
+/*+ The header at the start of a database container file (followed by the table of sections). +*/
+typedef struct _ContainerHeader
+{
+ char     magic[8];             /*+ The identification string (CONTAINER_MAGIC). +*/
+ uint32_t version;              /*+ The version number of the container format. +*/
+ uint32_t nsections;            /*+ The number of sections in the table. +*/
+ uint64_t buildid;              /*+ An identifier for the database (the checksum of the table of sections). +*/
+}
+ ContainerHeader;
+
+
+/*+ The description of one section of a database container file. +*/
+typedef struct _ContainerSection
+{
+ char     name[40];             /*+ The name of the file stored in the section. +*/
+ uint64_t offset;               /*+ The position of the section in the container (a multiple of CONTAINER_ALIGNMENT). +*/
+ uint64_t length;               /*+ The length of the section. +*/
+ uint64_t checksum;             /*+ The checksum of the section. +*/
+}
+ ContainerSection;
+
+
 /* Functions in files.c */
 
 char *FileName(const char *dirname,const char *prefix, const char *name);
 
 void *MapFile(const char *filename);
+void *MapFileOptions(const char *filename,int options);
 void *MapFileWriteable(const char *filename);
 
 void *UnmapFile(const void *address);
 
+offset_t SizeMappedFile(const void *address);
+
+uint64_t CreateContainerFile(const char *filename,const char *dirname,const char *prefix,const char * const *names,int nnames);
+void *MapContainerFile(const char *filename,const char *dirname,const char *prefix,int options);
+
 int SlimMapFile(const char *filename);
+int SlimMapFileOptions(const char *filename,int options);
 int SlimMapFileWriteable(const char *filename);
 
 int SlimUnmapFile(int fd);
 
+void SetSlimCacheSize(size_t size);
+size_t SlimCacheSize(void);
+
 int OpenFileBufferedNew(const char *filename);
 int OpenFileBufferedAppend(const char *filename);
 
@@ -90,8 +136,14 @@ int SkipFileBuffered(int fd,offset_t skip);
 
 int CloseFileBuffered(int fd);
 
+void SetFileBufferedAsync(int enable);
+
 int OpenFile(const char *filename);
 
+void SetFileReader(int fd,ssize_t (*readfn)(int,void*,size_t),void (*closefn)(int));
+
+ssize_t ReadFile(int fd,void *address,size_t length);
+
 void CloseFile(int fd);
 
 offset_t SizeFile(const char *filename);
@@ -106,6 +158,7 @@ int RenameFile(const char *oldfilename,const char *newfilename);
 
 static inline int SlimReplace(int fd,const void *address,size_t length,offset_t position);
 static inline int SlimFetch(int fd,void *address,size_t length,offset_t position);
+static inline ssize_t SlimFetchBlock(int fd,void *address,size_t length,offset_t position);
 
 
 /* Inline the frequently called functions */
@@ -184,4 +237,38 @@ static inline int SlimFetch(int fd,void *address,size_t length,offset_t position
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Read a block of data from a file that has been opened for slim mode access
+  (the block may extend past the end of the file).
+
+  ssize_t SlimFetchBlock Returns the amount of data read or a negative value in case of an error.
+
+  int fd The file descriptor to read from.
+
+  void *address The address the data is to be read into.
+
+  size_t length The maximum length of data to read.
+
+  offset_t position The position in the file to seek to.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline ssize_t SlimFetchBlock(int fd,void *address,size_t length,offset_t position)
+{
+ /* Seek and read the data */
+
+#if HAVE_PREAD_PWRITE
+
+ return(pread(fd,address,length,position));
+
+#else
+
+ if(lseek(fd,position,SEEK_SET)!=position)
+    return(-1);
+
+ return(read(fd,address,length));
+
+#endif
+}
+
+
 #endif /* FILES_H */
@@ -35,9 +35,17 @@
 /* Functions in optimiser.c */
 
 Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,
-                        index_t start_node,index_t prev_segment,index_t finish_node,
+                        index_t start_node,index_t prev_segment,index_t finish_node,Results *finish,
                         int start_waypoint,int finish_waypoint);
 
+Results *CalculateRouteFromParts(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,
+                                 Results *begin,Results *finish,int start_waypoint,int finish_waypoint);
+
+Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node);
+Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t finish_node);
+
+Results *FindReachableNodes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,score_t max_score);
+
 
 /* Functions in output.c */
 
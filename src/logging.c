@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -445,6 +445,33 @@ void log_munmap(size_t size)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Print the usage statistics of a slim mode cache when it is deleted.
+
+  const char *name The name of the cached data.
+
+  size_t nitems The number of items that the cache can hold.
+
+  size_t hits The number of fetches that found the data in the cache.
+
+  size_t misses The number of fetches that read the data from the file.
+
+  size_t evictions The number of cached items that were replaced.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void log_cache(const char *name,size_t nitems,size_t hits,size_t misses,size_t evictions)
+{
+ if(!option_logmemory)
+    return;
+
+ printf("Cache %s: Items=%lu Hits=%lu (%.1f%%) Misses=%lu Evictions=%lu\n",name,
+        (unsigned long)nitems,(unsigned long)hits,(hits+misses)?(100.0*hits/(hits+misses)):0.0,
+        (unsigned long)misses,(unsigned long)evictions);
+
+ fflush(stdout);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Do the work to print the first message in an overwriting sequence.
 
@@ -83,6 +83,8 @@ void log_free(void *address);
 void log_mmap(size_t size);
 void log_munmap(size_t size);
 
+void log_cache(const char *name,size_t nitems,size_t hits,size_t misses,size_t evictions);
+
 
 /* Error logging functions in logerror.c */
 
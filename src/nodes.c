@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -21,6 +21,8 @@
 
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include "types.h"
@@ -36,44 +38,94 @@
 
 static int valid_segment_for_profile(Ways *ways,Segment *segmentp,Profile *profile);
 
+static int valid_file_size(NodesFile *file,offset_t size,const char *filename);
+
 
 /*++++++++++++++++++++++++++++++++++++++
   Load in a node list from a file.
 
-  Nodes *LoadNodeList Returns the node list.
+  Nodes *LoadNodeList Returns the node list (or NULL in the library if the file cannot be loaded or is not valid).
 
   const char *filename The name of the file to load.
+
+  int options The options that control how the file is loaded (a combination of the MAPFILE_* options).
   ++++++++++++++++++++++++++++++++++++++*/
 
-Nodes *LoadNodeList(const char *filename)
+Nodes *LoadNodeList(const char *filename,int options)
 {
  Nodes *nodes;
+ index_t ncomponents=0;
+ Transport transport;
 #if SLIM
- size_t sizeoffsets;
+ size_t sizeoffsets,sizecomponents,sizelandmarknodes;
 #endif
 
  nodes=(Nodes*)malloc(sizeof(Nodes));
 
 #if !SLIM
 
- nodes->data=MapFile(filename);
+ nodes->data=MapFileOptions(filename,options);
+
+ if(!nodes->data)
+   {
+    free(nodes);
+    return(NULL);
+   }
+
+ /* Copy the NodesFile header structure from the loaded data and check it matches the file */
 
- /* Copy the NodesFile header structure from the loaded data */
+ if(SizeMappedFile(nodes->data)>=(offset_t)sizeof(NodesFile))
+    nodes->file=*((NodesFile*)nodes->data);
 
- nodes->file=*((NodesFile*)nodes->data);
+ if(!valid_file_size(&nodes->file,SizeMappedFile(nodes->data),filename))
+   {
+    nodes->data=UnmapFile(nodes->data);
+    free(nodes);
+    return(NULL);
+   }
 
  /* Set the pointers in the Nodes structure. */
 
  nodes->offsets=(index_t*)(nodes->data+sizeof(NodesFile));
  nodes->nodes  =(Node*   )(nodes->data+sizeof(NodesFile)+(nodes->file.latbins*nodes->file.lonbins+1)*sizeof(index_t));
 
+ nodes->components=(NodeComponent*)(nodes->nodes+nodes->file.number);
+
+ for(transport=Transport_None+1;transport<Transport_Count;transport++)
+    ncomponents+=nodes->file.ncomponents[transport];
+
+ if(nodes->file.nlandmarks)
+   {
+    nodes->landmarknodes=(index_t*   )(nodes->components+ncomponents);
+    nodes->landmarks    =(distance_t*)(nodes->landmarknodes+nodes->file.snumber);
+   }
+ else
+   {
+    nodes->landmarknodes=NULL;
+    nodes->landmarks    =NULL;
+   }
+
 #else
 
- nodes->fd=SlimMapFile(filename);
+ nodes->fd=SlimMapFileOptions(filename,options);
 
- /* Copy the NodesFile header structure from the loaded data */
+ if(nodes->fd<0)
+   {
+    free(nodes);
+    return(NULL);
+   }
 
- SlimFetch(nodes->fd,&nodes->file,sizeof(NodesFile),0);
+ /* Copy the NodesFile header structure from the loaded data and check it matches the file */
+
+ if(SizeFileFD(nodes->fd)>=(offset_t)sizeof(NodesFile))
+    SlimFetch(nodes->fd,&nodes->file,sizeof(NodesFile),0);
+
+ if(!valid_file_size(&nodes->file,SizeFileFD(nodes->fd),filename))
+   {
+    nodes->fd=SlimUnmapFile(nodes->fd);
+    free(nodes);
+    return(NULL);
+   }
 
  sizeoffsets=(nodes->file.latbins*nodes->file.lonbins+1)*sizeof(index_t);
 
@@ -88,15 +140,84 @@ Nodes *LoadNodeList(const char *filename)
 
  nodes->cache=NewNodeCache();
 #ifndef LIBROUTINO
- log_malloc(nodes->cache,sizeof(*nodes->cache));
+ log_malloc(nodes->cache,nodes->cache->size);
+#endif
+
+ for(transport=Transport_None+1;transport<Transport_Count;transport++)
+    ncomponents+=nodes->file.ncomponents[transport];
+
+ sizecomponents=ncomponents*sizeof(NodeComponent);
+
+ nodes->components=(NodeComponent*)malloc(sizecomponents);
+#ifndef LIBROUTINO
+ log_malloc(nodes->components,sizecomponents);
+#endif
+
+ SlimFetch(nodes->fd,nodes->components,sizecomponents,nodes->nodesoffset+nodes->file.number*sizeof(Node));
+
+ if(nodes->file.nlandmarks)
+   {
+    sizelandmarknodes=nodes->file.snumber*sizeof(index_t);
+
+    nodes->landmarknodes=(index_t*)malloc(sizelandmarknodes);
+#ifndef LIBROUTINO
+    log_malloc(nodes->landmarknodes,sizelandmarknodes);
 #endif
 
+    SlimFetch(nodes->fd,nodes->landmarknodes,sizelandmarknodes,nodes->nodesoffset+nodes->file.number*sizeof(Node)+sizecomponents);
+
+    nodes->landmarksoffset=nodes->nodesoffset+nodes->file.number*sizeof(Node)+sizecomponents+sizelandmarknodes;
+   }
+ else
+    nodes->landmarknodes=NULL;
+
 #endif
 
  return(nodes);
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Check that the size of a nodes file is the size described by its header (a file created by a different version of the program is not).
+
+  int valid_file_size Returns 1 if the file is valid or 0 in the library if it is not (exits in case of an error otherwise).
+
+  NodesFile *file The header from the file.
+
+  offset_t size The size of the file.
+
+  const char *filename The name of the file (for the error message).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int valid_file_size(NodesFile *file,offset_t size,const char *filename)
+{
+ offset_t expected=sizeof(NodesFile);
+ Transport transport;
+
+ if(size>=expected && file->latbins>0 && file->lonbins>0 && file->nlandmarks<=MAX_LANDMARKS)
+   {
+    expected+=((offset_t)file->latbins*file->lonbins+1)*sizeof(index_t);
+    expected+=(offset_t)file->number*sizeof(Node);
+
+    for(transport=Transport_None+1;transport<Transport_Count;transport++)
+       expected+=(offset_t)file->ncomponents[transport]*sizeof(NodeComponent);
+
+    if(file->nlandmarks)
+       expected+=(offset_t)file->snumber*(sizeof(index_t)+file->nlandmarks*sizeof(distance_t));
+
+    if(size==expected)
+       return(1);
+   }
+
+#ifdef LIBROUTINO
+ return(0);
+#else
+ fprintf(stderr,"The nodes file '%s' is not valid for this version of Routino (re-create the database using planetsplitter).\n",filename);
+ exit(EXIT_FAILURE);
+#endif
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Destroy the node list.
 
@@ -123,6 +244,19 @@ void DestroyNodeList(Nodes *nodes)
 #endif
  DeleteNodeCache(nodes->cache);
 
+#ifndef LIBROUTINO
+ log_free(nodes->components);
+#endif
+ free(nodes->components);
+
+ if(nodes->landmarknodes)
+   {
+#ifndef LIBROUTINO
+    log_free(nodes->landmarknodes);
+#endif
+    free(nodes->landmarknodes);
+   }
+
 #endif
 
  free(nodes);
@@ -622,3 +756,95 @@ void GetLatLong(Nodes *nodes,index_t index,Node *nodep,double *latitude,double *
  *latitude =latlong_to_radians(bin_to_latlong(nodes->file.latzero+latbin)+off_to_latlong(nodep->latoffset));
  *longitude=latlong_to_radians(bin_to_latlong(nodes->file.lonzero+lonbin)+off_to_latlong(nodep->lonoffset));
 }
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the connected component that a node is in for a type of transport (nodes in different components cannot be routed between).
+
+  index_t FindNodeComponent Returns the connected component number (zero for the largest component).
+
+  Nodes *nodes The set of nodes to use.
+
+  index_t index The index of the node.
+
+  Transport transport The type of transport.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+index_t FindNodeComponent(Nodes *nodes,index_t index,Transport transport)
+{
+ NodeComponent *components=nodes->components;
+ index_t start,end,mid;
+ Transport t;
+
+ /* Find the part of the array for this type of transport */
+
+ for(t=Transport_None+1;t<transport;t++)
+    components+=nodes->file.ncomponents[t];
+
+ /* Binary search - search key exact match is required (nodes in the largest component are not stored). */
+
+ start=0;
+ end=nodes->file.ncomponents[transport];
+
+ while(start<end)
+   {
+    mid=start+(end-start)/2;
+
+    if(components[mid].node<index)
+       start=mid+1;
+    else if(components[mid].node>index)
+       end=mid;
+    else
+       return(components[mid].component);
+   }
+
+ return(0);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Get the distances between a super-node and each of the landmarks.
+
+  int GetLandmarkDistances Returns 1 if the distances are known or 0 if not (not a super-node or no landmarks).
+
+  Nodes *nodes The set of nodes to use.
+
+  index_t index The index of the node.
+
+  distance_t *distances Returns the distances to each of the landmarks (INF_DISTANCE if not connected).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int GetLandmarkDistances(Nodes *nodes,index_t index,distance_t *distances)
+{
+ index_t start,end,mid;
+
+ if(!nodes->file.nlandmarks)
+    return(0);
+
+ /* Binary search - search key exact match is required (only super-nodes are stored). */
+
+ start=0;
+ end=nodes->file.snumber;
+
+ while(start<end)
+   {
+    mid=start+(end-start)/2;
+
+    if(nodes->landmarknodes[mid]<index)
+       start=mid+1;
+    else if(nodes->landmarknodes[mid]>index)
+       end=mid;
+    else
+      {
+#if !SLIM
+       memcpy(distances,&nodes->landmarks[mid*nodes->file.nlandmarks],nodes->file.nlandmarks*sizeof(distance_t));
+#else
+       SlimFetch(nodes->fd,distances,nodes->file.nlandmarks*sizeof(distance_t),nodes->landmarksoffset+(offset_t)mid*nodes->file.nlandmarks*sizeof(distance_t));
+#endif
+
+       return(1);
+      }
+   }
+
+ return(0);
+}
@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -49,11 +49,25 @@ struct _Node
 };
 
 
+/*+ A structure containing the connected component of a node for one type of transport. +*/
+typedef struct _NodeComponent
+{
+ index_t      node;             /*+ The index of the node. +*/
+ index_t      component;        /*+ The connected component number (not zero, the largest component is not stored). +*/
+}
+ NodeComponent;
+
+
 /*+ A structure containing the header from the file. +*/
 typedef struct _NodesFile
 {
  index_t  number;               /*+ The number of nodes in total. +*/
  index_t  snumber;              /*+ The number of super-nodes. +*/
+ index_t  s2number;             /*+ The number of second level super-nodes (may be zero). +*/
+
+ index_t  ncomponents[Transport_Count]; /*+ The number of nodes that are not in the largest connected component for each type of transport. +*/
+
+ index_t  nlandmarks;           /*+ The number of landmarks that super-node distances are stored for (may be zero). +*/
 
  ll_bin_t latbins;              /*+ The number of bins containing latitude. +*/
  ll_bin_t lonbins;              /*+ The number of bins containing longitude. +*/
@@ -77,6 +91,11 @@ struct _Nodes
 
  Node     *nodes;               /*+ A pointer to the array of nodes in the file. +*/
 
+ NodeComponent *components;     /*+ A pointer to the array of node connected components in the file. +*/
+
+ index_t  *landmarknodes;       /*+ A pointer to the array of super-nodes that have landmark distances in the file. +*/
+ distance_t *landmarks;         /*+ A pointer to the array of landmark distances for each super-node in the file. +*/
+
 #else
 
  int       fd;                  /*+ The file descriptor for the file. +*/
@@ -89,13 +108,18 @@ struct _Nodes
 
  NodeCache *cache;              /*+ A RAM cache of nodes read from the file. +*/
 
+ NodeComponent *components;     /*+ An allocated array with a copy of the node connected components. +*/
+
+ index_t  *landmarknodes;       /*+ An allocated array with a copy of the super-nodes that have landmark distances. +*/
+ offset_t  landmarksoffset;     /*+ The offset of the landmark distances within the file. +*/
+
 #endif
 };
 
 
 /* Functions in nodes.c */
 
-Nodes *LoadNodeList(const char *filename);
+Nodes *LoadNodeList(const char *filename,int options);
 
 void DestroyNodeList(Nodes *nodes);
 
@@ -108,12 +132,19 @@ index_t FindClosestSegment(Nodes *nodes,Segments *segments,Ways *ways,double lat
 
 void GetLatLong(Nodes *nodes,index_t index,Node *nodep,double *latitude,double *longitude);
 
+index_t FindNodeComponent(Nodes *nodes,index_t index,Transport transport);
+
+int GetLandmarkDistances(Nodes *nodes,index_t index,distance_t *distances);
+
 
 /* Macros and inline functions */
 
 /*+ Return true if this is a super-node. +*/
 #define IsSuperNode(xxx)            (((xxx)->flags)&NODE_SUPER)
 
+/*+ Return true if this is a second level super-node. +*/
+#define IsSuper2Node(xxx)           (((xxx)->flags)&NODE_SUPER2)
+
 /*+ Return true if this is a turn restricted node. +*/
 #define IsTurnRestrictedNode(xxx)   (((xxx)->flags)&NODE_TURNRSTRCT)
 
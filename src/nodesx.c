@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -25,6 +25,7 @@
 
 #include "types.h"
 #include "nodes.h"
+#include "segments.h"
 
 #include "typesx.h"
 #include "nodesx.h"
@@ -41,21 +42,45 @@
 /*+ The command line '--tmpdir' option or its default value. +*/
 extern char *option_tmpdirname;
 
+/* Local types */
+
+/*+ An entry in the queue of nodes used when calculating the landmark distances. +*/
+typedef struct _LandmarkQueueEntry
+{
+ distance_t distance;           /*+ The distance from the landmark when the node was queued. +*/
+ index_t    node;               /*+ The node that was queued. +*/
+}
+ LandmarkQueueEntry;
+
 /* Local variables */
 
 /*+ Temporary file-local variables for use by the sort functions (re-initialised for each sort). +*/
 static NodesX *sortnodesx;
 static latlong_t lat_min,lat_max,lon_min,lon_max;
 
+/*+ Temporary file-local variables for use when calculating the landmark distances (freed afterwards). +*/
+static LandmarkQueueEntry *landmarkqueue=NULL;
+static size_t nlandmarkqueue=0,nallocatedlandmarkqueue=0;
+
 /* Local functions */
 
 static int sort_by_id(NodeX *a,NodeX *b);
+static uint64_t key_by_id(NodeX *nodex);
 static int deduplicate_and_index_by_id(NodeX *nodex,index_t index);
 
+static void create_id_bins(NodesX *nodesx);
+
 static int update_id(NodeX *nodex,index_t index);
 static int sort_by_lat_long(NodeX *a,NodeX *b);
+static uint64_t key_by_lat_long(NodeX *nodex);
 static int index_by_lat_long(NodeX *nodex,index_t index);
 
+static index_t find_component_root(index_t *parent,index_t node);
+
+static void find_landmark_distances(SegmentsX *segmentsx,index_t start,distance_t *nodedistances,index_t nnodes);
+static void push_landmark_queue(index_t node,distance_t distance);
+static int pop_landmark_queue(index_t *node,distance_t *distance);
+
 
 /*++++++++++++++++++++++++++++++++++++++
   Allocate a new node list (create a new file or open an existing one).
@@ -102,7 +127,7 @@ NodesX *NewNodeList(int append,int readonly)
 
 #if SLIM
  nodesx->cache=NewNodeXCache();
- log_malloc(nodesx->cache,sizeof(*nodesx->cache));
+ log_malloc(nodesx->cache,nodesx->cache->size);
 #endif
 
  return(nodesx);
@@ -133,6 +158,12 @@ void FreeNodeList(NodesX *nodesx,int keep)
     free(nodesx->idata);
    }
 
+ if(nodesx->ibins)
+   {
+    log_free(nodesx->ibins);
+    free(nodesx->ibins);
+   }
+
  if(nodesx->gdata)
    {
     log_free(nodesx->gdata);
@@ -151,7 +182,32 @@ void FreeNodeList(NodesX *nodesx,int keep)
     free(nodesx->super);
    }
 
+ if(nodesx->super2)
+   {
+    log_free(nodesx->super2);
+    free(nodesx->super2);
+   }
+
+ if(nodesx->components)
+   {
+    log_free(nodesx->components);
+    free(nodesx->components);
+   }
+
+ if(nodesx->landmarknodes)
+   {
+    log_free(nodesx->landmarknodes);
+    free(nodesx->landmarknodes);
+   }
+
+ if(nodesx->landmarks)
+   {
+    log_free(nodesx->landmarks);
+    free(nodesx->landmarks);
+   }
+
 #if SLIM
+ log_cache("NodesX",nodesx->cache->slots.nitems,nodesx->cache->slots.hits,nodesx->cache->slots.misses,nodesx->cache->slots.evictions);
  log_free(nodesx->cache);
  DeleteNodeXCache(nodesx->cache);
 #endif
@@ -232,6 +288,27 @@ index_t IndexNodeX(NodesX *nodesx,node_t id)
  if(id>nodesx->idata[end])      /* Key is after end */
     return(NO_NODE);
 
+ /* Use the bins to find the few nodes with IDs close to the key */
+
+ if(!nodesx->ibins && nodesx->number>=1024) /* Not worth it for a few IDs */
+    create_id_bins(nodesx);
+
+ if(nodesx->ibins)
+   {
+    index_t bin=(index_t)((id-nodesx->idata[0])>>nodesx->ibinshift);
+
+    start=nodesx->ibins[bin];
+    end  =nodesx->ibins[bin+1];
+
+    if(start==end)                 /* No IDs in the bin */
+       return(NO_NODE);
+
+    end--;
+
+    if(id<nodesx->idata[start] || id>nodesx->idata[end]) /* Key is outside the bin's IDs */
+       return(NO_NODE);
+   }
+
  /* Binary search - search key exact match only is required.
   *
   *  # <- start  |  Check mid and move start or end if it doesn't match
@@ -266,6 +343,49 @@ index_t IndexNodeX(NodesX *nodesx,node_t id)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Create the bins that divide the range of node IDs into equal sized ranges so
+  that the search in IndexNodeX() only needs to consider a few IDs close together
+  in memory instead of a binary search over the whole array.
+
+  NodesX *nodesx The set of nodes to use.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void create_id_bins(NodesX *nodesx)
+{
+ node_t range=(node_t)(nodesx->idata[nodesx->number-1]-nodesx->idata[0]);
+ index_t nbins,bin,i;
+ int shift=0;
+
+ /* Choose a power of two range of IDs for each bin so that there are at least four nodes per bin on average */
+
+ while((range>>shift)>nodesx->number/4)
+    shift++;
+
+ nbins=(index_t)(range>>shift)+1;
+
+ nodesx->ibins=(index_t*)malloc((nbins+1)*sizeof(index_t));
+ log_malloc(nodesx->ibins,(nbins+1)*sizeof(index_t));
+
+ logassert(nodesx->ibins,"Failed to allocate memory (try using slim mode?)"); /* Check malloc() worked */
+
+ /* Store the index of the first node with an ID in the range of each bin */
+
+ for(bin=0,i=0;i<nodesx->number;i++)
+   {
+    index_t ibin=(index_t)((nodesx->idata[i]-nodesx->idata[0])>>shift);
+
+    while(bin<=ibin)
+       nodesx->ibins[bin++]=i;
+   }
+
+ while(bin<=nbins)
+    nodesx->ibins[bin++]=nodesx->number;
+
+ nodesx->ibinshift=shift;
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Sort the node list.
 
@@ -298,9 +418,10 @@ void SortNodeList(NodesX *nodesx)
 
  sortnodesx=nodesx;
 
- nodesx->number=filesort_fixed(nodesx->fd,fd,sizeof(NodeX),NULL,
-                                                           (int (*)(const void*,const void*))sort_by_id,
-                                                           (int (*)(void*,index_t))deduplicate_and_index_by_id);
+ nodesx->number=filesort_fixed_radix(nodesx->fd,fd,sizeof(NodeX),NULL,
+                                                                 (uint64_t (*)(const void*))key_by_id,
+                                                                 (int (*)(const void*,const void*))sort_by_id,
+                                                                 (int (*)(void*,index_t))deduplicate_and_index_by_id);
 
  nodesx->knumber=nodesx->number;
 
@@ -339,6 +460,20 @@ static int sort_by_id(NodeX *a,NodeX *b)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the key for a radix sort of the nodes into id order.
+
+  uint64_t key_by_id Returns the key (in the same order as sort_by_id() apart from the duplicates).
+
+  NodeX *nodex The extended node.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static uint64_t key_by_id(NodeX *nodex)
+{
+ return((uint64_t)nodex->id);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Create the index of identifiers and discard duplicate nodes.
 
@@ -444,6 +579,13 @@ void RemoveNonHighwayNodes(NodesX *nodesx,WaysX *waysx,int keep)
  free(nodesx->idata);
  nodesx->idata=NULL;
 
+ if(nodesx->ibins)
+   {
+    log_free(nodesx->ibins);
+    free(nodesx->ibins);
+    nodesx->ibins=NULL;
+   }
+
  /* Close the file */
 
  waysx->fd=CloseFileBuffered(waysx->fd);
@@ -637,9 +779,10 @@ void SortNodeListGeographically(NodesX *nodesx)
 
  sortnodesx=nodesx;
 
- filesort_fixed(nodesx->fd,fd,sizeof(NodeX),(int (*)(void*,index_t))update_id,
-                                            (int (*)(const void*,const void*))sort_by_lat_long,
-                                            (int (*)(void*,index_t))index_by_lat_long);
+ filesort_fixed_radix(nodesx->fd,fd,sizeof(NodeX),(int (*)(void*,index_t))update_id,
+                                                  (uint64_t (*)(const void*))key_by_lat_long,
+                                                  (int (*)(const void*,const void*))sort_by_lat_long,
+                                                  (int (*)(void*,index_t))index_by_lat_long);
 
  /* Close the files */
 
@@ -671,6 +814,13 @@ void SortNodeListGeographically(NodesX *nodesx)
     nodesx->super=NULL;
    }
 
+ if(nodesx->super2)
+   {
+    log_free(nodesx->super2);
+    free(nodesx->super2);
+    nodesx->super2=NULL;
+   }
+
  /* Print the final message */
 
  printf_last("Sorted Nodes Geographically: Nodes=%"Pindex_t,nodesx->number);
@@ -694,6 +844,9 @@ static int update_id(NodeX *nodex,index_t index)
  if(sortnodesx->super && IsBitSet(sortnodesx->super,index))
     nodex->flags|=NODE_SUPER;
 
+ if(sortnodesx->super2 && IsBitSet(sortnodesx->super2,index))
+    nodex->flags|=NODE_SUPER2;
+
  return(1);
 }
 
@@ -748,6 +901,27 @@ static int sort_by_lat_long(NodeX *a,NodeX *b)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the key for a radix sort of the nodes into latitude and longitude order.
+
+  uint64_t key_by_lat_long Returns the key (in the same order as sort_by_lat_long() apart from nodes in the same place).
+
+  NodeX *nodex The extended node.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static uint64_t key_by_lat_long(NodeX *nodex)
+{
+ /* Within a pair of bins the offsets are in the same order as the latitude and longitude. */
+
+ uint64_t lon_bin=(uint16_t)latlong_to_bin(nodex->longitude)^0x8000;
+ uint64_t lat_bin=(uint16_t)latlong_to_bin(nodex->latitude) ^0x8000;
+ uint64_t lon_off=latlong_to_off(nodex->longitude);
+ uint64_t lat_off=latlong_to_off(nodex->latitude);
+
+ return((lon_bin<<48)|(lat_bin<<32)|(lon_off<<16)|lat_off);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Create the index between the sorted and unsorted nodes.
 
@@ -778,6 +952,538 @@ static int index_by_lat_long(NodeX *nodex,index_t index)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the connected components of the nodes for each type of transport (any route between two nodes must stay
+  within one component so routes between different components can be rejected without searching).
+
+  NodesX *nodesx The set of nodes to use.
+
+  SegmentsX *segmentsx The set of segments to use.
+
+  WaysX *waysx The set of ways to use.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void CalculateNodeComponents(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx)
+{
+ index_t i,*parent,*label,nallocated=0,total=0;
+ transports_t *wayallow;
+ BitMask *used;
+ Transport transport;
+
+ if(nodesx->number==0 || segmentsx->number==0 || waysx->number==0)
+    return;
+
+ /* Print the start message */
+
+ printf_first("Finding Connected Components: Transport=0 Components=0");
+
+ /* Allocate the memory */
+
+ parent=(index_t*)malloc(nodesx->number*sizeof(index_t));
+ log_malloc(parent,nodesx->number*sizeof(index_t));
+
+ label=(index_t*)malloc(nodesx->number*sizeof(index_t));
+ log_malloc(label,nodesx->number*sizeof(index_t));
+
+ used=AllocBitMask(nodesx->number);
+ log_malloc(used,LengthBitMask(nodesx->number)*sizeof(BitMask));
+
+ wayallow=(transports_t*)malloc(waysx->number*sizeof(transports_t));
+ log_malloc(wayallow,waysx->number*sizeof(transports_t));
+
+ logassert(parent && label && used && wayallow,"Failed to allocate memory (try using slim mode?)"); /* Check malloc() worked */
+
+ /* Read the allowed transport types for each way */
+
+ waysx->fd=ReOpenFileBuffered(waysx->filename_tmp);
+
+ for(i=0;i<waysx->number;i++)
+   {
+    WayX wayx;
+
+    ReadFileBuffered(waysx->fd,&wayx,sizeof(WayX));
+
+    wayallow[i]=wayx.way.allow;
+   }
+
+ waysx->fd=CloseFileBuffered(waysx->fd);
+
+ /* Find the components for each type of transport (ignoring direction and node restrictions) */
+
+ for(transport=Transport_None+1;transport<Transport_Count;transport++)
+   {
+    index_t largest=NO_NODE,ncomponents=0;
+
+    for(i=0;i<nodesx->number;i++)
+       parent[i]=i;
+
+    ClearAllBits(used,nodesx->number);
+
+    /* Join together the nodes at each end of each segment that allows this transport */
+
+    segmentsx->fd=ReOpenFileBuffered(segmentsx->filename_tmp);
+
+    for(i=0;i<segmentsx->number;i++)
+      {
+       SegmentX segmentx;
+       index_t root1,root2;
+
+       ReadFileBuffered(segmentsx->fd,&segmentx,sizeof(SegmentX));
+
+       if(!(segmentx.distance&SEGMENT_NORMAL) || !(wayallow[segmentx.way]&TRANSPORTS(transport)))
+          continue;
+
+       SetBit(used,segmentx.node1);
+       SetBit(used,segmentx.node2);
+
+       root1=find_component_root(parent,segmentx.node1);
+       root2=find_component_root(parent,segmentx.node2);
+
+       if(root1<root2)
+          parent[root2]=root1;
+       else if(root2<root1)
+          parent[root1]=root2;
+      }
+
+    segmentsx->fd=CloseFileBuffered(segmentsx->fd);
+
+    /* Find the size of each component and the largest one */
+
+    for(i=0;i<nodesx->number;i++)
+       label[i]=0;
+
+    for(i=0;i<nodesx->number;i++)
+       if(IsBitSet(used,i))
+         {
+          index_t root=find_component_root(parent,i);
+
+          label[root]++;
+
+          if(largest==NO_NODE || label[root]>label[largest])
+             largest=root;
+         }
+
+    /* Number the other components and store the nodes in them */
+
+    for(i=0;i<nodesx->number;i++)
+       label[i]=0;
+
+    for(i=0;i<nodesx->number;i++)
+       if(IsBitSet(used,i))
+         {
+          index_t root=find_component_root(parent,i);
+
+          if(root==largest)
+             continue;
+
+          if(label[root]==0)
+             label[root]=++ncomponents;
+
+          if(total==nallocated)
+            {
+             if(nodesx->components)
+                log_free(nodesx->components);
+
+             nallocated+=1024*1024;
+             nodesx->components=(NodeComponent*)realloc((void*)nodesx->components,nallocated*sizeof(NodeComponent));
+             log_malloc(nodesx->components,nallocated*sizeof(NodeComponent));
+
+             logassert(nodesx->components,"Failed to allocate memory (try using slim mode?)"); /* Check realloc() worked */
+            }
+
+          nodesx->components[total].node=i;
+          nodesx->components[total].component=label[root];
+
+          total++;
+
+          nodesx->ncomponents[transport]++;
+         }
+
+    printf_middle("Finding Connected Components: Transport=%d Components=%"Pindex_t,transport,ncomponents+(largest!=NO_NODE));
+   }
+
+ /* Free the memory */
+
+ log_free(parent);
+ free(parent);
+
+ log_free(label);
+ free(label);
+
+ log_free(used);
+ free(used);
+
+ log_free(wayallow);
+ free(wayallow);
+
+ /* Print the final message */
+
+ printf_last("Found Connected Components: Nodes=%"Pindex_t" Entries=%"Pindex_t,nodesx->number,total);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the root node of the connected component containing a node (halving the path to the root on the way).
+
+  index_t find_component_root Returns the index of the root node.
+
+  index_t *parent The array of parent nodes.
+
+  index_t node The node to start from.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static index_t find_component_root(index_t *parent,index_t node)
+{
+ while(parent[node]!=node)
+   {
+    parent[node]=parent[parent[node]];
+    node=parent[node];
+   }
+
+ return(node);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Choose some landmark nodes and calculate the distance between each of them and each super-node (the difference
+  between the distances to a landmark gives a lower bound on the distance between two super-nodes).
+
+  The distances are the shortest distances along the segments ignoring the direction, the transport type and the
+  node restrictions so that they are valid for all profiles.  The landmarks are chosen so that each one is as far
+  as possible from the ones before it.
+
+  NodesX *nodesx The set of nodes to use.
+
+  SegmentsX *segmentsx The set of segments to use.
+
+  int nlandmarks The number of landmarks to choose.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void CalculateNodeLandmarks(NodesX *nodesx,SegmentsX *segmentsx,int nlandmarks)
+{
+ index_t i,nsuper=0,landmark;
+ distance_t *distances,*nodedistances;
+ int k,nchosen;
+
+ if(nlandmarks<=0 || nodesx->number==0 || segmentsx->number==0)
+    return;
+
+ if(nlandmarks>MAX_LANDMARKS)
+    nlandmarks=MAX_LANDMARKS;
+
+ /* Print the start message */
+
+ printf_first("Calculating Landmarks: Landmarks=0");
+
+ /* Find the super-nodes */
+
+ nodesx->fd=ReOpenFileBuffered(nodesx->filename_tmp);
+
+ for(i=0;i<nodesx->number;i++)
+   {
+    NodeX nodex;
+
+    ReadFileBuffered(nodesx->fd,&nodex,sizeof(NodeX));
+
+    if(nodex.flags&NODE_SUPER)
+      {
+       if((nsuper%(1024*1024))==0)
+         {
+          if(nodesx->landmarknodes)
+             log_free(nodesx->landmarknodes);
+
+          nodesx->landmarknodes=(index_t*)realloc((void*)nodesx->landmarknodes,(nsuper+1024*1024)*sizeof(index_t));
+          log_malloc(nodesx->landmarknodes,(nsuper+1024*1024)*sizeof(index_t));
+
+          logassert(nodesx->landmarknodes,"Failed to allocate memory (try using slim mode?)"); /* Check realloc() worked */
+         }
+
+       nodesx->landmarknodes[nsuper++]=i;
+      }
+   }
+
+ nodesx->fd=CloseFileBuffered(nodesx->fd);
+
+ if(nsuper==0)
+   {
+    printf_last("Calculated Landmarks: Super-Nodes=0 Landmarks=0");
+    return;
+   }
+
+ /* Allocate the memory */
+
+ distances=(distance_t*)malloc(nsuper*nlandmarks*sizeof(distance_t));
+ log_malloc(distances,nsuper*nlandmarks*sizeof(distance_t));
+
+ logassert(distances,"Failed to allocate memory (try using slim mode?)"); /* Check malloc() worked */
+
+ nodedistances=(distance_t*)malloc(nodesx->number*sizeof(distance_t));
+ log_malloc(nodedistances,nodesx->number*sizeof(distance_t));
+
+ logassert(nodedistances,"Failed to allocate memory (try using slim mode?)"); /* Check malloc() worked */
+
+ /* Map into memory / open the files */
+
+#if !SLIM
+ segmentsx->data=MapFile(segmentsx->filename_tmp);
+#else
+ segmentsx->fd=SlimMapFile(segmentsx->filename_tmp);
+
+ InvalidateSegmentXCache(segmentsx->cache);
+#endif
+
+ /* Choose the first landmark as the super-node furthest from an arbitrary one */
+
+ landmark=nodesx->landmarknodes[nsuper/2];
+
+ nchosen=nlandmarks;
+
+ for(k=-1;k<nlandmarks;k++)
+   {
+    distance_t furthest=0;
+
+    find_landmark_distances(segmentsx,landmark,nodedistances,nodesx->number);
+
+    /* Store the distances and find the super-node furthest from all of the landmarks so far */
+
+    for(i=0;i<nsuper;i++)
+      {
+       distance_t distance=nodedistances[nodesx->landmarknodes[i]];
+       int j;
+
+       if(k>=0)
+         {
+          distances[i*nlandmarks+k]=distance;
+
+          for(j=0;j<k;j++)
+             if(distances[i*nlandmarks+j]<distance)
+                distance=distances[i*nlandmarks+j];
+         }
+
+       if(distance!=INF_DISTANCE && distance>furthest)
+         {
+          furthest=distance;
+          landmark=nodesx->landmarknodes[i];
+         }
+      }
+
+    /* Stop early if there are no more super-nodes that are not already landmarks */
+
+    if(furthest==0)
+      {
+       nchosen=k+1;
+       break;
+      }
+
+    if(k>=0)
+       printf_middle("Calculating Landmarks: Landmarks=%d",k+1);
+   }
+
+ /* Unmap from memory / close the files */
+
+#if !SLIM
+ segmentsx->data=UnmapFile(segmentsx->data);
+#else
+ segmentsx->fd=SlimUnmapFile(segmentsx->fd);
+#endif
+
+ /* Store the distances (removing the space for any unused landmarks) */
+
+ nodesx->nlandmarks=nchosen;
+ nodesx->nlandmarknodes=nsuper;
+
+ if(nchosen>0)
+   {
+    nodesx->landmarks=(distance_t*)malloc(nsuper*nchosen*sizeof(distance_t));
+    log_malloc(nodesx->landmarks,nsuper*nchosen*sizeof(distance_t));
+
+    logassert(nodesx->landmarks,"Failed to allocate memory (try using slim mode?)"); /* Check malloc() worked */
+
+    for(i=0;i<nsuper;i++)
+       for(k=0;k<nchosen;k++)
+          nodesx->landmarks[i*nchosen+k]=distances[i*nlandmarks+k];
+   }
+
+ /* Free the memory */
+
+ log_free(distances);
+ free(distances);
+
+ log_free(nodedistances);
+ free(nodedistances);
+
+ if(landmarkqueue)
+   {
+    log_free(landmarkqueue);
+    free(landmarkqueue);
+   }
+
+ landmarkqueue=NULL;
+ nlandmarkqueue=nallocatedlandmarkqueue=0;
+
+ /* Print the final message */
+
+ printf_last("Calculated Landmarks: Super-Nodes=%"Pindex_t" Landmarks=%d",nsuper,nchosen);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the shortest distance from a node to all other nodes ignoring the direction of the segments.
+
+  SegmentsX *segmentsx The set of segments to use.
+
+  index_t start The start node.
+
+  distance_t *nodedistances Returns the distance to each node (INF_DISTANCE if not connected).
+
+  index_t nnodes The number of nodes.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void find_landmark_distances(SegmentsX *segmentsx,index_t start,distance_t *nodedistances,index_t nnodes)
+{
+ index_t i,node1;
+ distance_t distance1;
+
+ /* Insert the first node into the queue */
+
+ for(i=0;i<nnodes;i++)
+    nodedistances[i]=INF_DISTANCE;
+
+ nlandmarkqueue=0;
+
+ nodedistances[start]=0;
+
+ push_landmark_queue(start,0);
+
+ /* Loop across all nodes in the queue (ignoring entries that have been superseded by a shorter distance) */
+
+ while(pop_landmark_queue(&node1,&distance1))
+   {
+    SegmentX *segmentx;
+
+    if(distance1>nodedistances[node1])
+       continue;
+
+    segmentx=FirstSegmentX(segmentsx,node1,1);
+
+    while(segmentx)
+      {
+       index_t node2;
+       distance_t cumulative_distance;
+
+       /* must be a normal segment */
+       if(!(segmentx->distance&SEGMENT_NORMAL))
+          goto endloop;
+
+       node2=OtherNode(segmentx,node1);
+
+       cumulative_distance=distance1+DISTANCE(segmentx->distance);
+
+       if(cumulative_distance>=INF_DISTANCE)
+          cumulative_distance=INF_DISTANCE-1;
+
+       if(cumulative_distance<nodedistances[node2])
+         {
+          nodedistances[node2]=cumulative_distance;
+
+          push_landmark_queue(node2,cumulative_distance);
+         }
+
+      endloop:
+
+       segmentx=NextSegmentX(segmentsx,segmentx,node1);
+      }
+   }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Insert a node into the binary heap used as the queue when calculating the landmark distances.
+
+  index_t node The node to insert.
+
+  distance_t distance The distance to sort the node by.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void push_landmark_queue(index_t node,distance_t distance)
+{
+ size_t index;
+
+ if(nlandmarkqueue==nallocatedlandmarkqueue)
+   {
+    if(landmarkqueue)
+       log_free(landmarkqueue);
+
+    nallocatedlandmarkqueue+=64*1024;
+
+    landmarkqueue=(LandmarkQueueEntry*)realloc((void*)landmarkqueue,nallocatedlandmarkqueue*sizeof(LandmarkQueueEntry));
+    log_malloc(landmarkqueue,nallocatedlandmarkqueue*sizeof(LandmarkQueueEntry));
+
+    logassert(landmarkqueue,"Failed to allocate memory (try using slim mode?)"); /* Check realloc() worked */
+   }
+
+ /* Bubble up the new value */
+
+ index=nlandmarkqueue++;
+
+ while(index>0 && landmarkqueue[(index-1)/2].distance>distance)
+   {
+    landmarkqueue[index]=landmarkqueue[(index-1)/2];
+
+    index=(index-1)/2;
+   }
+
+ landmarkqueue[index].distance=distance;
+ landmarkqueue[index].node=node;
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Remove the node with the shortest distance from the binary heap used as the queue when calculating the landmark distances.
+
+  int pop_landmark_queue Returns 1 if a node was removed or 0 if the queue is empty.
+
+  index_t *node Returns the node that was removed.
+
+  distance_t *distance Returns the distance that the node was sorted by.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int pop_landmark_queue(index_t *node,distance_t *distance)
+{
+ LandmarkQueueEntry last;
+ size_t index=0;
+
+ if(nlandmarkqueue==0)
+    return(0);
+
+ *node=landmarkqueue[0].node;
+ *distance=landmarkqueue[0].distance;
+
+ /* Bubble down the last value from the top */
+
+ last=landmarkqueue[--nlandmarkqueue];
+
+ while(2*index+1<nlandmarkqueue)
+   {
+    size_t child=2*index+1;
+
+    if(child+1<nlandmarkqueue && landmarkqueue[child+1].distance<landmarkqueue[child].distance)
+       child++;
+
+    if(landmarkqueue[child].distance>=last.distance)
+       break;
+
+    landmarkqueue[index]=landmarkqueue[child];
+
+    index=child;
+   }
+
+ landmarkqueue[index]=last;
+
+ return(1);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Save the final node list database to a file.
 
@@ -793,9 +1499,10 @@ void SaveNodeList(NodesX *nodesx,const char *filename,SegmentsX *segmentsx)
  index_t i;
  int fd;
  NodesFile nodesfile={0};
- index_t super_number=0;
+ index_t super_number=0,super2_number=0,ncomponents=0;
  ll_bin2_t latlonbin=0,maxlatlonbins;
  index_t *offsets;
+ Transport transport;
 
  /* Print the start message */
 
@@ -839,6 +1546,9 @@ void SaveNodeList(NodesX *nodesx,const char *filename,SegmentsX *segmentsx)
     if(node.flags&NODE_SUPER)
        super_number++;
 
+    if(node.flags&NODE_SUPER2)
+       super2_number++;
+
     /* Work out the offsets */
 
     latbin=latlong_to_bin(nodex.latitude )-nodesx->latzero;
@@ -860,6 +1570,30 @@ void SaveNodeList(NodesX *nodesx,const char *filename,SegmentsX *segmentsx)
 
  nodesx->fd=CloseFileBuffered(nodesx->fd);
 
+ /* Write out the connected components (if calculated) after the nodes */
+
+ for(transport=Transport_None+1;transport<Transport_Count;transport++)
+   {
+    nodesfile.ncomponents[transport]=nodesx->ncomponents[transport];
+
+    ncomponents+=nodesx->ncomponents[transport];
+   }
+
+ if(ncomponents)
+    WriteFileBuffered(fd,nodesx->components,ncomponents*sizeof(NodeComponent));
+
+ /* Write out the landmark distances (if calculated) after the connected components */
+
+ if(nodesx->nlandmarks)
+   {
+    logassert(nodesx->nlandmarknodes==super_number,"Landmark distances are not stored for every super-node"); /* Check the landmarks are up to date */
+
+    WriteFileBuffered(fd,nodesx->landmarknodes,nodesx->nlandmarknodes*sizeof(index_t));
+    WriteFileBuffered(fd,nodesx->landmarks,nodesx->nlandmarknodes*nodesx->nlandmarks*sizeof(distance_t));
+   }
+
+ nodesfile.nlandmarks=nodesx->nlandmarks;
+
  /* Finish off the offset indexing and write them out */
 
  maxlatlonbins=nodesx->latbins*nodesx->lonbins;
@@ -876,6 +1610,7 @@ void SaveNodeList(NodesX *nodesx,const char *filename,SegmentsX *segmentsx)
 
  nodesfile.number=nodesx->number;
  nodesfile.snumber=super_number;
+ nodesfile.s2number=super2_number;
 
  nodesfile.latbins=nodesx->latbins;
  nodesfile.lonbins=nodesx->lonbins;
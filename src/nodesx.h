@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -75,11 +75,23 @@ struct _NodesX
 
  node_t   *idata;               /*+ The extended node IDs (sorted by ID). +*/
 
+ index_t  *ibins;               /*+ The index of the first extended node in each range of IDs (for searching idata). +*/
+ int       ibinshift;           /*+ The number of bits to shift an ID offset by to get the range number. +*/
+
  index_t  *pdata;               /*+ The node indexes after pruning. +*/
 
  index_t  *gdata;               /*+ The final node indexes (sorted geographically). +*/
 
  BitMask  *super;               /*+ A bit-mask marker for super nodes (same order as sorted nodes). +*/
+ BitMask  *super2;              /*+ A bit-mask marker for second level super nodes (same order as sorted nodes). +*/
+
+ NodeComponent *components;     /*+ The connected components of the nodes not in the largest component for each type of transport. +*/
+ index_t   ncomponents[Transport_Count]; /*+ The number of connected component entries for each type of transport. +*/
+
+ index_t   nlandmarks;          /*+ The number of landmarks that distances have been calculated for. +*/
+ index_t   nlandmarknodes;      /*+ The number of super-nodes that have landmark distances. +*/
+ index_t  *landmarknodes;       /*+ The super-nodes that have landmark distances. +*/
+ distance_t *landmarks;         /*+ The distances between each super-node and each of the landmarks. +*/
 
  index_t   latbins;             /*+ The number of bins containing latitude. +*/
  index_t   lonbins;             /*+ The number of bins containing longitude. +*/
@@ -107,6 +119,10 @@ void RemovePrunedNodes(NodesX *nodesx,SegmentsX *segmentsx);
 
 void SortNodeListGeographically(NodesX *nodesx);
 
+void CalculateNodeComponents(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx);
+
+void CalculateNodeLandmarks(NodesX *nodesx,SegmentsX *segmentsx,int nlandmarks);
+
 void SaveNodeList(NodesX *nodesx,const char *filename,SegmentsX *segmentsx);
 
 
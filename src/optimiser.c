@@ -36,13 +36,13 @@
 #include "routino.h"
 
 /*+ The function to be called to report on the routing progress. +*/
-extern Routino_ProgressFunc progress_func;
+extern THREAD_LOCAL Routino_ProgressFunc progress_func;
 
 /*+ The current state of the routing progress. +*/
-extern double progress_value;
+extern THREAD_LOCAL double progress_value;
 
 /*+ Set when the progress callback returns false in the routing function. +*/
-extern int progress_abort;
+extern THREAD_LOCAL int progress_abort;
 
 #endif
 
@@ -57,21 +57,42 @@ extern int progress_abort;
 extern int option_quiet;
 
 /*+ The option to calculate the quickest route insted of the shortest. +*/
-extern int option_quickest;
+extern THREAD_LOCAL int option_quickest;
+
+
+/* Local types */
+
+/*+ The lower bounds on the distances from a super-node to the start and finish found from the landmark distances. +*/
+typedef struct _LandmarkBounds
+{
+ index_t    node;               /*+ The super-node that the bounds are for (or NO_NODE). +*/
+
+ distance_t start;              /*+ The lower bound on the distance to the start super-node. +*/
+ distance_t finish;             /*+ The lower bound on the distance to the finish super-node. +*/
+}
+ LandmarkBounds;
+
+/*+ The number of entries in the cache of landmark bounds used in each middle route search (a power of 2). +*/
+#define LANDMARK_CACHE_SIZE 16384
 
 
 /* Local functions */
 
-static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node);
+static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node,int super2);
 static Results *FindMiddleRoute(Nodes *supernodes,Segments *supersegments,Ways *superways,Relations *relations,Profile *profile,Results *begin,Results *end);
 static index_t  FindSuperSegment(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t finish_node,index_t finish_segment);
 static Results *FindSuperRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t finish_node);
-static Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node);
-static Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t finish_node);
 static Results *CombineRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,Results *begin,Results *middle,Results *end);
 
 static void     FixForwardRoute(Results *results,Result *finish_result);
 
+static int      ConnectedNodes(Nodes *nodes,Profile *profile,index_t node1,index_t node2);
+
+static distance_t FindLandmarkAnchor(Nodes *nodes,Profile *profile,Results *results,distance_t *landmarks);
+static distance_t LandmarkDistance(Nodes *nodes,distance_t *landmarks1,distance_t *landmarks2);
+static LandmarkBounds *GetLandmarkBounds(Nodes *nodes,LandmarkBounds *cache,index_t node,
+                                         distance_t *start_landmarks,distance_t *finish_landmarks);
+
 #if DEBUG
 static void print_debug_route(Nodes *nodes,Segments *segments,Results *results,Result *first,int indent,int direction);
 #endif
@@ -98,13 +119,15 @@ static void print_debug_route(Nodes *nodes,Segments *segments,Results *results,R
 
   index_t finish_node The finish node.
 
+  Results *finish The routes from the super-nodes to the finish node (from FindFinishRoutes()) or NULL to calculate them here.
+
   int start_waypoint The starting waypoint.
 
   int finish_waypoint The finish waypoint.
   ++++++++++++++++++++++++++++++++++++++*/
 
 Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,
-                        index_t start_node,index_t prev_segment,index_t finish_node,
+                        index_t start_node,index_t prev_segment,index_t finish_node,Results *finish,
                         int start_waypoint,int finish_waypoint)
 {
  Results *complete=NULL;
@@ -149,6 +172,16 @@ Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *re
    {
     Results *begin;
 
+    /* Check that a route is possible between the start and finish */
+
+    if(!ConnectedNodes(nodes,profile,start_node,finish_node))
+      {
+#ifndef LIBROUTINO
+       fprintf(stderr,"Error: Cannot find a route because the start and finish are not connected for this transport.\n");
+#endif
+       return(NULL);
+      }
+
     /* Calculate the beginning of the route */
 
     begin=FindStartRoutes(nodes,segments,ways,relations,profile,start_node,prev_segment,finish_node);
@@ -194,9 +227,12 @@ Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *re
       {
        Results *middle,*end;
 
-       /* Calculate the end of the route */
+       /* Calculate the end of the route (unless it was calculated already) */
 
-       end=FindFinishRoutes(nodes,segments,ways,relations,profile,finish_node);
+       if(finish)
+          end=finish;
+       else
+          end=FindFinishRoutes(nodes,segments,ways,relations,profile,finish_node);
 
        if(!end)
          {
@@ -243,7 +279,9 @@ Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *re
 
        FreeResultsList(begin);
        FreeResultsList(middle);
-       FreeResultsList(end);
+
+       if(end!=finish)
+          FreeResultsList(end);
       }
    }
 
@@ -261,7 +299,74 @@ Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *re
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Find the optimum route between two nodes not passing through a super-node.
+  Find a complete route that passes through the super-nodes using the routes from the start node to the super-nodes and
+  from the super-nodes to the finish node that were calculated already (to re-use them for routes between several nodes).
+
+  Results *CalculateRouteFromParts Returns a set of results or NULL if there is no route.
+
+  Nodes *nodes The set of nodes to use.
+
+  Segments *segments The set of segments to use.
+
+  Ways *ways The set of ways to use.
+
+  Relations *relations The set of relations to use.
+
+  Profile *profile The profile containing the transport type, speeds and allowed highways.
+
+  Results *begin The routes from the start node to the super-nodes (from FindStartRoutes() with no finish node), the finish
+  node must not be one of them; they are not changed so they can be used again.
+
+  Results *finish The routes from the super-nodes to the finish node (from FindFinishRoutes()).
+
+  int start_waypoint The starting waypoint.
+
+  int finish_waypoint The finish waypoint.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+Results *CalculateRouteFromParts(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,
+                                 Results *begin,Results *finish,int start_waypoint,int finish_waypoint)
+{
+ Results *middle,*complete;
+ Result *result;
+
+ if(!ConnectedNodes(nodes,profile,begin->start_node,finish->finish_node))
+    return(NULL);
+
+ middle=FindMiddleRoute(nodes,segments,ways,relations,profile,begin,finish);
+
+ if(!middle)
+    return(NULL);
+
+ complete=CombineRoutes(nodes,segments,ways,relations,profile,begin,middle,finish);
+
+ FreeResultsList(middle);
+
+ /* Remove the forward route that was added to the start routes */
+
+ result=FindResult(begin,begin->start_node,begin->prev_segment);
+
+ while(result)
+   {
+    Result *next=result->next;
+
+    result->next=NULL;
+
+    result=next;
+   }
+
+ if(!complete)
+    return(NULL);
+
+ complete->start_waypoint=start_waypoint;
+ complete->finish_waypoint=finish_waypoint;
+
+ return(complete);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the optimum route between two nodes not passing through a super-node (or a second level super-node).
 
   Results *FindNormalRoute Returns a set of results.
 
@@ -280,9 +385,11 @@ Results *CalculateRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *re
   index_t prev_segment The previous segment before the start node.
 
   index_t finish_node The finish node.
+
+  int super2 If true then the route may pass through super-nodes that are not second level super-nodes.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node)
+static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node,int super2)
 {
  Results *results;
  Queue   *queue;
@@ -364,9 +471,9 @@ static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
       {
        Node *node2p=NULL;
        Way *way2p;
+       WayCost *waycost2p;
        index_t node2,seg2,seg2r;
-       score_t segment_pref,segment_score,cumulative_score;
-       int i;
+       score_t segment_score,cumulative_score;
 
        node2=OtherNode(segment2p,node1); /* need this here because we use node2 at the end of the loop */
 
@@ -416,42 +523,13 @@ static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
           node2p=LookupNode(nodes,node2,2);
 
        /* must not pass over super-node */
-       if(node2!=finish_node && node2p && IsSuperNode(node2p))
+       if(node2!=finish_node && node2p && IsSuperNode(node2p) && (!super2 || IsSuper2Node(node2p)))
           goto endloop;
 
-       way2p=LookupWay(ways,segment2p->way,1);
-
-       /* mode of transport must be allowed on the highway */
-       if(!(way2p->allow&profile->allow))
-          goto endloop;
-
-       /* must obey weight restriction (if exists) */
-       if(way2p->weight && way2p->weight<profile->weight)
-          goto endloop;
-
-       /* must obey height/width/length restriction (if exist) */
-       if((way2p->height && way2p->height<profile->height) ||
-          (way2p->width  && way2p->width <profile->width ) ||
-          (way2p->length && way2p->length<profile->length))
-          goto endloop;
-
-       segment_pref=profile->highway[HIGHWAY(way2p->type)];
-
-       /* highway preferences must allow this highway */
-       if(segment_pref==0)
-          goto endloop;
-
-       for(i=1;i<Property_Count;i++)
-          if(ways->file.props & PROPERTIES(i))
-            {
-             if(way2p->props & PROPERTIES(i))
-                segment_pref*=profile->props_yes[i];
-             else
-                segment_pref*=profile->props_no[i];
-            }
+       waycost2p=&profile->waycost[segment2p->way];
 
-       /* profile preferences must allow this highway */
-       if(segment_pref==0)
+       /* mode of transport, weight/height/width/length restrictions and preferences must allow this highway */
+       if(waycost2p->pref==0)
           goto endloop;
 
        /* mode of transport must be allowed through node2 unless it is the final node */
@@ -460,9 +538,9 @@ static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
 
        /* calculate the score for the segment and cumulative */
        if(option_quickest==0)
-          segment_score=(score_t)DISTANCE(segment2p->distance)/segment_pref;
+          segment_score=(score_t)DISTANCE(segment2p->distance)/waycost2p->pref;
        else
-          segment_score=(score_t)Duration(segment2p,way2p,profile)/segment_pref;
+          segment_score=(score_t)WayCostDuration(segment2p,waycost2p)/waycost2p->pref;
 
        cumulative_score=result1->score+segment_score;
 
@@ -546,6 +624,187 @@ static Results *FindNormalRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Find all of the nodes that can be reached from a node within a maximum distance or duration
+  (a Dijkstra search that does not stop at super-nodes and has no finish node to aim for).
+
+  Results *FindReachableNodes Returns a set of results with the distance or duration to each node/segment as the score.
+
+  Nodes *nodes The set of nodes to use.
+
+  Segments *segments The set of segments to use.
+
+  Ways *ways The set of ways to use.
+
+  Relations *relations The set of relations to use.
+
+  Profile *profile The profile containing the transport type, speeds and allowed highways.
+
+  index_t start_node The start node.
+
+  score_t max_score The maximum duration (if option_quickest is set) or distance (otherwise) to search.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+Results *FindReachableNodes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,score_t max_score)
+{
+ Results *results;
+ Queue   *queue;
+ Result  *start_result;
+ Result  *result1,*result2;
+
+#if DEBUG
+ printf("  FindReachableNodes(...,start_node=%"Pindex_t" max_score=%f)\n",start_node,max_score);
+#endif
+
+ /* Create the list of results and insert the first node into the queue */
+
+ results=NewResultsList(12);
+ queue=NewQueueList(12);
+
+ start_result=InsertResult(results,start_node,NO_SEGMENT);
+
+ InsertInQueue(queue,start_result,0);
+
+ /* Loop across all nodes in the queue */
+
+ while((result1=PopFromQueue(queue)))
+   {
+    Node *node1p=NULL;
+    Segment *segment2p;
+    index_t node1,seg1,seg1r;
+    index_t turnrelation=NO_RELATION;
+
+    node1=result1->node;
+    seg1=result1->segment;
+
+    if(IsFakeSegment(seg1))
+       seg1r=IndexRealSegment(seg1);
+    else
+       seg1r=seg1;
+
+    if(!IsFakeNode(node1))
+       node1p=LookupNode(nodes,node1,1);
+
+    /* mode of transport must be allowed through node1 unless it is the start node */
+    if(node1p && node1!=start_node && !(node1p->allow&profile->allow))
+       continue;
+
+    /* lookup if a turn restriction applies */
+    if(profile->turns && node1p && IsTurnRestrictedNode(node1p))
+       turnrelation=FindFirstTurnRelation2(relations,node1,seg1r);
+
+    /* Loop across all segments */
+
+    if(IsFakeNode(node1))
+       segment2p=FirstFakeSegment(node1);
+    else
+       segment2p=FirstSegment(segments,node1p,1);
+
+    while(segment2p)
+      {
+       Way *way2p;
+       WayCost *waycost2p;
+       index_t node2,seg2,seg2r;
+       score_t segment_score,cumulative_score;
+
+       node2=OtherNode(segment2p,node1); /* need this here because we use node2 at the end of the loop */
+
+       /* must be a normal segment */
+       if(!IsNormalSegment(segment2p))
+          goto endloop;
+
+       /* must obey one-way restrictions (unless profile allows) */
+       if(profile->oneway && IsOnewayTo(segment2p,node1))
+         {
+          if(profile->allow!=Transports_Bicycle)
+             goto endloop;
+
+          way2p=LookupWay(ways,segment2p->way,1);
+
+          if(!(way2p->type&Highway_CycleBothWays))
+             goto endloop;
+         }
+
+       if(IsFakeNode(node1) || IsFakeNode(node2))
+         {
+          seg2 =IndexFakeSegment(segment2p);
+          seg2r=IndexRealSegment(seg2);
+         }
+       else
+         {
+          seg2 =IndexSegment(segments,segment2p);
+          seg2r=seg2;
+         }
+
+       /* must not perform U-turn (unless profile allows) */
+       if(profile->turns && (seg1==seg2 || seg1==seg2r || seg1r==seg2 || (seg1r==seg2r && IsFakeUTurn(seg1,seg2))))
+          goto endloop;
+
+       /* must obey turn relations */
+       if(turnrelation!=NO_RELATION && !IsTurnAllowed(relations,turnrelation,node1,seg1r,seg2r,profile->allow))
+          goto endloop;
+
+       waycost2p=&profile->waycost[segment2p->way];
+
+       /* mode of transport, weight/height/width/length restrictions and preferences must allow this highway */
+       if(waycost2p->pref==0)
+          goto endloop;
+
+       /* calculate the actual distance or duration (not weighted by preference) for the segment and cumulative */
+       if(option_quickest==0)
+          segment_score=(score_t)DISTANCE(segment2p->distance);
+       else
+          segment_score=(score_t)WayCostDuration(segment2p,waycost2p);
+
+       cumulative_score=result1->score+segment_score;
+
+       /* score must be within the limit */
+       if(cumulative_score>max_score)
+          goto endloop;
+
+       /* find whether the node/segment combination already exists */
+       result2=FindResult(results,node2,seg2);
+
+       if(!result2) /* New end node/segment combination */
+         {
+          result2=InsertResult(results,node2,seg2);
+          result2->prev=result1;
+          result2->score=cumulative_score;
+         }
+       else if(cumulative_score<result2->score) /* New score for end node/segment combination is better */
+         {
+          result2->prev=result1;
+          result2->score=cumulative_score;
+         }
+       else
+          goto endloop;
+
+       InsertInQueue(queue,result2,result2->score);
+
+      endloop:
+
+       if(IsFakeNode(node1))
+          segment2p=NextFakeSegment(segment2p,node1);
+       else if(IsFakeNode(node2))
+          segment2p=NULL; /* cannot call NextSegment() with a fake segment */
+       else
+          segment2p=NextSegment(segments,segment2p,node1);
+      }
+   }
+
+ FreeQueueList(queue);
+
+ results->start_node  =start_result->node;
+ results->prev_segment=start_result->segment;
+
+#if DEBUG
+ printf("    Found %d node/segment combinations\n",results->number);
+#endif
+
+ return(results);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Find the optimum route between two nodes where the start and end are a set of pre/post-routed super-nodes.
 
@@ -574,6 +833,9 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
  score_t total_score;
  double  start_lat,start_lon;
  double  finish_lat,finish_lon;
+ distance_t start_landmarks[MAX_LANDMARKS],finish_landmarks[MAX_LANDMARKS];
+ distance_t start_offset=INF_DISTANCE,finish_offset=INF_DISTANCE;
+ LandmarkBounds *landmark_cache=NULL;
  Result  *result1,*result2;
  int     force_uturn=0;
 #ifdef LIBROUTINO
@@ -721,6 +983,27 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
    }
 
 
+ /* Find the super-nodes near the start and finish to measure the landmark distances from */
+
+ if(nodes->file.nlandmarks)
+   {
+    start_offset =FindLandmarkAnchor(nodes,profile,begin,start_landmarks);
+    finish_offset=FindLandmarkAnchor(nodes,profile,end,finish_landmarks);
+
+    /* The bounds for each super-node are cached since they are needed each time that the super-node is reached */
+
+    if(start_offset!=INF_DISTANCE || finish_offset!=INF_DISTANCE)
+      {
+       index_t i;
+
+       landmark_cache=(LandmarkBounds*)malloc(LANDMARK_CACHE_SIZE*sizeof(LandmarkBounds));
+
+       for(i=0;i<LANDMARK_CACHE_SIZE;i++)
+          landmark_cache[i].node=NO_NODE;
+      }
+   }
+
+
  /* Loop across all nodes in the two queues, alternating between them */
 
  while(1)
@@ -757,11 +1040,11 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
          {
           Node *node2p;
           Way *way2p;
+          WayCost *waycost2p;
           index_t node2,seg2;
-          score_t segment_pref,segment_score,cumulative_score,potential_score;
+          score_t segment_score,cumulative_score,potential_score;
           double lat,lon;
           distance_t direct;
-          int i;
 
           /* must be a super segment */
           if(!IsSuperSegment(segment2p))
@@ -796,39 +1079,10 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
           if(turnrelation!=NO_RELATION && !IsTurnAllowed(relations,turnrelation,node1,seg1,seg2,profile->allow))
              goto endloop_fwd;
 
-          way2p=LookupWay(ways,segment2p->way,1);
-
-          /* mode of transport must be allowed on the highway */
-          if(!(way2p->allow&profile->allow))
-             goto endloop_fwd;
-
-          /* must obey weight restriction (if exists) */
-          if(way2p->weight && way2p->weight<profile->weight)
-             goto endloop_fwd;
-
-          /* must obey height/width/length restriction (if exist) */
-          if((way2p->height && way2p->height<profile->height) ||
-             (way2p->width  && way2p->width <profile->width ) ||
-             (way2p->length && way2p->length<profile->length))
-             goto endloop_fwd;
-
-          segment_pref=profile->highway[HIGHWAY(way2p->type)];
-
-          /* highway preferences must allow this highway */
-          if(segment_pref==0)
-             goto endloop_fwd;
-
-          for(i=1;i<Property_Count;i++)
-             if(ways->file.props & PROPERTIES(i))
-               {
-                if(way2p->props & PROPERTIES(i))
-                   segment_pref*=profile->props_yes[i];
-                else
-                   segment_pref*=profile->props_no[i];
-               }
+          waycost2p=&profile->waycost[segment2p->way];
 
-          /* profile preferences must allow this highway */
-          if(segment_pref==0)
+          /* mode of transport, weight/height/width/length restrictions and preferences must allow this highway */
+          if(waycost2p->pref==0)
              goto endloop_fwd;
 
           node2=OtherNode(segment2p,node1);
@@ -841,9 +1095,9 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
 
           /* calculate the score for the segment and cumulative */
           if(option_quickest==0)
-             segment_score=(score_t)DISTANCE(segment2p->distance)/segment_pref;
+             segment_score=(score_t)DISTANCE(segment2p->distance)/waycost2p->pref;
           else
-             segment_score=(score_t)Duration(segment2p,way2p,profile)/segment_pref;
+             segment_score=(score_t)WayCostDuration(segment2p,waycost2p)/waycost2p->pref;
 
           cumulative_score=result1->score+segment_score;
 
@@ -866,6 +1120,10 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
              goto endloop_fwd;
             }
 
+          /* must stay on second level super-nodes once on one (except for a U-turn at the start) */
+          if(IsSuper2Node(node1p) && !IsSuper2Node(node2p) && !(force_uturn && node1==begin->start_node))
+             goto endloop_fwd;
+
           if(!result2) /* New end node/segment pair */
             {
              result2=InsertResult(results,node2,seg2);
@@ -886,6 +1144,15 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
 
           direct=Distance(lat,lon,finish_lat,finish_lon);
 
+          /* use the landmark distances if they give a better lower bound */
+          if(finish_offset!=INF_DISTANCE)
+            {
+             distance_t bound=GetLandmarkBounds(nodes,landmark_cache,node2,start_landmarks,finish_landmarks)->finish;
+
+             if(bound>(direct+finish_offset))
+                direct=bound-finish_offset;
+            }
+
           if(option_quickest==0)
              potential_score=result2->score+(score_t)direct/profile->max_pref;
           else
@@ -917,10 +1184,9 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
       {
        Node *node1p;
        Segment *segment1p,*segment2p;
-       Way *way1p;
+       WayCost *waycost1p;
        index_t real_node1,node1,seg1;
-       score_t segment1_pref,segment1_score=0;
-       int i;
+       score_t segment1_score=0;
 
        /* score must be better than current best score */
        if(result1->score>=total_score)
@@ -939,24 +1205,13 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
        if(!(node1p->allow&profile->allow))
           continue;
 
-       way1p=LookupWay(ways,segment1p->way,1);
-
-       segment1_pref=profile->highway[HIGHWAY(way1p->type)];
-
-       for(i=1;i<Property_Count;i++)
-          if(ways->file.props & PROPERTIES(i))
-            {
-             if(way1p->props & PROPERTIES(i))
-                segment1_pref*=profile->props_yes[i];
-             else
-                segment1_pref*=profile->props_no[i];
-            }
+       waycost1p=&profile->waycost[segment1p->way];
 
        /* calculate the score for the segment */
        if(option_quickest==0)
-          segment1_score=(score_t)DISTANCE(segment1p->distance)/segment1_pref;
+          segment1_score=(score_t)DISTANCE(segment1p->distance)/waycost1p->pref;
        else
-          segment1_score=(score_t)Duration(segment1p,way1p,profile)/segment1_pref;
+          segment1_score=(score_t)WayCostDuration(segment1p,waycost1p)/waycost1p->pref;
 
        /* Loop across all segments */
 
@@ -966,8 +1221,9 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
          {
           Node *node2p;
           Way *way2p;
+          WayCost *waycost2p;
           index_t node2,seg2;
-          score_t segment_pref,cumulative_score,potential_score;
+          score_t cumulative_score,potential_score;
           double lat,lon;
           distance_t direct;
 
@@ -1005,39 +1261,10 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
                 goto endloop_rev;
             }
 
-          way2p=LookupWay(ways,segment2p->way,1);
-
-          /* mode of transport must be allowed on the highway */
-          if(!(way2p->allow&profile->allow))
-             goto endloop_rev;
-
-          /* must obey weight restriction (if exists) */
-          if(way2p->weight && way2p->weight<profile->weight)
-             goto endloop_rev;
+          waycost2p=&profile->waycost[segment2p->way];
 
-          /* must obey height/width/length restriction (if exist) */
-          if((way2p->height && way2p->height<profile->height) ||
-             (way2p->width  && way2p->width <profile->width ) ||
-             (way2p->length && way2p->length<profile->length))
-             goto endloop_rev;
-
-          segment_pref=profile->highway[HIGHWAY(way2p->type)];
-
-          /* highway preferences must allow this highway */
-          if(segment_pref==0)
-             goto endloop_rev;
-
-          for(i=1;i<Property_Count;i++)
-             if(ways->file.props & PROPERTIES(i))
-               {
-                if(way2p->props & PROPERTIES(i))
-                   segment_pref*=profile->props_yes[i];
-                else
-                   segment_pref*=profile->props_no[i];
-               }
-
-          /* profile preferences must allow this highway */
-          if(segment_pref==0)
+          /* mode of transport, weight/height/width/length restrictions and preferences must allow this highway */
+          if(waycost2p->pref==0)
              goto endloop_rev;
 
           node2=OtherNode(segment2p,node1);
@@ -1060,6 +1287,12 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
              goto endloop_rev;
             }
 
+          node2p=LookupNode(nodes,node2,2); /* node2 cannot be a fake node (must be a super-node) */
+
+          /* must stay on second level super-nodes once on one */
+          if(IsSuper2Node(node1p) && !IsSuper2Node(node2p))
+             goto endloop_rev;
+
           if(!result2) /* New end node/segment pair */
             {
              result2=InsertResult(results,node1,seg2); /* adding in reverse => node1,seg2 */
@@ -1076,12 +1309,19 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
 
           /* Insert a new node into the queue */
 
-          node2p=LookupNode(nodes,node2,2); /* node2 cannot be a fake node (must be a super-node) */
-
           GetLatLong(nodes,node2,node2p,&lat,&lon);
 
           direct=Distance(lat,lon,start_lat,start_lon);
 
+          /* use the landmark distances if they give a better lower bound */
+          if(start_offset!=INF_DISTANCE)
+            {
+             distance_t bound=GetLandmarkBounds(nodes,landmark_cache,node2,start_landmarks,finish_landmarks)->start;
+
+             if(bound>(direct+start_offset))
+                direct=bound-start_offset;
+            }
+
           if(option_quickest==0)
              potential_score=result2->score+(score_t)direct/profile->max_pref;
           else
@@ -1114,6 +1354,9 @@ static Results *FindMiddleRoute(Nodes *nodes,Segments *segments,Ways *ways,Relat
  FreeQueueList(fwd_queue);
  FreeQueueList(rev_queue);
 
+ if(landmark_cache)
+    free(landmark_cache);
+
  /* Check it worked */
 
  if(!finish_result)
@@ -1427,10 +1670,10 @@ static Results *FindSuperRoute(Nodes *nodes,Segments *segments,Ways *ways,Relati
 
   index_t prev_segment The previous segment before the start node.
 
-  index_t finish_node The finish node.
+  index_t finish_node The finish node (or NO_NODE to find the routes to the super-nodes for any finish node).
   ++++++++++++++++++++++++++++++++++++++*/
 
-static Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node)
+Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t start_node,index_t prev_segment,index_t finish_node)
 {
  Results *results;
  Queue   *queue,*superqueue;
@@ -1507,9 +1750,9 @@ static Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relat
       {
        Node *node2p=NULL;
        Way *way2p;
+       WayCost *waycost2p;
        index_t node2,seg2,seg2r;
-       score_t segment_pref,segment_score,cumulative_score;
-       int i;
+       score_t segment_score,cumulative_score;
 
        node2=OtherNode(segment2p,node1); /* need this here because we use node2 at the end of the loop */
 
@@ -1555,39 +1798,10 @@ static Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relat
        if(turnrelation!=NO_RELATION && !IsTurnAllowed(relations,turnrelation,node1,seg1r,seg2r,profile->allow))
           goto endloop;
 
-       way2p=LookupWay(ways,segment2p->way,1);
+       waycost2p=&profile->waycost[segment2p->way];
 
-       /* mode of transport must be allowed on the highway */
-       if(!(way2p->allow&profile->allow))
-          goto endloop;
-
-       /* must obey weight restriction (if exists) */
-       if(way2p->weight && way2p->weight<profile->weight)
-          goto endloop;
-
-       /* must obey height/width/length restriction (if exists) */
-       if((way2p->height && way2p->height<profile->height) ||
-          (way2p->width  && way2p->width <profile->width ) ||
-          (way2p->length && way2p->length<profile->length))
-          goto endloop;
-
-       segment_pref=profile->highway[HIGHWAY(way2p->type)];
-
-       /* highway preferences must allow this highway */
-       if(segment_pref==0)
-          goto endloop;
-
-       for(i=1;i<Property_Count;i++)
-          if(ways->file.props & PROPERTIES(i))
-            {
-             if(way2p->props & PROPERTIES(i))
-                segment_pref*=profile->props_yes[i];
-             else
-                segment_pref*=profile->props_no[i];
-            }
-
-       /* profile preferences must allow this highway */
-       if(segment_pref==0)
+       /* mode of transport, weight/height/width/length restrictions and preferences must allow this highway */
+       if(waycost2p->pref==0)
           goto endloop;
 
        if(!IsFakeNode(node2))
@@ -1599,9 +1813,9 @@ static Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relat
 
        /* calculate the score for the segment and cumulative */
        if(option_quickest==0)
-          segment_score=(score_t)DISTANCE(segment2p->distance)/segment_pref;
+          segment_score=(score_t)DISTANCE(segment2p->distance)/waycost2p->pref;
        else
-          segment_score=(score_t)Duration(segment2p,way2p,profile)/segment_pref;
+          segment_score=(score_t)WayCostDuration(segment2p,waycost2p)/waycost2p->pref;
 
        /* prefer not to follow two fake segments when one would do (special case) */
        if(IsFakeSegment(seg2))
@@ -1747,7 +1961,7 @@ static Results *FindStartRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relat
   index_t finish_node The finishing node.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t finish_node)
+Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relations *relations,Profile *profile,index_t finish_node)
 {
  Results *results,*finish_results;
  Queue   *queue;
@@ -1780,11 +1994,10 @@ static Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Rela
    {
     Node *node1p=NULL;
     Segment *segment1p,*segment2p;
-    Way *way1p;
+    WayCost *waycost1p;
     index_t real_node1,node1,seg1,seg1r;
     index_t turnrelation=NO_RELATION;
-    score_t segment1_pref,segment1_score=0;
-    int i;
+    score_t segment1_score=0;
 
     real_node1=result1->node;
     seg1=result1->segment;
@@ -1817,24 +2030,13 @@ static Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Rela
 
     if(seg1!=NO_SEGMENT)
       {
-       way1p=LookupWay(ways,segment1p->way,1);
-
-       segment1_pref=profile->highway[HIGHWAY(way1p->type)];
-
-       for(i=1;i<Property_Count;i++)
-          if(ways->file.props & PROPERTIES(i))
-            {
-             if(way1p->props & PROPERTIES(i))
-                segment1_pref*=profile->props_yes[i];
-             else
-                segment1_pref*=profile->props_no[i];
-            }
+       waycost1p=&profile->waycost[segment1p->way];
 
        /* calculate the score for the segment */
        if(option_quickest==0)
-          segment1_score=(score_t)DISTANCE(segment1p->distance)/segment1_pref;
+          segment1_score=(score_t)DISTANCE(segment1p->distance)/waycost1p->pref;
        else
-          segment1_score=(score_t)Duration(segment1p,way1p,profile)/segment1_pref;
+          segment1_score=(score_t)WayCostDuration(segment1p,waycost1p)/waycost1p->pref;
 
        /* prefer not to follow two fake segments when one would do (special case) */
        if(IsFakeSegment(seg1))
@@ -1852,8 +2054,9 @@ static Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Rela
       {
        Node *node2p=NULL;
        Way *way2p;
+       WayCost *waycost2p;
        index_t node2,seg2,seg2r;
-       score_t segment_pref,cumulative_score;
+       score_t cumulative_score;
 
        /* must be a normal segment unless node1 is a super-node (see below). */
        if((IsFakeNode(node1) || !IsSuperNode(node1p)) && !IsNormalSegment(segment2p))
@@ -1916,39 +2119,10 @@ static Results *FindFinishRoutes(Nodes *nodes,Segments *segments,Ways *ways,Rela
              goto endloop;
          }
 
-       way2p=LookupWay(ways,segment2p->way,1);
-
-       /* mode of transport must be allowed on the highway */
-       if(!(way2p->allow&profile->allow))
-          goto endloop;
-
-       /* must obey weight restriction (if exists) */
-       if(way2p->weight && way2p->weight<profile->weight)
-          goto endloop;
-
-       /* must obey height/width/length restriction (if exist) */
-       if((way2p->height && way2p->height<profile->height) ||
-          (way2p->width  && way2p->width <profile->width ) ||
-          (way2p->length && way2p->length<profile->length))
-          goto endloop;
-
-       segment_pref=profile->highway[HIGHWAY(way2p->type)];
-
-       /* highway preferences must allow this highway */
-       if(segment_pref==0)
-          goto endloop;
-
-       for(i=1;i<Property_Count;i++)
-          if(ways->file.props & PROPERTIES(i))
-            {
-             if(way2p->props & PROPERTIES(i))
-                segment_pref*=profile->props_yes[i];
-             else
-                segment_pref*=profile->props_no[i];
-            }
+       waycost2p=&profile->waycost[segment2p->way];
 
-       /* profile preferences must allow this highway */
-       if(segment_pref==0)
+       /* mode of transport, weight/height/width/length restrictions and preferences must allow this highway */
+       if(waycost2p->pref==0)
           goto endloop;
 
        if(!IsFakeNode(node2))
@@ -2122,8 +2296,15 @@ static Results *CombineRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relatio
 
  while(midres->next && midres->next!=NO_RESULT)
    {
-    Results *results=FindNormalRoute(nodes,segments,ways,relations,profile,comres->node,comres->segment,midres->next->node);
+    Results *results;
     Result *result;
+    int super2=0;
+
+    /* a second level super-segment may pass through other super-nodes */
+    if(!IsFakeNode(comres->node) && !IsFakeNode(midres->next->node))
+       super2=IsSuper2Node(LookupNode(nodes,comres->node,1)) && IsSuper2Node(LookupNode(nodes,midres->next->node,2));
+
+    results=FindNormalRoute(nodes,segments,ways,relations,profile,comres->node,comres->segment,midres->next->node,super2);
 
     if(!results)
       {
@@ -2222,6 +2403,154 @@ static Results *CombineRoutes(Nodes *nodes,Segments *segments,Ways *ways,Relatio
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Check if two nodes are in the same connected component for the type of transport (if not then no route is possible).
+
+  int ConnectedNodes Returns 1 if the nodes are in the same component.
+
+  Nodes *nodes The set of nodes to use.
+
+  Profile *profile The profile containing the transport type.
+
+  index_t node1 The first node (may be a fake node).
+
+  index_t node2 The second node (may be a fake node).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int ConnectedNodes(Nodes *nodes,Profile *profile,index_t node1,index_t node2)
+{
+ /* A fake node is in the same component as the real node at the start of the segment that it splits */
+
+ if(IsFakeNode(node1))
+    node1=FirstFakeSegment(node1)->node1;
+
+ if(IsFakeNode(node2))
+    node2=FirstFakeSegment(node2)->node1;
+
+ return(FindNodeComponent(nodes,node1,profile->transport)==FindNodeComponent(nodes,node2,profile->transport));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the super-node with the lowest score in the start or finish portion of a route and get its landmark distances.
+
+  distance_t FindLandmarkAnchor Returns an upper limit on the distance from the super-node to the start or finish
+  (or INF_DISTANCE if there is no super-node).
+
+  Nodes *nodes The set of nodes to use.
+
+  Profile *profile The profile containing the transport type, speeds and allowed highways.
+
+  Results *results The start or finish portion of the route.
+
+  distance_t *landmarks Returns the distances to the landmarks from the selected super-node.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static distance_t FindLandmarkAnchor(Nodes *nodes,Profile *profile,Results *results,distance_t *landmarks)
+{
+ Result *result=FirstResult(results),*best=NULL;
+
+ while(result)
+   {
+    if(!IsFakeNode(result->node) && (!best || result->score<best->score) && IsSuperNode(LookupNode(nodes,result->node,3)))
+       best=result;
+
+    result=NextResult(results,result);
+   }
+
+ if(!best || !GetLandmarkDistances(nodes,best->node,landmarks))
+   {
+    index_t i;
+
+    for(i=0;i<nodes->file.nlandmarks;i++)
+       landmarks[i]=INF_DISTANCE;
+
+    return(INF_DISTANCE);
+   }
+
+ /* The score is at least the distance divided by the maximum preference (or the duration at the maximum speed
+    divided by the maximum preference) so the route to the super-node can be no longer than this. */
+
+ if(option_quickest==0)
+    return((distance_t)(best->score*profile->max_pref)+1);
+ else
+    return(duration_speed_to_distance(best->score*profile->max_pref,profile->max_speed)+1);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the lower bound on the distance between two super-nodes from their distances to the landmarks.
+
+  distance_t LandmarkDistance Returns the largest difference between the distances to any of the landmarks.
+
+  Nodes *nodes The set of nodes to use.
+
+  distance_t *landmarks1 The distances from the first super-node to the landmarks.
+
+  distance_t *landmarks2 The distances from the second super-node to the landmarks.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static distance_t LandmarkDistance(Nodes *nodes,distance_t *landmarks1,distance_t *landmarks2)
+{
+ distance_t bound=0;
+ index_t i;
+
+ for(i=0;i<nodes->file.nlandmarks;i++)
+   {
+    if(landmarks1[i]==INF_DISTANCE || landmarks2[i]==INF_DISTANCE)
+       continue;
+
+    if(landmarks1[i]>landmarks2[i] && (landmarks1[i]-landmarks2[i])>bound)
+       bound=landmarks1[i]-landmarks2[i];
+    else if(landmarks2[i]>landmarks1[i] && (landmarks2[i]-landmarks1[i])>bound)
+       bound=landmarks2[i]-landmarks1[i];
+   }
+
+ return(bound);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Get the lower bounds on the distances from a super-node to the start and finish using a cache of the ones already
+  calculated (each super-node is reached from several segments in the middle route search).
+
+  LandmarkBounds *GetLandmarkBounds Returns a pointer to the cached bounds.
+
+  Nodes *nodes The set of nodes to use.
+
+  LandmarkBounds *cache The cache of bounds (LANDMARK_CACHE_SIZE entries).
+
+  index_t node The super-node.
+
+  distance_t *start_landmarks The distances from the super-node near the start to the landmarks.
+
+  distance_t *finish_landmarks The distances from the super-node near the finish to the landmarks.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static LandmarkBounds *GetLandmarkBounds(Nodes *nodes,LandmarkBounds *cache,index_t node,
+                                         distance_t *start_landmarks,distance_t *finish_landmarks)
+{
+ LandmarkBounds *bounds=&cache[node%LANDMARK_CACHE_SIZE];
+
+ if(bounds->node!=node)
+   {
+    distance_t landmarks[MAX_LANDMARKS];
+
+    bounds->node=node;
+
+    if(GetLandmarkDistances(nodes,node,landmarks))
+      {
+       bounds->start =LandmarkDistance(nodes,landmarks,start_landmarks);
+       bounds->finish=LandmarkDistance(nodes,landmarks,finish_landmarks);
+      }
+    else
+       bounds->start=bounds->finish=0;
+   }
+
+ return(bounds);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Fix the forward route (i.e. setup next pointers for forward path from prev nodes on reverse path).
 
@@ -38,6 +38,7 @@
 
 #include "osmparser.h"
 #include "tagging.h"
+#include "files.h"
 #include "logging.h"
 
 
@@ -120,7 +121,7 @@ static inline int buffer_refill(int fd,uint32_t bytes)
 
  do
    {
-    n=read(fd,buffer_end,bytes);
+    n=ReadFile(fd,buffer_end,bytes);
 
     if(n<=0)
        return(1);
@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2012-2015 Andrew M. Bishop
+ This file Copyright 2012-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -39,8 +39,13 @@
 #include <zlib.h>
 #endif
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "osmparser.h"
 #include "tagging.h"
+#include "files.h"
 #include "logging.h"
 
 
@@ -129,21 +134,80 @@
 #define PBF_ERROR_TOO_MANY_GROUPS 112
 
 
+/* Block states */
+
+#define BLOCK_EMPTY                 0
+#define BLOCK_READ                  1
+#define BLOCK_DECODING              2
+#define BLOCK_DECODED               3
+
+
+/* Data types */
+
+/*+ A structure to hold a PBF Blob while it is decoded. +*/
+typedef struct _PBFBlock
+{
+ int            state;                       /*+ The state of the block (empty, read, decoding or decoded). +*/
+ int            error;                       /*+ The error state from decoding the block (or zero). +*/
+ uint64_t       byteno;                      /*+ The byte number in the file at the end of the block. +*/
+
+ int            osm_header;                  /*+ Set if the block contains a HeaderBlock message. +*/
+ int            osm_data;                    /*+ Set if the block contains a PrimitiveBlock message. +*/
+
+ uint32_t       blob_length;                 /*+ The length of the Blob message. +*/
+ uint32_t       blob_allocated;              /*+ The allocated size of the Blob message buffer. +*/
+ unsigned char *blob;                        /*+ The Blob message as read from the file. +*/
+
+ uint32_t       zbuffer_allocated;           /*+ The allocated size of the uncompressed data buffer. +*/
+ unsigned char *zbuffer;                     /*+ The uncompressed data. +*/
+
+ unsigned char *unsupported;                 /*+ The name of an unsupported required feature. +*/
+
+ int            string_table_length;         /*+ The number of strings in the StringTable. +*/
+ int            string_table_allocated;      /*+ The allocated number of strings in the StringTable. +*/
+ unsigned char **string_table;               /*+ The strings in the StringTable. +*/
+ uint32_t      *string_table_string_lengths; /*+ The lengths of the strings in the StringTable. +*/
+ int           *string_table_kid;            /*+ The strings in the StringTable as interned tag keys (or -2 if not yet known). +*/
+ int           *string_table_vid;            /*+ The strings in the StringTable as interned tag values (or -2 if not yet known). +*/
+
+ int32_t        granularity;                 /*+ The granularity of the latitude and longitude. +*/
+ int64_t        lat_offset;                  /*+ The offset of the latitude. +*/
+ int64_t        lon_offset;                  /*+ The offset of the longitude. +*/
+
+ uint32_t       nprimitive_groups;           /*+ The number of PrimitiveGroup messages. +*/
+ unsigned char *primitive_group[8];          /*+ The PrimitiveGroup messages. +*/
+ uint32_t       primitive_group_length[8];   /*+ The lengths of the PrimitiveGroup messages. +*/
+}
+ PBFBlock;
+
+
+/*+ The number of threads to use for decoding PBF blocks. +*/
+extern int option_parse_threads;
+
+
 /* Local parsing variables (re-initialised for each file) */
 
 static uint64_t byteno;
 static uint64_t nnodes,nways,nrelations;
 
-static uint32_t buffer_allocated,zbuffer_allocated;
-static unsigned char *buffer=NULL,*zbuffer=NULL;
+static uint32_t buffer_allocated;
+static unsigned char *buffer=NULL;
 static unsigned char *buffer_ptr,*buffer_end;
 
-static int string_table_length=0,string_table_allocated=0;
-static unsigned char **string_table=NULL;
-static uint32_t *string_table_string_lengths=NULL;
+static int nblocks;
+static PBFBlock *blocks=NULL;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
 
-static int32_t granularity=100;
-static int64_t lat_offset=0,lon_offset=0;
+static int nthreads;
+static pthread_t *threads=NULL;
+
+static int next_block,finished;
+
+static pthread_mutex_t blocks_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  blocks_cond  = PTHREAD_COND_INITIALIZER;
+
+#endif
 
 #define LENGTH_32M (32*1024*1024)
 
@@ -172,7 +236,7 @@ static inline int buffer_refill(int fd,uint32_t bytes)
 
  do
    {
-    n=read(fd,buffer_end,bytes);
+    n=ReadFile(fd,buffer_end,bytes);
 
     if(n<=0)
        return(1);
@@ -185,24 +249,29 @@ static inline int buffer_refill(int fd,uint32_t bytes)
  return(0);
 }
 
+static int read_block(int fd,PBFBlock *block,uint32_t bytes);
+static int decode_block(PBFBlock *block);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+static void *decode_blocks_thread(void *arg);
+#endif
+
 #if defined(USE_GZIP) && USE_GZIP
-static int uncompress_pbf(unsigned char *data,uint32_t compressed,uint32_t uncompressed);
+static int uncompress_pbf(PBFBlock *block,unsigned char *data,uint32_t compressed,uint32_t uncompressed);
 #endif /* USE_GZIP */
 
-static void process_string_table(unsigned char *data,uint32_t length);
-static void process_primitive_group(unsigned char *data,uint32_t length);
-static void process_nodes(unsigned char *data,uint32_t length);
-static void process_dense_nodes(unsigned char *data,uint32_t length);
-static void process_ways(unsigned char *data,uint32_t length);
-static void process_relations(unsigned char *data,uint32_t length);
+static void process_string_table(PBFBlock *block,unsigned char *data,uint32_t length);
+static void process_primitive_group(PBFBlock *block,unsigned char *data,uint32_t length);
+static void process_nodes(PBFBlock *block,unsigned char *data,uint32_t length);
+static void process_dense_nodes(PBFBlock *block,unsigned char *data,uint32_t length);
+static void process_ways(PBFBlock *block,unsigned char *data,uint32_t length);
+static void process_relations(PBFBlock *block,unsigned char *data,uint32_t length);
 
 
 /* Macros to simplify the parser (and make it look more like the XML parser) */
 
 #define BEGIN(xx)            do{ state=(xx); goto finish_parsing; } while(0)
 
-#define BUFFER_CHARS_EOF(xx) do{ if(buffer_refill(fd,(xx))) BEGIN(PBF_EOF); } while(0)
-
 #define BUFFER_CHARS(xx)     do{ if(buffer_refill(fd,(xx))) BEGIN(PBF_ERROR_UNEXP_EOF); } while(0)
 
 
@@ -211,8 +280,32 @@ static void process_relations(unsigned char *data,uint32_t length);
 #define PBF_FIELD(xx)   (int)(((xx)&0xFFF8)>>3)
 #define PBF_TYPE(xx)    (int)((xx)&0x0007)
 
-#define PBF_LATITUDE(xx)  (double)(1E-9*(granularity*(xx)+lat_offset))
-#define PBF_LONGITUDE(xx) (double)(1E-9*(granularity*(xx)+lon_offset))
+#define PBF_LATITUDE(bb,xx)  (double)(1E-9*((bb)->granularity*(xx)+(bb)->lat_offset))
+#define PBF_LONGITUDE(bb,xx) (double)(1E-9*((bb)->granularity*(xx)+(bb)->lon_offset))
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Append a tag from the StringTable to a list of tags, looking up each string only once per block.
+
+  PBFBlock *block The block containing the StringTable.
+
+  TagList *tags The list of tags to append to.
+
+  uint32_t key The index of the tag key in the StringTable.
+
+  uint32_t val The index of the tag value in the StringTable.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline void pbf_append_tag(PBFBlock *block,TagList *tags,uint32_t key,uint32_t val)
+{
+ if(block->string_table_kid[key]==-2)
+    block->string_table_kid[key]=InternTagKey((char*)block->string_table[key]);
+
+ if(block->string_table_vid[val]==-2)
+    block->string_table_vid[val]=LookupTagValue((char*)block->string_table[val]);
+
+ AppendTagIds(tags,(char*)block->string_table[key],block->string_table_kid[key],(char*)block->string_table[val],block->string_table_vid[val]);
+}
 
 
 /*++++++++++++++++++++++++++++++++++++++
@@ -367,8 +460,10 @@ static inline void pbf_skip(unsigned char **ptr,int type)
 
 static int ParsePBF(int fd)
 {
- int state;
+ int state=PBF_EOF;
  unsigned char *error=NULL;
+ int first=0,nqueued=0,eof=0;
+ int i;
 
  /* Print the initial message */
 
@@ -380,136 +475,80 @@ static int ParsePBF(int fd)
 
  nnodes=0,nways=0,nrelations=0;
 
- string_table_allocated=16384;
- string_table_length=0;
- string_table=(unsigned char **)malloc(string_table_allocated*sizeof(unsigned char *));
- string_table_string_lengths=(uint32_t *)malloc(string_table_allocated*sizeof(uint32_t));
-
- zbuffer_allocated=0;
- zbuffer=NULL;
-
  buffer_allocated=65536;
  buffer=(unsigned char*)malloc(buffer_allocated);
 
  buffer_ptr=buffer_end=buffer;
 
- while(1)
-   {
-    int32_t blob_header_length=0;
-    int osm_data=0,osm_header=0;
-    int32_t blob_length=0;
-    uint32_t raw_size=0,compressed_size=0,uncompressed_size=0;
-    unsigned char *raw_data=NULL,*zlib_data=NULL;
-    uint32_t length;
-    unsigned char *data;
-
-    /* ================ Parsing states ================ */
-
-
-    BUFFER_CHARS_EOF(4);
+ /* Allocate the blocks and start the threads that decode them */
 
-    blob_header_length=(256*(256*(256*(int)buffer_ptr[0])+(int)buffer_ptr[1])+(int)buffer_ptr[2])+buffer_ptr[3];
-    buffer_ptr+=4;
-
-    if(blob_header_length==0 || blob_header_length>LENGTH_32M)
-       BEGIN(PBF_ERROR_BLOB_HEADER_LEN);
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ if(option_parse_threads>1)
+    nblocks=2*option_parse_threads;
+ else
+#endif
+    nblocks=1;
 
+ blocks=(PBFBlock*)calloc(nblocks,sizeof(PBFBlock));
 
-    BUFFER_CHARS(blob_header_length);
+ for(i=0;i<nblocks;i++)
+   {
+    blocks[i].string_table_allocated=16384;
+    blocks[i].string_table=(unsigned char **)malloc(blocks[i].string_table_allocated*sizeof(unsigned char *));
+    blocks[i].string_table_string_lengths=(uint32_t *)malloc(blocks[i].string_table_allocated*sizeof(uint32_t));
+    blocks[i].string_table_kid=(int *)malloc(blocks[i].string_table_allocated*sizeof(int));
+    blocks[i].string_table_vid=(int *)malloc(blocks[i].string_table_allocated*sizeof(int));
+   }
 
-    osm_header=0;
-    osm_data=0;
+#if defined(USE_PTHREADS) && USE_PTHREADS
 
-    while(buffer_ptr<buffer_end)
-      {
-       int fieldtype=pbf_int32(&buffer_ptr);
-       int field=PBF_FIELD(fieldtype);
+ next_block=0;
+ finished=0;
 
-       switch(field)
-         {
-         case PBF_VAL_BLOBHEADER_TYPE: /* string */
-          {
-           uint32_t length=0;
-           unsigned char *type=NULL;
+ nthreads=option_parse_threads>1?option_parse_threads:0;
 
-           type=pbf_length_delimited(&buffer_ptr,&length);
-
-           if(length==9 && !strncmp((char*)type,"OSMHeader",9))
-              osm_header=1;
-
-           if(length==7 && !strncmp((char*)type,"OSMData",7))
-              osm_data=1;
-          }
-          break;
+ if(nthreads)
+   {
+    threads=(pthread_t*)malloc(nthreads*sizeof(pthread_t));
 
-         case PBF_VAL_BLOBHEADER_SIZE: /* int32 */
-          blob_length=pbf_int32(&buffer_ptr);
-          break;
+    for(i=0;i<nthreads;i++)
+       pthread_create(&threads[i],NULL,decode_blocks_thread,NULL);
+   }
 
-         default:
-          pbf_skip(&buffer_ptr,PBF_TYPE(fieldtype));
-         }
-      }
+#endif
 
-    if(blob_length==0 || blob_length>LENGTH_32M)
-       BEGIN(PBF_ERROR_BLOB_LEN);
+ while(1)
+   {
+    PBFBlock *block;
 
-    if(!osm_data && !osm_header)
-       BEGIN(PBF_ERROR_NOT_OSM);
+    /* ================ Parsing states ================ */
 
 
-    BUFFER_CHARS(blob_length);
+    /* Read as many blocks as there is space for */
 
-    while(buffer_ptr<buffer_end)
+    while(!eof && nqueued<nblocks)
       {
-       int fieldtype=pbf_int32(&buffer_ptr);
-       int field=PBF_FIELD(fieldtype);
-
-       switch(field)
-         {
-         case PBF_VAL_BLOB_RAW_DATA: /* bytes */
-          raw_data=pbf_length_delimited(&buffer_ptr,&raw_size);
-          break;
+       int32_t blob_header_length=0;
+       int osm_data=0,osm_header=0;
+       int32_t blob_length=0;
 
-         case PBF_VAL_BLOB_RAW_SIZE: /* int32 */
-          uncompressed_size=pbf_int32(&buffer_ptr);
-          break;
+       block=&blocks[(first+nqueued)%nblocks];
 
-         case PBF_VAL_BLOB_ZLIB_DATA: /* bytes */
-          zlib_data=pbf_length_delimited(&buffer_ptr,&compressed_size);
+       if(buffer_refill(fd,4))
+         {
+          eof=1;
           break;
-
-         default:
-          pbf_skip(&buffer_ptr,PBF_TYPE(fieldtype));
          }
-      }
 
-    if(raw_data && zlib_data)
-       BEGIN(PBF_ERROR_BLOB_BOTH);
+       blob_header_length=(256*(256*(256*(int)buffer_ptr[0])+(int)buffer_ptr[1])+(int)buffer_ptr[2])+buffer_ptr[3];
+       buffer_ptr+=4;
 
-    if(!raw_data && !zlib_data)
-       BEGIN(PBF_ERROR_BLOB_NEITHER);
+       if(blob_header_length==0 || blob_header_length>LENGTH_32M)
+          BEGIN(PBF_ERROR_BLOB_HEADER_LEN);
 
-    if(zlib_data)
-      {
-#if defined(USE_GZIP) && USE_GZIP
-       int newstate=uncompress_pbf(zlib_data,compressed_size,uncompressed_size);
-
-       if(newstate)
-          BEGIN(newstate);
-#else
-       BEGIN(PBF_ERROR_NO_GZIP);
-#endif
-      }
-    else
-      {
-       buffer_ptr=raw_data;
-       buffer_end=raw_data+raw_size;
-      }
 
+       BUFFER_CHARS(blob_header_length);
 
-    if(osm_header)
-      {
        while(buffer_ptr<buffer_end)
          {
           int fieldtype=pbf_int32(&buffer_ptr);
@@ -517,88 +556,137 @@ static int ParsePBF(int fd)
 
           switch(field)
             {
-            case PBF_VAL_REQUIRED_FEATURES: /* string */
+            case PBF_VAL_BLOBHEADER_TYPE: /* string */
              {
               uint32_t length=0;
-              unsigned char *feature=NULL;
+              unsigned char *type=NULL;
+
+              type=pbf_length_delimited(&buffer_ptr,&length);
 
-              feature=pbf_length_delimited(&buffer_ptr,&length);
+              if(length==9 && !strncmp((char*)type,"OSMHeader",9))
+                 osm_header=1;
 
-              if(strncmp((char*)feature,"OsmSchema-V0.6",14) &&
-                 strncmp((char*)feature,"DenseNodes",10))
-                {
-                 feature[length]=0;
-                 error=feature;
-                 BEGIN(PBF_ERROR_UNSUPPORTED);
-                }
+              if(length==7 && !strncmp((char*)type,"OSMData",7))
+                 osm_data=1;
              }
              break;
 
-            case PBF_VAL_OPTIONAL_FEATURES: /* string */
-             pbf_length_delimited(&buffer_ptr,NULL);
+            case PBF_VAL_BLOBHEADER_SIZE: /* int32 */
+             blob_length=pbf_int32(&buffer_ptr);
              break;
 
             default:
              pbf_skip(&buffer_ptr,PBF_TYPE(fieldtype));
             }
          }
-      }
 
+       if(blob_length==0 || blob_length>LENGTH_32M)
+          BEGIN(PBF_ERROR_BLOB_LEN);
 
-    if(osm_data)
-      {
-       unsigned char *primitive_group[8]={NULL};
-       uint32_t primitive_group_length[8]={0};
-       uint32_t nprimitive_groups=0,i;
+       if(!osm_data && !osm_header)
+          BEGIN(PBF_ERROR_NOT_OSM);
 
-       granularity=100;
-       lat_offset=lon_offset=0;
 
-       while(buffer_ptr<buffer_end)
-         {
-          int fieldtype=pbf_int32(&buffer_ptr);
-          int field=PBF_FIELD(fieldtype);
+       if(read_block(fd,block,blob_length))
+          BEGIN(PBF_ERROR_UNEXP_EOF);
 
-          switch(field)
-            {
-            case PBF_VAL_STRING_TABLE: /* bytes */
-             data=pbf_length_delimited(&buffer_ptr,&length);
-             process_string_table(data,length);
-             break;
+       block->osm_header=osm_header;
+       block->osm_data=osm_data;
 
-            case PBF_VAL_PRIMITIVE_GROUP: /* bytes */
-             primitive_group[nprimitive_groups]=pbf_length_delimited(&buffer_ptr,&primitive_group_length[nprimitive_groups]);
+       nqueued++;
 
-             if(++nprimitive_groups>(sizeof(primitive_group)/sizeof(primitive_group[0])))
-                BEGIN(PBF_ERROR_TOO_MANY_GROUPS);
-             break;
+       /* Decode the block (or pass it to a thread to decode) */
 
-            case PBF_VAL_GRANULARITY: /* int32 */
-             granularity=pbf_int32(&buffer_ptr);
-             break;
+#if defined(USE_PTHREADS) && USE_PTHREADS
+       if(nthreads)
+         {
+          pthread_mutex_lock(&blocks_mutex);
 
-            case PBF_VAL_LAT_OFFSET: /* int64 */
-             lat_offset=pbf_int64(&buffer_ptr);
-             break;
+          block->state=BLOCK_READ;
 
-            case PBF_VAL_LON_OFFSET: /* int64 */
-             lon_offset=pbf_int64(&buffer_ptr);
-             break;
+          pthread_cond_broadcast(&blocks_cond);
 
-            default:
-             pbf_skip(&buffer_ptr,PBF_TYPE(fieldtype));
-            }
+          pthread_mutex_unlock(&blocks_mutex);
+         }
+       else
+#endif
+         {
+          block->error=decode_block(block);
+          block->state=BLOCK_DECODED;
          }
+      }
+
+    if(nqueued==0)
+       break;
+
+    /* Wait for the first block to be decoded and process it (keeps the file order) */
+
+    block=&blocks[first];
 
-       if(nprimitive_groups)
-          for(i=0;i<nprimitive_groups;i++)
-             process_primitive_group(primitive_group[i],primitive_group_length[i]);
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    if(nthreads)
+      {
+       pthread_mutex_lock(&blocks_mutex);
+
+       while(block->state!=BLOCK_DECODED)
+          pthread_cond_wait(&blocks_cond,&blocks_mutex);
+
+       pthread_mutex_unlock(&blocks_mutex);
+      }
+#endif
+
+    if(block->error)
+      {
+       byteno=block->byteno;
+       error=block->unsupported;
+       BEGIN(block->error);
       }
+
+    if(block->osm_data)
+       for(i=0;i<(int)block->nprimitive_groups;i++)
+          process_primitive_group(block,block->primitive_group[i],block->primitive_group_length[i]);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    if(nthreads)
+       pthread_mutex_lock(&blocks_mutex);
+#endif
+
+    block->state=BLOCK_EMPTY;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    if(nthreads)
+       pthread_mutex_unlock(&blocks_mutex);
+#endif
+
+    first=(first+1)%nblocks;
+    nqueued--;
    }
 
 
  finish_parsing:
 
+ /* Stop the threads */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ if(nthreads)
+   {
+    pthread_mutex_lock(&blocks_mutex);
+
+    finished=1;
+
+    pthread_cond_broadcast(&blocks_cond);
+
+    pthread_mutex_unlock(&blocks_mutex);
+
+    for(i=0;i<nthreads;i++)
+       pthread_join(threads[i],NULL);
+
+    free(threads);
+   }
+
+#endif
+
  switch(state)
    {
     /* End of file */
@@ -665,12 +753,22 @@ static int ParsePBF(int fd)
 
  /* Free the parser variables */
 
- free(string_table);
- free(string_table_string_lengths);
+ for(i=0;i<nblocks;i++)
+   {
+    free(blocks[i].string_table);
+    free(blocks[i].string_table_string_lengths);
+    free(blocks[i].string_table_kid);
+    free(blocks[i].string_table_vid);
+
+    if(blocks[i].blob)
+       free(blocks[i].blob);
+    if(blocks[i].zbuffer)
+       free(blocks[i].zbuffer);
+   }
+
+ free(blocks);
 
  free(buffer);
- if(zbuffer)
-    free(zbuffer);
 
  /* Print the final message */
 
@@ -680,21 +778,285 @@ static int ParsePBF(int fd)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Read a Blob message from the file into a block.
+
+  int read_block Return 0 if everything is OK or 1 for EOF.
+
+  int fd The file descriptor to read from.
+
+  PBFBlock *block The block to read the data into.
+
+  uint32_t bytes The number of bytes to read.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int read_block(int fd,PBFBlock *block,uint32_t bytes)
+{
+ unsigned char *ptr;
+ ssize_t n;
+
+ if(bytes>block->blob_allocated)
+    block->blob=(unsigned char *)realloc(block->blob,block->blob_allocated=bytes);
+
+ byteno+=bytes;
+
+ block->byteno=byteno;
+ block->blob_length=bytes;
+
+ ptr=block->blob;
+
+ do
+   {
+    n=ReadFile(fd,ptr,bytes);
+
+    if(n<=0)
+       return(1);
+
+    ptr+=n;
+    bytes-=n;
+   }
+ while(bytes>0);
+
+ return(0);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Decode a Blob message (uncompressing it if required) and the HeaderBlock or PrimitiveBlock message inside it.
+
+  int decode_block Returns the error state or 0 if OK.
+
+  PBFBlock *block The block to decode.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int decode_block(PBFBlock *block)
+{
+ uint32_t raw_size=0,compressed_size=0,uncompressed_size=0;
+ unsigned char *raw_data=NULL,*zlib_data=NULL;
+ unsigned char *ptr=block->blob,*end=block->blob+block->blob_length;
+ uint32_t length;
+ unsigned char *data;
+ int i;
+
+ block->unsupported=NULL;
+ block->nprimitive_groups=0;
+
+ while(ptr<end)
+   {
+    int fieldtype=pbf_int32(&ptr);
+    int field=PBF_FIELD(fieldtype);
+
+    switch(field)
+      {
+      case PBF_VAL_BLOB_RAW_DATA: /* bytes */
+       raw_data=pbf_length_delimited(&ptr,&raw_size);
+       break;
+
+      case PBF_VAL_BLOB_RAW_SIZE: /* int32 */
+       uncompressed_size=pbf_int32(&ptr);
+       break;
+
+      case PBF_VAL_BLOB_ZLIB_DATA: /* bytes */
+       zlib_data=pbf_length_delimited(&ptr,&compressed_size);
+       break;
+
+      default:
+       pbf_skip(&ptr,PBF_TYPE(fieldtype));
+      }
+   }
+
+ if(raw_data && zlib_data)
+    return(PBF_ERROR_BLOB_BOTH);
+
+ if(!raw_data && !zlib_data)
+    return(PBF_ERROR_BLOB_NEITHER);
+
+ if(zlib_data)
+   {
+#if defined(USE_GZIP) && USE_GZIP
+    int newstate=uncompress_pbf(block,zlib_data,compressed_size,uncompressed_size);
+
+    if(newstate)
+       return(newstate);
+
+    ptr=block->zbuffer;
+    end=block->zbuffer+uncompressed_size;
+#else
+    return(PBF_ERROR_NO_GZIP);
+#endif
+   }
+ else
+   {
+    ptr=raw_data;
+    end=raw_data+raw_size;
+   }
+
+
+ if(block->osm_header)
+   {
+    while(ptr<end)
+      {
+       int fieldtype=pbf_int32(&ptr);
+       int field=PBF_FIELD(fieldtype);
+
+       switch(field)
+         {
+         case PBF_VAL_REQUIRED_FEATURES: /* string */
+          {
+           uint32_t length=0;
+           unsigned char *feature=NULL;
+
+           feature=pbf_length_delimited(&ptr,&length);
+
+           if(strncmp((char*)feature,"OsmSchema-V0.6",14) &&
+              strncmp((char*)feature,"DenseNodes",10))
+             {
+              feature[length]=0;
+              block->unsupported=feature;
+              return(PBF_ERROR_UNSUPPORTED);
+             }
+          }
+          break;
+
+         case PBF_VAL_OPTIONAL_FEATURES: /* string */
+          pbf_length_delimited(&ptr,NULL);
+          break;
+
+         default:
+          pbf_skip(&ptr,PBF_TYPE(fieldtype));
+         }
+      }
+   }
+
+
+ if(block->osm_data)
+   {
+    block->granularity=100;
+    block->lat_offset=block->lon_offset=0;
+
+    block->string_table_length=0;
+
+    while(ptr<end)
+      {
+       int fieldtype=pbf_int32(&ptr);
+       int field=PBF_FIELD(fieldtype);
+
+       switch(field)
+         {
+         case PBF_VAL_STRING_TABLE: /* bytes */
+          data=pbf_length_delimited(&ptr,&length);
+          process_string_table(block,data,length);
+          break;
+
+         case PBF_VAL_PRIMITIVE_GROUP: /* bytes */
+          if(block->nprimitive_groups==(sizeof(block->primitive_group)/sizeof(block->primitive_group[0])))
+             return(PBF_ERROR_TOO_MANY_GROUPS);
+
+          block->primitive_group[block->nprimitive_groups]=pbf_length_delimited(&ptr,&block->primitive_group_length[block->nprimitive_groups]);
+
+          block->nprimitive_groups++;
+          break;
+
+         case PBF_VAL_GRANULARITY: /* int32 */
+          block->granularity=pbf_int32(&ptr);
+          break;
+
+         case PBF_VAL_LAT_OFFSET: /* int64 */
+          block->lat_offset=pbf_int64(&ptr);
+          break;
+
+         case PBF_VAL_LON_OFFSET: /* int64 */
+          block->lon_offset=pbf_int64(&ptr);
+          break;
+
+         default:
+          pbf_skip(&ptr,PBF_TYPE(fieldtype));
+         }
+      }
+
+    /* Fixup the strings (not null terminated in buffer) */
+
+    for(i=0;i<block->string_table_length;i++)
+      {
+       block->string_table[i][block->string_table_string_lengths[i]]=0;
+
+       block->string_table_kid[i]=block->string_table_vid[i]=-2;
+      }
+   }
+
+ return(0);
+}
+
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+/*++++++++++++++++++++++++++++++++++++++
+  A thread that decodes the blocks that have been read from the file in the order they were read.
+
+  void *decode_blocks_thread Returns NULL (required to return void*).
+
+  void *arg Not used (required for pthread_create()).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *decode_blocks_thread(void *arg)
+{
+ pthread_mutex_lock(&blocks_mutex);
+
+ while(1)
+   {
+    PBFBlock *block=&blocks[next_block];
+    int error;
+
+    if(block->state!=BLOCK_READ)
+      {
+       if(finished)
+          break;
+
+       pthread_cond_wait(&blocks_cond,&blocks_mutex);
+       continue;
+      }
+
+    block->state=BLOCK_DECODING;
+
+    next_block=(next_block+1)%nblocks;
+
+    pthread_mutex_unlock(&blocks_mutex);
+
+    error=decode_block(block);
+
+    pthread_mutex_lock(&blocks_mutex);
+
+    block->error=error;
+    block->state=BLOCK_DECODED;
+
+    pthread_cond_broadcast(&blocks_cond);
+   }
+
+ pthread_mutex_unlock(&blocks_mutex);
+
+ return(NULL);
+}
+
+#endif /* USE_PTHREADS */
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Process a PBF StringTable message.
 
+  PBFBlock *block The block containing the data.
+
   unsigned char *data The data to process.
 
   uint32_t length The length of the data.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void process_string_table(unsigned char *data,uint32_t length)
+static void process_string_table(PBFBlock *block,unsigned char *data,uint32_t length)
 {
  unsigned char *end=data+length;
  unsigned char *string;
  uint32_t string_length;
 
- string_table_length=0;
+ block->string_table_length=0;
 
  while(data<end)
    {
@@ -706,17 +1068,19 @@ static void process_string_table(unsigned char *data,uint32_t length)
       case PBF_VAL_STRING:      /* string */
        string=pbf_length_delimited(&data,&string_length);
 
-       if(string_table_length==string_table_allocated)
+       if(block->string_table_length==block->string_table_allocated)
          {
-          string_table_allocated+=8192;
-          string_table=(unsigned char **)realloc(string_table,string_table_allocated*sizeof(unsigned char *));
-          string_table_string_lengths=(uint32_t *)realloc(string_table_string_lengths,string_table_allocated*sizeof(uint32_t));
+          block->string_table_allocated+=8192;
+          block->string_table=(unsigned char **)realloc(block->string_table,block->string_table_allocated*sizeof(unsigned char *));
+          block->string_table_string_lengths=(uint32_t *)realloc(block->string_table_string_lengths,block->string_table_allocated*sizeof(uint32_t));
+          block->string_table_kid=(int *)realloc(block->string_table_kid,block->string_table_allocated*sizeof(int));
+          block->string_table_vid=(int *)realloc(block->string_table_vid,block->string_table_allocated*sizeof(int));
          }
 
-       string_table[string_table_length]=string;
-       string_table_string_lengths[string_table_length]=string_length;
+       block->string_table[block->string_table_length]=string;
+       block->string_table_string_lengths[block->string_table_length]=string_length;
 
-       string_table_length++;
+       block->string_table_length++;
        break;
 
       default:
@@ -729,24 +1093,18 @@ static void process_string_table(unsigned char *data,uint32_t length)
 /*++++++++++++++++++++++++++++++++++++++
   Process a PBF PrimitiveGroup message.
 
+  PBFBlock *block The block containing the data.
+
   unsigned char *data The data to process.
 
   uint32_t length The length of the data.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void process_primitive_group(unsigned char *data,uint32_t length)
+static void process_primitive_group(PBFBlock *block,unsigned char *data,uint32_t length)
 {
  unsigned char *end=data+length;
  unsigned char *subdata;
  uint32_t sublength;
- int i;
-
- /* Fixup the strings (not null terminated in buffer) */
-
- for(i=0;i<string_table_length;i++)
-    string_table[i][string_table_string_lengths[i]]=0;
-
-
  while(data<end)
    {
     int fieldtype=pbf_int32(&data);
@@ -756,22 +1114,22 @@ static void process_primitive_group(unsigned char *data,uint32_t length)
       {
       case PBF_VAL_NODES:       /* message */
        subdata=pbf_length_delimited(&data,&sublength);
-       process_nodes(subdata,sublength);
+       process_nodes(block,subdata,sublength);
        break;
 
       case PBF_VAL_DENSE_NODES: /* message */
        subdata=pbf_length_delimited(&data,&sublength);
-       process_dense_nodes(subdata,sublength);
+       process_dense_nodes(block,subdata,sublength);
        break;
 
       case PBF_VAL_WAYS:        /* message */
        subdata=pbf_length_delimited(&data,&sublength);
-       process_ways(subdata,sublength);
+       process_ways(block,subdata,sublength);
        break;
 
       case PBF_VAL_RELATIONS:   /* message */
        subdata=pbf_length_delimited(&data,&sublength);
-       process_relations(subdata,sublength);
+       process_relations(block,subdata,sublength);
        break;
 
       default:
@@ -784,12 +1142,14 @@ static void process_primitive_group(unsigned char *data,uint32_t length)
 /*++++++++++++++++++++++++++++++++++++++
   Process a PBF Node message.
 
+  PBFBlock *block The block containing the data.
+
   unsigned char *data The data to process.
 
   uint32_t length The length of the data.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void process_nodes(unsigned char *data,uint32_t length)
+static void process_nodes(PBFBlock *block,unsigned char *data,uint32_t length)
 {
  unsigned char *end=data+length;
  int64_t id=0;
@@ -849,13 +1209,13 @@ static void process_nodes(unsigned char *data,uint32_t length)
        uint32_t key=pbf_int32(&keys);
        uint32_t val=pbf_int32(&vals);
 
-       AppendTag(tags,(char*)string_table[key],(char*)string_table[val]);
+       pbf_append_tag(block,tags,key,val);
       }
    }
 
  result=ApplyNodeTaggingRules(tags,id);
 
- ProcessNodeTags(result,id,PBF_LATITUDE(lat),PBF_LONGITUDE(lon),MODE_NORMAL);
+ ProcessNodeTags(result,id,PBF_LATITUDE(block,lat),PBF_LONGITUDE(block,lon),MODE_NORMAL);
 
  DeleteTagList(tags);
  DeleteTagList(result);
@@ -865,12 +1225,14 @@ static void process_nodes(unsigned char *data,uint32_t length)
 /*++++++++++++++++++++++++++++++++++++++
   Process a PBF DenseNode message.
 
+  PBFBlock *block The block containing the data.
+
   unsigned char *data The data to process.
 
   uint32_t length The length of the data.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void process_dense_nodes(unsigned char *data,uint32_t length)
+static void process_dense_nodes(PBFBlock *block,unsigned char *data,uint32_t length)
 {
  unsigned char *end=data+length;
  unsigned char *ids=NULL,*keys_vals=NULL,*lats=NULL,*lons=NULL;
@@ -942,13 +1304,13 @@ static void process_dense_nodes(unsigned char *data,uint32_t length)
 
           val=pbf_int32(&keys_vals);
 
-          AppendTag(tags,(char*)string_table[key],(char*)string_table[val]);
+          pbf_append_tag(block,tags,key,val);
          }
       }
 
     result=ApplyNodeTaggingRules(tags,id);
 
-    ProcessNodeTags(result,id,PBF_LATITUDE(lat),PBF_LONGITUDE(lon),MODE_NORMAL);
+    ProcessNodeTags(result,id,PBF_LATITUDE(block,lat),PBF_LONGITUDE(block,lon),MODE_NORMAL);
 
     DeleteTagList(tags);
     DeleteTagList(result);
@@ -959,12 +1321,14 @@ static void process_dense_nodes(unsigned char *data,uint32_t length)
 /*++++++++++++++++++++++++++++++++++++++
   Process a PBF Way message.
 
+  PBFBlock *block The block containing the data.
+
   unsigned char *data The data to process.
 
   uint32_t length The length of the data.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void process_ways(unsigned char *data,uint32_t length)
+static void process_ways(PBFBlock *block,unsigned char *data,uint32_t length)
 {
  unsigned char *end=data+length;
  int64_t id=0;
@@ -1021,7 +1385,7 @@ static void process_ways(unsigned char *data,uint32_t length)
        uint32_t key=pbf_int32(&keys);
        uint32_t val=pbf_int32(&vals);
 
-       AppendTag(tags,(char*)string_table[key],(char*)string_table[val]);
+       pbf_append_tag(block,tags,key,val);
       }
    }
 
@@ -1054,12 +1418,14 @@ static void process_ways(unsigned char *data,uint32_t length)
 /*++++++++++++++++++++++++++++++++++++++
   Process a PBF Relation message.
 
+  PBFBlock *block The block containing the data.
+
   unsigned char *data The data to process.
 
   uint32_t length The length of the data.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void process_relations(unsigned char *data,uint32_t length)
+static void process_relations(PBFBlock *block,unsigned char *data,uint32_t length)
 {
  unsigned char *end=data+length;
  int64_t id=0;
@@ -1127,7 +1493,7 @@ static void process_relations(unsigned char *data,uint32_t length)
        uint32_t key=pbf_int32(&keys);
        uint32_t val=pbf_int32(&vals);
 
-       AppendTag(tags,(char*)string_table[key],(char*)string_table[val]);
+       pbf_append_tag(block,tags,key,val);
       }
    }
 
@@ -1142,7 +1508,7 @@ static void process_relations(unsigned char *data,uint32_t length)
        type=pbf_int32(&types);
 
        if(roles)
-          role=string_table[pbf_int32(&roles)];
+          role=block->string_table[pbf_int32(&roles)];
 
        memid+=delta_memid;
 
@@ -1170,6 +1536,8 @@ static void process_relations(unsigned char *data,uint32_t length)
 
   int uncompress_pbf Returns the error state or 0 if OK.
 
+  PBFBlock *block The block to store the uncompressed data in.
+
   unsigned char *data The data to uncompress.
 
   uint32_t compressed The number of bytes to uncompress.
@@ -1177,12 +1545,12 @@ static void process_relations(unsigned char *data,uint32_t length)
   uint32_t uncompressed The number of bytes expected when uncompressed.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static int uncompress_pbf(unsigned char *data,uint32_t compressed,uint32_t uncompressed)
+static int uncompress_pbf(PBFBlock *block,unsigned char *data,uint32_t compressed,uint32_t uncompressed)
 {
  z_stream z={0};
 
- if(uncompressed>zbuffer_allocated)
-    zbuffer=(unsigned char *)realloc(zbuffer,zbuffer_allocated=uncompressed);
+ if(uncompressed>block->zbuffer_allocated)
+    block->zbuffer=(unsigned char *)realloc(block->zbuffer,block->zbuffer_allocated=uncompressed);
 
  if(inflateInit2(&z,15+32)!=Z_OK)
     return(PBF_ERROR_GZIP_INIT);
@@ -1190,7 +1558,7 @@ static int uncompress_pbf(unsigned char *data,uint32_t compressed,uint32_t uncom
  z.next_in=data;
  z.avail_in=compressed;
 
- z.next_out=zbuffer;
+ z.next_out=block->zbuffer;
  z.avail_out=uncompressed;
 
  if(inflate(&z,Z_FINISH)!=Z_STREAM_END)
@@ -1202,9 +1570,6 @@ static int uncompress_pbf(unsigned char *data,uint32_t compressed,uint32_t uncom
  if(inflateEnd(&z)!=Z_OK)
     return(PBF_ERROR_GZIP_END);
 
- buffer_ptr=zbuffer;
- buffer_end=zbuffer+uncompressed;
-
  return(0);
 }
 
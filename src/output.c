@@ -53,13 +53,13 @@
 /* Global variables */
 
 /*+ The option to calculate the quickest route insted of the shortest. +*/
-int option_quickest=0;
+THREAD_LOCAL int option_quickest=0;
 
 /*+ The options to select the format of the file output. +*/
-int option_file_html=0,option_file_gpx_track=0,option_file_gpx_route=0,option_file_text=0,option_file_text_all=0,option_file_stdout=0;
+THREAD_LOCAL int option_file_html=0,option_file_gpx_track=0,option_file_gpx_route=0,option_file_text=0,option_file_text_all=0,option_file_stdout=0;
 
 /*+ The options to select the format of the linked list output. +*/
-int option_list_html=0,option_list_html_all=0,option_list_text=0,option_list_text_all=0;
+THREAD_LOCAL int option_list_html=0,option_list_html_all=0,option_list_text=0,option_list_text_all=0;
 
 
 /* Local variables */
@@ -58,6 +58,12 @@ ssize_t option_filesort_ramsize=0;
 /*+ The number of threads to use for filesorting. +*/
 int option_filesort_threads=1;
 
+/*+ Set to non-zero to compress the temporary files used for filesorting. +*/
+int option_filesort_compress=0;
+
+/*+ The number of threads to use for decoding PBF files. +*/
+int option_parse_threads=1;
+
 
 /* Local functions */
 
@@ -75,11 +81,15 @@ int main(int argc,char** argv)
  WaysX      *OSMWays;
  RelationsX *OSMRelations;
  int         iteration=0,quit=0;
- int         max_iterations=5;
+ int         max_iterations=5,max_landmarks=0,super_levels=1;
  char       *dirname=NULL,*prefix=NULL,*tagging=NULL,*errorlog=NULL;
  int         option_parse_only=0,option_process_only=0;
  int         option_append=0,option_keep=0,option_changes=0;
  int         option_filenames=0;
+ int         option_single_file=0;
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ int         option_async_io=0;
+#endif
  int         option_prune_isolated=500,option_prune_short=5,option_prune_straight=3;
  int         arg;
 
@@ -102,6 +112,16 @@ int main(int argc,char** argv)
 #if defined(USE_PTHREADS) && USE_PTHREADS
     else if(!strncmp(argv[arg],"--sort-threads=",15))
        option_filesort_threads=atoi(&argv[arg][15]);
+    else if(!strncmp(argv[arg],"--parse-threads=",16))
+       option_parse_threads=atoi(&argv[arg][16]);
+    else if(!strcmp(argv[arg],"--async-io"))
+       option_async_io=1;
+#endif
+    else if(!strcmp(argv[arg],"--sort-compress"))
+       option_filesort_compress=1;
+#if SLIM
+    else if(!strncmp(argv[arg],"--cache-size=",13))
+       SetSlimCacheSize((size_t)atoi(&argv[arg][13])*1024*1024);
 #endif
     else if(!strncmp(argv[arg],"--tmpdir=",9))
        option_tmpdirname=&argv[arg][9];
@@ -127,8 +147,14 @@ int main(int argc,char** argv)
        option_keep=1;
     else if(!strcmp(argv[arg],"--changes"))
        option_changes=1;
+    else if(!strcmp(argv[arg],"--single-file"))
+       option_single_file=1;
     else if(!strncmp(argv[arg],"--max-iterations=",17))
        max_iterations=atoi(&argv[arg][17]);
+    else if(!strncmp(argv[arg],"--landmarks=",12))
+       max_landmarks=atoi(&argv[arg][12]);
+    else if(!strncmp(argv[arg],"--super-levels=",15))
+       super_levels=atoi(&argv[arg][15]);
     else if(!strncmp(argv[arg],"--prune",7))
       {
        if(!strcmp(&argv[arg][7],"-none"))
@@ -178,6 +204,12 @@ int main(int argc,char** argv)
 #if defined(USE_PTHREADS) && USE_PTHREADS
  if(option_filesort_threads<1 || option_filesort_threads>32)
     print_usage(0,NULL,"Sorting threads '--sort-threads=...' must be small positive integer.");
+
+ if(option_parse_threads<1 || option_parse_threads>32)
+    print_usage(0,NULL,"Parsing threads '--parse-threads=...' must be small positive integer.");
+
+ if(option_async_io)
+    SetFileBufferedAsync(1);
 #endif
 
  if(!option_tmpdirname)
@@ -468,7 +500,7 @@ if(!option_process_only)
 
        /* Select the super-segments */
 
-       SuperSegments=CreateSuperSegments(OSMNodes,OSMSegments,OSMWays);
+       SuperSegments=CreateSuperSegments(OSMNodes,OSMSegments,OSMWays,0);
 
        nsuper=OSMSegments->number;
       }
@@ -486,7 +518,7 @@ if(!option_process_only)
 
        /* Select the super-segments */
 
-       SuperSegments2=CreateSuperSegments(OSMNodes,SuperSegments,OSMWays);
+       SuperSegments2=CreateSuperSegments(OSMNodes,SuperSegments,OSMWays,0);
 
        nsuper=SuperSegments->number;
 
@@ -511,6 +543,22 @@ if(!option_process_only)
    }
  while(!quit);
 
+ /* Create the second level of super-nodes and super-segments */
+
+ if(super_levels>1)
+   {
+    SegmentsX *SuperSegments2;
+
+    printf("\nProcess Super-Data (second level)\n=================================\n\n");
+    fflush(stdout);
+
+    SuperSegments2=CreateSecondLevelSuperSegments(OSMNodes,SuperSegments,OSMWays);
+
+    FreeSegmentList(SuperSegments);
+
+    SuperSegments=SuperSegments2;
+   }
+
  /* Combine the super-segments */
 
  printf("\nCombine Segments and Super-Segments\n===================================\n\n");
@@ -545,6 +593,15 @@ if(!option_process_only)
 
  SortTurnRelationListGeographically(OSMRelations,OSMNodes,OSMSegments,1);
 
+ /* Find the connected components for each type of transport */
+
+ CalculateNodeComponents(OSMNodes,OSMSegments,OSMWays);
+
+ /* Calculate the landmark distances for the super-nodes */
+
+ if(max_landmarks)
+    CalculateNodeLandmarks(OSMNodes,OSMSegments,max_landmarks);
+
  /* Output the results */
 
  printf("\nWrite Out Database Files\n========================\n\n");
@@ -595,6 +652,33 @@ if(!option_process_only)
       }
    }
 
+ /* Write out the single database file (or delete an old one that does not match the new files) */
+
+ if(option_single_file)
+   {
+    const char *names[5]={"nodes.mem","segments.mem","ways.mem","relations.mem","errorlogs.mem"};
+    int nnames=(errorlog && option_keep)?5:4;
+    uint64_t buildid;
+
+    printf("\nWrite Single Database File\n==========================\n\n");
+    fflush(stdout);
+
+    printf_first("Writing Database File: Sections=%d",nnames);
+
+    buildid=CreateContainerFile(FileName(dirname,prefix,"database.mem"),dirname,prefix,names,nnames);
+
+    printf_last("Wrote Database File: Sections=%d Build ID=%016"PRIx64,nnames,buildid);
+   }
+ else
+   {
+    char *filename=FileName(dirname,prefix,"database.mem");
+
+    if(ExistsFile(filename))
+       DeleteFile(filename);
+
+    free(filename);
+   }
+
  /* Free the memory (delete the temporary files) */
 
  FreeNodeList(OSMNodes,0);
@@ -637,8 +721,13 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "                      [--dir=<dirname>] [--prefix=<name>]\n"
 #if defined(USE_PTHREADS) && USE_PTHREADS
             "                      [--sort-ram-size=<size>] [--sort-threads=<number>]\n"
+            "                      [--parse-threads=<number>] [--async-io]\n"
 #else
             "                      [--sort-ram-size=<size>]\n"
+#endif
+            "                      [--sort-compress]\n"
+#if SLIM
+            "                      [--cache-size=<size>]\n"
 #endif
             "                      [--tmpdir=<dirname>]\n"
             "                      [--tagging=<filename>]\n"
@@ -646,7 +735,10 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "                      [--errorlog[=<name>]]\n"
             "                      [--parse-only | --process-only]\n"
             "                      [--append] [--keep] [--changes]\n"
+            "                      [--single-file]\n"
             "                      [--max-iterations=<number>]\n"
+            "                      [--landmarks=<number>]\n"
+            "                      [--super-levels=<number>]\n"
             "                      [--prune-none]\n"
             "                      [--prune-isolated=<len>]\n"
             "                      [--prune-short=<len>]\n"
@@ -694,6 +786,15 @@ static void print_usage(int detail,const char *argerr,const char *err)
 #endif
 #if defined(USE_PTHREADS) && USE_PTHREADS
             "--sort-threads=<number>   The number of threads to use for data sorting.\n"
+            "--parse-threads=<number>  The number of threads to use for decoding PBF files\n"
+            "                          and uncompressing bzip2 files.\n"
+            "--async-io                Read and write the temporary files using a separate\n"
+            "                          thread so that processing and disk I/O overlap.\n"
+#endif
+            "--sort-compress           Compress the temporary files used for data sorting.\n"
+#if SLIM
+            "--cache-size=<size>       The amount of RAM (in MB) to use for each of the\n"
+            "                          caches of nodes, segments and ways.\n"
 #endif
             "\n"
             "--tmpdir=<dirname>        The directory name for temporary files.\n"
@@ -707,6 +808,9 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "--loggable                Print progress messages suitable for logging to file.\n"
             "--logtime                 Print the elapsed time for each processing step.\n"
             "--logmemory               Print the max allocated/mapped memory for each step.\n"
+#if SLIM
+            "                          (and the cache statistics at the end.)\n"
+#endif
             "--errorlog[=<name>]       Log parsing errors to 'error.log' or the given name\n"
             "                          (the '--dir' and '--prefix' options are applied).\n"
             "\n"
@@ -715,9 +819,14 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "--append                  Parse the OSM file(s) and append to existing results.\n"
             "--keep                    Keep the intermediate files after parsing & sorting.\n"
             "--changes                 Parse the data as an OSC file and apply the changes.\n"
+            "--single-file             Also write the database into one checksummed file.\n"
             "\n"
             "--max-iterations=<number> The number of iterations for finding super-nodes\n"
             "                          (defaults to 5).\n"
+            "--landmarks=<number>      The number of landmarks to store distances for to\n"
+            "                          speed up long routes (defaults to 0, maximum 16).\n"
+            "--super-levels=<number>   The number of levels of super-nodes to create to\n"
+            "                          speed up long routes (defaults to 1, maximum 2).\n"
             "\n"
             "--prune-none              Disable the prune options below, they are re-enabled\n"
             "                          by adding them to the command line after this option.\n"
@@ -773,12 +773,7 @@ void FreeXMLProfiles(void)
     return;
 
  for(i=0;i<nloaded_profiles;i++)
-   {
-    if(loaded_profiles[i]->name)
-       free(loaded_profiles[i]->name);
-
-    free(loaded_profiles[i]);
-   }
+    FreeProfile(loaded_profiles[i]);
 
  free(loaded_profiles);
 
@@ -876,10 +871,36 @@ int UpdateProfile(Profile *profile,Ways *ways)
           profile->max_pref*=profile->props_no[i];
       }
 
+ /* Calculate the routing cost of each way */
+
+ if(profile->waycost)
+    DestroyWayCostList(profile->waycost);
+
+ profile->waycost=NewWayCostList(ways,profile);
+ profile->ways=ways;
+
  return(0);
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Free a profile including the way costs that were derived from it.
+
+  Profile *profile The profile to be freed.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void FreeProfile(Profile *profile)
+{
+ if(profile->name)
+    free(profile->name);
+
+ if(profile->waycost)
+    DestroyWayCostList(profile->waycost);
+
+ free(profile);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Print out a profile.
 
@@ -28,6 +28,15 @@
 
 /* Data structures */
 
+/*+ A data structure to hold the routing cost of a way for a profile (derived from the profile and the way). +*/
+typedef struct _WayCost
+{
+ score_t      pref;                      /*+ The combined highway and property preference (zero if the way is not allowed). +*/
+ speed_t      speed;                     /*+ The speed to use on the way (zero if neither the way nor the profile has a speed). +*/
+}
+ WayCost;
+
+
 /*+ A data structure to hold a transport type profile. +*/
 typedef struct _Profile
 {
@@ -61,6 +70,12 @@ typedef struct _Profile
 
  score_t      max_pref;                  /*+ The maximum preference for any highway type. +*/
  speed_t      max_speed;                 /*+ The maximum speed for any highway type. +*/
+
+ /* The parts derived from the ways */
+
+ Ways        *ways;                      /*+ The set of ways that the way costs were calculated for. +*/
+ unsigned int generation;                /*+ The generation of the library database files that the way costs were calculated for. +*/
+ WayCost     *waycost;                   /*+ The routing cost of each of the ways. +*/
 }
  Profile;
 
@@ -77,6 +92,8 @@ void FreeXMLProfiles(void);
 
 int UpdateProfile(Profile *profile,Ways *ways);
 
+void FreeProfile(Profile *profile);
+
 void PrintProfile(const Profile *profile);
 
 void PrintProfilesXML(void);
@@ -20,6 +20,7 @@
  ***************************************/
 
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -27,6 +28,31 @@
 #include "logging.h"
 
 
+/* The type of priority queue: the binary heap is the original implementation,
+   the 4-ary heap keeps the sort keys with the result pointers so that less memory
+   is accessed, the radix heap is fastest when the scores of the results removed
+   from the queue never decrease (scores that are lower than the last one removed
+   are treated as being equal to it).  To change the type of queue compile with
+   -DQUEUE_TYPE=QUEUE_BINARY_HEAP (or QUEUE_DARY_HEAP or QUEUE_RADIX_HEAP). */
+
+#define QUEUE_BINARY_HEAP 1
+#define QUEUE_DARY_HEAP   2
+#define QUEUE_RADIX_HEAP  3
+
+#ifndef QUEUE_TYPE
+#define QUEUE_TYPE QUEUE_DARY_HEAP
+#endif
+
+/* To record the queue operations to stderr so that they can be replayed by the
+   queue-benchmark program in the test directory compile with -DQUEUE_TRACE=1. */
+
+#ifndef QUEUE_TRACE
+#define QUEUE_TRACE 0
+#endif
+
+
+#if QUEUE_TYPE==QUEUE_BINARY_HEAP
+
 /*+ A queue of results. +*/
 struct _Queue
 {
@@ -37,9 +63,84 @@ struct _Queue
  Result **results;              /*+ The queue of pointers to results. +*/
 };
 
+#elif QUEUE_TYPE==QUEUE_DARY_HEAP
+
+/*+ The number of children of each entry in the heap. +*/
+#define HEAP_D 4
+
+/*+ An entry in the queue of results. +*/
+typedef struct _QueueEntry
+{
+ score_t  sortby;               /*+ The score used for sorting the result (a copy of the value in the result). +*/
+ Result  *result;               /*+ The result. +*/
+}
+ QueueEntry;
+
+/*+ A queue of results. +*/
+struct _Queue
+{
+ uint32_t nincrement;           /*+ The amount to increment the queue when full. +*/
+ uint32_t nallocated;           /*+ The number of entries allocated. +*/
+ uint32_t noccupied;            /*+ The number of entries occupied. +*/
+
+ QueueEntry *entries;           /*+ The queue of results and their scores. +*/
+};
+
+#elif QUEUE_TYPE==QUEUE_RADIX_HEAP
+
+/*+ The number of buckets, one for equal keys and one for each bit of the key. +*/
+#define NBUCKETS 33
+
+/*+ An entry in the queue of results. +*/
+typedef struct _QueueEntry
+{
+ uint32_t key;                  /*+ The integer key used for sorting the result. +*/
+ score_t  sortby;               /*+ The score of the result when it was inserted (to detect out of date entries). +*/
+ Result  *result;               /*+ The result. +*/
+}
+ QueueEntry;
+
+/*+ A queue of results. +*/
+struct _Queue
+{
+ uint32_t nincrement;           /*+ The amount to increment the buckets when full. +*/
+ uint32_t noccupied;            /*+ The number of results in the queue. +*/
+
+ uint32_t last;                 /*+ The key of the most recently removed result. +*/
+
+ uint32_t nallocated[NBUCKETS]; /*+ The number of entries allocated in each bucket. +*/
+ uint32_t nentries[NBUCKETS];   /*+ The number of entries in each bucket (including out of date ones). +*/
+
+ QueueEntry *buckets[NBUCKETS]; /*+ The buckets of results whose keys differ from the last one in the same most significant bit. +*/
+};
+
+#else
+
+#error "Unknown QUEUE_TYPE"
+
+#endif
+
+
+/*+ The maximum number of freed queues that are kept for re-use. +*/
+#define NSPARE_QUEUES 8
+
+
+/* Local functions */
+
+static void destroy_queue_list(Queue *queue);
+
+
+/* Local variables (separate for each thread in the library) */
+
+/*+ The queues that have been freed and are kept for re-use. +*/
+static THREAD_LOCAL Queue *spare_queues[NSPARE_QUEUES];
+
+/*+ The number of queues that have been freed and are kept for re-use. +*/
+static THREAD_LOCAL int nspare_queues=0;
+
 
 /*++++++++++++++++++++++++++++++++++++++
-  Allocate a new queue.
+  Allocate a new queue (or re-use one that has been freed).
 
   Queue *NewQueueList Returns the queue.
 
@@ -50,19 +151,59 @@ Queue *NewQueueList(uint8_t log2bins)
 {
  Queue *queue;
 
+#if QUEUE_TRACE
+ fprintf(stderr,"N\n");
+#endif
+
+ /* Re-use the most recently freed queue */
+
+ if(nspare_queues>0)
+   {
+    queue=spare_queues[--nspare_queues];
+
+    if(queue->nincrement<(uint32_t)(1<<log2bins))
+       queue->nincrement=1<<log2bins;
+
+    return(queue);
+   }
+
  queue=(Queue*)malloc(sizeof(Queue));
 
  queue->nincrement=1<<log2bins;
 
- queue->nallocated=queue->nincrement;
  queue->noccupied=0;
 
+#if QUEUE_TYPE==QUEUE_BINARY_HEAP
+
+ queue->nallocated=queue->nincrement;
+
  queue->results=(Result**)malloc(queue->nallocated*sizeof(Result*));
 
 #ifndef LIBROUTINO
  log_malloc(queue->results,queue->nallocated*sizeof(Result*));
 #endif
 
+#elif QUEUE_TYPE==QUEUE_DARY_HEAP
+
+ queue->nallocated=queue->nincrement;
+
+ queue->entries=(QueueEntry*)malloc(queue->nallocated*sizeof(QueueEntry));
+
+#ifndef LIBROUTINO
+ log_malloc(queue->entries,queue->nallocated*sizeof(QueueEntry));
+#endif
+
+#elif QUEUE_TYPE==QUEUE_RADIX_HEAP
+
+ queue->last=0;
+
+ memset(queue->nallocated,0,sizeof(queue->nallocated));
+ memset(queue->nentries,0,sizeof(queue->nentries));
+
+ memset(queue->buckets,0,sizeof(queue->buckets));
+
+#endif
+
  return(queue);
 }
 
@@ -76,27 +217,93 @@ Queue *NewQueueList(uint8_t log2bins)
 void ResetQueueList(Queue *queue)
 {
  queue->noccupied=0;
+
+#if QUEUE_TYPE==QUEUE_RADIX_HEAP
+
+ queue->last=0;
+
+ memset(queue->nentries,0,sizeof(queue->nentries));
+
+#endif
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Free a queue.
+  Free a queue (it is reset and kept for re-use unless there are enough spare ones already).
 
   Queue *queue The queue to be freed.
   ++++++++++++++++++++++++++++++++++++++*/
 
 void FreeQueueList(Queue *queue)
 {
+ if(nspare_queues<NSPARE_QUEUES)
+   {
+    ResetQueueList(queue);
+
+    spare_queues[nspare_queues++]=queue;
+   }
+ else
+    destroy_queue_list(queue);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Free the queues that are being kept for re-use.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void FreeSpareQueueLists(void)
+{
+ while(nspare_queues>0)
+    destroy_queue_list(spare_queues[--nspare_queues]);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Destroy a queue and release its memory.
+
+  Queue *queue The queue to be destroyed.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void destroy_queue_list(Queue *queue)
+{
+#if QUEUE_TYPE==QUEUE_BINARY_HEAP
+
 #ifndef LIBROUTINO
  log_free(queue->results);
 #endif
 
  free(queue->results);
 
+#elif QUEUE_TYPE==QUEUE_DARY_HEAP
+
+#ifndef LIBROUTINO
+ log_free(queue->entries);
+#endif
+
+ free(queue->entries);
+
+#elif QUEUE_TYPE==QUEUE_RADIX_HEAP
+
+ int i;
+
+ for(i=0;i<NBUCKETS;i++)
+    if(queue->buckets[i])
+      {
+#ifndef LIBROUTINO
+       log_free(queue->buckets[i]);
+#endif
+
+       free(queue->buckets[i]);
+      }
+
+#endif
+
  free(queue);
 }
 
 
+#if QUEUE_TYPE==QUEUE_BINARY_HEAP
+
 /*++++++++++++++++++++++++++++++++++++++
   Insert a new item into the queue in the right place.
 
@@ -114,6 +321,10 @@ void InsertInQueue(Queue *queue,Result *result,score_t score)
 {
  uint32_t index;
 
+#if QUEUE_TRACE
+ fprintf(stderr,"I %"Pindex_t" %"Pindex_t" %.9g\n",result->node,result->segment,(double)score);
+#endif
+
  if(result->queued==NOT_QUEUED)
    {
     queue->noccupied++;
@@ -177,6 +388,10 @@ Result *PopFromQueue(Queue *queue)
  uint32_t index;
  Result *retval;
 
+#if QUEUE_TRACE
+ fprintf(stderr,"P\n");
+#endif
+
  if(queue->noccupied==0)
     return(NULL);
 
@@ -236,3 +451,341 @@ Result *PopFromQueue(Queue *queue)
 
  return(retval);
 }
+
+#elif QUEUE_TYPE==QUEUE_DARY_HEAP
+
+/*++++++++++++++++++++++++++++++++++++++
+  Insert a new item into the queue in the right place.
+
+  The data is stored in a "d-ary Heap" https://en.wikipedia.org/wiki/D-ary_heap
+  with four children for each entry (so that the tree is half as deep as a
+  binary heap and the children share a cache line) and this operation is
+  adding an item to the heap.
+
+  Queue *queue The queue to insert the result into.
+
+  Result *result The result to insert into the queue.
+
+  score_t score The score to use for sorting the node.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void InsertInQueue(Queue *queue,Result *result,score_t score)
+{
+ uint32_t index;
+
+#if QUEUE_TRACE
+ fprintf(stderr,"I %"Pindex_t" %"Pindex_t" %.9g\n",result->node,result->segment,(double)score);
+#endif
+
+ if(result->queued==NOT_QUEUED)
+   {
+    if(queue->noccupied==queue->nallocated)
+      {
+#ifndef LIBROUTINO
+       log_free(queue->entries);
+#endif
+
+       queue->nallocated=queue->nallocated+queue->nincrement;
+       queue->entries=(QueueEntry*)realloc((void*)queue->entries,queue->nallocated*sizeof(QueueEntry));
+
+#ifndef LIBROUTINO
+       log_malloc(queue->entries,queue->nallocated*sizeof(QueueEntry));
+#endif
+      }
+
+    index=queue->noccupied++;
+   }
+ else
+    index=result->queued-1;
+
+ result->sortby=score;
+
+ /* Bubble up the new value */
+
+ while(index>0)
+   {
+    uint32_t newindex=(index-1)/HEAP_D;
+
+    if(score>=queue->entries[newindex].sortby)
+       break;
+
+    queue->entries[index]=queue->entries[newindex];
+    queue->entries[index].result->queued=index+1;
+
+    index=newindex;
+   }
+
+ queue->entries[index].sortby=score;
+ queue->entries[index].result=result;
+
+ result->queued=index+1;
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Pop an item from the front of the queue.
+
+  The data is stored in a "d-ary Heap" https://en.wikipedia.org/wiki/D-ary_heap
+  and this operation is deleting the root item from the heap.
+
+  Result *PopFromQueue Returns the top item.
+
+  Queue *queue The queue to remove the result from.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+Result *PopFromQueue(Queue *queue)
+{
+ uint32_t index;
+ Result *retval;
+ QueueEntry last;
+
+#if QUEUE_TRACE
+ fprintf(stderr,"P\n");
+#endif
+
+ if(queue->noccupied==0)
+    return(NULL);
+
+ retval=queue->entries[0].result;
+ retval->queued=NOT_QUEUED;
+
+ queue->noccupied--;
+
+ if(queue->noccupied==0)
+    return(retval);
+
+ last=queue->entries[queue->noccupied];
+
+ /* Bubble down the last value from the top */
+
+ index=0;
+
+ while(1)
+   {
+    uint32_t child=HEAP_D*index+1,newindex,i;
+
+    if(child>=queue->noccupied)
+       break;
+
+    newindex=child;
+
+    for(i=child+1;i<(child+HEAP_D) && i<queue->noccupied;i++)
+       if(queue->entries[i].sortby<queue->entries[newindex].sortby)
+          newindex=i;
+
+    if(last.sortby<=queue->entries[newindex].sortby)
+       break;
+
+    queue->entries[index]=queue->entries[newindex];
+    queue->entries[index].result->queued=index+1;
+
+    index=newindex;
+   }
+
+ queue->entries[index]=last;
+ queue->entries[index].result->queued=index+1;
+
+ return(retval);
+}
+
+#elif QUEUE_TYPE==QUEUE_RADIX_HEAP
+
+/*++++++++++++++++++++++++++++++++++++++
+  Convert a score into an integer key that sorts into the same order.
+
+  uint32_t score_to_key Returns the key.
+
+  score_t score The score (which is never negative).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline uint32_t score_to_key(score_t score)
+{
+ uint32_t key;
+
+ /* The bit patterns of non-negative IEEE floating point numbers sort in the same order as the numbers. */
+
+ memcpy(&key,&score,sizeof(uint32_t));
+
+ return(key);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the bucket for a key, given the key of the last result removed from the queue.
+
+  uint32_t key_bucket Returns the number of the most significant bit that is different (plus one) or zero if they are the same.
+
+  uint32_t key The key of the result.
+
+  uint32_t last The key of the last result removed from the queue.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline uint32_t key_bucket(uint32_t key,uint32_t last)
+{
+ uint32_t diff=key^last;
+
+ if(diff==0)
+    return(0);
+
+#if defined(__GNUC__)
+
+ return(32-__builtin_clz(diff));
+
+#else
+
+ {
+  uint32_t bucket=0;
+
+  while(diff)
+    {
+     bucket++;
+     diff>>=1;
+    }
+
+  return(bucket);
+ }
+
+#endif
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Add an entry to one of the buckets.
+
+  Queue *queue The queue to add the entry to.
+
+  QueueEntry *entry The entry to add.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline void add_to_bucket(Queue *queue,QueueEntry *entry)
+{
+ uint32_t bucket=key_bucket(entry->key,queue->last);
+
+ if(queue->nentries[bucket]==queue->nallocated[bucket])
+   {
+#ifndef LIBROUTINO
+    if(queue->buckets[bucket])
+       log_free(queue->buckets[bucket]);
+#endif
+
+    queue->nallocated[bucket]+=queue->nincrement;
+    queue->buckets[bucket]=(QueueEntry*)realloc((void*)queue->buckets[bucket],queue->nallocated[bucket]*sizeof(QueueEntry));
+
+#ifndef LIBROUTINO
+    log_malloc(queue->buckets[bucket],queue->nallocated[bucket]*sizeof(QueueEntry));
+#endif
+   }
+
+ queue->buckets[bucket][queue->nentries[bucket]++]=*entry;
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Insert a new item into the queue in the right place.
+
+  The data is stored in a "Radix Heap" https://en.wikipedia.org/wiki/Radix_heap
+  and this operation is adding an item to the heap (changing the score of an
+  item already in the queue adds a new entry and the old one is ignored).
+
+  Queue *queue The queue to insert the result into.
+
+  Result *result The result to insert into the queue.
+
+  score_t score The score to use for sorting the node.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void InsertInQueue(Queue *queue,Result *result,score_t score)
+{
+ QueueEntry entry;
+
+#if QUEUE_TRACE
+ fprintf(stderr,"I %"Pindex_t" %"Pindex_t" %.9g\n",result->node,result->segment,(double)score);
+#endif
+
+ if(result->queued==NOT_QUEUED)
+   {
+    queue->noccupied++;
+    result->queued=1;
+   }
+
+ result->sortby=score;
+
+ entry.key=score_to_key(score);
+ entry.sortby=score;
+ entry.result=result;
+
+ if(entry.key<queue->last)
+    entry.key=queue->last;
+
+ add_to_bucket(queue,&entry);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Pop an item from the front of the queue.
+
+  The data is stored in a "Radix Heap" https://en.wikipedia.org/wiki/Radix_heap
+  and this operation is deleting the smallest item from the heap.
+
+  Result *PopFromQueue Returns the top item.
+
+  Queue *queue The queue to remove the result from.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+Result *PopFromQueue(Queue *queue)
+{
+#if QUEUE_TRACE
+ fprintf(stderr,"P\n");
+#endif
+
+ while(queue->noccupied>0)
+   {
+    QueueEntry *entry;
+    Result *result;
+
+    /* Refill the bucket of entries equal to the last key from the first non-empty bucket */
+
+    if(queue->nentries[0]==0)
+      {
+       uint32_t bucket=1,i,n;
+       QueueEntry *entries;
+
+       while(queue->nentries[bucket]==0)
+          bucket++;
+
+       entries=queue->buckets[bucket];
+       n=queue->nentries[bucket];
+
+       queue->last=entries[0].key;
+
+       for(i=1;i<n;i++)
+          if(entries[i].key<queue->last)
+             queue->last=entries[i].key;
+
+       queue->nentries[bucket]=0;
+
+       for(i=0;i<n;i++)
+          if(entries[i].result->queued!=NOT_QUEUED && entries[i].result->sortby==entries[i].sortby)
+             add_to_bucket(queue,&entries[i]);
+
+       continue;
+      }
+
+    entry=&queue->buckets[0][--queue->nentries[0]];
+    result=entry->result;
+
+    /* Ignore out of date entries */
+
+    if(result->queued==NOT_QUEUED || result->sortby!=entry->sortby)
+       continue;
+
+    result->queued=NOT_QUEUED;
+    queue->noccupied--;
+
+    return(result);
+   }
+
+ return(NULL);
+}
+
+#endif
@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -35,9 +35,11 @@
   Relations *LoadRelationList Returns the relation list.
 
   const char *filename The name of the file to load.
+
+  int options The options that control how the file is loaded (a combination of the MAPFILE_* options).
   ++++++++++++++++++++++++++++++++++++++*/
 
-Relations *LoadRelationList(const char *filename)
+Relations *LoadRelationList(const char *filename,int options)
 {
  Relations *relations;
 
@@ -45,7 +47,7 @@ Relations *LoadRelationList(const char *filename)
 
 #if !SLIM
 
- relations->data=MapFile(filename);
+ relations->data=MapFileOptions(filename,options);
 
  /* Copy the RelationsFile header structure from the loaded data */
 
@@ -57,7 +59,7 @@ Relations *LoadRelationList(const char *filename)
 
 #else
 
- relations->fd=SlimMapFile(filename);
+ relations->fd=SlimMapFileOptions(filename,options);
 
  /* Copy the RelationsFile header structure from the loaded data */
 
@@ -67,7 +69,7 @@ Relations *LoadRelationList(const char *filename)
 
  relations->cache=NewTurnRelationCache();
 #ifndef LIBROUTINO
- log_malloc(relations->cache,sizeof(*relations->cache));
+ log_malloc(relations->cache,relations->cache->size);
 #endif
 
 #endif
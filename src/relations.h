@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -85,7 +85,7 @@ struct _Relations
 
 /* Functions in relations.c */
 
-Relations *LoadRelationList(const char *filename);
+Relations *LoadRelationList(const char *filename,int options);
 
 void DestroyRelationList(Relations *relations);
 
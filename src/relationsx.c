@@ -1124,10 +1124,24 @@ void ProcessTurnRelations(RelationsX *relationsx,NodesX *nodesx,SegmentsX *segme
  free(nodesx->idata);
  nodesx->idata=NULL;
 
+ if(nodesx->ibins)
+   {
+    log_free(nodesx->ibins);
+    free(nodesx->ibins);
+    nodesx->ibins=NULL;
+   }
+
  log_free(waysx->idata);
  free(waysx->idata);
  waysx->idata=NULL;
 
+ if(waysx->ibins)
+   {
+    log_free(waysx->ibins);
+    free(waysx->ibins);
+    waysx->ibins=NULL;
+   }
+
  log_free(segmentsx->firstnode);
  free(segmentsx->firstnode);
  segmentsx->firstnode=NULL;
@@ -30,9 +30,28 @@
 
 #define HASH_NODE_SEGMENT(node,segment) ((node)^(segment<<4))
 
+/*+ The maximum number of freed results lists that are kept for re-use. +*/
+#define NSPARE_RESULTS 8
+
+
+/* Local functions */
+
+static void destroy_results_list(Results *results);
+
+static inline Result *result_at(Results *results,uint32_t n);
+
+
+/* Local variables (separate for each thread in the library) */
+
+/*+ The results lists that have been freed and are kept for re-use. +*/
+static THREAD_LOCAL Results *spare_results[NSPARE_RESULTS];
+
+/*+ The number of results lists that have been freed and are kept for re-use. +*/
+static THREAD_LOCAL int nspare_results=0;
+
 
 /*++++++++++++++++++++++++++++++++++++++
-  Allocate a new results list.
+  Allocate a new results list (or re-use one that has been freed).
 
   Results *NewResultsList Returns the results list.
 
@@ -43,6 +62,49 @@ Results *NewResultsList(uint8_t log2bins)
 {
  Results *results;
 
+ /* Re-use the smallest spare results list that is big enough (or else the biggest one) */
+
+ if(nspare_results>0)
+   {
+    uint32_t nbins=1<<log2bins;
+    int i,best=0;
+
+    for(i=1;i<nspare_results;i++)
+      {
+       if(spare_results[best]->nbins>=nbins)
+         {
+          if(spare_results[i]->nbins>=nbins && spare_results[i]->nbins<spare_results[best]->nbins)
+             best=i;
+         }
+       else if(spare_results[i]->nbins>spare_results[best]->nbins)
+          best=i;
+      }
+
+    results=spare_results[best];
+
+    spare_results[best]=spare_results[--nspare_results];
+
+    if(results->nbins<nbins)
+      {
+#ifndef LIBROUTINO
+       log_free(results->bins);
+#endif
+
+       free(results->bins);
+
+       results->nbins=nbins;
+       results->mask=results->nbins-1;
+
+       results->bins=(ResultBin*)calloc(results->nbins,sizeof(ResultBin));
+
+#ifndef LIBROUTINO
+       log_malloc(results->bins,results->nbins*sizeof(ResultBin));
+#endif
+      }
+
+    return(results);
+   }
+
  results=(Results*)malloc(sizeof(Results));
 
  results->nbins=1<<log2bins;
@@ -50,15 +112,16 @@ Results *NewResultsList(uint8_t log2bins)
 
  results->number=0;
 
- results->point=(Result**)calloc(results->nbins,sizeof(Result*));
+ results->bins=(ResultBin*)calloc(results->nbins,sizeof(ResultBin));
 
 #ifndef LIBROUTINO
- log_malloc(results->point,results->nbins*sizeof(Result*));
+ log_malloc(results->bins,results->nbins*sizeof(ResultBin));
 #endif
 
  results->ndata1=0;
  results->nallocdata1=0;
- results->ndata2=results->nbins>>2;
+ results->log2ndata2=log2bins>2?log2bins-2:0;
+ results->ndata2=1<<results->log2ndata2;
 
  results->data=NULL;
 
@@ -76,36 +139,84 @@ Results *NewResultsList(uint8_t log2bins)
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Allocate a new results list.
+  Reset a results list so that it can be re-used, the time taken depends on the number of results not the size of the hash table.
 
   Results *results The results list to be reset.
   ++++++++++++++++++++++++++++++++++++++*/
 
 void ResetResultsList(Results *results)
 {
- uint32_t i;
+ uint32_t n;
+
+ /* Clear the occupied bins individually unless a large part of the hash table is used */
+
+ if(results->number<(results->nbins>>3))
+   {
+    for(n=0;n<results->number;n++)
+      {
+       Result *result=result_at(results,n);
+       uint32_t bin=HASH_NODE_SEGMENT(result->node,result->segment)&results->mask;
+
+       while(results->bins[bin].index!=(n+1))
+          bin=(bin+1)&results->mask;
+
+       results->bins[bin].index=0;
+      }
+   }
+ else
+    memset(results->bins,0,results->nbins*sizeof(ResultBin));
 
  results->number=0;
  results->ndata1=0;
 
- for(i=0;i<results->nbins;i++)
-    results->point[i]=NULL;
-
  results->start_node=NO_NODE;
  results->prev_segment=NO_SEGMENT;
 
  results->finish_node=NO_NODE;
  results->last_segment=NO_SEGMENT;
+
+ results->start_waypoint=NO_WAYPOINT;
+ results->finish_waypoint=NO_WAYPOINT;
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Free a results list.
+  Free a results list (it is reset and kept for re-use unless there are enough spare ones already).
 
-  Results *results The results list to be destroyed.
+  Results *results The results list to be freed.
   ++++++++++++++++++++++++++++++++++++++*/
 
 void FreeResultsList(Results *results)
+{
+ if(nspare_results<NSPARE_RESULTS)
+   {
+    ResetResultsList(results);
+
+    spare_results[nspare_results++]=results;
+   }
+ else
+    destroy_results_list(results);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Free the results lists that are being kept for re-use.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void FreeSpareResultsLists(void)
+{
+ while(nspare_results>0)
+    destroy_results_list(spare_results[--nspare_results]);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Destroy a results list and release its memory.
+
+  Results *results The results list to be destroyed.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void destroy_results_list(Results *results)
 {
  uint32_t i;
 
@@ -120,9 +231,9 @@ void FreeResultsList(Results *results)
  free(results->data);
 
 #ifndef LIBROUTINO
- log_free(results->point);
+ log_free(results->bins);
 #endif
- free(results->point);
+ free(results->bins);
 
  free(results);
 }
@@ -136,28 +247,23 @@ void FreeResultsList(Results *results)
 
   Results *results The results structure to insert into.
 
-  Result *result The result to insert.
+  uint32_t n The position of the result in the data array.
 
   index_t node The node that is to be inserted into the results.
 
   index_t segment The segment that is to be inserted into the results.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static inline void insert_result(Results *results,Result *result,index_t node,index_t segment)
+static inline void insert_result(Results *results,uint32_t n,index_t node,index_t segment)
 {
  uint32_t bin=HASH_NODE_SEGMENT(node,segment)&results->mask;
 
- while(1)
-   {
-    Result *r=results->point[bin];
-
-    if(!r)
-       break;
-
-    bin=(bin+1)%results->nbins;
-   }
+ while(results->bins[bin].index)
+    bin=(bin+1)&results->mask;
 
- results->point[bin]=result;
+ results->bins[bin].node=node;
+ results->bins[bin].segment=segment;
+ results->bins[bin].index=n+1;
 }
 
 
@@ -183,30 +289,27 @@ Result *InsertResult(Results *results,index_t node,index_t segment)
    {
     uint32_t n;
 
-#ifndef LIBROUTINO
-    log_free(results->point);
-#endif
-
-    free(results->point);
+    ResultBin *oldbins=results->bins;
+    uint32_t oldnbins=results->nbins;
 
     results->nbins<<=1;
     results->mask=results->nbins-1;
 
-    results->point=(Result**)calloc(results->nbins,sizeof(Result*));
+    results->bins=(ResultBin*)calloc(results->nbins,sizeof(ResultBin));
 
 #ifndef LIBROUTINO
-    log_malloc(results->point,results->nbins*sizeof(Result*));
+    log_malloc(results->bins,results->nbins*sizeof(ResultBin));
 #endif
 
-    for(n=0;n<results->number;n++)
-      {
-       uint32_t i=n/results->ndata2;
-       uint32_t j=n%results->ndata2;
+    for(n=0;n<oldnbins;n++)
+       if(oldbins[n].index)
+          insert_result(results,oldbins[n].index-1,oldbins[n].node,oldbins[n].segment);
 
-       result=&results->data[i][j];
+#ifndef LIBROUTINO
+    log_free(oldbins);
+#endif
 
-       insert_result(results,result,result->node,result->segment);
-      }
+    free(oldbins);
    }
 
  /* Check if we need more data space allocated */
@@ -215,7 +318,7 @@ Result *InsertResult(Results *results,index_t node,index_t segment)
    {
     results->ndata1++;
 
-    if(results->ndata1>=results->nallocdata1)
+    if(results->ndata1>results->nallocdata1)
       {
        results->nallocdata1++;
        results->data=(Result**)realloc((void*)results->data,results->nallocdata1*sizeof(Result*));
@@ -228,9 +331,9 @@ Result *InsertResult(Results *results,index_t node,index_t segment)
 
  /* Insert the new entry */
 
- result=&results->data[results->ndata1-1][results->number%results->ndata2];
+ result=result_at(results,results->number);
 
- insert_result(results,result,node,segment);
+ insert_result(results,results->number,node,segment);
 
  results->number++;
 
@@ -270,23 +373,34 @@ Result *FindResult(Results *results,index_t node,index_t segment)
 {
  uint32_t bin=HASH_NODE_SEGMENT(node,segment)&results->mask;
 
- while(1)
+ while(results->bins[bin].index)
    {
-    Result *r=results->point[bin];
-
-    if(!r)
-       break;
-
-    if(r->segment==segment && r->node==node)
-       return(r);
+    if(results->bins[bin].segment==segment && results->bins[bin].node==node)
+       return(result_at(results,results->bins[bin].index-1));
 
-    bin=(bin+1)%results->nbins;
+    bin=(bin+1)&results->mask;
    }
 
  return(NULL);
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Find the result at a particular position in the data array.
+
+  Result *result_at Returns a pointer to the result.
+
+  Results *results The set of results.
+
+  uint32_t n The position of the result in the data array.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline Result *result_at(Results *results,uint32_t n)
+{
+ return(&results->data[n>>results->log2ndata2][n&(results->ndata2-1)]);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Find the first result from a set of results.
 
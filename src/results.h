@@ -56,6 +56,16 @@ struct _Result
  uint32_t  queued;              /*+ The position of this result in the queue. +*/
 };
 
+/*+ A bin in the hash table of results (contains a copy of the key so that searching does not need to access the results). +*/
+typedef struct _ResultBin
+{
+ index_t   node;                /*+ The node for the result in this bin. +*/
+ index_t   segment;             /*+ The segment for the result in this bin. +*/
+
+ uint32_t  index;               /*+ One more than the position of the result in the data array (or zero for an empty bin). +*/
+}
+ ResultBin;
+
 /*+ A list of results. +*/
 typedef struct _Results
 {
@@ -64,10 +74,11 @@ typedef struct _Results
 
  uint32_t  number;              /*+ The total number of occupied results. +*/
 
- Result  **point;               /*+ An array of nbins pointers to results in the data array. +*/
+ ResultBin *bins;               /*+ An array of nbins entries that locate the results in the data array. +*/
 
  uint32_t  ndata1;              /*+ The size of the first dimension of the 'data' array. +*/
- uint32_t  ndata2;              /*+ The size of the second dimension of the 'data' array. +*/
+ uint32_t  ndata2;              /*+ The size of the second dimension of the 'data' array (a power of 2). +*/
+ uint32_t  log2ndata2;          /*+ The base 2 logarithm of ndata2. +*/
 
  uint32_t  nallocdata1;         /*+ The amount of allocated space in the first dimension of the 'data' array. +*/
 
@@ -98,6 +109,7 @@ typedef struct _Queue Queue;
 Results *NewResultsList(uint8_t log2bins);
 void ResetResultsList(Results *results);
 void FreeResultsList(Results *results);
+void FreeSpareResultsLists(void);
 
 Result *InsertResult(Results *results,index_t node,index_t segment);
 
@@ -112,6 +124,7 @@ Result *NextResult(Results *results,Result *result);
 Queue *NewQueueList(uint8_t log2bins);
 void ResetQueueList(Queue *queue);
 void FreeQueueList(Queue *queue);
+void FreeSpareQueueLists(void);
 
 void InsertInQueue(Queue *queue,Result *result,score_t score);
 Result *PopFromQueue(Queue *queue);
@@ -64,6 +64,7 @@ int main(int argc,char** argv)
  char                *profiles=NULL,*profilename="motorcar";
  char                *translations=NULL,*language="en";
  int                  reverse=0,loop=0;
+ int                  load_flags=ROUTINO_LOAD_DEFAULT;
  int                  quickest=0;
  int                  html=0,gpx_track=0,gpx_route=0,text=0,text_all=0,none=0,use_stdout=0;
  int                  list_html=0,list_html_all=0,list_text=0,list_text_all=0;
@@ -100,6 +101,18 @@ int main(int argc,char** argv)
        profiles=&argv[arg][11];
     else if(!strncmp(argv[arg],"--translations=",15))
        translations=&argv[arg][15];
+    else if(!strcmp(argv[arg],"--load-random"))
+       load_flags|=ROUTINO_LOAD_RANDOM;
+    else if(!strcmp(argv[arg],"--load-willneed"))
+       load_flags|=ROUTINO_LOAD_WILLNEED;
+    else if(!strcmp(argv[arg],"--load-prefault"))
+       load_flags|=ROUTINO_LOAD_PREFAULT;
+    else if(!strcmp(argv[arg],"--load-lock"))
+       load_flags|=ROUTINO_LOAD_LOCK;
+    else if(!strcmp(argv[arg],"--load-hugepages"))
+       load_flags|=ROUTINO_LOAD_HUGEPAGES;
+    else if(!strcmp(argv[arg],"--verify-database"))
+       load_flags|=ROUTINO_LOAD_VERIFY;
     else if(!strncmp(argv[arg],"--reverse",9))
       {
        if(argv[arg][9]=='=')
@@ -343,7 +356,16 @@ int main(int argc,char** argv)
 
  /* Load in the routing database */
 
- database=Routino_LoadDatabase(dirname,prefix);
+ database=Routino_LoadDatabaseFlags(dirname,prefix,load_flags);
+
+ if(!database)
+   {
+    if(Routino_errno==ROUTINO_ERROR_BAD_DATABASE_FILES)
+       fprintf(stderr,"Error: Database files are not valid for this version of Routino (re-create the database using planetsplitter).\n");
+    else
+       fprintf(stderr,"Error: Cannot load the database files (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
 
  /* Check the profile is valid for use with this database */
 
@@ -523,6 +545,9 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "              [--help ]\n"
             "              [--dir=<dirname>] [--prefix=<name>]\n"
             "              [--profiles=<filename>] [--translations=<filename>]\n"
+            "              [--load-random] [--load-willneed] [--load-prefault]\n"
+            "              [--load-lock] [--load-hugepages]\n"
+            "              [--verify-database]\n"
             "              [--language=<lang>]\n"
             "              [--output-html]\n"
             "              [--output-gpx-track] [--output-gpx-route]\n"
@@ -566,6 +591,13 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "                         '--prefix' options or the file installed in\n"
             "                         '" ROUTINO_DATADIR "').\n"
             "\n"
+            "--load-random           Advise that the database is accessed randomly.\n"
+            "--load-willneed         Start reading the whole database in the background.\n"
+            "--load-prefault         Read the whole database into memory before routing.\n"
+            "--load-lock             Lock the database into memory (if allowed).\n"
+            "--load-hugepages        Copy the database into memory using huge pages.\n"
+            "--verify-database       Check all of the single file database checksums.\n"
+            "\n"
             "--language=<lang>       Use the translations for specified language.\n"
             "--output-html           Write an HTML description of the route.\n"
             "--output-gpx-track      Write a GPX track file with all route points.\n"
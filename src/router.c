@@ -51,10 +51,10 @@
 int option_quiet=0;
 
 /*+ The option to calculate the quickest route insted of the shortest. +*/
-extern int option_quickest;
+extern THREAD_LOCAL int option_quickest;
 
 /*+ The options to select the format of the file output. +*/
-extern int option_file_html,option_file_gpx_track,option_file_gpx_route,option_file_text,option_file_text_all,option_file_stdout;
+extern THREAD_LOCAL int option_file_html,option_file_gpx_track,option_file_gpx_route,option_file_text,option_file_text_all,option_file_stdout;
 int option_file_none=0;
 
 
@@ -80,9 +80,14 @@ int main(int argc,char** argv)
  double       heading=-999;
  int          help_profile=0,help_profile_xml=0,help_profile_json=0,help_profile_pl=0;
  char        *dirname=NULL,*prefix=NULL;
+#if !SLIM
+ char        *container_filename;
+#endif
+ void        *container=NULL;
  char        *profiles=NULL,*profilename=NULL;
  char        *translations=NULL,*language=NULL;
  int          exactnodes=0,reverse=0,loop=0;
+ int          load_options=0;
  Transport    transport=Transport_None;
  Profile     *profile=NULL;
  Translation *translation=NULL;
@@ -126,6 +131,22 @@ int main(int argc,char** argv)
        translations=&argv[arg][15];
     else if(!strcmp(argv[arg],"--exact-nodes-only"))
        exactnodes=1;
+    else if(!strcmp(argv[arg],"--load-random"))
+       load_options|=MAPFILE_RANDOM;
+    else if(!strcmp(argv[arg],"--load-willneed"))
+       load_options|=MAPFILE_WILLNEED;
+    else if(!strcmp(argv[arg],"--load-prefault"))
+       load_options|=MAPFILE_PREFAULT;
+    else if(!strcmp(argv[arg],"--load-lock"))
+       load_options|=MAPFILE_LOCK;
+    else if(!strcmp(argv[arg],"--load-hugepages"))
+       load_options|=MAPFILE_HUGEPAGES;
+    else if(!strcmp(argv[arg],"--verify-database"))
+       load_options|=MAPFILE_VERIFY;
+#if SLIM
+    else if(!strncmp(argv[arg],"--cache-size=",13))
+       SetSlimCacheSize((size_t)atoi(&argv[arg][13])*1024*1024);
+#endif
     else if(!strncmp(argv[arg],"--reverse",9))
       {
        if(argv[arg][9]=='=')
@@ -501,16 +522,25 @@ int main(int argc,char** argv)
  if(!option_quiet)
     printf_first("Loading Files:");
 
- OSMNodes=LoadNodeList(FileName(dirname,prefix,"nodes.mem"));
+#if !SLIM
+ container_filename=FileName(dirname,prefix,"database.mem");
+
+ if(ExistsFile(container_filename))
+    container=MapContainerFile(container_filename,dirname,prefix,load_options);
+
+ free(container_filename);
+#endif
+
+ OSMNodes=LoadNodeList(FileName(dirname,prefix,"nodes.mem"),load_options);
 
- OSMSegments=LoadSegmentList(FileName(dirname,prefix,"segments.mem"));
+ OSMSegments=LoadSegmentList(FileName(dirname,prefix,"segments.mem"),load_options);
 
- OSMWays=LoadWayList(FileName(dirname,prefix,"ways.mem"));
+ OSMWays=LoadWayList(FileName(dirname,prefix,"ways.mem"),load_options);
 
- OSMRelations=LoadRelationList(FileName(dirname,prefix,"relations.mem"));
+ OSMRelations=LoadRelationList(FileName(dirname,prefix,"relations.mem"),load_options);
 
  if(!option_quiet)
-    printf_last("Loaded Files: nodes, segments, ways & relations");
+    printf_last("Loaded Files: nodes, segments, ways & relations%s",container?" (single file)":"");
 
  /* Check the profile is valid for use with this database */
 
@@ -622,7 +652,7 @@ int main(int argc,char** argv)
     if(!option_quiet)
        printf("Routing from waypoint %d to waypoint %d\n",start_waypoint,finish_waypoint);
 
-    results[nresults]=CalculateRoute(OSMNodes,OSMSegments,OSMWays,OSMRelations,profile,start_node,join_segment,finish_node,start_waypoint,finish_waypoint);
+    results[nresults]=CalculateRoute(OSMNodes,OSMSegments,OSMWays,OSMRelations,profile,start_node,join_segment,finish_node,NULL,start_waypoint,finish_waypoint);
 
     if(!results[nresults])
        exit(EXIT_FAILURE);
@@ -645,7 +675,7 @@ int main(int argc,char** argv)
     if(!option_quiet)
        printf("Routing from waypoint %d to waypoint %d\n",start_waypoint,finish_waypoint);
 
-    results[nresults]=CalculateRoute(OSMNodes,OSMSegments,OSMWays,OSMRelations,profile,start_node,join_segment,finish_node,start_waypoint,finish_waypoint);
+    results[nresults]=CalculateRoute(OSMNodes,OSMSegments,OSMWays,OSMRelations,profile,start_node,join_segment,finish_node,NULL,start_waypoint,finish_waypoint);
 
     if(!results[nresults])
        exit(EXIT_FAILURE);
@@ -670,6 +700,15 @@ int main(int argc,char** argv)
  if(!option_quiet)
     printf_last("Generated Result Outputs");
 
+ /* Print the cache statistics */
+
+#if SLIM
+ log_cache("Nodes",OSMNodes->cache->slots.nitems,OSMNodes->cache->slots.hits,OSMNodes->cache->slots.misses,OSMNodes->cache->slots.evictions);
+ log_cache("Segments",OSMSegments->cache->slots.nitems,OSMSegments->cache->slots.hits,OSMSegments->cache->slots.misses,OSMSegments->cache->slots.evictions);
+ log_cache("Ways",OSMWays->cache->slots.nitems,OSMWays->cache->slots.hits,OSMWays->cache->slots.misses,OSMWays->cache->slots.evictions);
+ log_cache("TurnRelations",OSMRelations->cache->slots.nitems,OSMRelations->cache->slots.hits,OSMRelations->cache->slots.misses,OSMRelations->cache->slots.evictions);
+#endif
+
  /* Destroy the remaining results lists and data structures */
 
 #ifdef DEBUG_MEMORY_LEAK
@@ -677,11 +716,17 @@ int main(int argc,char** argv)
  for(waypoint=0;waypoint<nresults;waypoint++)
     FreeResultsList(results[waypoint]);
 
+ FreeSpareResultsLists();
+ FreeSpareQueueLists();
+
  DestroyNodeList(OSMNodes);
  DestroySegmentList(OSMSegments);
  DestroyWayList(OSMWays);
  DestroyRelationList(OSMRelations);
 
+ if(container)
+    UnmapFile(container);
+
  FreeXMLProfiles();
 
  FreeXMLTranslations();
@@ -723,6 +768,12 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "              [--dir=<dirname>] [--prefix=<name>]\n"
             "              [--profiles=<filename>] [--translations=<filename>]\n"
             "              [--exact-nodes-only]\n"
+            "              [--load-random] [--load-willneed] [--load-prefault]\n"
+            "              [--load-lock] [--load-hugepages]\n"
+            "              [--verify-database]\n"
+#if SLIM
+            "              [--cache-size=<size>]\n"
+#endif
             "              [--quiet | [--loggable] [--logtime] [--logmemory]]\n"
             "              [--language=<lang>]\n"
             "              [--output-html]\n"
@@ -755,6 +806,7 @@ static void print_usage(int detail,const char *argerr,const char *err)
    }
 
  if(detail==1)
+   {
     fprintf(stderr,
             "\n"
             "--version               Print the version of Routino.\n"
@@ -778,10 +830,28 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "\n"
             "--exact-nodes-only      Only route between nodes (don't find closest segment).\n"
             "\n"
+            "--load-random           Advise that the database is accessed randomly.\n"
+            "--load-willneed         Start reading the whole database in the background.\n"
+            "--load-prefault         Read the whole database into memory before routing.\n"
+            "--load-lock             Lock the database into memory (if allowed).\n"
+            "--load-hugepages        Copy the database into memory using huge pages.\n"
+            "--verify-database       Check all of the single file database checksums.\n"
+            "\n"
+#if SLIM
+            "--cache-size=<size>     The amount of RAM (in MB) to use for each of the\n"
+            "                        caches of nodes, segments, ways and relations.\n"
+            "\n"
+#endif
+            );
+
+    fprintf(stderr,
             "--quiet                 Don't print any screen output when running.\n"
             "--loggable              Print progress messages suitable for logging to file.\n"
             "--logtime               Print the elapsed time for each processing step.\n"
             "--logmemory             Print the max allocated/mapped memory for each step.\n"
+#if SLIM
+            "                        (and the cache statistics at the end.)\n"
+#endif
             "\n"
             "--language=<lang>       Use the translations for specified language.\n"
             "--output-html           Write an HTML description of the route.\n"
@@ -829,6 +899,7 @@ static void print_usage(int detail,const char *argerr,const char *err)
             "<property> can be selected from:\n"
             "%s",
             TransportList(),HighwayList(),PropertyList());
+   }
 
  exit(!detail);
 }
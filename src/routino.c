@@ -21,6 +21,10 @@
 
 #include <stdlib.h>
 
+#if defined(USE_PTHREADS) && USE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "routino.h"
 
 #include "types.h"
@@ -34,6 +38,7 @@
 #include "functions.h"
 #include "profiles.h"
 #include "translations.h"
+#include "xmlparse.h"
 
 #include "version.h"
 
@@ -46,41 +51,89 @@ DLL_PUBLIC const int Routino_APIVersion=ROUTINO_API_VERSION;
 /*+ Contains the Routino version number. +*/
 DLL_PUBLIC const char *Routino_Version=ROUTINO_VERSION;
 
-/*+ Contains the error number of the most recent Routino function (one of the ROUTINO_ERROR_* values). +*/
+/*+ Contains the error number of the most recent Routino function (one of the ROUTINO_ERROR_* values); it is shared by all threads so it is not meaningful while functions are being called by more than one thread. +*/
 DLL_PUBLIC int Routino_errno=ROUTINO_ERROR_NONE;
 
 /*+ The function to be called to report on the routing progress. +*/
-Routino_ProgressFunc progress_func=NULL;
+THREAD_LOCAL Routino_ProgressFunc progress_func=NULL;
 
 /*+ The current state of the routing progress. +*/
-double progress_value=0;
+THREAD_LOCAL double progress_value=0;
 
 /*+ Set when the progress callback returns false in the routing function. +*/
-int progress_abort=0;
+THREAD_LOCAL int progress_abort=0;
 
 /*+ The option to calculate the quickest route insted of the shortest. +*/
-extern int option_quickest;
+extern THREAD_LOCAL int option_quickest;
 
 /*+ The options to select the format of the file output. +*/
-extern int option_file_html,option_file_gpx_track,option_file_gpx_route,option_file_text,option_file_text_all,option_file_stdout;
+extern THREAD_LOCAL int option_file_html,option_file_gpx_track,option_file_gpx_route,option_file_text,option_file_text_all,option_file_stdout;
 
 /*+ The options to select the format of the linked list output. +*/
-extern int option_list_html,option_list_html_all,option_list_text,option_list_text_all;
+extern THREAD_LOCAL int option_list_html,option_list_html_all,option_list_text,option_list_text_all;
 
 
 /* Static variables */
 
 static distance_t distmax=km_to_distance(1);
 
+/*+ The generation of the most recently loaded set of database files (changed while load_mutex is locked). +*/
+static unsigned int last_generation=0;
+
+/*+ The number of contexts created by the calling thread that have not been deleted yet. +*/
+static THREAD_LOCAL int thread_contexts=0;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+/*+ A mutex so that only one set of database files is loaded at a time. +*/
+static pthread_mutex_t load_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+/*+ A key that is set in each thread that calculates a route so that the memory it keeps for re-use is freed when it exits. +*/
+static pthread_key_t thread_memory_key;
+
+/*+ Used to create thread_memory_key only once. +*/
+static pthread_once_t thread_memory_once=PTHREAD_ONCE_INIT;
+
+#endif
+
 
 /* Local types */
 
-struct _Routino_Database
+struct database_files
 {
  Nodes      *nodes;
  Segments   *segments;
  Ways       *ways;
  Relations  *relations;
+
+ void        *container;        /* The mapped single database file that holds the files (or NULL if they are separate). */
+
+ unsigned int generation;       /* A number that is different for each set of files loaded (never re-used, unlike the pointers). */
+ int          refcount;         /* The number of users of the files (the database while they are current and each route being calculated). */
+
+ WayCost    **waycosts;         /* The way costs of validated profiles that were replaced while the files were in use. */
+ int          nwaycosts;        /* The number of replaced way costs. */
+
+ struct database_files *next;   /* The next (older) set of files that is still in use. */
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_t mutex;         /* The slim mode data caches are shared so only one thread can route at a time. */
+#endif
+};
+
+struct _Routino_Database
+{
+ struct database_files *files;  /* The current set of files followed by the older ones that routes are still using. */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_t mutex;         /* The mutex for the list of files, their reference counts and the validated profiles. */
+#endif
+};
+
+struct _Routino_Context
+{
+ Routino_Database *database;
+ int error;
 };
 
 struct _Routino_Waypoint
@@ -88,9 +141,36 @@ struct _Routino_Waypoint
  index_t segment;
  index_t node1,node2;
  distance_t dist1,dist2;
+
+ double latitude,longitude;     /* The location that was searched for (to find the waypoint again if the database is swapped). */
+ unsigned int generation;       /* The generation of the database files that the waypoint was found in. */
 };
 
 
+/* Local functions */
+
+static struct database_files *load_files(const char *dirname,const char *prefix,int flags);
+static void destroy_files(struct database_files *files);
+
+static struct database_files *acquire_files(Routino_Database *database);
+static void release_files(Routino_Database *database,struct database_files *files);
+
+static int select_profile(Routino_Database *database,struct database_files *files,Routino_Profile *profile,Routino_Profile *selected,WayCost **waycost);
+static Routino_Waypoint *select_waypoint(struct database_files *files,Routino_Profile *profile,Routino_Waypoint *waypoint,Routino_Waypoint *selected);
+
+static Routino_Output *calculate_route(Routino_Context *context,struct database_files *files,Routino_Profile *profile,Routino_Translation *translation,
+                                       Routino_Waypoint **waypoints,int nwaypoints,int options,Routino_ProgressFunc progress);
+
+static void route_distance_duration(struct database_files *files,Routino_Profile *profile,Results *results,float *dist,float *time);
+
+static void keep_thread_memory(void);
+static void free_thread_memory(void *arg);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+static void create_thread_memory_key(void);
+#endif
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Check the version of the library used by the caller against the library version
 
@@ -111,7 +191,7 @@ DLL_PUBLIC int Routino_Check_API_Version(int caller_version)
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Load a database of files for Routino to use for routing.
+  Load a database of files for Routino to use for routing (from the single database file if there is one).
 
   Routino_Database *Routino_LoadDatabase Returns a pointer to the database.
 
@@ -121,31 +201,216 @@ DLL_PUBLIC int Routino_Check_API_Version(int caller_version)
   ++++++++++++++++++++++++++++++++++++++*/
 
 DLL_PUBLIC Routino_Database *Routino_LoadDatabase(const char *dirname,const char *prefix)
+{
+ return(Routino_LoadDatabaseFlags(dirname,prefix,ROUTINO_LOAD_DEFAULT));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Load a database of files for Routino to use for routing with options that control how they are loaded.
+
+  Routino_Database *Routino_LoadDatabaseFlags Returns a pointer to the database.
+
+  const char *dirname The pathname of the directory containing the database files.
+
+  const char *prefix The prefix of the database files.
+
+  int flags A combination of the ROUTINO_LOAD_* options (in slim mode only the access advice and reading ahead apply).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Database *Routino_LoadDatabaseFlags(const char *dirname,const char *prefix,int flags)
+{
+ Routino_Database *database;
+ struct database_files *files;
+
+ files=load_files(dirname,prefix,flags);
+
+ if(!files)
+    return(NULL);
+
+ database=calloc(sizeof(Routino_Database),1);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_init(&database->mutex,NULL);
+#endif
+
+ database->files=files;
+
+ Routino_errno=ROUTINO_ERROR_NONE;
+ return(database);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Close the database files that were opened by a call to Routino_LoadDatabase() (no routes can be being calculated with the database);
+  this also frees the memory that the calling thread keeps for re-use between routes.
+
+  Routino_Database *database The database to close.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC void Routino_UnloadDatabase(Routino_Database *database)
+{
+ if(!database)
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+ else
+   {
+    while(database->files)
+      {
+       struct database_files *files=database->files;
+
+       database->files=files->next;
+
+       destroy_files(files);
+      }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    pthread_mutex_destroy(&database->mutex);
+#endif
+
+    free(database);
+
+    free_thread_memory(NULL);
+
+    Routino_errno=ROUTINO_ERROR_NONE;
+   }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Replace the files of a loaded database with a new set while it is in use; routes started after this use the new files
+  and routes that are already being calculated finish with the old ones, which are closed when the last of them finishes.
+
+  int Routino_SwapDatabase Returns zero if OK or something else in case of an error (the old files are still used).
+
+  Routino_Database *database The loaded database to update.
+
+  const char *dirname The pathname of the directory containing the new database files.
+
+  const char *prefix The prefix of the new database files.
+
+  int flags A combination of the ROUTINO_LOAD_* options (e.g. ROUTINO_LOAD_PREFAULT to read the new files into memory before they are used).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC int Routino_SwapDatabase(Routino_Database *database,const char *dirname,const char *prefix,int flags)
+{
+ struct database_files *files,*oldfiles;
+
+ if(!database)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+    return(Routino_errno);
+   }
+
+ files=load_files(dirname,prefix,flags);
+
+ if(!files)
+    return(Routino_errno);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&database->mutex);
+#endif
+
+ oldfiles=database->files;
+
+ files->next=oldfiles;
+
+ database->files=files;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&database->mutex);
+#endif
+
+ release_files(database,oldfiles);
+
+ Routino_errno=ROUTINO_ERROR_NONE;
+ return(Routino_errno);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Load a set of database files (from the single database file if there is one).
+
+  struct database_files *load_files Returns a pointer to the files (with one reference) or NULL in case of an error.
+
+  const char *dirname The pathname of the directory containing the database files.
+
+  const char *prefix The prefix of the database files.
+
+  int flags A combination of the ROUTINO_LOAD_* options.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static struct database_files *load_files(const char *dirname,const char *prefix,int flags)
 {
  char *nodes_filename;
  char *segments_filename;
  char *ways_filename;
  char *relations_filename;
- Routino_Database *database=NULL;
+ char *container_filename=NULL;
+ struct database_files *files=NULL;
+ int options=0;
+
+ if(flags&ROUTINO_LOAD_RANDOM)    options|=MAPFILE_RANDOM;
+ if(flags&ROUTINO_LOAD_WILLNEED)  options|=MAPFILE_WILLNEED;
+ if(flags&ROUTINO_LOAD_PREFAULT)  options|=MAPFILE_PREFAULT;
+ if(flags&ROUTINO_LOAD_LOCK)      options|=MAPFILE_LOCK;
+ if(flags&ROUTINO_LOAD_HUGEPAGES) options|=MAPFILE_HUGEPAGES;
+ if(flags&ROUTINO_LOAD_VERIFY)    options|=MAPFILE_VERIFY;
 
  nodes_filename    =FileName(dirname,prefix,"nodes.mem");
  segments_filename =FileName(dirname,prefix,"segments.mem");
  ways_filename     =FileName(dirname,prefix,"ways.mem");
  relations_filename=FileName(dirname,prefix,"relations.mem");
 
- if(!ExistsFile(nodes_filename) || !ExistsFile(nodes_filename) || !ExistsFile(nodes_filename) || !ExistsFile(nodes_filename))
+#if !SLIM
+ container_filename=FileName(dirname,prefix,"database.mem");
+
+ if(!ExistsFile(container_filename))
    {
-    Routino_errno=ROUTINO_ERROR_NO_DATABASE_FILES;
-    return(NULL);
+    free(container_filename);
+    container_filename=NULL;
    }
+#endif
+
+ if(!container_filename && (!ExistsFile(nodes_filename) || !ExistsFile(segments_filename) || !ExistsFile(ways_filename) || !ExistsFile(relations_filename)))
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE_FILES;
  else
    {
-    database=calloc(sizeof(Routino_Database),1);
+    files=calloc(sizeof(struct database_files),1);
+
+    files->refcount=1;
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+    pthread_mutex_init(&files->mutex,NULL);
+#endif
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    pthread_mutex_lock(&load_mutex);
+#endif
 
-    database->nodes    =LoadNodeList    (nodes_filename);
-    database->segments =LoadSegmentList (segments_filename);
-    database->ways     =LoadWayList     (ways_filename);
-    database->relations=LoadRelationList(relations_filename);
+    files->generation=++last_generation;
+
+    if(container_filename)
+       files->container=MapContainerFile(container_filename,dirname,prefix,options);
+
+    if(files->container || !container_filename)
+      {
+       files->nodes    =LoadNodeList    (nodes_filename    ,options);
+       files->segments =LoadSegmentList (segments_filename ,options);
+       files->ways     =LoadWayList     (ways_filename     ,options);
+       files->relations=LoadRelationList(relations_filename,options);
+      }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+    pthread_mutex_unlock(&load_mutex);
+#endif
+
+    if(!files->nodes || !files->segments || !files->ways || !files->relations)
+      {
+       destroy_files(files);
+       files=NULL;
+
+       Routino_errno=ROUTINO_ERROR_BAD_DATABASE_FILES;
+      }
    }
 
  free(nodes_filename);
@@ -153,45 +418,191 @@ DLL_PUBLIC Routino_Database *Routino_LoadDatabase(const char *dirname,const char
  free(ways_filename);
  free(relations_filename);
 
- if(!database->nodes || !database->segments || !database->ways || !database->relations)
-   {
-    Routino_UnloadDatabase(database);
-    database=NULL;
+ if(container_filename)
+    free(container_filename);
 
-    Routino_errno=ROUTINO_ERROR_BAD_DATABASE_FILES;
-   }
+ return(files);
+}
 
- if(database)
-   {
-    Routino_errno=ROUTINO_ERROR_NONE;
-    return(database);
-   }
- else
-    return(NULL);
+
+/*++++++++++++++++++++++++++++++++++++++
+  Close a set of database files and free the way costs that were kept until they were no longer used.
+
+  struct database_files *files The set of files to close.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void destroy_files(struct database_files *files)
+{
+ int i;
+
+ if(files->nodes)     DestroyNodeList    (files->nodes);
+ if(files->segments)  DestroySegmentList (files->segments);
+ if(files->ways)      DestroyWayList     (files->ways);
+ if(files->relations) DestroyRelationList(files->relations);
+
+ if(files->container) UnmapFile(files->container);
+
+ for(i=0;i<files->nwaycosts;i++)
+    DestroyWayCostList(files->waycosts[i]);
+
+ free(files->waycosts);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_destroy(&files->mutex);
+#endif
+
+ free(files);
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Close the database files that were opened by a call to Routino_LoadDatabase().
+  Take a reference to the current set of database files so that they are not closed while they are being used.
 
-  Routino_Database *database The database to close.
+  struct database_files *acquire_files Returns the current set of files.
+
+  Routino_Database *database The loaded database.
   ++++++++++++++++++++++++++++++++++++++*/
 
-DLL_PUBLIC void Routino_UnloadDatabase(Routino_Database *database)
+static struct database_files *acquire_files(Routino_Database *database)
 {
- if(!database)
-    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
- else
+ struct database_files *files;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&database->mutex);
+#endif
+
+ files=database->files;
+
+ files->refcount++;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&database->mutex);
+#endif
+
+ return(files);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Release a reference to a set of database files, closing them if it was the last one.
+
+  Routino_Database *database The loaded database.
+
+  struct database_files *files The set of files to release.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void release_files(Routino_Database *database,struct database_files *files)
+{
+ int unused;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&database->mutex);
+#endif
+
+ unused=(--files->refcount==0);
+
+ if(unused)
    {
-    if(database->nodes)     DestroyNodeList    (database->nodes);
-    if(database->segments)  DestroySegmentList (database->segments);
-    if(database->ways)      DestroyWayList     (database->ways);
-    if(database->relations) DestroyRelationList(database->relations);
+    struct database_files **prev=&database->files;
 
-    free(database);
+    while(*prev!=files)
+       prev=&(*prev)->next;
 
-    Routino_errno=ROUTINO_ERROR_NONE;
+    *prev=files->next;
    }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&database->mutex);
+#endif
+
+ if(unused)
+    destroy_files(files);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Take a copy of a validated profile to route with a set of database files, calculating temporary way costs
+  if it was validated with a different set of files (e.g. before the database was swapped).
+
+  int select_profile Returns ROUTINO_ERROR_NONE or an error number.
+
+  Routino_Database *database The loaded database.
+
+  struct database_files *files The set of files to be used (locked in slim mode).
+
+  Routino_Profile *profile The profile selected by the caller.
+
+  Routino_Profile *selected Returns the copy of the profile to route with.
+
+  WayCost **waycost Returns the temporary way costs to be freed after routing (or NULL if there are none).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int select_profile(Routino_Database *database,struct database_files *files,Routino_Profile *profile,Routino_Profile *selected,WayCost **waycost)
+{
+ *waycost=NULL;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&database->mutex);
+#endif
+
+ *selected=*profile;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&database->mutex);
+#endif
+
+ if(!selected->allow)
+    return(ROUTINO_ERROR_NOTVALID_PROFILE);
+
+ if(selected->generation==files->generation)
+    return(ROUTINO_ERROR_NONE);
+
+ selected->waycost=NULL;
+
+ if(UpdateProfile(selected,files->ways))
+    return(ROUTINO_ERROR_PROFILE_DATABASE_ERR);
+
+ selected->generation=files->generation;
+
+ *waycost=selected->waycost;
+
+ return(ROUTINO_ERROR_NONE);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Select a waypoint to route with a set of database files, finding it again if it was found with a different set of files.
+
+  Routino_Waypoint *select_waypoint Returns the waypoint to use or NULL if it cannot be found.
+
+  struct database_files *files The set of files to be used (locked in slim mode).
+
+  Routino_Profile *profile The profile to use to find the waypoint.
+
+  Routino_Waypoint *waypoint The waypoint selected by the caller.
+
+  Routino_Waypoint *selected A waypoint to fill in if the waypoint needs to be found again.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static Routino_Waypoint *select_waypoint(struct database_files *files,Routino_Profile *profile,Routino_Waypoint *waypoint,Routino_Waypoint *selected)
+{
+ distance_t dist;
+
+ if(waypoint->generation==files->generation)
+    return(waypoint);
+
+ *selected=*waypoint;
+
+ selected->segment=FindClosestSegment(files->nodes,files->segments,files->ways,
+                                      degrees_to_radians(selected->latitude),degrees_to_radians(selected->longitude),distmax,profile,
+                                      &dist,&selected->node1,&selected->node2,&selected->dist1,&selected->dist2);
+
+ selected->generation=files->generation;
+
+ if(selected->segment==NO_SEGMENT)
+    return(NULL);
+
+ return(selected);
 }
 
 
@@ -354,7 +765,7 @@ DLL_PUBLIC void Routino_FreeXMLTranslations(void)
 /*++++++++++++++++++++++++++++++++++++++
   Create a fully formed Routino Profile from a Routino User Profile.
 
-  Routino_Profile *Routino_CreateProfileFromUserProfile Returns an allocated Routino Profile.
+  Routino_Profile *Routino_CreateProfileFromUserProfile Returns an allocated Routino Profile (free it using Routino_DeleteProfile()).
 
   Routino_UserProfile *profile The user specified profile to convert (not modified by this).
   ++++++++++++++++++++++++++++++++++++++*/
@@ -460,49 +871,147 @@ DLL_PUBLIC Routino_UserProfile *Routino_CreateUserProfileFromProfile(Routino_Pro
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Validates that a selected routing profile is valid for use with the selected routing database.
-
-  int Routino_ValidateProfile Returns zero if OK or something else in case of an error.
+  Delete a Routino Profile that was created by Routino_CreateProfileFromUserProfile().
 
-  Routino_Database *database The Routino database to use.
-
-  Routino_Profile *profile The Routino profile to validate.
+  Routino_Profile *profile The Routino Profile to delete.
   ++++++++++++++++++++++++++++++++++++++*/
 
-DLL_PUBLIC int Routino_ValidateProfile(Routino_Database *database,Routino_Profile *profile)
+DLL_PUBLIC void Routino_DeleteProfile(Routino_Profile *profile)
 {
  Routino_errno=ROUTINO_ERROR_NONE;
 
- if(UpdateProfile(profile,database->ways))
-    Routino_errno=ROUTINO_ERROR_PROFILE_DATABASE_ERR;
-
- return(Routino_errno);
+ if(profile)
+    FreeProfile(profile);
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Finds the nearest point in the database to the specified latitude and longitude.
+  Validates that a selected routing profile is valid for use with the selected routing database.
+  The profile can only be used for routing with the most recent database that it was validated with
+  (after the database is swapped it can still be used but it should be validated again to avoid
+  recalculating the way costs for every route).
 
-  Routino_Waypoint *Routino_FindWaypoint Returns a pointer to a newly allocated Routino waypoint or NULL if none could be found.
+  int Routino_ValidateProfile Returns zero if OK or something else in case of an error.
 
   Routino_Database *database The Routino database to use.
 
-  Routino_Profile *profile The Routino profile to use.
-
-  double latitude The latitude in degrees of the point.
-
-  double longitude The longitude in degrees of the point.
+  Routino_Profile *profile The Routino profile to validate.
   ++++++++++++++++++++++++++++++++++++++*/
 
-DLL_PUBLIC Routino_Waypoint *Routino_FindWaypoint(Routino_Database *database,Routino_Profile *profile,double latitude,double longitude)
+DLL_PUBLIC int Routino_ValidateProfile(Routino_Database *database,Routino_Profile *profile)
 {
- distance_t dist;
- Routino_Waypoint *waypoint;
+ struct database_files *files,*oldfiles;
+ Routino_Profile updated;
+ WayCost *waycost;
+ int retval;
 
  if(!database)
    {
     Routino_errno=ROUTINO_ERROR_NO_DATABASE;
-    return(NULL);
+    return(Routino_errno);
+   }
+
+ if(!profile)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_PROFILE;
+    return(Routino_errno);
+   }
+
+ files=acquire_files(database);
+
+ /* Update a copy of the profile since routes can be using the profile at the same time */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&database->mutex);
+#endif
+
+ updated=*profile;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&database->mutex);
+#endif
+
+ updated.waycost=NULL;
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&files->mutex);
+#endif
+
+ retval=UpdateProfile(&updated,files->ways);
+
+ updated.generation=files->generation;
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&files->mutex);
+#endif
+
+ if(retval)
+   {
+    release_files(database,files);
+
+    Routino_errno=ROUTINO_ERROR_PROFILE_DATABASE_ERR;
+    return(Routino_errno);
+   }
+
+ /* Replace the profile and keep the old way costs until the files they were used with are closed */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&database->mutex);
+#endif
+
+ waycost=profile->waycost;
+
+ for(oldfiles=database->files;oldfiles;oldfiles=oldfiles->next)
+    if(oldfiles->generation==profile->generation)
+       break;
+
+ *profile=updated;
+
+ if(waycost && oldfiles)
+   {
+    oldfiles->waycosts=realloc(oldfiles->waycosts,(oldfiles->nwaycosts+1)*sizeof(WayCost*));
+    oldfiles->waycosts[oldfiles->nwaycosts++]=waycost;
+    waycost=NULL;
+   }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&database->mutex);
+#endif
+
+ if(waycost)
+    DestroyWayCostList(waycost);
+
+ release_files(database,files);
+
+ Routino_errno=ROUTINO_ERROR_NONE;
+ return(Routino_errno);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Finds the nearest point in the database to the specified latitude and longitude.
+
+  Routino_Waypoint *Routino_FindWaypoint Returns a pointer to a newly allocated Routino waypoint or NULL if none could be found.
+
+  Routino_Database *database The Routino database to use.
+
+  Routino_Profile *profile The Routino profile to use.
+
+  double latitude The latitude in degrees of the point.
+
+  double longitude The longitude in degrees of the point.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Waypoint *Routino_FindWaypoint(Routino_Database *database,Routino_Profile *profile,double latitude,double longitude)
+{
+ distance_t dist;
+ Routino_Waypoint *waypoint;
+ struct database_files *files;
+
+ if(!database)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+    return(NULL);
    }
 
  if(!profile)
@@ -519,10 +1028,26 @@ DLL_PUBLIC Routino_Waypoint *Routino_FindWaypoint(Routino_Database *database,Rou
 
  waypoint=calloc(sizeof(Routino_Waypoint),1);
 
- waypoint->segment=FindClosestSegment(database->nodes,database->segments,database->ways,
+ files=acquire_files(database);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&files->mutex);
+#endif
+
+ waypoint->segment=FindClosestSegment(files->nodes,files->segments,files->ways,
                                       degrees_to_radians(latitude),degrees_to_radians(longitude),distmax,profile,
                                       &dist,&waypoint->node1,&waypoint->node2,&waypoint->dist1,&waypoint->dist2);
 
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&files->mutex);
+#endif
+
+ waypoint->latitude=latitude;
+ waypoint->longitude=longitude;
+ waypoint->generation=files->generation;
+
+ release_files(database,files);
+
  if(waypoint->segment==NO_SEGMENT)
    {
     free(waypoint);
@@ -536,6 +1061,74 @@ DLL_PUBLIC Routino_Waypoint *Routino_FindWaypoint(Routino_Database *database,Rou
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Create a routing context that holds the error status of its routes so that several threads can calculate routes using the same database at once.
+
+  Routino_Context *Routino_CreateContext Returns a pointer to the newly allocated context or NULL in case of an error.
+
+  Routino_Database *database The loaded database that the context will be used with.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Context *Routino_CreateContext(Routino_Database *database)
+{
+ Routino_Context *context;
+
+ if(!database)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+    return(NULL);
+   }
+
+ context=calloc(sizeof(Routino_Context),1);
+
+ context->database=database;
+ context->error=ROUTINO_ERROR_NONE;
+
+ thread_contexts++;
+
+ return(context);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Delete a routing context that was created by Routino_CreateContext(), if it is the last context of the calling thread this also frees the memory
+  that the thread keeps for re-use between routes.
+
+  Routino_Context *context The context to be deleted.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC void Routino_DeleteContext(Routino_Context *context)
+{
+ if(!context)
+    return;
+
+ if(thread_contexts>0)
+    thread_contexts--;
+
+ if(thread_contexts==0)
+    free_thread_memory(NULL);
+
+ free(context);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Return the error number of the most recent route calculated with a context (routes calculated with a context do not change Routino_errno).
+
+  int Routino_ContextErrno Returns one of the ROUTINO_ERROR_* values.
+
+  Routino_Context *context The context to check.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC int Routino_ContextErrno(Routino_Context *context)
+{
+ if(!context)
+    return(ROUTINO_ERROR_NO_DATABASE);
+
+ return(context->error);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Calculate a route using a loaded database, chosen profile, chosen translation and set of waypoints.
 
@@ -559,13 +1152,8 @@ DLL_PUBLIC Routino_Waypoint *Routino_FindWaypoint(Routino_Database *database,Rou
 DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Routino_Profile *profile,Routino_Translation *translation,
                                                   Routino_Waypoint **waypoints,int nwaypoints,int options,Routino_ProgressFunc progress)
 {
- int first_waypoint,last_waypoint,this_waypoint,nwaypoints_routed,inc_dec_waypoint,start_waypoint,finish_waypoint=-1;
- index_t start_node,finish_node=NO_NODE;
- index_t join_segment=NO_SEGMENT;
- Results **results;
- Routino_Output *output=NULL;
-
- /* Check the input data */
+ Routino_Context context;
+ Routino_Output *output;
 
  if(!database)
    {
@@ -573,21 +1161,118 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
     return(NULL);
    }
 
- if(!profile)
+ /* A temporary context (the memory used for the route is kept by the thread for the next one) */
+
+ context.database=database;
+
+ output=Routino_CalculateRouteContext(&context,profile,translation,waypoints,nwaypoints,options,progress);
+
+ Routino_errno=context.error;
+
+ return(output);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate a route using a routing context, chosen profile, chosen translation and set of waypoints; different threads can use different contexts at the same time
+  (the error number is only stored in the context and is available from Routino_ContextErrno()).
+
+  Routino_Output *Routino_CalculateRouteContext Returns the head of a linked list of route data (if requested) or NULL.
+
+  Routino_Context *context The routing context to use (not to be used by more than one thread at a time).
+
+  Routino_Profile *profile The chosen routing profile to use.
+
+  Routino_Translation *translation The chosen translation information to use.
+
+  Routino_Waypoint **waypoints The set of waypoints.
+
+  int nwaypoints The number of waypoints.
+
+  int options The set of routing options (ROUTINO_ROUTE_*) ORed together.
+
+  Routino_ProgressFunc progress A function to be called occasionally to report progress or NULL.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Output *Routino_CalculateRouteContext(Routino_Context *context,Routino_Profile *profile,Routino_Translation *translation,
+                                                         Routino_Waypoint **waypoints,int nwaypoints,int options,Routino_ProgressFunc progress)
+{
+ Routino_Output *output;
+ struct database_files *files;
+
+ if(!context)
    {
-    Routino_errno=ROUTINO_ERROR_NO_PROFILE;
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
     return(NULL);
    }
 
- if(!profile->allow)
+ context->error=ROUTINO_ERROR_NONE;
+
+ keep_thread_memory();
+
+ files=acquire_files(context->database);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&files->mutex);
+#endif
+
+ output=calculate_route(context,files,profile,translation,waypoints,nwaypoints,options,progress);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&files->mutex);
+#endif
+
+ release_files(context->database,files);
+
+ return(output);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate a route using a routing context (the implementation of Routino_CalculateRouteContext()).
+
+  Routino_Output *calculate_route Returns the head of a linked list of route data (if requested) or NULL.
+
+  Routino_Context *context The routing context to use.
+
+  struct database_files *files The set of database files to use (locked in slim mode).
+
+  Routino_Profile *profile The chosen routing profile to use.
+
+  Routino_Translation *translation The chosen translation information to use.
+
+  Routino_Waypoint **waypoints The set of waypoints.
+
+  int nwaypoints The number of waypoints.
+
+  int options The set of routing options (ROUTINO_ROUTE_*) ORed together.
+
+  Routino_ProgressFunc progress A function to be called occasionally to report progress or NULL.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static Routino_Output *calculate_route(Routino_Context *context,struct database_files *files,Routino_Profile *profile,Routino_Translation *translation,
+                                       Routino_Waypoint **waypoints,int nwaypoints,int options,Routino_ProgressFunc progress)
+{
+ int first_waypoint,last_waypoint,this_waypoint,nwaypoints_routed,inc_dec_waypoint,start_waypoint,finish_waypoint=-1;
+ index_t start_node,finish_node=NO_NODE;
+ index_t join_segment=NO_SEGMENT;
+ Results **results;
+ Routino_Output *output=NULL;
+ Routino_Profile selected_profile;
+ Routino_Waypoint **selected_waypoints,*found_waypoints;
+ WayCost *waycost;
+
+ /* Check the input data */
+
+ if(!profile)
    {
-    Routino_errno=ROUTINO_ERROR_NOTVALID_PROFILE;
+    context->error=ROUTINO_ERROR_NO_PROFILE;
     return(NULL);
    }
 
  if(!translation)
    {
-    Routino_errno=ROUTINO_ERROR_NO_TRANSLATION;
+    context->error=ROUTINO_ERROR_NO_TRANSLATION;
     return(NULL);
    }
 
@@ -605,7 +1290,7 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
 
  if(option_file_stdout && (option_file_html+option_file_gpx_track+option_file_gpx_route+option_file_text+option_file_text_all)!=1)
    {
-    Routino_errno=ROUTINO_ERROR_BAD_OPTIONS;
+    context->error=ROUTINO_ERROR_BAD_OPTIONS;
     return(NULL);
    }
 
@@ -616,10 +1301,33 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
 
  if((option_list_html+option_list_html_all+option_list_text+option_list_text_all)>1)
    {
-    Routino_errno=ROUTINO_ERROR_BAD_OPTIONS;
+    context->error=ROUTINO_ERROR_BAD_OPTIONS;
     return(NULL);
    }
 
+ /* Select the profile and waypoints to use with the database files */
+
+ context->error=select_profile(context->database,files,profile,&selected_profile,&waycost);
+
+ if(context->error!=ROUTINO_ERROR_NONE)
+    return(NULL);
+
+ profile=&selected_profile;
+
+ selected_waypoints=malloc(nwaypoints*sizeof(Routino_Waypoint*));
+ found_waypoints=malloc(nwaypoints*sizeof(Routino_Waypoint));
+
+ results=calloc(sizeof(Results*),nwaypoints);
+
+ for(this_waypoint=0;this_waypoint<nwaypoints;this_waypoint++)
+    if(!(selected_waypoints[this_waypoint]=select_waypoint(files,profile,waypoints[this_waypoint],&found_waypoints[this_waypoint])))
+      {
+       context->error=ROUTINO_ERROR_NO_NEARBY_HIGHWAY;
+       goto tidy_and_exit;
+      }
+
+ waypoints=selected_waypoints;
+
  /* Set up the progress callback */
 
  progress_func=progress;
@@ -650,8 +1358,6 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
 
  /* Loop through all pairs of waypoints */
 
- results=calloc(sizeof(Results*),nwaypoints);
-
  for(this_waypoint=first_waypoint;this_waypoint!=(last_waypoint+inc_dec_waypoint);this_waypoint+=inc_dec_waypoint)
    {
     int waypoint=this_waypoint%nwaypoints;
@@ -663,7 +1369,7 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
 
        if(!progress_func(progress_value))
          {
-          Routino_errno=ROUTINO_ERROR_PROGRESS_ABORTED;
+          context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
           goto tidy_and_exit;
          }
       }
@@ -672,22 +1378,22 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
     start_node=finish_node;
 
     finish_waypoint=waypoint+1;
-    finish_node=CreateFakes(database->nodes,database->segments,finish_waypoint,
-                            LookupSegment(database->segments,waypoints[waypoint]->segment,1),
+    finish_node=CreateFakes(files->nodes,files->segments,finish_waypoint,
+                            LookupSegment(files->segments,waypoints[waypoint]->segment,1),
                             waypoints[waypoint]->node1,waypoints[waypoint]->node2,waypoints[waypoint]->dist1,waypoints[waypoint]->dist2);
 
     if(waypoint_count==0)
        continue;
 
-    results[waypoint_count-1]=CalculateRoute(database->nodes,database->segments,database->ways,database->relations,
-                                             profile,start_node,join_segment,finish_node,start_waypoint,finish_waypoint);
+    results[waypoint_count-1]=CalculateRoute(files->nodes,files->segments,files->ways,files->relations,
+                                             profile,start_node,join_segment,finish_node,NULL,start_waypoint,finish_waypoint);
 
     if(!results[waypoint_count-1])
       {
        if(progress_func && progress_abort)
-          Routino_errno=ROUTINO_ERROR_PROGRESS_ABORTED;
+          context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
        else
-          Routino_errno=ROUTINO_ERROR_NO_ROUTE_1-1+start_waypoint;
+          context->error=ROUTINO_ERROR_NO_ROUTE_1-1+start_waypoint;
 
        goto tidy_and_exit;
       }
@@ -701,18 +1407,18 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
 
     if(!progress_func(progress_value))
       {
-       Routino_errno=ROUTINO_ERROR_PROGRESS_ABORTED;
+       context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
        goto tidy_and_exit;
       }
    }
 
  /* Print the route */
 
- output=PrintRoute(results,nwaypoints_routed-1,database->nodes,database->segments,database->ways,database->relations,profile,translation);
+ output=PrintRoute(results,nwaypoints_routed-1,files->nodes,files->segments,files->ways,files->relations,profile,translation);
 
  if(progress_func && !progress_func(1.0))
    {
-    Routino_errno=ROUTINO_ERROR_PROGRESS_ABORTED;
+    context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
     goto tidy_and_exit;
    }
 
@@ -728,6 +1434,12 @@ DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Rou
 
  free(results);
 
+ free(selected_waypoints);
+ free(found_waypoints);
+
+ if(waycost)
+    DestroyWayCostList(waycost);
+
  return(output);
 }
 
@@ -761,3 +1473,659 @@ DLL_PUBLIC void Routino_DeleteRoute(Routino_Output *output)
     output=next;
    }
 }
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the distance and duration of the routes from each of a set of sources to each of a set of targets.
+
+  Routino_Matrix *Routino_CalculateMatrix Returns a pointer to a newly allocated matrix of results or NULL in case of an error.
+
+  Routino_Database *database The loaded database to use.
+
+  Routino_Profile *profile The chosen routing profile to use.
+
+  Routino_Waypoint **sources The set of waypoints to start from.
+
+  int nsources The number of waypoints to start from.
+
+  Routino_Waypoint **targets The set of waypoints to finish at.
+
+  int ntargets The number of waypoints to finish at.
+
+  int options The set of routing options, only ROUTINO_ROUTE_SHORTEST or ROUTINO_ROUTE_QUICKEST are allowed.
+
+  Routino_ProgressFunc progress A function to be called occasionally to report progress or NULL.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Matrix *Routino_CalculateMatrix(Routino_Database *database,Routino_Profile *profile,
+                                                   Routino_Waypoint **sources,int nsources,Routino_Waypoint **targets,int ntargets,
+                                                   int options,Routino_ProgressFunc progress)
+{
+ Routino_Context context;
+ Routino_Matrix *matrix;
+
+ if(!database)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+    return(NULL);
+   }
+
+ /* A temporary context (the memory used for the routes is kept by the thread for the next ones) */
+
+ context.database=database;
+
+ matrix=Routino_CalculateMatrixContext(&context,profile,sources,nsources,targets,ntargets,options,progress);
+
+ Routino_errno=context.error;
+
+ return(matrix);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the distance and duration of the routes from each of a set of sources to each of a set of targets using a routing context;
+  different threads can use different contexts at the same time (the error number is only stored in the context and is available from
+  Routino_ContextErrno()).
+
+  Routino_Matrix *Routino_CalculateMatrixContext Returns a pointer to a newly allocated matrix of results or NULL in case of an error.
+
+  Routino_Context *context The routing context to use (not to be used by more than one thread at a time).
+
+  Routino_Profile *profile The chosen routing profile to use.
+
+  Routino_Waypoint **sources The set of waypoints to start from.
+
+  int nsources The number of waypoints to start from.
+
+  Routino_Waypoint **targets The set of waypoints to finish at.
+
+  int ntargets The number of waypoints to finish at.
+
+  int options The set of routing options, only ROUTINO_ROUTE_SHORTEST or ROUTINO_ROUTE_QUICKEST are allowed.
+
+  Routino_ProgressFunc progress A function to be called occasionally to report progress or NULL.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Matrix *Routino_CalculateMatrixContext(Routino_Context *context,Routino_Profile *profile,
+                                                          Routino_Waypoint **sources,int nsources,Routino_Waypoint **targets,int ntargets,
+                                                          int options,Routino_ProgressFunc progress)
+{
+ Routino_Matrix *matrix=NULL;
+ Results **finish,*begin=NULL;
+ index_t *target_nodes;
+ int *target_local,*target_barrier;
+ int source,target;
+ Routino_Database *database;
+ struct database_files *files;
+ Routino_Profile selected_profile;
+ Routino_Waypoint **selected_waypoints,*found_waypoints;
+ WayCost *waycost;
+
+ /* Check the input data */
+
+ if(!context)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+    return(NULL);
+   }
+
+ database=context->database;
+
+ if(!profile)
+   {
+    context->error=ROUTINO_ERROR_NO_PROFILE;
+    return(NULL);
+   }
+
+ if(options&~ROUTINO_ROUTE_QUICKEST || !sources || nsources<1 || !targets || ntargets<1)
+   {
+    context->error=ROUTINO_ERROR_BAD_OPTIONS;
+    return(NULL);
+   }
+
+ context->error=ROUTINO_ERROR_NONE;
+
+ /* Extract the options */
+
+ if(options&ROUTINO_ROUTE_QUICKEST) option_quickest=1; else option_quickest=0;
+
+ /* Set up the progress callback */
+
+ progress_func=progress;
+ progress_value=0.0;
+ progress_abort=0;
+
+ keep_thread_memory();
+
+ files=acquire_files(database);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&files->mutex);
+#endif
+
+ /* Select the profile and waypoints to use with the database files */
+
+ context->error=select_profile(database,files,profile,&selected_profile,&waycost);
+
+ profile=&selected_profile;
+
+ selected_waypoints=malloc((nsources+ntargets)*sizeof(Routino_Waypoint*));
+ found_waypoints=malloc((nsources+ntargets)*sizeof(Routino_Waypoint));
+
+ finish=calloc(sizeof(Results*),ntargets);
+
+ target_nodes=malloc(2*ntargets*sizeof(index_t));
+ target_local=malloc(ntargets*sizeof(int));
+ target_barrier=malloc(ntargets*sizeof(int));
+
+ if(context->error!=ROUTINO_ERROR_NONE)
+    goto tidy_and_exit;
+
+ for(source=0;source<nsources;source++)
+    if(!(selected_waypoints[source]=select_waypoint(files,profile,sources[source],&found_waypoints[source])))
+      {
+       context->error=ROUTINO_ERROR_NO_NEARBY_HIGHWAY;
+       goto tidy_and_exit;
+      }
+
+ for(target=0;target<ntargets;target++)
+    if(!(selected_waypoints[nsources+target]=select_waypoint(files,profile,targets[target],&found_waypoints[nsources+target])))
+      {
+       context->error=ROUTINO_ERROR_NO_NEARBY_HIGHWAY;
+       goto tidy_and_exit;
+      }
+
+ sources=selected_waypoints;
+ targets=selected_waypoints+nsources;
+
+ /* Calculate the routes from the super-nodes to each target once (without any source nearby) */
+
+ for(target=0;target<ntargets;target++)
+   {
+    index_t finish_node;
+
+    DeleteFakeNodes();
+
+    finish_node=CreateFakes(files->nodes,files->segments,2,
+                            LookupSegment(files->segments,targets[target]->segment,1),
+                            targets[target]->node1,targets[target]->node2,targets[target]->dist1,targets[target]->dist2);
+
+    finish[target]=FindFinishRoutes(files->nodes,files->segments,files->ways,files->relations,profile,finish_node);
+
+    if(progress_abort)
+      {
+       context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
+       goto tidy_and_exit;
+      }
+
+    target_nodes[2*target  ]=targets[target]->node1;
+    target_nodes[2*target+1]=targets[target]->node2;
+
+    /* The start routes never include a node that the profile cannot pass through so they cannot be used if the target is next to one */
+
+    target_barrier[target]=!(LookupNode(files->nodes,targets[target]->node1,1)->allow&profile->allow) ||
+                           !(LookupNode(files->nodes,targets[target]->node2,1)->allow&profile->allow);
+   }
+
+ /* Calculate the route from each source to each target */
+
+ matrix=malloc(sizeof(Routino_Matrix));
+
+ matrix->nsources=nsources;
+ matrix->ntargets=ntargets;
+
+ matrix->dist=malloc(nsources*ntargets*sizeof(float));
+ matrix->time=malloc(nsources*ntargets*sizeof(float));
+
+ for(source=0;source<nsources;source++)
+   {
+    index_t start_node;
+
+    if(progress_func)
+      {
+       progress_value=(double)source/(double)nsources;
+
+       if(!progress_func(progress_value))
+         {
+          context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
+          goto tidy_and_exit;
+         }
+      }
+
+    /* Calculate the routes from the source to the super-nodes once (without any target nearby) */
+
+    DeleteFakeNodes();
+
+    start_node=CreateFakes(files->nodes,files->segments,1,
+                           LookupSegment(files->segments,sources[source]->segment,1),
+                           sources[source]->node1,sources[source]->node2,sources[source]->dist1,sources[source]->dist2);
+
+    begin=FindStartRoutes(files->nodes,files->segments,files->ways,files->relations,profile,start_node,NO_SEGMENT,NO_NODE);
+
+    /* Find the targets that are on a segment that is reached before any super-node (they are routed individually) */
+
+    for(target=0;target<ntargets;target++)
+       target_local[target]=!begin || target_barrier[target];
+
+    if(begin)
+      {
+       Result *result=FirstResult(begin);
+
+       while(result)
+         {
+          for(target=0;target<2*ntargets;target++)
+             if(target_nodes[target]==result->node)
+                target_local[target/2]=1;
+
+          result=NextResult(begin,result);
+         }
+      }
+
+    for(target=0;target<ntargets;target++)
+      {
+       index_t finish_node;
+       Results *results;
+       int n=source*ntargets+target;
+
+       DeleteFakeNodes();
+
+       start_node=CreateFakes(files->nodes,files->segments,1,
+                              LookupSegment(files->segments,sources[source]->segment,1),
+                              sources[source]->node1,sources[source]->node2,sources[source]->dist1,sources[source]->dist2);
+
+       finish_node=CreateFakes(files->nodes,files->segments,2,
+                               LookupSegment(files->segments,targets[target]->segment,1),
+                               targets[target]->node1,targets[target]->node2,targets[target]->dist1,targets[target]->dist2);
+
+       if(start_node==finish_node)
+         {
+          matrix->dist[n]=0;
+          matrix->time[n]=0;
+          continue;
+         }
+
+       /* The finish routes cannot be re-used if the source and target are on the same segment (extra fake segments join them)
+          and the start routes cannot be re-used if the target can be reached before the super-nodes (or is next to a barrier). */
+
+       if(sources[source]->segment==targets[target]->segment)
+          results=CalculateRoute(files->nodes,files->segments,files->ways,files->relations,
+                                 profile,start_node,NO_SEGMENT,finish_node,NULL,1,2);
+       else if(target_local[target])
+          results=CalculateRoute(files->nodes,files->segments,files->ways,files->relations,
+                                 profile,start_node,NO_SEGMENT,finish_node,finish[target],1,2);
+       else if(finish[target])
+          results=CalculateRouteFromParts(files->nodes,files->segments,files->ways,files->relations,
+                                          profile,begin,finish[target],1,2);
+       else
+          results=NULL;
+
+       if(!results)
+         {
+          if(progress_func && progress_abort)
+            {
+             context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
+             goto tidy_and_exit;
+            }
+
+          matrix->dist[n]=-1;
+          matrix->time[n]=-1;
+          continue;
+         }
+
+       route_distance_duration(files,profile,results,&matrix->dist[n],&matrix->time[n]);
+
+       FreeResultsList(results);
+      }
+
+    if(begin)
+       FreeResultsList(begin);
+
+    begin=NULL;
+   }
+
+ if(progress_func && !progress_func(1.0))
+    context->error=ROUTINO_ERROR_PROGRESS_ABORTED;
+
+ /* Tidy up and exit */
+
+ tidy_and_exit:
+
+ DeleteFakeNodes();
+
+ if(begin)
+    FreeResultsList(begin);
+
+ for(target=0;target<ntargets;target++)
+    if(finish[target])
+       FreeResultsList(finish[target]);
+
+ free(finish);
+
+ free(target_nodes);
+ free(target_local);
+ free(target_barrier);
+
+ free(selected_waypoints);
+ free(found_waypoints);
+
+ if(waycost)
+    DestroyWayCostList(waycost);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&files->mutex);
+#endif
+
+ release_files(database,files);
+
+ if(context->error!=ROUTINO_ERROR_NONE)
+   {
+    Routino_DeleteMatrix(matrix);
+    return(NULL);
+   }
+
+ return(matrix);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Delete the matrix created by Routino_CalculateMatrix.
+
+  Routino_Matrix *matrix The matrix to be deleted.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC void Routino_DeleteMatrix(Routino_Matrix *matrix)
+{
+ if(!matrix)
+    return;
+
+ free(matrix->dist);
+ free(matrix->time);
+
+ free(matrix);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Add up the distance and duration of a calculated route without creating any output.
+
+  struct database_files *files The set of database files that was used.
+
+  Routino_Profile *profile The Routino profile that was used.
+
+  Results *results The calculated route.
+
+  float *dist Returns the distance of the route (kilometres).
+
+  float *time Returns the duration of the route (minutes).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void route_distance_duration(struct database_files *files,Routino_Profile *profile,Results *results,float *dist,float *time)
+{
+ Result *result=FindResult(results,results->start_node,results->prev_segment);
+ distance_t distance=0;
+ duration_t duration=0;
+
+ while((result=result->next))
+   {
+    Segment *segmentp;
+    Way *wayp;
+
+    if(IsFakeSegment(result->segment))
+       segmentp=LookupFakeSegment(result->segment);
+    else
+       segmentp=LookupSegment(files->segments,result->segment,1);
+
+    wayp=LookupWay(files->ways,segmentp->way,1);
+
+    distance+=DISTANCE(segmentp->distance);
+    duration+=Duration(segmentp,wayp,profile);
+   }
+
+ *dist=distance_to_km(distance);
+ *time=duration_to_minutes(duration);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find all of the nodes that can be reached from a waypoint within a maximum distance or journey time.
+
+  Routino_Isochrone *Routino_CalculateIsochrone Returns a pointer to a newly allocated set of reachable points or NULL in case of an error.
+
+  Routino_Database *database The loaded database to use.
+
+  Routino_Profile *profile The chosen routing profile to use.
+
+  Routino_Waypoint *waypoint The waypoint to start from.
+
+  double max_distance The maximum distance (kilometres) to travel, used if max_duration is zero.
+
+  double max_duration The maximum journey time (minutes) to travel, used if it is not zero.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC Routino_Isochrone *Routino_CalculateIsochrone(Routino_Database *database,Routino_Profile *profile,Routino_Waypoint *waypoint,
+                                                         double max_distance,double max_duration)
+{
+ Routino_Isochrone *isochrone;
+ Results *results,*nodes;
+ Result *result;
+ index_t start_node;
+ score_t max_score;
+ int n;
+ struct database_files *files;
+ Routino_Profile selected_profile;
+ Routino_Waypoint found_waypoint;
+ WayCost *waycost;
+
+ /* Check the input data */
+
+ if(!database)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_DATABASE;
+    return(NULL);
+   }
+
+ if(!profile)
+   {
+    Routino_errno=ROUTINO_ERROR_NO_PROFILE;
+    return(NULL);
+   }
+
+ if(!waypoint || max_distance<0 || max_duration<0 || (max_distance==0 && max_duration==0))
+   {
+    Routino_errno=ROUTINO_ERROR_BAD_OPTIONS;
+    return(NULL);
+   }
+
+ /* Select the type of limit */
+
+ if(max_duration>0)
+   {
+    option_quickest=1;
+    max_score=(score_t)minutes_to_duration(max_duration);
+   }
+ else
+   {
+    option_quickest=0;
+    max_score=(score_t)km_to_distance(max_distance);
+   }
+
+ keep_thread_memory();
+
+ files=acquire_files(database);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_lock(&files->mutex);
+#endif
+
+ /* Select the profile and waypoint to use with the database files */
+
+ Routino_errno=select_profile(database,files,profile,&selected_profile,&waycost);
+
+ profile=&selected_profile;
+
+ if(Routino_errno==ROUTINO_ERROR_NONE)
+    if(!(waypoint=select_waypoint(files,profile,waypoint,&found_waypoint)))
+       Routino_errno=ROUTINO_ERROR_NO_NEARBY_HIGHWAY;
+
+ if(Routino_errno!=ROUTINO_ERROR_NONE)
+   {
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+    pthread_mutex_unlock(&files->mutex);
+#endif
+
+    release_files(database,files);
+
+    if(waycost)
+       DestroyWayCostList(waycost);
+
+    return(NULL);
+   }
+
+ /* Search outwards from the waypoint */
+
+ start_node=CreateFakes(files->nodes,files->segments,1,
+                        LookupSegment(files->segments,waypoint->segment,1),
+                        waypoint->node1,waypoint->node2,waypoint->dist1,waypoint->dist2);
+
+ results=FindReachableNodes(files->nodes,files->segments,files->ways,files->relations,profile,start_node,max_score);
+
+ /* Keep the lowest score for each real node (it may be reached along several segments) */
+
+ nodes=NewResultsList(12);
+
+ result=FirstResult(results);
+
+ while(result)
+   {
+    if(!IsFakeNode(result->node))
+      {
+       Result *noderesult=FindResult(nodes,result->node,NO_SEGMENT);
+
+       if(!noderesult)
+         {
+          noderesult=InsertResult(nodes,result->node,NO_SEGMENT);
+          noderesult->score=result->score;
+         }
+       else if(result->score<noderesult->score)
+          noderesult->score=result->score;
+      }
+
+    result=NextResult(results,result);
+   }
+
+ FreeResultsList(results);
+
+ /* Create the output */
+
+ isochrone=malloc(sizeof(Routino_Isochrone));
+
+ isochrone->npoints=nodes->number;
+
+ isochrone->lon  =malloc(nodes->number*sizeof(float));
+ isochrone->lat  =malloc(nodes->number*sizeof(float));
+ isochrone->value=malloc(nodes->number*sizeof(float));
+
+ n=0;
+
+ result=nodes->number?FirstResult(nodes):NULL;
+
+ while(result)
+   {
+    double latitude,longitude;
+
+    GetLatLong(files->nodes,result->node,NULL,&latitude,&longitude);
+
+    isochrone->lon[n]=longitude;
+    isochrone->lat[n]=latitude;
+
+    if(option_quickest)
+       isochrone->value[n]=duration_to_minutes(result->score);
+    else
+       isochrone->value[n]=distance_to_km(result->score);
+
+    n++;
+
+    result=NextResult(nodes,result);
+   }
+
+ FreeResultsList(nodes);
+
+ DeleteFakeNodes();
+
+ if(waycost)
+    DestroyWayCostList(waycost);
+
+#if SLIM && defined(USE_PTHREADS) && USE_PTHREADS
+ pthread_mutex_unlock(&files->mutex);
+#endif
+
+ release_files(database,files);
+
+ Routino_errno=ROUTINO_ERROR_NONE;
+ return(isochrone);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Delete the set of points created by Routino_CalculateIsochrone.
+
+  Routino_Isochrone *isochrone The set of points to be deleted.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+DLL_PUBLIC void Routino_DeleteIsochrone(Routino_Isochrone *isochrone)
+{
+ if(!isochrone)
+    return;
+
+ free(isochrone->lon);
+ free(isochrone->lat);
+ free(isochrone->value);
+
+ free(isochrone);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Make sure that the memory kept by the calling thread for re-use between routes is freed when the thread exits.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void keep_thread_memory(void)
+{
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ pthread_once(&thread_memory_once,create_thread_memory_key);
+
+ if(!pthread_getspecific(thread_memory_key))
+    pthread_setspecific(thread_memory_key,&thread_memory_key);
+
+#endif
+}
+
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+/*++++++++++++++++++++++++++++++++++++++
+  Create the key that frees the memory kept by each thread when it exits.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void create_thread_memory_key(void)
+{
+ pthread_key_create(&thread_memory_key,free_thread_memory);
+}
+
+#endif
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Free the memory that the calling thread keeps for re-use between routes (the spare results lists and queues and the XML output buffer).
+
+  void *arg Not used (the value of thread_memory_key when called as the thread exits).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void free_thread_memory(void *arg)
+{
+ FreeSpareResultsLists();
+ FreeSpareQueueLists();
+
+ ParseXML_Free_Encode_Safe_XML();
+}
@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2015 Andrew M. Bishop
+ This file Copyright 2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -61,7 +61,7 @@ extern "C"
 
  /* Routino library API version */
 
-#define ROUTINO_API_VERSION                 8 /*+ A version number for the Routino API. +*/
+#define ROUTINO_API_VERSION                 9 /*+ A version number for the Routino API. +*/
 
 
  /* Routino error constants */
@@ -122,6 +122,17 @@ extern "C"
 #define ROUTINO_ROUTE_REVERSE            4096 /*+ Route between the points in reverse order. +*/
 
 
+ /* Routino database loading option constants */
+
+#define ROUTINO_LOAD_DEFAULT                0 /*+ Map the database files into memory and let them be read when they are used. +*/
+#define ROUTINO_LOAD_RANDOM                 1 /*+ Advise that the database files are accessed randomly (no read-ahead). +*/
+#define ROUTINO_LOAD_WILLNEED               2 /*+ Advise that all of the database files will be needed (start reading them). +*/
+#define ROUTINO_LOAD_PREFAULT               4 /*+ Read all of the database files into memory before returning (using several threads). +*/
+#define ROUTINO_LOAD_LOCK                   8 /*+ Lock the database files into memory (if allowed) so that they cannot be paged out. +*/
+#define ROUTINO_LOAD_HUGEPAGES             16 /*+ Copy the database files into memory that can use transparent huge pages. +*/
+#define ROUTINO_LOAD_VERIFY                32 /*+ Check the checksum of all of a single file database (not just its table of sections). +*/
+
+
  /* Routino output point types */
 
 #define ROUTINO_POINT_UNIMPORTANT  0      /*+ An unimportant, intermediate, node. +*/
@@ -168,6 +179,9 @@ extern "C"
  /*+ A data structure to hold a Routino waypoint found within the database (the contents are private). +*/
  typedef struct _Routino_Waypoint Routino_Waypoint;
 
+ /*+ A data structure to hold the database and the error status for routing in one thread (the contents are private; the memory re-used between routes is kept by the thread). +*/
+ typedef struct _Routino_Context Routino_Context;
+
  /*+ A data structure to hold a Routino routing profile (the contents are private). +*/
 #ifdef LIBROUTINO
  typedef struct _Profile             Routino_Profile;
@@ -234,6 +248,31 @@ extern "C"
  };
 
 
+ /*+ The distances and journey times from a set of sources to a set of targets (element [source*ntargets+target], negative if there is no route). +*/
+ typedef struct _Routino_Matrix
+ {
+  int             nsources;     /*+ The number of sources (rows of the matrix). +*/
+  int             ntargets;     /*+ The number of targets (columns of the matrix). +*/
+
+  float          *dist;         /*+ The distance (kilometres) of the route from each source to each target. +*/
+  float          *time;         /*+ The journey time (minutes) of the route from each source to each target. +*/
+ }
+  Routino_Matrix;
+
+
+ /*+ The nodes that can be reached from a waypoint within a maximum distance or journey time. +*/
+ typedef struct _Routino_Isochrone
+ {
+  int             npoints;      /*+ The number of nodes that can be reached. +*/
+
+  float          *lon;          /*+ The longitude of each node (radians). +*/
+  float          *lat;          /*+ The latitude of each node (radians). +*/
+
+  float          *value;        /*+ The distance (kilometres) or journey time (minutes) to reach each node, whichever was limited. +*/
+ }
+  Routino_Isochrone;
+
+
  /*+ A type of function that can be used as a callback to indicate routing progress, if it returns false the router stops. +*/
  typedef int (*Routino_ProgressFunc)(double complete);
 
@@ -246,7 +285,7 @@ extern "C"
  /*+ Contains the Routino version number. +*/
  DLL_PUBLIC extern const char *Routino_Version;
 
- /*+ Contains the error number of the most recent Routino function (one of the ROUTINO_ERROR_* values). +*/
+ /*+ Contains the error number of the most recent Routino function (one of the ROUTINO_ERROR_* values); it is shared by all threads so it is not meaningful while functions are being called by more than one thread. +*/
  DLL_PUBLIC extern int Routino_errno;
 
 
@@ -257,7 +296,9 @@ extern "C"
  DLL_PUBLIC int Routino_Check_API_Version(int caller_version);
 
  DLL_PUBLIC Routino_Database *Routino_LoadDatabase(const char *dirname,const char *prefix);
+ DLL_PUBLIC Routino_Database *Routino_LoadDatabaseFlags(const char *dirname,const char *prefix,int flags);
  DLL_PUBLIC void Routino_UnloadDatabase(Routino_Database *database);
+ DLL_PUBLIC int Routino_SwapDatabase(Routino_Database *database,const char *dirname,const char *prefix,int flags);
 
  DLL_PUBLIC int Routino_ParseXMLProfiles(const char *filename);
  DLL_PUBLIC char **Routino_GetProfileNames(void);
@@ -272,6 +313,7 @@ extern "C"
 
  DLL_PUBLIC Routino_Profile *Routino_CreateProfileFromUserProfile(Routino_UserProfile *profile);
  DLL_PUBLIC Routino_UserProfile *Routino_CreateUserProfileFromProfile(Routino_Profile *profile);
+ DLL_PUBLIC void Routino_DeleteProfile(Routino_Profile *profile);
 
  DLL_PUBLIC int Routino_ValidateProfile(Routino_Database *database,Routino_Profile *profile);
 
@@ -280,8 +322,30 @@ extern "C"
  DLL_PUBLIC Routino_Output *Routino_CalculateRoute(Routino_Database *database,Routino_Profile *profile,Routino_Translation *translation,
                                                    Routino_Waypoint **waypoints,int nwaypoints,int options,Routino_ProgressFunc progress);
 
+ DLL_PUBLIC Routino_Context *Routino_CreateContext(Routino_Database *database);
+ DLL_PUBLIC void Routino_DeleteContext(Routino_Context *context);
+ DLL_PUBLIC int Routino_ContextErrno(Routino_Context *context);
+
+ DLL_PUBLIC Routino_Output *Routino_CalculateRouteContext(Routino_Context *context,Routino_Profile *profile,Routino_Translation *translation,
+                                                          Routino_Waypoint **waypoints,int nwaypoints,int options,Routino_ProgressFunc progress);
+
  DLL_PUBLIC void Routino_DeleteRoute(Routino_Output *output);
 
+ DLL_PUBLIC Routino_Matrix *Routino_CalculateMatrix(Routino_Database *database,Routino_Profile *profile,
+                                                    Routino_Waypoint **sources,int nsources,Routino_Waypoint **targets,int ntargets,
+                                                    int options,Routino_ProgressFunc progress);
+
+ DLL_PUBLIC Routino_Matrix *Routino_CalculateMatrixContext(Routino_Context *context,Routino_Profile *profile,
+                                                           Routino_Waypoint **sources,int nsources,Routino_Waypoint **targets,int ntargets,
+                                                           int options,Routino_ProgressFunc progress);
+
+ DLL_PUBLIC void Routino_DeleteMatrix(Routino_Matrix *matrix);
+
+ DLL_PUBLIC Routino_Isochrone *Routino_CalculateIsochrone(Routino_Database *database,Routino_Profile *profile,Routino_Waypoint *waypoint,
+                                                          double max_distance,double max_duration);
+
+ DLL_PUBLIC void Routino_DeleteIsochrone(Routino_Isochrone *isochrone);
+
 
 /* Handle compilation with a C++ compiler */
 
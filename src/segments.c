@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -39,9 +39,11 @@
   Segments *LoadSegmentList Returns the segment list that has just been loaded.
 
   const char *filename The name of the file to load.
+
+  int options The options that control how the file is loaded (a combination of the MAPFILE_* options).
   ++++++++++++++++++++++++++++++++++++++*/
 
-Segments *LoadSegmentList(const char *filename)
+Segments *LoadSegmentList(const char *filename,int options)
 {
  Segments *segments;
 
@@ -49,7 +51,7 @@ Segments *LoadSegmentList(const char *filename)
 
 #if !SLIM
 
- segments->data=MapFile(filename);
+ segments->data=MapFileOptions(filename,options);
 
  /* Copy the SegmentsFile structure from the loaded data */
 
@@ -61,7 +63,7 @@ Segments *LoadSegmentList(const char *filename)
 
 #else
 
- segments->fd=SlimMapFile(filename);
+ segments->fd=SlimMapFileOptions(filename,options);
 
  /* Copy the SegmentsFile header structure from the loaded data */
 
@@ -69,7 +71,7 @@ Segments *LoadSegmentList(const char *filename)
 
  segments->cache=NewSegmentCache();
 #ifndef LIBROUTINO
- log_malloc(segments->cache,sizeof(*segments->cache));
+ log_malloc(segments->cache,segments->cache->size);
 #endif
 
 #endif
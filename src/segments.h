@@ -5,7 +5,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2016 Andrew M. Bishop
+ This file Copyright 2008-2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -87,7 +87,7 @@ struct _Segments
 
 /* Functions in segments.c */
 
-Segments *LoadSegmentList(const char *filename);
+Segments *LoadSegmentList(const char *filename,int options);
 
 void DestroySegmentList(Segments *segments);
 
@@ -127,6 +127,9 @@ static inline Segment *NextSegment(Segments *segments,Segment *segmentp,index_t
 /*+ Return the other node in the segment that is not the specified node. +*/
 #define OtherNode(xxx,yyy)     ((xxx)->node1==(yyy)?(xxx)->node2:(xxx)->node1)
 
+/*+ Return the duration of travel on a segment using the precalculated way cost (the same result as the Duration() function). +*/
+#define WayCostDuration(xxx,yyy) ((yyy)->speed?distance_speed_to_duration(DISTANCE((xxx)->distance),(yyy)->speed):hours_to_duration(10))
+
 
 #if !SLIM
 
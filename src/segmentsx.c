@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -53,6 +53,7 @@ static WaysX *sortwaysx;
 /* Local functions */
 
 static int sort_by_id(SegmentX *a,SegmentX *b);
+static uint64_t key_by_id(SegmentX *segmentx);
 
 static int delete_pruned(SegmentX *segmentx,index_t index);
 
@@ -85,7 +86,7 @@ SegmentsX *NewSegmentList(void)
 
 #if SLIM
  segmentsx->cache=NewSegmentXCache();
- log_malloc(segmentsx->cache,sizeof(*segmentsx->cache));
+ log_malloc(segmentsx->cache,segmentsx->cache->size);
 #endif
 
  return(segmentsx);
@@ -123,6 +124,7 @@ void FreeSegmentList(SegmentsX *segmentsx)
    }
 
 #if SLIM
+ log_cache("SegmentsX",segmentsx->cache->slots.nitems,segmentsx->cache->slots.hits,segmentsx->cache->slots.misses,segmentsx->cache->slots.evictions);
  log_free(segmentsx->cache);
  DeleteSegmentXCache(segmentsx->cache);
 #endif
@@ -298,9 +300,10 @@ void SortSegmentList(SegmentsX *segmentsx)
 
  /* Sort by node indexes */
 
- segmentsx->number=filesort_fixed(segmentsx->fd,fd,sizeof(SegmentX),NULL,
-                                                                    (int (*)(const void*,const void*))sort_by_id,
-                                                                    NULL);
+ segmentsx->number=filesort_fixed_radix(segmentsx->fd,fd,sizeof(SegmentX),NULL,
+                                                                          (uint64_t (*)(const void*))key_by_id,
+                                                                          (int (*)(const void*,const void*))sort_by_id,
+                                                                          NULL);
 
  /* Close the files */
 
@@ -367,6 +370,20 @@ static int sort_by_id(SegmentX *a,SegmentX *b)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the key for a radix sort of the segments into node order.
+
+  uint64_t key_by_id Returns the key (in the same order as sort_by_id() apart from segments between the same nodes).
+
+  SegmentX *segmentx The extended segment.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static uint64_t key_by_id(SegmentX *segmentx)
+{
+ return(((uint64_t)segmentx->node1<<32)|segmentx->node2);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Process segments (non-trivial duplicates).
 
@@ -654,9 +671,10 @@ void RemovePrunedSegments(SegmentsX *segmentsx,WaysX *waysx)
 
  sortsegmentsx=segmentsx;
 
- segmentsx->number=filesort_fixed(segmentsx->fd,fd,sizeof(SegmentX),(int (*)(void*,index_t))delete_pruned,
-                                                                    (int (*)(const void*,const void*))sort_by_id,
-                                                                    NULL);
+ segmentsx->number=filesort_fixed_radix(segmentsx->fd,fd,sizeof(SegmentX),(int (*)(void*,index_t))delete_pruned,
+                                                                          (uint64_t (*)(const void*))key_by_id,
+                                                                          (int (*)(const void*,const void*))sort_by_id,
+                                                                          NULL);
 
  /* Close the files */
 
@@ -731,9 +749,10 @@ void DeduplicateSuperSegments(SegmentsX *segmentsx,WaysX *waysx)
  sortsegmentsx=segmentsx;
  sortwaysx=waysx;
 
- segmentsx->number=filesort_fixed(segmentsx->fd,fd,sizeof(SegmentX),NULL,
-                                                                    (int (*)(const void*,const void*))sort_by_id,
-                                                                    (int (*)(void*,index_t))deduplicate_super);
+ segmentsx->number=filesort_fixed_radix(segmentsx->fd,fd,sizeof(SegmentX),NULL,
+                                                                          (uint64_t (*)(const void*))key_by_id,
+                                                                          (int (*)(const void*,const void*))sort_by_id,
+                                                                          (int (*)(void*,index_t))deduplicate_super);
 
  /* Close the files */
 
@@ -848,9 +867,10 @@ void SortSegmentListGeographically(SegmentsX *segmentsx,NodesX *nodesx)
 
  sortnodesx=nodesx;
 
- filesort_fixed(segmentsx->fd,fd,sizeof(SegmentX),(int (*)(void*,index_t))geographically_index,
-                                                  (int (*)(const void*,const void*))sort_by_id,
-                                                  NULL);
+ filesort_fixed_radix(segmentsx->fd,fd,sizeof(SegmentX),(int (*)(void*,index_t))geographically_index,
+                                                        (uint64_t (*)(const void*))key_by_id,
+                                                        (int (*)(const void*,const void*))sort_by_id,
+                                                        NULL);
  /* Close the files */
 
  segmentsx->fd=CloseFileBuffered(segmentsx->fd);
@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
@@ -46,9 +47,38 @@ extern size_t option_filesort_ramsize;
 /*+ The number of filesorting threads allowed. +*/
 extern int option_filesort_threads;
 
+/*+ Set to non-zero to compress the temporary files used for filesorting. +*/
+extern int option_filesort_compress;
+
+
+/* Constants */
+
+/*+ The number of fixed length items in each block of a compressed temporary file. +*/
+#define FILESORT_BLOCK_ITEMS 256
+
 
 /* Thread data type definitions */
 
+/*+ A data type for holding one of the inputs to a merge of fixed length data. +*/
+typedef struct _merge_input
+ {
+  int       fd;                 /*+ The file descriptor of the sorted temporary file. +*/
+
+  index_t   pos;                /*+ The position in the file of the next item to read into the buffer. +*/
+  index_t   end;                /*+ The position in the file after the last item to merge. +*/
+
+  char     *buffer;             /*+ The buffer of items read from the file. +*/
+  size_t    bufsize;            /*+ The number of items that fit in the buffer. +*/
+  size_t    bufptr;             /*+ The next item to use from the buffer. +*/
+  size_t    buflen;             /*+ The number of items in the buffer. +*/
+
+  offset_t *blocks;             /*+ The offset of each block if the file is compressed (or NULL). +*/
+  char     *cbuffer;            /*+ The buffer for a compressed block. +*/
+
+  int       done;               /*+ Set to non-zero when all of the items have been used. +*/
+ }
+ merge_input;
+
 /*+ A data type for holding data for a thread. +*/
 typedef struct _thread_data
  {
@@ -64,10 +94,18 @@ typedef struct _thread_data
   void    **datap;              /*+ An array of pointers to the data objects. +*/
   size_t    n;                  /*+ The number of pointers. +*/
 
+  char     *scratch;            /*+ A second data array for the radix sort (or NULL). +*/
+
   char    *filename;            /*+ The name of the file to write the results to. +*/
 
   size_t   itemsize;            /*+ The size of each item. +*/
   int    (*compare)(const void*,const void*); /*+ The comparison function. +*/
+  uint64_t (*key)(const void*); /*+ The key function for the radix sort (or NULL). +*/
+
+  merge_input *inputs;          /*+ The inputs to merge in this thread (or NULL). +*/
+  int      ninputs;             /*+ The number of inputs to merge. +*/
+  char    *slots;               /*+ The current item from each of the inputs. +*/
+  int      fd;                  /*+ The file descriptor to write the merged data to. +*/
  }
  thread_data;
 
@@ -81,11 +119,50 @@ static pthread_cond_t  running_cond  = PTHREAD_COND_INITIALIZER;
 
 #endif
 
+/* Local functions */
+
+static index_t filesort_fixed_internal(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_function)(void*,index_t),
+                                                                            uint64_t (*key_function)(const void*),
+                                                                            int (*compare_function)(const void*,const void*),
+                                                                            int (*post_sort_function)(void*,index_t));
+
+static void filesort_fixed_sort(thread_data *thread);
+
+static void filesort_radixsort(char *data,char *scratch,void **datap,size_t nitems,size_t itemsize,uint64_t (*key_function)(const void*),
+                                                                                                   int (*compare_function)(const void*,const void*));
+
 /* Thread helper functions */
 
 static void *filesort_fixed_heapsort_thread(thread_data *thread);
 static void *filesort_vary_heapsort_thread(thread_data *thread);
 
+static void filesort_fixed_write_file(thread_data *thread);
+static void filesort_vary_write_file(thread_data *thread);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+static void *filesort_merge_thread(thread_data *thread);
+#endif
+
+static index_t filesort_merge_in_memory(int fd_out,thread_data *threads,int nparts,size_t itemsize,
+                                        int (*compare_function)(const void*,const void*),
+                                        int (*post_sort_function)(void*,index_t));
+
+static index_t filesort_merge_files(int fd_out,int *fds,int nfiles,thread_data *threads,size_t nitems,size_t itemsize,
+                                    int (*compare_function)(const void*,const void*),
+                                    int (*post_sort_function)(void*,index_t));
+static void filesort_merge_splitters(int *fds,offset_t **blocks,int nfiles,index_t *sizes,index_t *bounds,int nranges,size_t itemsize,
+                                     int (*compare_function)(const void*,const void*));
+static index_t filesort_merge(merge_input *inputs,int ninputs,char *slots,size_t itemsize,
+                              int (*compare_function)(const void*,const void*),
+                              int (*post_sort_function)(void*,index_t),int fd_out);
+static inline int filesort_merge_read(merge_input *input,char *item,size_t itemsize);
+
+static offset_t *filesort_read_block_index(int fd,index_t *nitems);
+static void filesort_read_block(int fd,offset_t *blocks,index_t block,size_t nitems,char *cbuffer,char *buffer,size_t itemsize);
+static int filesort_vary_read(int fd,char *item,char *prev,FILESORT_VARINT *prevsize,char *temp);
+static inline size_t filesort_encode_item(char *out,const char *item,const char *prev,size_t itemsize);
+static inline size_t filesort_decode_item(const char *in,char *item,const char *prev,size_t itemsize);
+
 
 /*++++++++++++++++++++++++++++++++++++++
   A function to sort the contents of a file of fixed length objects using a
@@ -95,7 +172,9 @@ static void *filesort_vary_heapsort_thread(thread_data *thread);
   and in particular an "external sort" http://en.wikipedia.org/wiki/External_sorting.
   The individual sort steps and the merge step both use a "Heap sort"
   http://en.wikipedia.org/wiki/Heapsort.  The combination of the two should work well
-  if the data is already partially sorted.
+  if the data is already partially sorted.  If all of the data fits in the RAM
+  allowed then each thread sorts one part of it and the parts are merged without
+  using any temporary files.
 
   index_t filesort_fixed Returns the number of objects kept.
 
@@ -123,15 +202,87 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
                                                             int (*compare_function)(const void*,const void*),
                                                             int (*post_sort_function)(void*,index_t))
 {
- int *fds=NULL,*heap=NULL;
- int nfiles=0,ndata=0;
+ return(filesort_fixed_internal(fd_in,fd_out,itemsize,pre_sort_function,NULL,compare_function,post_sort_function));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  A function to sort the contents of a file of fixed length objects that have an
+  integer key using a limited amount of RAM.
+
+  This is the same as filesort_fixed() except that the individual sort steps use
+  a "Radix sort" http://en.wikipedia.org/wiki/Radix_sort on the data items
+  themselves (which needs twice as much RAM per item).  The comparison function
+  is only used to sort items that have the same key and for the merge step.
+
+  index_t filesort_fixed_radix Returns the number of objects kept.
+
+  int fd_in The file descriptor of the input file (opened for reading and at the beginning).
+
+  int fd_out The file descriptor of the output file (opened for writing and empty).
+
+  size_t itemsize The size of each item in the file that needs sorting.
+
+  int (*pre_sort_function)(void *,index_t) If non-NULL then this function is called for
+     each item before they have been sorted.  The second parameter is the number of objects
+     previously read from the input file.  If the function returns 1 then the object is kept
+     and it is sorted, otherwise it is ignored.
+
+  uint64_t (*key_function)(const void*) The key function.  The items must be in the same order
+     when sorted by the key as when sorted by the comparison function, apart from items that
+     have the same key.
+
+  int (*compare_function)(const void*, const void*) The comparison function.  This is identical
+     to qsort if the data to be sorted is an array of things not pointers.
+
+  int (*post_sort_function)(void *,index_t) If non-NULL then this function is called for
+     each item after they have been sorted.  The second parameter is the number of objects
+     already written to the output file.  If the function returns 1 then the object is written
+     to the output file., otherwise it is ignored.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+index_t filesort_fixed_radix(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_function)(void*,index_t),
+                                                                  uint64_t (*key_function)(const void*),
+                                                                  int (*compare_function)(const void*,const void*),
+                                                                  int (*post_sort_function)(void*,index_t))
+{
+ return(filesort_fixed_internal(fd_in,fd_out,itemsize,pre_sort_function,key_function,compare_function,post_sort_function));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  The function that sorts the contents of a file of fixed length objects for
+  filesort_fixed() and filesort_fixed_radix().
+
+  index_t filesort_fixed_internal Returns the number of objects kept.
+
+  int fd_in The file descriptor of the input file (opened for reading and at the beginning).
+
+  int fd_out The file descriptor of the output file (opened for writing and empty).
+
+  size_t itemsize The size of each item in the file that needs sorting.
+
+  int (*pre_sort_function)(void *,index_t) The function to call for each item before sorting (or NULL).
+
+  uint64_t (*key_function)(const void*) The key function for a radix sort (or NULL for a heap sort).
+
+  int (*compare_function)(const void*, const void*) The comparison function.
+
+  int (*post_sort_function)(void *,index_t) The function to call for each item after sorting (or NULL).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static index_t filesort_fixed_internal(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_function)(void*,index_t),
+                                                                            uint64_t (*key_function)(const void*),
+                                                                            int (*compare_function)(const void*,const void*),
+                                                                            int (*post_sort_function)(void*,index_t))
+{
+ int *fds=NULL;
+ int nfiles=0;
  index_t count_out=0,count_in=0,total=0;
  size_t nitems;
- char *data;
- void **datap;
  thread_data *threads;
- size_t item;
- int i,more=1;
+ size_t item,ramperitem;
+ int i,more=1,inmemory=0;
 #if defined(USE_PTHREADS) && USE_PTHREADS
  int nthreads=0;
 #endif
@@ -143,10 +294,21 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
  if(nitems==0)
     return(0);
 
- if((nitems*(itemsize+sizeof(void*)))<option_filesort_ramsize)
+ ramperitem=itemsize+sizeof(void*);
+
+ if(key_function)
+    ramperitem+=itemsize;
+
+ /* If all of the data fits in RAM then each thread sorts one part of it and
+    they are merged in RAM without any temporary files. */
+
+ if((nitems*ramperitem)<option_filesort_ramsize)
+   {
     nitems=1+nitems/option_filesort_threads;
+    inmemory=1;
+   }
  else
-    nitems=option_filesort_ramsize/(option_filesort_threads*(itemsize+sizeof(void*)));
+    nitems=option_filesort_ramsize/(option_filesort_threads*ramperitem);
 
  threads=(thread_data*)calloc(option_filesort_threads,sizeof(thread_data));
 
@@ -158,10 +320,18 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     log_malloc(threads[i].data ,nitems*itemsize);
     log_malloc(threads[i].datap,nitems*sizeof(void*));
 
+    if(key_function)
+      {
+       threads[i].scratch=malloc(nitems*itemsize);
+
+       log_malloc(threads[i].scratch,nitems*itemsize);
+      }
+
     threads[i].filename=(char*)malloc(strlen(option_tmpdirname)+24);
 
     threads[i].itemsize=itemsize;
     threads[i].compare=compare_function;
+    threads[i].key=key_function;
    }
 
  /* Loop around, fill the buffer, sort the data and write a temporary file */
@@ -170,9 +340,12 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
    {
     int thread=0;
 
+    if(inmemory)
+       thread=nfiles;    /* There are never more parts than threads (see above) */
+
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
-    if(option_filesort_threads>1)
+    if(!inmemory && option_filesort_threads>1)
       {
        /* Find a spare slot (one *must* be unused at all times) */
 
@@ -220,16 +393,33 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     if(threads[thread].n==0)
        break;
 
-    /* Sort the data pointers using a heap sort (potentially in a thread) */
+    /* Sort the data pointers using a heap sort or the data using a radix sort (potentially in a thread) */
 
-    sprintf(threads[thread].filename,"%s/filesort.%d.tmp",option_tmpdirname,nfiles);
+    if(inmemory)
+       threads[thread].filename[0]=0;
+    else
+       sprintf(threads[thread].filename,"%s/filesort.%d.tmp",option_tmpdirname,nfiles);
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
     /* Shortcut if only one file, don't write to disk */
 
     if(more==0 && nfiles==0)
-       filesort_heapsort(threads[thread].datap,threads[thread].n,threads[thread].compare);
+       filesort_fixed_sort(&threads[thread]);
+    else if(inmemory && option_filesort_threads>1)
+      {
+       /* Sort in a thread while reading the next part (a spare slot is not needed) */
+
+       pthread_mutex_lock(&running_mutex);
+
+       threads[thread].running=1;
+
+       pthread_mutex_unlock(&running_mutex);
+
+       pthread_create(&threads[thread].thread,NULL,(void* (*)(void*))filesort_fixed_heapsort_thread,&threads[thread]);
+
+       nthreads++;
+      }
     else if(option_filesort_threads>1)
       {
        pthread_mutex_lock(&running_mutex);
@@ -264,7 +454,7 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     /* Shortcut if only one file, don't write to disk */
 
     if(more==0 && nfiles==0)
-       filesort_heapsort(threads[thread].datap,threads[thread].n,threads[thread].compare);
+       filesort_fixed_sort(&threads[thread]);
     else
        filesort_fixed_heapsort_thread(&threads[thread]);
 
@@ -278,19 +468,25 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
- while(option_filesort_threads>1 && nthreads)
+ if(option_filesort_threads>1)
    {
     pthread_mutex_lock(&running_mutex);
 
-    pthread_cond_wait(&running_cond,&running_mutex);
+    /* Check before waiting since a thread may already have finished and signalled */
 
-    for(i=0;i<option_filesort_threads;i++)
-       if(threads[i].running==2)
-         {
-          pthread_join(threads[i].thread,NULL);
-          threads[i].running=0;
-          nthreads--;
-         }
+    while(nthreads)
+      {
+       for(i=0;i<option_filesort_threads;i++)
+          if(threads[i].running==2)
+            {
+             pthread_join(threads[i].thread,NULL);
+             threads[i].running=0;
+             nthreads--;
+            }
+
+       if(nthreads)
+          pthread_cond_wait(&running_cond,&running_mutex);
+      }
 
     pthread_mutex_unlock(&running_mutex);
    }
@@ -320,6 +516,15 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     goto tidy_and_exit;
    }
 
+ /* Merge the sorted parts if they are all still in RAM */
+
+ if(inmemory)
+   {
+    count_out=filesort_merge_in_memory(fd_out,threads,nfiles,itemsize,compare_function,post_sort_function);
+
+    goto tidy_and_exit;
+   }
+
  /* Check that number of files is less than file size */
 
  logassert((unsigned)nfiles<nitems,"Too many temporary files (use more sorting memory?)");
@@ -339,107 +544,9 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     DeleteFile(filename);
    }
 
- /* Perform an n-way merge using a binary heap */
-
- heap=(int*)malloc((1+nfiles)*sizeof(int));
-
- data =threads[0].data;
- datap=threads[0].datap;
-
- /* Fill the heap to start with */
-
- for(i=0;i<nfiles;i++)
-   {
-    int index;
-
-    datap[i]=data+i*itemsize;
-
-    ReadFileBuffered(fds[i],datap[i],itemsize);
-
-    index=i+1;
-
-    heap[index]=i;
-
-    /* Bubble up the new value */
-
-    while(index>1)
-      {
-       int newindex;
-       int temp;
-
-       newindex=index/2;
-
-       if(compare_function(datap[heap[index]],datap[heap[newindex]])>=0)
-          break;
-
-       temp=heap[index];
-       heap[index]=heap[newindex];
-       heap[newindex]=temp;
-
-       index=newindex;
-      }
-   }
-
- /* Repeatedly pull out the root of the heap and refill from the same file */
-
- ndata=nfiles;
-
- do
-   {
-    int index=1;
-
-    if(!post_sort_function || post_sort_function(datap[heap[index]],count_out))
-      {
-       WriteFileBuffered(fd_out,datap[heap[index]],itemsize);
-       count_out++;
-      }
-
-    if(ReadFileBuffered(fds[heap[index]],datap[heap[index]],itemsize))
-      {
-       heap[index]=heap[ndata];
-       ndata--;
-      }
-
-    /* Bubble down the new value */
-
-    while((2*index)<ndata)
-      {
-       int newindex;
-       int temp;
-
-       newindex=2*index;
-
-       if(compare_function(datap[heap[newindex]],datap[heap[newindex+1]])>=0)
-          newindex=newindex+1;
-
-       if(compare_function(datap[heap[index]],datap[heap[newindex]])<=0)
-          break;
-
-       temp=heap[newindex];
-       heap[newindex]=heap[index];
-       heap[index]=temp;
-
-       index=newindex;
-      }
-
-    if((2*index)==ndata)
-      {
-       int newindex;
-       int temp;
-
-       newindex=2*index;
+ /* Perform an n-way merge (in parallel if possible) */
 
-       if(compare_function(datap[heap[index]],datap[heap[newindex]])<=0)
-          ; /* break */
-       else
-         {
-          temp=heap[newindex];
-          heap[newindex]=heap[index];
-          heap[index]=temp;
-         }
-      }
-   }
- while(ndata>0);
+ count_out=filesort_merge_files(fd_out,fds,nfiles,threads,nitems,itemsize,compare_function,post_sort_function);
 
  /* Tidy up */
 
@@ -452,9 +559,6 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     free(fds);
    }
 
- if(heap)
-    free(heap);
-
  for(i=0;i<option_filesort_threads;i++)
    {
     log_free(threads[i].data);
@@ -463,6 +567,13 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
     free(threads[i].data);
     free(threads[i].datap);
 
+    if(threads[i].scratch)
+      {
+       log_free(threads[i].scratch);
+
+       free(threads[i].scratch);
+      }
+
     free(threads[i].filename);
    }
 
@@ -480,7 +591,9 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
   and in particular an "external sort" http://en.wikipedia.org/wiki/External_sorting.
   The individual sort steps and the merge step both use a "Heap sort"
   http://en.wikipedia.org/wiki/Heapsort.  The combination of the two should work well
-  if the data is already partially sorted.
+  if the data is already partially sorted.  If all of the data fits in the RAM
+  allowed then each thread sorts one part of it and the parts are merged without
+  using any temporary files.
 
   index_t filesort_vary Returns the number of objects kept.
 
@@ -511,11 +624,12 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
  index_t count_out=0,count_in=0,total=0;
  size_t datasize;
  FILESORT_VARINT nextitemsize,largestitemsize=0;
- char *data;
+ char *data,*prev=NULL,*encoded=NULL;
+ FILESORT_VARINT *prevsize=NULL;
  void **datap;
  thread_data *threads;
  size_t item;
- int i,more=1;
+ int i,more=1,inmemory=0;
 #if defined(USE_PTHREADS) && USE_PTHREADS
  int nthreads=0;
 #endif
@@ -531,8 +645,14 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
     one will require RAM for data, FILESORT_VARALIGN and sizeof(void*)
     Assume that data+FILESORT_VARALIGN+sizeof(void*) is 4*data. */
 
+ /* If all of the data is expected to fit in RAM then each thread sorts one
+    part of it and they are merged in RAM without any temporary files. */
+
  if((datasize*4)<option_filesort_ramsize)
+   {
     datasize=(datasize*4)/option_filesort_threads;
+    inmemory=1;
+   }
  else
     datasize=option_filesort_ramsize/option_filesort_threads;
 
@@ -560,9 +680,52 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
     size_t ramused=FILESORT_VARALIGN-FILESORT_VARSIZE;
     int thread=0;
 
+    /* If the estimate was wrong and there are more parts than threads then
+       write the parts already sorted to temporary files and continue. */
+
+    if(inmemory && nfiles==option_filesort_threads)
+      {
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
-    if(option_filesort_threads>1)
+       if(option_filesort_threads>1)
+         {
+          pthread_mutex_lock(&running_mutex);
+
+          while(nthreads)
+            {
+             for(i=0;i<option_filesort_threads;i++)
+                if(threads[i].running==2)
+                  {
+                   pthread_join(threads[i].thread,NULL);
+                   threads[i].running=0;
+                   nthreads--;
+                  }
+
+             if(nthreads)
+                pthread_cond_wait(&running_cond,&running_mutex);
+            }
+
+          pthread_mutex_unlock(&running_mutex);
+         }
+
+#endif
+
+       for(i=0;i<nfiles;i++)
+         {
+          sprintf(threads[i].filename,"%s/filesort.%d.tmp",option_tmpdirname,i);
+
+          filesort_vary_write_file(&threads[i]);
+         }
+
+       inmemory=0;
+      }
+
+    if(inmemory)
+       thread=nfiles;    /* There are normally no more parts than threads (see above) */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+    if(!inmemory && option_filesort_threads>1)
       {
        /* Find a spare slot (one *must* be unused at all times) */
 
@@ -627,7 +790,7 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
 
     /* Sort the data pointers using a heap sort (potentially in a thread) */
 
-    if(more==0 && nfiles==0)
+    if((more==0 && nfiles==0) || inmemory)
        threads[thread].filename[0]=0;
     else
        sprintf(threads[thread].filename,"%s/filesort.%d.tmp",option_tmpdirname,nfiles);
@@ -638,6 +801,20 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
 
     if(more==0 && nfiles==0)
        filesort_heapsort(threads[thread].datap,threads[thread].n,threads[thread].compare);
+    else if(inmemory && option_filesort_threads>1)
+      {
+       /* Sort in a thread while reading the next part (a spare slot is not needed) */
+
+       pthread_mutex_lock(&running_mutex);
+
+       threads[thread].running=1;
+
+       pthread_mutex_unlock(&running_mutex);
+
+       pthread_create(&threads[thread].thread,NULL,(void* (*)(void*))filesort_vary_heapsort_thread,&threads[thread]);
+
+       nthreads++;
+      }
     else if(option_filesort_threads>1)
       {
        pthread_mutex_lock(&running_mutex);
@@ -686,19 +863,25 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
- while(option_filesort_threads>1 && nthreads)
+ if(option_filesort_threads>1)
    {
     pthread_mutex_lock(&running_mutex);
 
-    pthread_cond_wait(&running_cond,&running_mutex);
+    /* Check before waiting since a thread may already have finished and signalled */
 
-    for(i=0;i<option_filesort_threads;i++)
-       if(threads[i].running==2)
-         {
-          pthread_join(threads[i].thread,NULL);
-          threads[i].running=0;
-          nthreads--;
-         }
+    while(nthreads)
+      {
+       for(i=0;i<option_filesort_threads;i++)
+          if(threads[i].running==2)
+            {
+             pthread_join(threads[i].thread,NULL);
+             threads[i].running=0;
+             nthreads--;
+            }
+
+       if(nthreads)
+          pthread_cond_wait(&running_cond,&running_mutex);
+      }
 
     pthread_mutex_unlock(&running_mutex);
    }
@@ -730,6 +913,15 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
     goto tidy_and_exit;
    }
 
+ /* Merge the sorted parts if they are all still in RAM */
+
+ if(inmemory)
+   {
+    count_out=filesort_merge_in_memory(fd_out,threads,nfiles,0,compare_function,post_sort_function);
+
+    goto tidy_and_exit;
+   }
+
  /* Check that number of files is less than file size */
 
  largestitemsize=FILESORT_VARALIGN*(1+(largestitemsize+FILESORT_VARALIGN-FILESORT_VARSIZE)/FILESORT_VARALIGN);
@@ -758,20 +950,24 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
  data=threads[0].data;
  datap=(void**)(data+datasize-nfiles*sizeof(void*));
 
+ /* Compressed files need the previous item from each file to decode the next one */
+
+ if(option_filesort_compress)
+   {
+    prev=(char*)calloc(nfiles,largestitemsize);
+    prevsize=(FILESORT_VARINT*)calloc(nfiles,sizeof(FILESORT_VARINT));
+    encoded=(char*)malloc(largestitemsize+(largestitemsize+7)/8);
+   }
+
  /* Fill the heap to start with */
 
  for(i=0;i<nfiles;i++)
    {
     int index;
-    FILESORT_VARINT itemsize;
 
     datap[i]=data+FILESORT_VARALIGN-FILESORT_VARSIZE+i*largestitemsize;
 
-    ReadFileBuffered(fds[i],&itemsize,FILESORT_VARSIZE);
-
-    *(FILESORT_VARINT*)((char*)datap[i]-FILESORT_VARSIZE)=itemsize;
-
-    ReadFileBuffered(fds[i],datap[i],itemsize);
+    filesort_vary_read(fds[i],datap[i],prev?prev+i*largestitemsize:NULL,prevsize?prevsize+i:NULL,encoded);
 
     index=i+1;
 
@@ -803,7 +999,7 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
 
  do
    {
-    int index=1;
+    int index=1,file=heap[index];
     FILESORT_VARINT itemsize;
 
     if(!post_sort_function || post_sort_function(datap[heap[index]],count_out))
@@ -814,17 +1010,11 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
        count_out++;
       }
 
-    if(ReadFileBuffered(fds[heap[index]],&itemsize,FILESORT_VARSIZE))
+    if(filesort_vary_read(fds[file],datap[file],prev?prev+file*largestitemsize:NULL,prevsize?prevsize+file:NULL,encoded))
       {
        heap[index]=heap[ndata];
        ndata--;
       }
-    else
-      {
-       *(FILESORT_VARINT*)((char*)datap[heap[index]]-FILESORT_VARSIZE)=itemsize;
-
-       ReadFileBuffered(fds[heap[index]],datap[heap[index]],itemsize);
-      }
 
     /* Bubble down the new value */
 
@@ -881,6 +1071,13 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
  if(heap)
     free(heap);
 
+ if(prev)
+   {
+    free(prev);
+    free(prevsize);
+    free(encoded);
+   }
+
  for(i=0;i<option_filesort_threads;i++)
    {
     log_free(threads[i].data);
@@ -906,14 +1103,50 @@ index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_
 
 static void *filesort_fixed_heapsort_thread(thread_data *thread)
 {
- int fd;
- size_t item;
+ /* Sort the data pointers using a heap sort or the data using a radix sort */
 
- /* Sort the data pointers using a heap sort */
+ filesort_fixed_sort(thread);
 
- filesort_heapsort(thread->datap,thread->n,thread->compare);
+ /* Create a temporary file and write the result (unless it is kept in RAM) */
+
+ if(thread->filename[0])
+    filesort_fixed_write_file(thread);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ if(option_filesort_threads>1)
+   {
+    pthread_mutex_lock(&running_mutex);
 
- /* Create a temporary file and write the result */
+    thread->running=2;
+
+    pthread_cond_signal(&running_cond);
+
+    pthread_mutex_unlock(&running_mutex);
+   }
+
+#endif
+
+ return(NULL);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Write the sorted fixed length data held by one thread to its temporary file.
+
+  If the temporary files are compressed then the items are written in blocks of
+  FILESORT_BLOCK_ITEMS, each item encoded relative to the previous one in the
+  block (see filesort_encode_item()).  The offset of each block, the number of
+  items and the number of blocks are written at the end of the file so that the
+  merge can start reading from any item.
+
+  thread_data *thread The data to be written.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void filesort_fixed_write_file(thread_data *thread)
+{
+ int fd;
+ size_t item;
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
@@ -924,17 +1157,107 @@ static void *filesort_fixed_heapsort_thread(thread_data *thread)
 
  fd=OpenFileBufferedNew(thread->filename);
 
- for(item=0;item<thread->n;item++)
-    WriteFileBuffered(fd,thread->datap[item],thread->itemsize);
+ if(!option_filesort_compress)
+   {
+    for(item=0;item<thread->n;item++)
+       WriteFileBuffered(fd,thread->datap[item],thread->itemsize);
+   }
+ else
+   {
+    size_t nblocks=(thread->n+FILESORT_BLOCK_ITEMS-1)/FILESORT_BLOCK_ITEMS,block;
+    char *cbuffer=(char*)malloc(FILESORT_BLOCK_ITEMS*(thread->itemsize+(thread->itemsize+7)/8));
+    offset_t *blocks=(offset_t*)malloc((nblocks+3)*sizeof(offset_t));
+    offset_t offset=0;
+
+    /* The compressed data is written directly so the file buffers are not needed after opening the file */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+    if(option_filesort_threads>1)
+       pthread_mutex_unlock(&files_mutex);
+
+#endif
+
+    for(block=0;block<nblocks;block++)
+      {
+       size_t length=0;
+
+       blocks[block]=offset;
+
+       for(item=block*FILESORT_BLOCK_ITEMS;item<thread->n && item<(block+1)*FILESORT_BLOCK_ITEMS;item++)
+          length+=filesort_encode_item(cbuffer+length,thread->datap[item],(item%FILESORT_BLOCK_ITEMS)?thread->datap[item-1]:NULL,thread->itemsize);
+
+       SlimReplace(fd,cbuffer,length,offset);
+
+       offset+=length;
+      }
+
+    blocks[nblocks]=offset;
+    blocks[nblocks+1]=thread->n;
+    blocks[nblocks+2]=nblocks;
+
+    SlimReplace(fd,blocks,(nblocks+3)*sizeof(offset_t),offset);
+
+    free(cbuffer);
+    free(blocks);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+    if(option_filesort_threads>1)
+       pthread_mutex_lock(&files_mutex);
+
+#endif
+   }
 
  CloseFileBuffered(fd);
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
  if(option_filesort_threads>1)
-   {
     pthread_mutex_unlock(&files_mutex);
 
+#endif
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Sort the fixed length data held by one thread using the method selected for it.
+
+  thread_data *thread The data to be sorted.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void filesort_fixed_sort(thread_data *thread)
+{
+ if(thread->key)
+    filesort_radixsort(thread->data,thread->scratch,thread->datap,thread->n,thread->itemsize,thread->key,thread->compare);
+ else
+    filesort_heapsort(thread->datap,thread->n,thread->compare);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  A wrapper function that can be run in a thread for variable data.
+
+  void *filesort_vary_heapsort_thread Returns NULL (required to return void*).
+
+  thread_data *thread The data to be processed in this thread.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *filesort_vary_heapsort_thread(thread_data *thread)
+{
+ /* Sort the data pointers using a heap sort */
+
+ filesort_heapsort(thread->datap,thread->n,thread->compare);
+
+ /* Create a temporary file and write the result (unless it is kept in RAM) */
+
+ if(thread->filename[0])
+    filesort_vary_write_file(thread);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ if(option_filesort_threads>1)
+   {
     pthread_mutex_lock(&running_mutex);
 
     thread->running=2;
@@ -951,24 +1274,16 @@ static void *filesort_fixed_heapsort_thread(thread_data *thread)
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  A wrapper function that can be run in a thread for variable data.
+  Write the sorted variable length data held by one thread to its temporary file.
 
-  void *filesort_vary_heapsort_thread Returns NULL (required to return void*).
-
-  thread_data *thread The data to be processed in this thread.
+  thread_data *thread The data to be written.
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void *filesort_vary_heapsort_thread(thread_data *thread)
+static void filesort_vary_write_file(thread_data *thread)
 {
  int fd;
  size_t item;
 
- /* Sort the data pointers using a heap sort */
-
- filesort_heapsort(thread->datap,thread->n,thread->compare);
-
- /* Create a temporary file and write the result */
-
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
  if(option_filesort_threads>1)
@@ -978,125 +1293,1125 @@ static void *filesort_vary_heapsort_thread(thread_data *thread)
 
  fd=OpenFileBufferedNew(thread->filename);
 
- for(item=0;item<thread->n;item++)
+ if(!option_filesort_compress)
    {
-    FILESORT_VARINT itemsize=*(FILESORT_VARINT*)((char*)thread->datap[item]-FILESORT_VARSIZE);
+    for(item=0;item<thread->n;item++)
+      {
+       FILESORT_VARINT itemsize=*(FILESORT_VARINT*)((char*)thread->datap[item]-FILESORT_VARSIZE);
 
-    WriteFileBuffered(fd,(char*)thread->datap[item]-FILESORT_VARSIZE,itemsize+FILESORT_VARSIZE);
+       WriteFileBuffered(fd,(char*)thread->datap[item]-FILESORT_VARSIZE,itemsize+FILESORT_VARSIZE);
+      }
    }
+ else
+   {
+    size_t bufsize=4*65536,length=0;
+    char *cbuffer=(char*)malloc(bufsize);
+    char *prev=(char*)calloc(65536,1);
+    FILESORT_VARINT prevsize=0;
+    offset_t offset=0;
 
- CloseFileBuffered(fd);
+    /* The compressed data is written directly so the file buffers are not needed after opening the file */
 
 #if defined(USE_PTHREADS) && USE_PTHREADS
 
- if(option_filesort_threads>1)
-   {
-    pthread_mutex_unlock(&files_mutex);
+    if(option_filesort_threads>1)
+       pthread_mutex_unlock(&files_mutex);
 
-    pthread_mutex_lock(&running_mutex);
+#endif
 
-    thread->running=2;
+    /* Each item is written as its size (a variable length integer) and then
+       encoded relative to the previous item (see filesort_encode_item()). */
 
-    pthread_cond_signal(&running_cond);
+    for(item=0;item<thread->n;item++)
+      {
+       FILESORT_VARINT itemsize=*(FILESORT_VARINT*)((char*)thread->datap[item]-FILESORT_VARSIZE);
+       unsigned int size=itemsize;
 
-    pthread_mutex_unlock(&running_mutex);
-   }
+       if((length+3+(itemsize+7)/8+itemsize)>bufsize)
+         {
+          SlimReplace(fd,cbuffer,length,offset);
+
+          offset+=length;
+          length=0;
+         }
+
+       while(size>=0x80)
+         {
+          cbuffer[length++]=(char)(0x80|(size&0x7f));
+          size>>=7;
+         }
+
+       cbuffer[length++]=(char)size;
+
+       length+=filesort_encode_item(cbuffer+length,thread->datap[item],prev,itemsize);
+
+       memcpy(prev,thread->datap[item],itemsize);
+
+       if(itemsize<prevsize)
+          memset(prev+itemsize,0,prevsize-itemsize);
+
+       prevsize=itemsize;
+      }
+
+    SlimReplace(fd,cbuffer,length,offset);
+
+    free(cbuffer);
+    free(prev);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+    if(option_filesort_threads>1)
+       pthread_mutex_lock(&files_mutex);
 
 #endif
+   }
 
- return(NULL);
+ CloseFileBuffered(fd);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ if(option_filesort_threads>1)
+    pthread_mutex_unlock(&files_mutex);
+
+#endif
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  A function to sort an array of pointers efficiently.
+  Merge the sorted parts of the data that are held in RAM by the threads and
+  write them to the output file.
 
-  The data is sorted using a "Heap sort" http://en.wikipedia.org/wiki/Heapsort,
-  in particular, this is good because it can operate in-place and doesn't
-  allocate more memory like using qsort() does.
+  index_t filesort_merge_in_memory Returns the number of objects kept.
 
-  void **datap A pointer to the array of pointers to sort.
+  int fd_out The file descriptor of the output file.
 
-  size_t nitems The number of items of data to sort.
+  thread_data *threads The threads holding the sorted parts (in the order that they were read).
 
-  int (*compare_function)(const void*, const void*) The comparison function.  This is identical
-     to qsort if the data to be sorted is an array of things not pointers.
+  int nparts The number of parts to merge.
+
+  size_t itemsize The size of each item or zero for variable length data.
+
+  int (*compare_function)(const void*, const void*) The comparison function.
+
+  int (*post_sort_function)(void *,index_t) If non-NULL then this function is called for
+     each item after they have been sorted (see filesort_fixed() and filesort_vary()).
   ++++++++++++++++++++++++++++++++++++++*/
 
-void filesort_heapsort(void **datap,size_t nitems,int(*compare_function)(const void*, const void*))
+static index_t filesort_merge_in_memory(int fd_out,thread_data *threads,int nparts,size_t itemsize,
+                                        int (*compare_function)(const void*,const void*),
+                                        int (*post_sort_function)(void*,index_t))
 {
- void **datap1=&datap[-1];
- size_t item;
+ index_t count_out=0;
+ size_t slotsize=itemsize,*next;
+ char *data;
+ void **datap;
+ int *heap;
+ int i,ndata;
 
- /* Fill the heap by pretending to insert the data that is already there */
+ /* The head of each part is copied into its own slot of a small buffer so
+    that the comparison function sees the same relative addresses (which
+    decide the order of equal items) as in the merge of temporary files. */
 
- for(item=2;item<=nitems;item++)
+ if(itemsize==0)
    {
-    size_t index=item;
+    for(i=0;i<nparts;i++)
+      {
+       size_t item;
 
-    /* Bubble up the new value (upside-down, put largest at top) */
+       for(item=0;item<threads[i].n;item++)
+         {
+          FILESORT_VARINT size=*(FILESORT_VARINT*)((char*)threads[i].datap[item]-FILESORT_VARSIZE);
 
-    while(index>1)
-      {
-       int newindex;
-       void *temp;
+          if(size>slotsize)
+             slotsize=size;
+         }
+      }
 
-       newindex=index/2;
+    slotsize=FILESORT_VARALIGN*(1+(slotsize+FILESORT_VARALIGN-FILESORT_VARSIZE)/FILESORT_VARALIGN);
+   }
 
-       if(compare_function(datap1[index],datap1[newindex])<=0) /* reversed comparison to filesort_fixed() above */
-          break;
+ data =(char*)malloc(nparts*slotsize);
+ datap=(void**)malloc(nparts*sizeof(void*));
+ next =(size_t*)malloc(nparts*sizeof(size_t));
+ heap =(int*)malloc((1+nparts)*sizeof(int));
 
-       temp=datap1[index];
-       datap1[index]=datap1[newindex];
-       datap1[newindex]=temp;
+ /* Fill the heap to start with */
 
-       index=newindex;
+ for(i=0;i<nparts;i++)
+   {
+    int index;
+
+    if(itemsize)
+      {
+       datap[i]=data+i*slotsize;
+
+       memcpy(datap[i],threads[i].datap[0],itemsize);
       }
-   }
+    else
+      {
+       FILESORT_VARINT size=*(FILESORT_VARINT*)((char*)threads[i].datap[0]-FILESORT_VARSIZE);
 
- /* Repeatedly pull out the root of the heap and swap with the bottom item */
+       datap[i]=data+FILESORT_VARALIGN-FILESORT_VARSIZE+i*slotsize;
 
- for(item=nitems;item>1;item--)
-   {
-    size_t index=1;
-    void *temp;
+       memcpy((char*)datap[i]-FILESORT_VARSIZE,(char*)threads[i].datap[0]-FILESORT_VARSIZE,size+FILESORT_VARSIZE);
+      }
 
-    temp=datap1[index];
-    datap1[index]=datap1[item];
-    datap1[item]=temp;
+    next[i]=1;
 
-    /* Bubble down the new value (upside-down, put largest at top) */
+    index=i+1;
 
-    while((2*index)<(item-1))
+    heap[index]=i;
+
+    /* Bubble up the new value */
+
+    while(index>1)
       {
        int newindex;
-       void *temp;
-
-       newindex=2*index;
+       int temp;
 
-       if(compare_function(datap1[newindex],datap1[newindex+1])<=0) /* reversed comparison to filesort_fixed() above */
-          newindex=newindex+1;
+       newindex=index/2;
 
-       if(compare_function(datap1[index],datap1[newindex])>=0) /* reversed comparison to filesort_fixed() above */
+       if(compare_function(datap[heap[index]],datap[heap[newindex]])>=0)
           break;
 
-       temp=datap1[newindex];
-       datap1[newindex]=datap1[index];
-       datap1[index]=temp;
+       temp=heap[index];
+       heap[index]=heap[newindex];
+       heap[newindex]=temp;
 
        index=newindex;
       }
+   }
 
-    if((2*index)==(item-1))
-      {
-       int newindex;
-       void *temp;
+ /* Repeatedly pull out the root of the heap and refill from the same part */
 
-       newindex=2*index;
+ ndata=nparts;
 
-       if(compare_function(datap1[index],datap1[newindex])>=0) /* reversed comparison to filesort_fixed() above */
-          ; /* break */
-       else
+ do
+   {
+    int index=1;
+    int part=heap[index];
+
+    if(!post_sort_function || post_sort_function(datap[part],count_out))
+      {
+       if(itemsize)
+          WriteFileBuffered(fd_out,datap[part],itemsize);
+       else
+         {
+          FILESORT_VARINT size=*(FILESORT_VARINT*)((char*)datap[part]-FILESORT_VARSIZE);
+
+          WriteFileBuffered(fd_out,(char*)datap[part]-FILESORT_VARSIZE,size+FILESORT_VARSIZE);
+         }
+
+       count_out++;
+      }
+
+    if(next[part]==threads[part].n)
+      {
+       heap[index]=heap[ndata];
+       ndata--;
+      }
+    else
+      {
+       if(itemsize)
+          memcpy(datap[part],threads[part].datap[next[part]],itemsize);
+       else
+         {
+          FILESORT_VARINT size=*(FILESORT_VARINT*)((char*)threads[part].datap[next[part]]-FILESORT_VARSIZE);
+
+          memcpy((char*)datap[part]-FILESORT_VARSIZE,(char*)threads[part].datap[next[part]]-FILESORT_VARSIZE,size+FILESORT_VARSIZE);
+         }
+
+       next[part]++;
+      }
+
+    /* Bubble down the new value */
+
+    while((2*index)<ndata)
+      {
+       int newindex;
+       int temp;
+
+       newindex=2*index;
+
+       if(compare_function(datap[heap[newindex]],datap[heap[newindex+1]])>=0)
+          newindex=newindex+1;
+
+       if(compare_function(datap[heap[index]],datap[heap[newindex]])<=0)
+          break;
+
+       temp=heap[newindex];
+       heap[newindex]=heap[index];
+       heap[index]=temp;
+
+       index=newindex;
+      }
+
+    if((2*index)==ndata)
+      {
+       int newindex;
+       int temp;
+
+       newindex=2*index;
+
+       if(compare_function(datap[heap[index]],datap[heap[newindex]])>0)
+         {
+          temp=heap[newindex];
+          heap[newindex]=heap[index];
+          heap[index]=temp;
+         }
+      }
+   }
+ while(ndata>0);
+
+ free(data);
+ free(datap);
+ free(next);
+ free(heap);
+
+ return(count_out);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Merge the sorted temporary files of fixed length data and write them to the
+  output file.
+
+  If there are several threads then the key space is split into ranges using
+  items sampled from the files and each range is merged by a separate thread.
+  The main thread merges the first range directly into the output file and the
+  other ranges are merged into temporary files that are appended afterwards.
+
+  index_t filesort_merge_files Returns the number of objects kept.
+
+  int fd_out The file descriptor of the output file.
+
+  int *fds The file descriptors of the sorted temporary files.
+
+  int nfiles The number of temporary files.
+
+  thread_data *threads The thread data (the data arrays are used as file buffers).
+
+  size_t nitems The number of items that fit in each thread's data array.
+
+  size_t itemsize The size of each item.
+
+  int (*compare_function)(const void*, const void*) The comparison function.
+
+  int (*post_sort_function)(void *,index_t) If non-NULL then this function is called for
+     each item after they have been sorted (see filesort_fixed()).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static index_t filesort_merge_files(int fd_out,int *fds,int nfiles,thread_data *threads,size_t nitems,size_t itemsize,
+                                    int (*compare_function)(const void*,const void*),
+                                    int (*post_sort_function)(void*,index_t))
+{
+ index_t count_out=0,*sizes,*bounds;
+ offset_t **blocks=NULL;
+ merge_input *inputs;
+ size_t bufitems;
+ int nranges=1,range,i;
+
+ sizes=(index_t*)malloc(nfiles*sizeof(index_t));
+
+ if(option_filesort_compress)
+   {
+    blocks=(offset_t**)malloc(nfiles*sizeof(offset_t*));
+
+    for(i=0;i<nfiles;i++)
+       blocks[i]=filesort_read_block_index(fds[i],&sizes[i]);
+   }
+ else
+    for(i=0;i<nfiles;i++)
+       sizes[i]=SizeFileFD(fds[i])/itemsize;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS && HAVE_PREAD_PWRITE
+
+ if(option_filesort_threads>1)
+    nranges=option_filesort_threads;
+
+#endif
+
+ /* Find the range of each file that will be merged by each thread */
+
+ bounds=(index_t*)malloc((size_t)(nranges+1)*nfiles*sizeof(index_t));
+
+ for(i=0;i<nfiles;i++)
+   {
+    bounds[i]=0;
+    bounds[nranges*nfiles+i]=sizes[i];
+   }
+
+ if(nranges>1)
+    filesort_merge_splitters(fds,blocks,nfiles,sizes,bounds,nranges,itemsize,compare_function);
+
+ /* Set up the inputs for each thread using its data array for buffers (or
+    separate buffers for whole blocks if the files are compressed) */
+
+ bufitems=nitems/nfiles;
+
+ inputs=(merge_input*)malloc((size_t)nranges*nfiles*sizeof(merge_input));
+
+ for(range=0;range<nranges;range++)
+   {
+    for(i=0;i<nfiles;i++)
+      {
+       merge_input *input=&inputs[range*nfiles+i];
+
+       input->fd=fds[i];
+
+       input->pos=bounds[range*nfiles+i];
+       input->end=bounds[(range+1)*nfiles+i];
+
+       input->bufptr=0;
+       input->buflen=0;
+
+       if(blocks)
+         {
+          input->buffer=(char*)malloc(FILESORT_BLOCK_ITEMS*itemsize);
+          input->bufsize=FILESORT_BLOCK_ITEMS;
+
+          input->blocks=blocks[i];
+          input->cbuffer=(char*)malloc(FILESORT_BLOCK_ITEMS*(itemsize+(itemsize+7)/8));
+         }
+       else
+         {
+          input->buffer=threads[range].data+i*bufitems*itemsize;
+          input->bufsize=bufitems;
+
+          input->blocks=NULL;
+          input->cbuffer=NULL;
+         }
+      }
+
+    threads[range].inputs=&inputs[range*nfiles];
+    threads[range].ninputs=nfiles;
+    threads[range].slots=(char*)malloc(nfiles*itemsize);
+   }
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ /* Start the threads that merge all except the first range */
+
+ for(range=1;range<nranges;range++)
+   {
+    sprintf(threads[range].filename,"%s/filesort.%d.tmp",option_tmpdirname,nfiles+range);
+
+    threads[range].fd=OpenFileBufferedNew(threads[range].filename);
+   }
+
+ for(range=1;range<nranges;range++)
+   {
+    pthread_mutex_lock(&running_mutex);
+
+    threads[range].running=1;
+
+    pthread_mutex_unlock(&running_mutex);
+
+    pthread_create(&threads[range].thread,NULL,(void* (*)(void*))filesort_merge_thread,&threads[range]);
+   }
+
+#endif
+
+ /* Merge the first range in this thread */
+
+ count_out=filesort_merge(threads[0].inputs,nfiles,threads[0].slots,itemsize,compare_function,post_sort_function,fd_out);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ if(nranges>1)
+   {
+    int nthreads=nranges-1;
+
+    /* Wait for the other threads to finish */
+
+    pthread_mutex_lock(&running_mutex);
+
+    while(nthreads)
+      {
+       for(range=1;range<nranges;range++)
+          if(threads[range].running==2)
+            {
+             pthread_join(threads[range].thread,NULL);
+             threads[range].running=0;
+             nthreads--;
+            }
+
+       if(nthreads)
+          pthread_cond_wait(&running_cond,&running_mutex);
+      }
+
+    pthread_mutex_unlock(&running_mutex);
+
+    /* Append the other ranges to the output file in order */
+
+    for(range=1;range<nranges;range++)
+      {
+       int fd;
+
+       CloseFileBuffered(threads[range].fd);
+
+       fd=ReOpenFileBuffered(threads[range].filename);
+
+       DeleteFile(threads[range].filename);
+
+       while(!ReadFileBuffered(fd,threads[0].slots,itemsize))
+          if(!post_sort_function || post_sort_function(threads[0].slots,count_out))
+            {
+             WriteFileBuffered(fd_out,threads[0].slots,itemsize);
+             count_out++;
+            }
+
+       CloseFileBuffered(fd);
+      }
+   }
+
+#endif
+
+ /* Tidy up */
+
+ for(range=0;range<nranges;range++)
+   {
+    free(threads[range].slots);
+
+    threads[range].inputs=NULL;
+    threads[range].slots=NULL;
+   }
+
+ if(blocks)
+   {
+    for(i=0;i<nranges*nfiles;i++)
+      {
+       free(inputs[i].buffer);
+       free(inputs[i].cbuffer);
+      }
+
+    for(i=0;i<nfiles;i++)
+       free(blocks[i]);
+
+    free(blocks);
+   }
+
+ free(inputs);
+ free(bounds);
+ free(sizes);
+
+ return(count_out);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Split the items in the sorted temporary files into ranges that can be merged
+  independently.  Some items are sampled from each file and sorted and the ones
+  at equal intervals are used to split the files using binary searches.
+
+  int *fds The file descriptors of the sorted temporary files.
+
+  int nfiles The number of temporary files.
+
+  index_t *sizes The number of items in each file.
+
+  index_t *bounds Returns the position in each file where each range starts (the
+     first and last set of positions must already be filled in).
+
+  int nranges The number of ranges.
+
+  size_t itemsize The size of each item.
+
+  int (*compare_function)(const void*, const void*) The comparison function.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void filesort_merge_splitters(int *fds,offset_t **blocks,int nfiles,index_t *sizes,index_t *bounds,int nranges,size_t itemsize,
+                                     int (*compare_function)(const void*,const void*))
+{
+ size_t nsamples=8*nranges;
+ char *samples,*slots,*buffer=NULL,*cbuffer=NULL;
+ void **samplep;
+ index_t *positions;
+ int *files;
+ size_t n=0,j;
+ int range,i;
+
+ samples  =(char*)malloc(nfiles*nsamples*itemsize);
+ samplep  =(void**)malloc(nfiles*nsamples*sizeof(void*));
+ positions=(index_t*)malloc(nfiles*nsamples*sizeof(index_t));
+ files    =(int*)malloc(nfiles*nsamples*sizeof(int));
+ slots    =(char*)malloc(nfiles*itemsize);
+
+ if(blocks)
+   {
+    buffer =(char*)malloc(FILESORT_BLOCK_ITEMS*itemsize);
+    cbuffer=(char*)malloc(FILESORT_BLOCK_ITEMS*(itemsize+(itemsize+7)/8));
+   }
+
+ /* Read evenly spaced samples from each file (in file order so that equal
+    items are sorted into the same order as the merge would put them). */
+
+ for(i=0;i<nfiles;i++)
+    for(j=0;j<nsamples;j++)
+      {
+       positions[n]=(index_t)(((uint64_t)sizes[i]*(2*j+1))/(2*nsamples));
+       files[n]=i;
+
+       samplep[n]=samples+n*itemsize;
+
+       if(blocks)
+         {
+          filesort_read_block(fds[i],blocks[i],positions[n]/FILESORT_BLOCK_ITEMS,1+positions[n]%FILESORT_BLOCK_ITEMS,cbuffer,buffer,itemsize);
+
+          memcpy(samplep[n],buffer+(positions[n]%FILESORT_BLOCK_ITEMS)*itemsize,itemsize);
+         }
+       else
+          SlimFetch(fds[i],samplep[n],itemsize,(offset_t)positions[n]*itemsize);
+
+       n++;
+      }
+
+ filesort_heapsort(samplep,n,compare_function);
+
+ /* Find the position in each file of each of the splitting items */
+
+ for(range=1;range<nranges;range++)
+   {
+    size_t index=((char*)samplep[(n*range)/nranges]-samples)/itemsize;
+    int file=files[index];
+
+    /* The splitting item goes in the slot for the file that it came from so
+       that equal items are compared in the same way as in the merge. */
+
+    memcpy(slots+file*itemsize,samplep[(n*range)/nranges],itemsize);
+
+    for(i=0;i<nfiles;i++)
+      {
+       index_t start,end;
+
+       if(i==file)
+          start=positions[index];
+       else
+         {
+          start=0;
+          end=sizes[i];
+
+          while(start<end)
+            {
+             index_t mid=start+(end-start)/2;
+
+             if(blocks)
+               {
+                filesort_read_block(fds[i],blocks[i],mid/FILESORT_BLOCK_ITEMS,1+mid%FILESORT_BLOCK_ITEMS,cbuffer,buffer,itemsize);
+
+                memcpy(slots+i*itemsize,buffer+(mid%FILESORT_BLOCK_ITEMS)*itemsize,itemsize);
+               }
+             else
+                SlimFetch(fds[i],slots+i*itemsize,itemsize,(offset_t)mid*itemsize);
+
+             if(compare_function(slots+i*itemsize,slots+file*itemsize)<0)
+                start=mid+1;
+             else
+                end=mid;
+            }
+         }
+
+       /* Equal items from one file may have been sampled out of order, an empty range is OK */
+
+       if(start<bounds[(range-1)*nfiles+i])
+          start=bounds[(range-1)*nfiles+i];
+
+       bounds[range*nfiles+i]=start;
+      }
+   }
+
+ free(samples);
+ free(samplep);
+ free(positions);
+ free(files);
+ free(slots);
+
+ if(buffer)
+   {
+    free(buffer);
+    free(cbuffer);
+   }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Merge sorted fixed length data using a "Tournament tree" (a loser tree)
+  http://en.wikipedia.org/wiki/K-way_merge_algorithm#Tournament_Tree which
+  needs only one comparison per level to replace the item that was removed.
+
+  index_t filesort_merge Returns the number of objects kept.
+
+  merge_input *inputs The inputs to merge.
+
+  int ninputs The number of inputs.
+
+  char *slots Space for one item from each input.
+
+  size_t itemsize The size of each item.
+
+  int (*compare_function)(const void*, const void*) The comparison function.
+
+  int (*post_sort_function)(void *,index_t) If non-NULL then this function is called for
+     each item after they have been sorted (see filesort_fixed()).
+
+  int fd_out The file descriptor of the output file.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static index_t filesort_merge(merge_input *inputs,int ninputs,char *slots,size_t itemsize,
+                              int (*compare_function)(const void*,const void*),
+                              int (*post_sort_function)(void*,index_t),int fd_out)
+{
+ index_t count_out=0;
+ int *tree,*winners;
+ int node,winner,i;
+
+ /* The tree holds the loser of each match (nodes 1 to ninputs-1) and the overall winner (node 0) */
+
+ tree   =(int*)malloc(ninputs*sizeof(int));
+ winners=(int*)malloc(2*ninputs*sizeof(int));
+
+ for(i=0;i<ninputs;i++)
+   {
+    inputs[i].done=filesort_merge_read(&inputs[i],slots+i*itemsize,itemsize);
+
+    winners[ninputs+i]=i;
+   }
+
+ /* Play all of the matches to start with */
+
+ for(node=ninputs-1;node>0;node--)
+   {
+    int left=winners[2*node],right=winners[2*node+1];
+
+    if(!inputs[right].done && (inputs[left].done || compare_function(slots+right*itemsize,slots+left*itemsize)<0))
+      {
+       winners[node]=right;
+       tree[node]=left;
+      }
+    else
+      {
+       winners[node]=left;
+       tree[node]=right;
+      }
+   }
+
+ tree[0]=winners[1];
+
+ free(winners);
+
+ /* Repeatedly write out the winner, refill from the same input and replay its matches */
+
+ while(!inputs[winner=tree[0]].done)
+   {
+    char *item=slots+winner*itemsize;
+
+    if(!post_sort_function || post_sort_function(item,count_out))
+      {
+       WriteFileBuffered(fd_out,item,itemsize);
+       count_out++;
+      }
+
+    inputs[winner].done=filesort_merge_read(&inputs[winner],item,itemsize);
+
+    for(node=(ninputs+winner)/2;node>0;node/=2)
+      {
+       int other=tree[node];
+
+       if(!inputs[other].done && (inputs[winner].done || compare_function(slots+other*itemsize,slots+winner*itemsize)<0))
+         {
+          tree[node]=winner;
+          winner=other;
+         }
+      }
+
+    tree[0]=winner;
+   }
+
+ free(tree);
+
+ return(count_out);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Read the next item from one of the inputs to a merge.
+
+  int filesort_merge_read Returns 0 if OK or 1 if there are no more items.
+
+  merge_input *input The input to read from.
+
+  char *item The location to copy the item to.
+
+  size_t itemsize The size of each item.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline int filesort_merge_read(merge_input *input,char *item,size_t itemsize)
+{
+ if(input->bufptr==input->buflen)
+   {
+    index_t n=input->end-input->pos;
+
+    if(n==0)
+       return(1);
+
+    if(input->blocks)
+      {
+       /* Decode the block containing the next item (the first one may start part way through) */
+
+       index_t first=input->pos-input->pos%FILESORT_BLOCK_ITEMS;
+
+       if((n+input->pos-first)>FILESORT_BLOCK_ITEMS)
+          n=FILESORT_BLOCK_ITEMS-(input->pos-first);
+
+       filesort_read_block(input->fd,input->blocks,first/FILESORT_BLOCK_ITEMS,n+input->pos-first,input->cbuffer,input->buffer,itemsize);
+
+       input->bufptr=input->pos-first;
+       input->buflen=n+input->pos-first;
+       input->pos+=n;
+      }
+    else
+      {
+       if(n>input->bufsize)
+          n=input->bufsize;
+
+       SlimFetch(input->fd,input->buffer,n*itemsize,(offset_t)input->pos*itemsize);
+
+       input->pos+=n;
+       input->buflen=n;
+       input->bufptr=0;
+      }
+   }
+
+ memcpy(item,input->buffer+input->bufptr*itemsize,itemsize);
+
+ input->bufptr++;
+
+ return(0);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Read the block index from the end of a compressed temporary file of fixed length data.
+
+  offset_t *filesort_read_block_index Returns the offset of each block and the end of the data (allocated).
+
+  int fd The file descriptor of the temporary file.
+
+  index_t *nitems Returns the number of items in the file.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static offset_t *filesort_read_block_index(int fd,index_t *nitems)
+{
+ offset_t size=SizeFileFD(fd),footer[2],*blocks;
+
+ SlimFetch(fd,footer,2*sizeof(offset_t),size-2*sizeof(offset_t));
+
+ *nitems=(index_t)footer[0];
+
+ blocks=(offset_t*)malloc((footer[1]+1)*sizeof(offset_t));
+
+ SlimFetch(fd,blocks,(footer[1]+1)*sizeof(offset_t),size-(footer[1]+3)*sizeof(offset_t));
+
+ return(blocks);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Read and decode the items at the start of one block of a compressed temporary file of fixed length data.
+
+  int fd The file descriptor of the temporary file.
+
+  offset_t *blocks The offset of each block.
+
+  index_t block The block to read.
+
+  size_t nitems The number of items to decode from the start of the block.
+
+  char *cbuffer A buffer for the compressed block.
+
+  char *buffer Returns the decoded items.
+
+  size_t itemsize The size of each item.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void filesort_read_block(int fd,offset_t *blocks,index_t block,size_t nitems,char *cbuffer,char *buffer,size_t itemsize)
+{
+ const char *in=cbuffer;
+ size_t item;
+
+ SlimFetch(fd,cbuffer,blocks[block+1]-blocks[block],blocks[block]);
+
+ for(item=0;item<nitems;item++)
+    in+=filesort_decode_item(in,buffer+item*itemsize,item?buffer+(item-1)*itemsize:NULL,itemsize);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Read the next item from a temporary file of variable length data (compressed or not).
+
+  int filesort_vary_read Returns 0 if OK or 1 if there are no more items.
+
+  int fd The file descriptor of the temporary file.
+
+  char *item The location to read the item to (its size is stored before it).
+
+  char *prev The previous item from the same file (zero padded, only for compressed files).
+
+  FILESORT_VARINT *prevsize The size of the previous item (only for compressed files).
+
+  char *temp A buffer large enough for an encoded item (only for compressed files).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int filesort_vary_read(int fd,char *item,char *prev,FILESORT_VARINT *prevsize,char *temp)
+{
+ FILESORT_VARINT itemsize;
+
+ if(!option_filesort_compress)
+   {
+    if(ReadFileBuffered(fd,&itemsize,FILESORT_VARSIZE))
+       return(1);
+
+    *(FILESORT_VARINT*)(item-FILESORT_VARSIZE)=itemsize;
+
+    ReadFileBuffered(fd,item,itemsize);
+   }
+ else
+   {
+    unsigned char byte;
+    unsigned int size=0,shift=0;
+    size_t nmask,nbytes=0,i;
+
+    do
+      {
+       if(ReadFileBuffered(fd,&byte,1))
+          return(1);
+
+       size|=(unsigned int)(byte&0x7f)<<shift;
+       shift+=7;
+      }
+    while(byte&0x80);
+
+    itemsize=(FILESORT_VARINT)size;
+
+    nmask=(itemsize+7)/8;
+
+    ReadFileBuffered(fd,temp,nmask);
+
+    for(i=0;i<nmask;i++)
+       for(byte=(unsigned char)temp[i];byte;byte&=byte-1)
+          nbytes++;
+
+    ReadFileBuffered(fd,temp+nmask,nbytes);
+
+    filesort_decode_item(temp,item,prev,itemsize);
+
+    *(FILESORT_VARINT*)(item-FILESORT_VARSIZE)=itemsize;
+
+    memcpy(prev,item,itemsize);
+
+    if(itemsize<*prevsize)
+       memset(prev+itemsize,0,*prevsize-itemsize);
+
+    *prevsize=itemsize;
+   }
+
+ return(0);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Encode an item for a compressed temporary file.  The item is XORed with the
+  previous one (so that the bytes that are the same in sorted neighbours become
+  zero) and then written as a bit mask of the non-zero bytes followed by those
+  bytes.  This is a type independent form of delta encoding with variable
+  length integers and needs no knowledge of the structure of the items.
+
+  size_t filesort_encode_item Returns the length of the encoded item.
+
+  char *out The location to write the encoded item to.
+
+  const char *item The item to encode.
+
+  const char *prev The previous item (or NULL to encode the item by itself).
+
+  size_t itemsize The size of the item.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline size_t filesort_encode_item(char *out,const char *item,const char *prev,size_t itemsize)
+{
+ size_t nmask=(itemsize+7)/8,length=nmask,i;
+
+ memset(out,0,nmask);
+
+ for(i=0;i<itemsize;i++)
+   {
+    char byte=prev?(item[i]^prev[i]):item[i];
+
+    if(byte)
+      {
+       out[i/8]|=(char)(1<<(i%8));
+       out[length++]=byte;
+      }
+   }
+
+ return(length);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Decode an item from a compressed temporary file (see filesort_encode_item()).
+
+  size_t filesort_decode_item Returns the length of the encoded item.
+
+  const char *in The encoded item.
+
+  char *item Returns the decoded item.
+
+  const char *prev The previous item (or NULL if the item was encoded by itself).
+
+  size_t itemsize The size of the item.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static inline size_t filesort_decode_item(const char *in,char *item,const char *prev,size_t itemsize)
+{
+ size_t nmask=(itemsize+7)/8,length=nmask,i;
+
+ if(prev)
+    memcpy(item,prev,itemsize);
+ else
+    memset(item,0,itemsize);
+
+ for(i=0;i<nmask;i++)
+    if(in[i])
+      {
+       size_t j;
+
+       for(j=0;j<8;j++)
+          if(in[i]&(1<<j))
+             item[i*8+j]^=in[length++];
+      }
+
+ return(length);
+}
+
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+/*++++++++++++++++++++++++++++++++++++++
+  A wrapper function that can be run in a thread for merging one range of fixed data.
+
+  void *filesort_merge_thread Returns NULL (required to return void*).
+
+  thread_data *thread The data to be processed in this thread.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *filesort_merge_thread(thread_data *thread)
+{
+ filesort_merge(thread->inputs,thread->ninputs,thread->slots,thread->itemsize,thread->compare,NULL,thread->fd);
+
+ pthread_mutex_lock(&running_mutex);
+
+ thread->running=2;
+
+ pthread_cond_signal(&running_cond);
+
+ pthread_mutex_unlock(&running_mutex);
+
+ return(NULL);
+}
+
+#endif
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  A function to sort an array of pointers efficiently.
+
+  The data is sorted using a "Heap sort" http://en.wikipedia.org/wiki/Heapsort,
+  in particular, this is good because it can operate in-place and doesn't
+  allocate more memory like using qsort() does.
+
+  void **datap A pointer to the array of pointers to sort.
+
+  size_t nitems The number of items of data to sort.
+
+  int (*compare_function)(const void*, const void*) The comparison function.  This is identical
+     to qsort if the data to be sorted is an array of things not pointers.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void filesort_heapsort(void **datap,size_t nitems,int(*compare_function)(const void*, const void*))
+{
+ void **datap1=&datap[-1];
+ size_t item;
+
+ /* Fill the heap by pretending to insert the data that is already there */
+
+ for(item=2;item<=nitems;item++)
+   {
+    size_t index=item;
+
+    /* Bubble up the new value (upside-down, put largest at top) */
+
+    while(index>1)
+      {
+       int newindex;
+       void *temp;
+
+       newindex=index/2;
+
+       if(compare_function(datap1[index],datap1[newindex])<=0) /* reversed comparison to filesort_fixed() above */
+          break;
+
+       temp=datap1[index];
+       datap1[index]=datap1[newindex];
+       datap1[newindex]=temp;
+
+       index=newindex;
+      }
+   }
+
+ /* Repeatedly pull out the root of the heap and swap with the bottom item */
+
+ for(item=nitems;item>1;item--)
+   {
+    size_t index=1;
+    void *temp;
+
+    temp=datap1[index];
+    datap1[index]=datap1[item];
+    datap1[item]=temp;
+
+    /* Bubble down the new value (upside-down, put largest at top) */
+
+    while((2*index)<(item-1))
+      {
+       int newindex;
+       void *temp;
+
+       newindex=2*index;
+
+       if(compare_function(datap1[newindex],datap1[newindex+1])<=0) /* reversed comparison to filesort_fixed() above */
+          newindex=newindex+1;
+
+       if(compare_function(datap1[index],datap1[newindex])>=0) /* reversed comparison to filesort_fixed() above */
+          break;
+
+       temp=datap1[newindex];
+       datap1[newindex]=datap1[index];
+       datap1[index]=temp;
+
+       index=newindex;
+      }
+
+    if((2*index)==(item-1))
+      {
+       int newindex;
+       void *temp;
+
+       newindex=2*index;
+
+       if(compare_function(datap1[index],datap1[newindex])>=0) /* reversed comparison to filesort_fixed() above */
+          ; /* break */
+       else
          {
           temp=datap1[newindex];
           datap1[newindex]=datap1[index];
@@ -1105,3 +2420,114 @@ void filesort_heapsort(void **datap,size_t nitems,int(*compare_function)(const v
       }
    }
 }
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  A function to sort an array of fixed length data items that have an integer key.
+
+  The data is sorted using a "Radix sort" http://en.wikipedia.org/wiki/Radix_sort
+  (least significant byte first) moving the items between the two data arrays.
+  Bytes of the key that are the same for all items are skipped.  Items with the
+  same key are kept in their original order and then sorted with the comparison
+  function so that the result is the same as a heap sort would have given.
+
+  char *data The data to be sorted (also holds the result).
+
+  char *scratch Another array the same size as the data.
+
+  void **datap An array of pointers which are set to point to the sorted data.
+
+  size_t nitems The number of items of data to sort.
+
+  size_t itemsize The size of each item.
+
+  uint64_t (*key_function)(const void*) The key function.
+
+  int (*compare_function)(const void*, const void*) The comparison function.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void filesort_radixsort(char *data,char *scratch,void **datap,size_t nitems,size_t itemsize,uint64_t (*key_function)(const void*),
+                                                                                                   int (*compare_function)(const void*,const void*))
+{
+ size_t (*counts)[256]=(size_t(*)[256])calloc(8,sizeof(*counts));
+ char *src=data,*dst=scratch;
+ size_t item,run;
+ int byte,value;
+
+ /* Count the values of each byte of the key in one pass */
+
+ for(item=0;item<nitems;item++)
+   {
+    uint64_t key=key_function(data+item*itemsize);
+
+    for(byte=0;byte<8;byte++)
+       counts[byte][(key>>(8*byte))&0xff]++;
+   }
+
+ /* Sort on each byte of the key starting with the least significant */
+
+ for(byte=0;byte<8;byte++)
+   {
+    size_t offset=0;
+
+    if(counts[byte][(key_function(src)>>(8*byte))&0xff]==nitems)
+       continue;
+
+    for(value=0;value<256;value++)
+      {
+       size_t count=counts[byte][value];
+
+       counts[byte][value]=offset;
+
+       offset+=count;
+      }
+
+    for(item=0;item<nitems;item++)
+      {
+       char *itemp=src+item*itemsize;
+
+       value=(key_function(itemp)>>(8*byte))&0xff;
+
+       memcpy(dst+counts[byte][value]*itemsize,itemp,itemsize);
+
+       counts[byte][value]++;
+      }
+
+    dst=src;
+    src=(src==data)?scratch:data;
+   }
+
+ free(counts);
+
+ if(src!=data)
+    memcpy(data,src,nitems*itemsize);
+
+ /* Sort the items that have the same key using the comparison function */
+
+ for(item=0;item<nitems;item=run)
+   {
+    uint64_t key=key_function(data+item*itemsize);
+
+    for(run=item+1;run<nitems;run++)
+       if(key_function(data+run*itemsize)!=key)
+          break;
+
+    if((run-item)>1)
+      {
+       size_t i;
+
+       for(i=item;i<run;i++)
+          datap[i]=data+i*itemsize;
+
+       filesort_heapsort(&datap[item],run-item,compare_function);
+
+       for(i=item;i<run;i++)
+          memcpy(scratch+(i-item)*itemsize,datap[i],itemsize);
+
+       memcpy(data+item*itemsize,scratch,(run-item)*itemsize);
+      }
+   }
+
+ for(item=0;item<nitems;item++)
+    datap[item]=data+item*itemsize;
+}
@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2012 Andrew M. Bishop
+ This file Copyright 2008-2012, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -49,6 +49,11 @@ index_t filesort_fixed(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_funct
                                                             int (*compare_function)(const void*,const void*),
                                                             int (*post_sort_function)(void*,index_t));
 
+index_t filesort_fixed_radix(int fd_in,int fd_out,size_t itemsize,int (*pre_sort_function)(void*,index_t),
+                                                                  uint64_t (*key_function)(const void*),
+                                                                  int (*compare_function)(const void*,const void*),
+                                                                  int (*post_sort_function)(void*,index_t));
+
 index_t filesort_vary(int fd_in,int fd_out,int (*pre_sort_function)(void*,index_t),
                                            int (*compare_function)(const void*,const void*),
                                            int (*post_sort_function)(void*,index_t));
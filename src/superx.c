@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2008-2015 Andrew M. Bishop
+ This file Copyright 2008-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -21,6 +21,7 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "types.h"
 #include "segments.h"
@@ -41,6 +42,8 @@
 
 static Results *FindSuperRoutes(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx,node_t start,Way *match);
 
+static SegmentsX *FindCoreSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx);
+
 
 /*++++++++++++++++++++++++++++++++++++++
   Select the super-nodes from the list of nodes.
@@ -208,9 +211,11 @@ void ChooseSuperNodes(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx)
   SegmentsX *segmentsx The set of segments to use.
 
   WaysX *waysx The set of ways to use.
+
+  int bypass If true then only create the super-segments that pass through another node of the segments being used.
   ++++++++++++++++++++++++++++++++++++++*/
 
-SegmentsX *CreateSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx)
+SegmentsX *CreateSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx,int bypass)
 {
  index_t i;
  SegmentsX *supersegmentsx;
@@ -290,7 +295,8 @@ SegmentsX *CreateSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx)
 
              while(result)
                {
-                if(IsBitSet(nodesx->super,result->node) && result->segment!=NO_SEGMENT)
+                if(IsBitSet(nodesx->super,result->node) && result->segment!=NO_SEGMENT &&
+                   (!bypass || result->prev->node!=i))
                   {
                    if(wayx->way.type&Highway_OneWay && result->node!=i)
                       AppendSegmentList(supersegmentsx,segmentx->way,i,result->node,DISTANCE((distance_t)result->score)|ONEWAY_1TO2);
@@ -474,6 +480,267 @@ SegmentsX *MergeSuperSegments(SegmentsX *segmentsx,SegmentsX *supersegmentsx)
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Create a second level of super-nodes and super-segments on top of the existing super-segments.
+
+  SegmentsX *CreateSecondLevelSuperSegments Returns the existing super-segments combined with the new ones.
+
+  NodesX *nodesx The set of nodes to use.
+
+  SegmentsX *supersegmentsx The set of existing super-segments to use.
+
+  WaysX *waysx The set of ways to use.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+SegmentsX *CreateSecondLevelSuperSegments(NodesX *nodesx,SegmentsX *supersegmentsx,WaysX *waysx)
+{
+ BitMask *super;
+ SegmentsX *coresegmentsx,*bypasssegmentsx,*mergedsegmentsx;
+ SegmentX segmentx;
+ index_t i;
+
+ /* Keep the first level super-nodes and start the second level with a copy */
+
+ super=nodesx->super;
+
+ nodesx->super=AllocBitMask(nodesx->number);
+ log_malloc(nodesx->super,LengthBitMask(nodesx->number)*sizeof(BitMask));
+
+ logassert(nodesx->super,"Failed to allocate memory (try using slim mode?)"); /* Check AllocBitMask() worked */
+
+ memcpy(nodesx->super,super,LengthBitMask(nodesx->number)*sizeof(BitMask));
+
+ /* Remove the parts of the super-segment network that cannot be passed through */
+
+ coresegmentsx=FindCoreSuperSegments(nodesx,supersegmentsx,waysx);
+
+ /* Select the second level super-nodes and the super-segments that bypass the other nodes */
+
+ IndexSegments(coresegmentsx,nodesx,waysx);
+
+ ChooseSuperNodes(nodesx,coresegmentsx,waysx);
+
+ bypasssegmentsx=CreateSuperSegments(nodesx,coresegmentsx,waysx,1);
+
+ FreeSegmentList(coresegmentsx);
+
+ DeduplicateSuperSegments(bypasssegmentsx,waysx);
+
+ nodesx->super2=nodesx->super;
+ nodesx->super=super;
+
+ /* Combine the two sets of super-segments */
+
+ mergedsegmentsx=NewSegmentList();
+
+ if(supersegmentsx->number>0)
+   {
+    supersegmentsx->fd=ReOpenFileBuffered(supersegmentsx->filename_tmp);
+
+    for(i=0;i<supersegmentsx->number;i++)
+      {
+       ReadFileBuffered(supersegmentsx->fd,&segmentx,sizeof(SegmentX));
+
+       AppendSegmentList(mergedsegmentsx,segmentx.way,segmentx.node1,segmentx.node2,segmentx.distance);
+      }
+
+    supersegmentsx->fd=CloseFileBuffered(supersegmentsx->fd);
+   }
+
+ if(bypasssegmentsx->number>0)
+   {
+    bypasssegmentsx->fd=ReOpenFileBuffered(bypasssegmentsx->filename_tmp);
+
+    for(i=0;i<bypasssegmentsx->number;i++)
+      {
+       ReadFileBuffered(bypasssegmentsx->fd,&segmentx,sizeof(SegmentX));
+
+       AppendSegmentList(mergedsegmentsx,segmentx.way,segmentx.node1,segmentx.node2,segmentx.distance);
+      }
+
+    bypasssegmentsx->fd=CloseFileBuffered(bypasssegmentsx->fd);
+   }
+
+ FreeSegmentList(bypasssegmentsx);
+
+ FinishSegmentList(mergedsegmentsx);
+
+ SortSegmentList(mergedsegmentsx);
+
+ return(mergedsegmentsx);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Remove the super-nodes and super-segments that form trees hanging off the rest of the network; a route cannot pass
+  through them without a U-turn so they are not needed for the second level.
+
+  SegmentsX *FindCoreSuperSegments Returns the super-segments that remain.
+
+  NodesX *nodesx The set of nodes to use (the super-node markers are cleared for the removed nodes).
+
+  SegmentsX *segmentsx The set of super-segments to use.
+
+  WaysX *waysx The set of ways to use.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static SegmentsX *FindCoreSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx)
+{
+ SegmentsX *coresegmentsx;
+ BitMask *removed;
+ index_t *count,*leaves;
+ index_t i,nleaves=0,ntree=0,ncore=0;
+
+ coresegmentsx=NewSegmentList();
+
+ if(nodesx->number==0 || segmentsx->number==0)
+   {
+    FinishSegmentList(coresegmentsx);
+
+    return(coresegmentsx);
+   }
+
+ /* Index the super-segments */
+
+ IndexSegments(segmentsx,nodesx,waysx);
+
+ /* Print the start message */
+
+ printf_first("Finding Core Super-Nodes: Removed=0");
+
+ /* Allocate the arrays */
+
+ count=(index_t*)malloc(nodesx->number*sizeof(index_t));
+ log_malloc(count,nodesx->number*sizeof(index_t));
+
+ leaves=(index_t*)malloc(nodesx->number*sizeof(index_t));
+ log_malloc(leaves,nodesx->number*sizeof(index_t));
+
+ removed=AllocBitMask(segmentsx->number);
+ log_malloc(removed,LengthBitMask(segmentsx->number)*sizeof(BitMask));
+
+ logassert(count && leaves && removed,"Failed to allocate memory (try using slim mode?)"); /* Check malloc() worked */
+
+ /* Map into memory / open the files */
+
+#if !SLIM
+ segmentsx->data=MapFile(segmentsx->filename_tmp);
+#else
+ segmentsx->fd=SlimMapFile(segmentsx->filename_tmp);
+
+ InvalidateSegmentXCache(segmentsx->cache);
+#endif
+
+ /* Count the super-segments at each super-node (loops count twice) and find the ones with less than two */
+
+ for(i=0;i<nodesx->number;i++)
+   {
+    count[i]=0;
+
+    if(IsBitSet(nodesx->super,i))
+      {
+       SegmentX *segmentx=FirstSegmentX(segmentsx,i,1);
+
+       while(segmentx)
+         {
+          if(segmentx->node1==segmentx->node2)
+             count[i]+=2;
+          else
+             count[i]+=1;
+
+          segmentx=NextSegmentX(segmentsx,segmentx,i);
+         }
+
+       if(count[i]<2)
+          leaves[nleaves++]=i;
+      }
+   }
+
+ /* Remove the leaves one at a time, the node at the other end may become a leaf */
+
+ while(nleaves>0)
+   {
+    index_t node=leaves[--nleaves];
+    SegmentX *segmentx=FirstSegmentX(segmentsx,node,1);
+
+    ClearBit(nodesx->super,node);
+
+    while(segmentx)
+      {
+       index_t seg=IndexSegmentX(segmentsx,segmentx);
+
+       if(!IsBitSet(removed,seg))
+         {
+          index_t othernode=OtherNode(segmentx,node);
+
+          SetBit(removed,seg);
+
+          if(--count[othernode]==1)
+             leaves[nleaves++]=othernode;
+         }
+
+       segmentx=NextSegmentX(segmentsx,segmentx,node);
+      }
+
+    ntree++;
+
+    if(!(ntree%10000))
+       printf_middle("Finding Core Super-Nodes: Removed=%"Pindex_t,ntree);
+   }
+
+ /* Unmap from memory / close the files */
+
+#if !SLIM
+ segmentsx->data=UnmapFile(segmentsx->data);
+#else
+ segmentsx->fd=SlimUnmapFile(segmentsx->fd);
+#endif
+
+ /* Copy the super-segments that remain */
+
+ segmentsx->fd=ReOpenFileBuffered(segmentsx->filename_tmp);
+
+ for(i=0;i<segmentsx->number;i++)
+   {
+    SegmentX segmentx;
+
+    ReadFileBuffered(segmentsx->fd,&segmentx,sizeof(SegmentX));
+
+    if(!IsBitSet(removed,i))
+      {
+       AppendSegmentList(coresegmentsx,segmentx.way,segmentx.node1,segmentx.node2,segmentx.distance);
+
+       ncore++;
+      }
+   }
+
+ segmentsx->fd=CloseFileBuffered(segmentsx->fd);
+
+ FinishSegmentList(coresegmentsx);
+
+ /* Free the no-longer required memory */
+
+ log_free(count);
+ free(count);
+
+ log_free(leaves);
+ free(leaves);
+
+ log_free(removed);
+ free(removed);
+
+ log_free(segmentsx->firstnode);
+ free(segmentsx->firstnode);
+ segmentsx->firstnode=NULL;
+
+ /* Print the final message */
+
+ printf_last("Found Core Super-Nodes: Removed=%"Pindex_t" Core-Segments=%"Pindex_t,ntree,ncore);
+
+ return(coresegmentsx);
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Find all routes from a specified super-node to any other super-node that follows a certain type of way.
 
@@ -30,9 +30,11 @@
 
 void ChooseSuperNodes(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx);
 
-SegmentsX *CreateSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx);
+SegmentsX *CreateSuperSegments(NodesX *nodesx,SegmentsX *segmentsx,WaysX *waysx,int bypass);
 
 SegmentsX *MergeSuperSegments(SegmentsX *segmentsx,SegmentsX *supersegmentsx);
 
+SegmentsX *CreateSecondLevelSuperSegments(NodesX *nodesx,SegmentsX *supersegmentsx,WaysX *waysx);
+
 
 #endif /* SUPERX_H */
@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2010-2015 Andrew M. Bishop
+ This file Copyright 2010-2015, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -46,6 +46,18 @@
 
 static const char* const default_logerror_message="ignoring it";
 
+/*+ The minimum number of consecutive rules testing the same key that are indexed. +*/
+#define MIN_INDEXED_RULES  4
+
+/*+ The maximum number of strings that are interned (tag keys are not interned after this). +*/
+#define MAX_INTERNED_STRINGS (1024*1024)
+
+/*+ The size of the blocks of memory used to store the tag strings that are not interned. +*/
+#define TAGLIST_BUFFER_SIZE 1024
+
+/*+ The number of deleted tag lists that are kept for re-use. +*/
+#define TAGLIST_POOL_SIZE  8
+
 
 /* Local variable (intialised before each use) */
 
@@ -61,13 +73,39 @@ static int current_list_stack_depth=0;
 static TaggingRuleList **current_list_stack=NULL;
 static TaggingRuleList *current_list=NULL;
 
+/* Local variables for the interned rule strings and tag keys (re-initialised by DeleteXMLTaggingRules() function) */
+
+static char **strings=NULL;
+static int nstrings=0;
+
+static int *strings_hash=NULL;
+static int strings_hash_size=0;
+
+/* Local variables for the deleted tag lists that can be re-used (re-initialised by DeleteXMLTaggingRules() function) */
+
+static TagList *taglist_pool[TAGLIST_POOL_SIZE];
+static int ntaglist_pool=0;
+
 /* Local parsing functions */
 
 static TaggingRuleList *AppendTaggingRule(TaggingRuleList *rules,const char *k,const char *v,int action);
 static void AppendTaggingAction(TaggingRuleList *rules,const char *k,const char *v,int action,const char *message);
 static void DeleteTaggingRuleList(TaggingRuleList *rules);
 
-static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,const char *match_k,const char *match_v);
+static int InternString(const char *string);
+static int LookupString(const char *string);
+static uint32_t hash_string(const char *string);
+
+static void IndexTaggingRuleList(TaggingRuleList *rules);
+static int sort_by_vid_and_rule(const void *a,const void *b);
+
+static char *CopyTagString(TagList *tags,const char *string);
+static void ModifyTagIds(TagList *tags,const char *k,int kid,const char *v,int vid);
+static void DeleteTagIds(TagList *tags,const char *k,int kid);
+
+static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,const char *match_k,int match_kid,const char *match_v,int match_vid);
+static void ApplyIfRule(TaggingRule *rule,TagList *input,TagList *output);
+static int NextIndexedRule(TaggingRule *rule,int first,int last,TagList *input);
 
 
 /* The XML tag processing function prototypes */
@@ -479,6 +517,12 @@ int ParseXMLTaggingRules(const char *filename)
  if(retval)
     return(1);
 
+ /* Compile the rules for faster matching */
+
+ IndexTaggingRuleList(&NodeRules);
+ IndexTaggingRuleList(&WayRules);
+ IndexTaggingRuleList(&RelationRules);
+
  return(0);
 }
 
@@ -496,6 +540,44 @@ void DeleteXMLTaggingRules(void)
  DeleteTaggingRuleList(&NodeRules);
  DeleteTaggingRuleList(&WayRules);
  DeleteTaggingRuleList(&RelationRules);
+
+ if(strings)
+   {
+    int i;
+
+    for(i=0;i<nstrings;i++)
+       free(strings[i]);
+
+    free(strings);
+    free(strings_hash);
+   }
+
+ strings=NULL;
+ nstrings=0;
+
+ strings_hash=NULL;
+ strings_hash_size=0;
+
+ while(ntaglist_pool>0)
+   {
+    TagList *tags=taglist_pool[--ntaglist_pool];
+
+    while(tags->buffer)
+      {
+       char *previous=*(char**)tags->buffer;
+
+       free(tags->buffer);
+
+       tags->buffer=previous;
+      }
+
+    if(tags->k)   free(tags->k);
+    if(tags->v)   free(tags->v);
+    if(tags->kid) free(tags->kid);
+    if(tags->vid) free(tags->vid);
+
+    free(tags);
+   }
 }
 
 
@@ -523,14 +605,29 @@ TaggingRuleList *AppendTaggingRule(TaggingRuleList *rules,const char *k,const ch
  rules->rules[rules->nrules-1].action=action;
 
  if(k)
-    rules->rules[rules->nrules-1].k=strcpy(malloc(strlen(k)+1),k);
+   {
+    rules->rules[rules->nrules-1].kid=InternString(k);
+    rules->rules[rules->nrules-1].k=strings[rules->rules[rules->nrules-1].kid];
+   }
  else
+   {
+    rules->rules[rules->nrules-1].kid=-1;
     rules->rules[rules->nrules-1].k=NULL;
+   }
 
  if(v)
-    rules->rules[rules->nrules-1].v=strcpy(malloc(strlen(v)+1),v);
+   {
+    rules->rules[rules->nrules-1].vid=InternString(v);
+    rules->rules[rules->nrules-1].v=strings[rules->rules[rules->nrules-1].vid];
+   }
  else
+   {
+    rules->rules[rules->nrules-1].vid=-1;
     rules->rules[rules->nrules-1].v=NULL;
+   }
+
+ rules->rules[rules->nrules-1].nindex=0;
+ rules->rules[rules->nrules-1].index=NULL;
 
  rules->rules[rules->nrules-1].message=NULL;
 
@@ -564,14 +661,29 @@ static void AppendTaggingAction(TaggingRuleList *rules,const char *k,const char
  rules->rules[rules->nrules-1].action=action;
 
  if(k)
-    rules->rules[rules->nrules-1].k=strcpy(malloc(strlen(k)+1),k);
+   {
+    rules->rules[rules->nrules-1].kid=InternString(k);
+    rules->rules[rules->nrules-1].k=strings[rules->rules[rules->nrules-1].kid];
+   }
  else
+   {
+    rules->rules[rules->nrules-1].kid=-1;
     rules->rules[rules->nrules-1].k=NULL;
+   }
 
  if(v)
-    rules->rules[rules->nrules-1].v=strcpy(malloc(strlen(v)+1),v);
+   {
+    rules->rules[rules->nrules-1].vid=InternString(v);
+    rules->rules[rules->nrules-1].v=strings[rules->rules[rules->nrules-1].vid];
+   }
  else
+   {
+    rules->rules[rules->nrules-1].vid=-1;
     rules->rules[rules->nrules-1].v=NULL;
+   }
+
+ rules->rules[rules->nrules-1].nindex=0;
+ rules->rules[rules->nrules-1].index=NULL;
 
  if(message)
     rules->rules[rules->nrules-1].message=strcpy(malloc(strlen(message)+1),message);
@@ -594,10 +706,8 @@ void DeleteTaggingRuleList(TaggingRuleList *rules)
 
  for(i=0;i<rules->nrules;i++)
    {
-    if(rules->rules[i].k)
-       free(rules->rules[i].k);
-    if(rules->rules[i].v)
-       free(rules->rules[i].v);
+    if(rules->rules[i].index)
+       free(rules->rules[i].index);
     if(rules->rules[i].message && rules->rules[i].message!=default_logerror_message)
        free(rules->rules[i].message);
 
@@ -617,40 +727,274 @@ void DeleteTaggingRuleList(TaggingRuleList *rules)
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Create a new TagList structure.
+  Intern a string used in the tagging rules so that it can be compared by number.
+
+  int InternString Returns the index of the interned string.
+
+  const char *string The string to intern.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int InternString(const char *string)
+{
+ int i;
+
+ if(2*nstrings>=strings_hash_size)
+   {
+    strings_hash_size=strings_hash_size?2*strings_hash_size:256;
+
+    strings_hash=(int*)realloc((void*)strings_hash,strings_hash_size*sizeof(int));
+
+    for(i=0;i<strings_hash_size;i++)
+       strings_hash[i]=-1;
+
+    for(i=0;i<nstrings;i++)
+      {
+       uint32_t j=hash_string(strings[i])&(strings_hash_size-1);
+
+       while(strings_hash[j]!=-1)
+          j=(j+1)&(strings_hash_size-1);
+
+       strings_hash[j]=i;
+      }
+   }
+
+ i=hash_string(string)&(strings_hash_size-1);
+
+ while(strings_hash[i]!=-1)
+   {
+    if(!strcmp(strings[strings_hash[i]],string))
+       return(strings_hash[i]);
+
+    i=(i+1)&(strings_hash_size-1);
+   }
+
+ if((nstrings%256)==0)
+    strings=(char**)realloc((void*)strings,(nstrings+256)*sizeof(char*));
+
+ strings[nstrings]=strcpy(malloc(strlen(string)+1),string);
+
+ strings_hash[i]=nstrings;
+
+ return(nstrings++);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find a string in the set of interned strings.
+
+  int LookupString Returns the index of the interned string or -1 if it is not one of them.
+
+  const char *string The string to find.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int LookupString(const char *string)
+{
+ uint32_t i;
+
+ if(!strings_hash)
+    return(-1);
+
+ i=hash_string(string)&(strings_hash_size-1);
+
+ while(strings_hash[i]!=-1)
+   {
+    if(!strcmp(strings[strings_hash[i]],string))
+       return(strings_hash[i]);
+
+    i=(i+1)&(strings_hash_size-1);
+   }
+
+ return(-1);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate the hash of a string (32-bit FNV-1a).
+
+  uint32_t hash_string Returns the hash value.
+
+  const char *string The string to hash.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static uint32_t hash_string(const char *string)
+{
+ uint32_t hash=2166136261U;
+
+ while(*string)
+   {
+    hash^=(unsigned char)*string++;
+    hash*=16777619U;
+   }
+
+ return(hash);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Compile a list of tagging rules by creating an index for each run of consecutive 'if' rules that test the same key
+  against different values (and recursively for the sub-rules).
+
+  TaggingRuleList *rules The list of rules to index.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void IndexTaggingRuleList(TaggingRuleList *rules)
+{
+ int i=0,j;
+
+ for(j=0;j<rules->nrules;j++)
+    if(rules->rules[j].rulelist)
+       IndexTaggingRuleList(rules->rules[j].rulelist);
+
+ while(i<rules->nrules)
+   {
+    TaggingRule *rule=&rules->rules[i];
+    int n=1;
+
+    if(rule->action==TAGACTION_IF && rule->k && rule->v)
+       while((i+n)<rules->nrules && rules->rules[i+n].action==TAGACTION_IF &&
+             rules->rules[i+n].kid==rule->kid && rules->rules[i+n].v)
+          n++;
+
+    if(n>=MIN_INDEXED_RULES)
+      {
+       rule->nindex=n;
+       rule->index=(TaggingRuleIndex*)malloc(n*sizeof(TaggingRuleIndex));
+
+       for(j=0;j<n;j++)
+         {
+          rule->index[j].vid=rules->rules[i+j].vid;
+          rule->index[j].rule=i+j;
+         }
+
+       qsort(rule->index,n,sizeof(TaggingRuleIndex),sort_by_vid_and_rule);
+      }
+
+    i+=n;
+   }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Sort the tagging rule index entries into value and then rule order.
+
+  int sort_by_vid_and_rule Returns the comparison of the entries.
+
+  const void *a The first entry.
+
+  const void *b The second entry.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int sort_by_vid_and_rule(const void *a,const void *b)
+{
+ const TaggingRuleIndex *a_index=(const TaggingRuleIndex*)a;
+ const TaggingRuleIndex *b_index=(const TaggingRuleIndex*)b;
+
+ if(a_index->vid!=b_index->vid)
+    return(a_index->vid<b_index->vid?-1:1);
+
+ return(a_index->rule-b_index->rule);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Create a new TagList structure (re-using a deleted one if possible).
 
   TagList *NewTagList Returns the new allocated TagList.
   ++++++++++++++++++++++++++++++++++++++*/
 
 TagList *NewTagList(void)
 {
+ if(ntaglist_pool>0)
+    return(taglist_pool[--ntaglist_pool]);
+
  return((TagList*)calloc(sizeof(TagList),1));
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Delete a tag list and the contents.
+  Delete a tag list and the contents (or keep it for re-use).
 
   TagList *tags The list of tags to delete.
   ++++++++++++++++++++++++++++++++++++++*/
 
 void DeleteTagList(TagList *tags)
 {
- int i;
+ char *buffer;
 
- for(i=0;i<tags->ntags;i++)
+ /* Keep the latest block of memory if the list is going to be re-used */
+
+ if(ntaglist_pool<TAGLIST_POOL_SIZE && tags->buffer)
+   {
+    buffer=*(char**)tags->buffer;
+
+    *(char**)tags->buffer=NULL;
+    tags->buffer_used=sizeof(char*);
+   }
+ else
+   {
+    buffer=tags->buffer;
+
+    tags->buffer=NULL;
+   }
+
+ while(buffer)
+   {
+    char *previous=*(char**)buffer;
+
+    free(buffer);
+
+    buffer=previous;
+   }
+
+ if(ntaglist_pool<TAGLIST_POOL_SIZE)
    {
-    if(tags->k[i]) free(tags->k[i]);
-    if(tags->v[i]) free(tags->v[i]);
+    tags->ntags=0;
+
+    taglist_pool[ntaglist_pool++]=tags;
+
+    return;
    }
 
- if(tags->k) free(tags->k);
- if(tags->v) free(tags->v);
+ if(tags->k)   free(tags->k);
+ if(tags->v)   free(tags->v);
+ if(tags->kid) free(tags->kid);
+ if(tags->vid) free(tags->vid);
 
  free(tags);
 }
 
 
+/*++++++++++++++++++++++++++++++++++++++
+  Intern a tag key so that it can be stored and compared by number.
+
+  int InternTagKey Returns the interned key or -1 if too many strings have been interned already.
+
+  const char *k The tag key.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int InternTagKey(const char *k)
+{
+ if(nstrings<MAX_INTERNED_STRINGS)
+    return(InternString(k));
+ else
+    return(LookupString(k));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find a tag value in the interned strings (values are not added since most of them are unique).
+
+  int LookupTagValue Returns the interned value or -1 if it is not interned.
+
+  const char *v The tag value.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int LookupTagValue(const char *v)
+{
+ return(LookupString(v));
+}
+
+
 /*++++++++++++++++++++++++++++++++++++++
   Append a tag to the list of tags.
 
@@ -663,19 +1007,42 @@ void DeleteTagList(TagList *tags)
 
 void AppendTag(TagList *tags,const char *k,const char *v)
 {
- if((tags->ntags%8)==0)
+ AppendTagIds(tags,k,InternTagKey(k),v,LookupTagValue(v));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Append a tag whose key and value have already been looked up to the list of tags.
+
+  TagList *tags The list of tags to add to.
+
+  const char *k The tag key.
+
+  int kid The interned tag key (as returned by InternTagKey()).
+
+  const char *v The tag value.
+
+  int vid The interned tag value (as returned by LookupTagValue()).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void AppendTagIds(TagList *tags,const char *k,int kid,const char *v,int vid)
+{
+ if(tags->ntags==tags->nallocated)
    {
-    int i;
+    tags->nallocated+=8;
 
-    tags->k=(char**)realloc((void*)tags->k,(tags->ntags+8)*sizeof(char*));
-    tags->v=(char**)realloc((void*)tags->v,(tags->ntags+8)*sizeof(char*));
+    tags->k=(char**)realloc((void*)tags->k,tags->nallocated*sizeof(char*));
+    tags->v=(char**)realloc((void*)tags->v,tags->nallocated*sizeof(char*));
 
-    for(i=tags->ntags;i<(tags->ntags+8);i++)
-       tags->k[i]=tags->v[i]=NULL;
+    tags->kid=(int*)realloc((void*)tags->kid,tags->nallocated*sizeof(int));
+    tags->vid=(int*)realloc((void*)tags->vid,tags->nallocated*sizeof(int));
    }
 
- tags->k[tags->ntags]=strcpy(realloc(tags->k[tags->ntags],strlen(k)+1),k);
- tags->v[tags->ntags]=strcpy(realloc(tags->v[tags->ntags],strlen(v)+1),v);
+ tags->k[tags->ntags]=(kid!=-1)?strings[kid]:CopyTagString(tags,k);
+ tags->v[tags->ntags]=(vid!=-1)?strings[vid]:CopyTagString(tags,v);
+
+ tags->kid[tags->ntags]=kid;
+ tags->vid[tags->ntags]=vid;
 
  tags->ntags++;
 }
@@ -692,49 +1059,125 @@ void AppendTag(TagList *tags,const char *k,const char *v)
   ++++++++++++++++++++++++++++++++++++++*/
 
 void ModifyTag(TagList *tags,const char *k,const char *v)
+{
+ ModifyTagIds(tags,k,InternTagKey(k),v,LookupTagValue(v));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Delete an existing tag from the list of tags.
+
+  TagList *tags The list of tags to modify.
+
+  const char *k The tag key.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+void DeleteTag(TagList *tags,const char *k)
+{
+ DeleteTagIds(tags,k,LookupString(k));
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Copy a string that is not interned into the memory belonging to a list of tags.
+
+  char *CopyTagString Returns a pointer to the copy of the string.
+
+  TagList *tags The list of tags that will contain the string.
+
+  const char *string The string to copy.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static char *CopyTagString(TagList *tags,const char *string)
+{
+ size_t length=strlen(string)+1;
+ char *copy;
+
+ /* Each block of memory starts with a pointer to the previous one. */
+
+ if(!tags->buffer || (tags->buffer_used+length)>tags->buffer_size)
+   {
+    char *buffer;
+
+    tags->buffer_size=TAGLIST_BUFFER_SIZE;
+
+    if((sizeof(char*)+length)>tags->buffer_size)
+       tags->buffer_size=sizeof(char*)+length;
+
+    buffer=(char*)malloc(tags->buffer_size);
+
+    *(char**)buffer=tags->buffer;
+
+    tags->buffer=buffer;
+    tags->buffer_used=sizeof(char*);
+   }
+
+ copy=memcpy(tags->buffer+tags->buffer_used,string,length);
+
+ tags->buffer_used+=length;
+
+ return(copy);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Modify an existing tag or append a new tag to the list of tags using the interned strings.
+
+  TagList *tags The list of tags to modify.
+
+  const char *k The tag key.
+
+  int kid The interned tag key (or -1).
+
+  const char *v The tag value.
+
+  int vid The interned tag value (or -1).
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void ModifyTagIds(TagList *tags,const char *k,int kid,const char *v,int vid)
 {
  int i;
 
  for(i=0;i<tags->ntags;i++)
-    if(!strcmp(tags->k[i],k))
+    if((kid!=-1 && tags->kid[i]!=-1)?(tags->kid[i]==kid):!strcmp(tags->k[i],k))
       {
-       tags->v[i]=strcpy(realloc(tags->v[i],strlen(v)+1),v);
+       tags->v[i]=(vid!=-1)?strings[vid]:CopyTagString(tags,v);
+       tags->vid[i]=vid;
        return;
       }
 
- AppendTag(tags,k,v);
+ AppendTagIds(tags,k,kid,v,vid);
 }
 
 
 /*++++++++++++++++++++++++++++++++++++++
-  Delete an existing tag from the list of tags.
+  Delete an existing tag from the list of tags using the interned strings.
 
   TagList *tags The list of tags to modify.
 
   const char *k The tag key.
+
+  int kid The interned tag key (or -1).
   ++++++++++++++++++++++++++++++++++++++*/
 
-void DeleteTag(TagList *tags,const char *k)
+static void DeleteTagIds(TagList *tags,const char *k,int kid)
 {
  int i,j;
 
  for(i=0;i<tags->ntags;i++)
-    if(!strcmp(tags->k[i],k))
+    if((kid!=-1 && tags->kid[i]!=-1)?(tags->kid[i]==kid):!strcmp(tags->k[i],k))
       {
-       if(tags->k[i]) free(tags->k[i]);
-       if(tags->v[i]) free(tags->v[i]);
-
        for(j=i+1;j<tags->ntags;j++)
          {
           tags->k[j-1]=tags->k[j];
           tags->v[j-1]=tags->v[j];
+
+          tags->kid[j-1]=tags->kid[j];
+          tags->vid[j-1]=tags->vid[j];
          }
 
        tags->ntags--;
 
-       tags->k[tags->ntags]=NULL;
-       tags->v[tags->ntags]=NULL;
-
        return;
       }
 }
@@ -787,7 +1230,7 @@ TagList *ApplyNodeTaggingRules(TagList *tags,int64_t id)
  current_id=id;
  current_list=&NodeRules;
 
- ApplyRules(current_list,tags,result,NULL,NULL);
+ ApplyRules(current_list,tags,result,NULL,-1,NULL,-1);
 
  return(result);
 }
@@ -810,7 +1253,7 @@ TagList *ApplyWayTaggingRules(TagList *tags,int64_t id)
  current_id=id;
  current_list=&WayRules;
 
- ApplyRules(current_list,tags,result,NULL,NULL);
+ ApplyRules(current_list,tags,result,NULL,-1,NULL,-1);
 
  return(result);
 }
@@ -833,7 +1276,7 @@ TagList *ApplyRelationTaggingRules(TagList *tags,int64_t id)
  current_id=id;
  current_list=&RelationRules;
 
- ApplyRules(current_list,tags,result,NULL,NULL);
+ ApplyRules(current_list,tags,result,NULL,-1,NULL,-1);
 
  return(result);
 }
@@ -850,70 +1293,67 @@ TagList *ApplyRelationTaggingRules(TagList *tags,int64_t id)
 
   const char *match_k The key matched at the higher level rule.
 
+  int match_kid The interned key matched at the higher level rule (or -1).
+
   const char *match_v The value matched at the higher level rule.
+
+  int match_vid The interned value matched at the higher level rule (or -1).
   ++++++++++++++++++++++++++++++++++++++*/
 
-static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,const char *match_k,const char *match_v)
+static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,const char *match_k,int match_kid,const char *match_v,int match_vid)
 {
  int i,j;
- char *match_k_copy=NULL,*match_v_copy=NULL;
- 
- if(match_k)
-    match_k_copy=strcpy(malloc(strlen(match_k)+1),match_k);
 
- if(match_v)
-    match_v_copy=strcpy(malloc(strlen(match_v)+1),match_v);
+ /* The matched key and value are not changed by the rules since modified and deleted tags
+    are not freed until the list of tags is deleted. */
 
  for(i=0;i<rules->nrules;i++)
    {
+    TaggingRule *rule=&rules->rules[i];
     const char *k,*v;
+    int kid,vid;
 
-    k=rules->rules[i].k;
+    k=rule->k;
+    kid=rule->kid;
 
-    if(!k && rules->rules[i].action >= TAGACTION_INHERIT)
-       k=match_k_copy;
+    if(!k && rule->action >= TAGACTION_INHERIT)
+      {
+       k=match_k;
+       kid=match_kid;
+      }
 
-    v=rules->rules[i].v;
+    v=rule->v;
+    vid=rule->vid;
 
-    if(!v && rules->rules[i].action >= TAGACTION_INHERIT)
-       v=match_v_copy;
+    if(!v && rule->action >= TAGACTION_INHERIT)
+      {
+       v=match_v;
+       vid=match_vid;
+      }
 
-    switch(rules->rules[i].action)
+    switch(rule->action)
       {
       case TAGACTION_IF:
-       if(k && v)
-         {
-          for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->k[j],k) && !strcmp(input->v[j],v))
-                ApplyRules(rules->rules[i].rulelist,input,output,input->k[j],input->v[j]);
-         }
-       else if(k && !v)
-         {
-          for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->k[j],k))
-                ApplyRules(rules->rules[i].rulelist,input,output,input->k[j],input->v[j]);
-         }
-       else if(!k && v)
-         {
-          for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->v[j],v))
-                ApplyRules(rules->rules[i].rulelist,input,output,input->k[j],input->v[j]);
-         }
-       else /* if(!k && !v) */
+       if(rule->index)
          {
-          if(!input->ntags)
-             ApplyRules(rules->rules[i].rulelist,input,output,"","");
-          else
-             for(j=0;j<input->ntags;j++)
-                ApplyRules(rules->rules[i].rulelist,input,output,input->k[j],input->v[j]);
+          int last=i+rule->nindex;
+
+          /* Only the rules in the index that can match are tested, in the original order. */
+
+          for(i=NextIndexedRule(rule,i,last,input);i<last;i=NextIndexedRule(rule,i+1,last,input))
+             ApplyIfRule(&rules->rules[i],input,output);
+
+          i=last-1;
          }
+       else
+          ApplyIfRule(rule,input,output);
        break;
 
       case TAGACTION_IFNOT:
        if(k && v)
          {
           for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->k[j],k) && !strcmp(input->v[j],v))
+             if(input->kid[j]==kid && input->vid[j]==vid)
                 break;
 
           if(j!=input->ntags)
@@ -922,7 +1362,7 @@ static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,con
        else if(k && !v)
          {
           for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->k[j],k))
+             if(input->kid[j]==kid)
                 break;
 
           if(j!=input->ntags)
@@ -931,7 +1371,7 @@ static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,con
        else if(!k && v)
          {
           for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->v[j],v))
+             if(input->vid[j]==vid)
                 break;
 
           if(j!=input->ntags)
@@ -942,39 +1382,125 @@ static void ApplyRules(TaggingRuleList *rules,TagList *input,TagList *output,con
           break;
          }
 
-       ApplyRules(rules->rules[i].rulelist,input,output,k,v);
+       ApplyRules(rule->rulelist,input,output,k,kid,v,vid);
        break;
 
       case TAGACTION_SET:
-       ModifyTag(input,k,v);
+       ModifyTagIds(input,k,kid,v,vid);
        break;
 
       case TAGACTION_UNSET:
-       DeleteTag(input,k);
+       DeleteTagIds(input,k,kid);
        break;
 
       case TAGACTION_OUTPUT:
-       ModifyTag(output,k,v);
+       ModifyTagIds(output,k,kid,v,vid);
        break;
 
       case TAGACTION_LOGERROR:
-       if(rules->rules[i].k && !rules->rules[i].v)
+       if(rule->k && !rule->v)
           for(j=0;j<input->ntags;j++)
-             if(!strcmp(input->k[j],rules->rules[i].k))
+             if(input->kid[j]==rule->kid)
                {
                 v=input->v[j];
                 break;
                }
 
        if(current_list==&NodeRules)
-          logerror("Node %"Pnode_t" has an unrecognised tag '%s' = '%s' (in tagging rules); %s.\n",logerror_node(current_id),k,v,rules->rules[i].message);
+          logerror("Node %"Pnode_t" has an unrecognised tag '%s' = '%s' (in tagging rules); %s.\n",logerror_node(current_id),k,v,rule->message);
        if(current_list==&WayRules)
-          logerror("Way %"Pway_t" has an unrecognised tag '%s' = '%s' (in tagging rules); %s.\n",logerror_way(current_id),k,v,rules->rules[i].message);
+          logerror("Way %"Pway_t" has an unrecognised tag '%s' = '%s' (in tagging rules); %s.\n",logerror_way(current_id),k,v,rule->message);
        if(current_list==&RelationRules)
-          logerror("Relation %"Prelation_t" has an unrecognised tag '%s' = '%s' (in tagging rules); %s.\n",logerror_relation(current_id),k,v,rules->rules[i].message);
+          logerror("Relation %"Prelation_t" has an unrecognised tag '%s' = '%s' (in tagging rules); %s.\n",logerror_relation(current_id),k,v,rule->message);
+      }
+   }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Apply a single 'if' rule to the tags that it matches.
+
+  TaggingRule *rule The rule to apply.
+
+  TagList *input The input tags.
+
+  TagList *output The output tags.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void ApplyIfRule(TaggingRule *rule,TagList *input,TagList *output)
+{
+ int j;
+
+ if(rule->k && rule->v)
+   {
+    for(j=0;j<input->ntags;j++)
+       if(input->kid[j]==rule->kid && input->vid[j]==rule->vid)
+          ApplyRules(rule->rulelist,input,output,input->k[j],input->kid[j],input->v[j],input->vid[j]);
+   }
+ else if(rule->k && !rule->v)
+   {
+    for(j=0;j<input->ntags;j++)
+       if(input->kid[j]==rule->kid)
+          ApplyRules(rule->rulelist,input,output,input->k[j],input->kid[j],input->v[j],input->vid[j]);
+   }
+ else if(!rule->k && rule->v)
+   {
+    for(j=0;j<input->ntags;j++)
+       if(input->vid[j]==rule->vid)
+          ApplyRules(rule->rulelist,input,output,input->k[j],input->kid[j],input->v[j],input->vid[j]);
+   }
+ else /* if(!rule->k && !rule->v) */
+   {
+    if(!input->ntags)
+      {
+       int emptyid=LookupString("");
+
+       ApplyRules(rule->rulelist,input,output,"",emptyid,"",emptyid);
       }
+    else
+       for(j=0;j<input->ntags;j++)
+          ApplyRules(rule->rulelist,input,output,input->k[j],input->kid[j],input->v[j],input->vid[j]);
    }
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Find the next rule in an indexed run of 'if' rules that matches one of the input tags.
+
+  int NextIndexedRule Returns the position of the next matching rule or 'last' if there is none.
+
+  TaggingRule *rule The first rule of the run (which holds the index).
+
+  int first The position of the first rule that can be chosen.
+
+  int last The position after the end of the run.
+
+  TagList *input The input tags.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int NextIndexedRule(TaggingRule *rule,int first,int last,TagList *input)
+{
+ int j,next=last;
+
+ for(j=0;j<input->ntags;j++)
+    if(input->kid[j]==rule->kid && input->vid[j]!=-1)
+      {
+       int vid=input->vid[j];
+       int start=0,end=rule->nindex;
+
+       while(start<end)
+         {
+          int mid=(start+end)/2;
+
+          if(rule->index[mid].vid<vid || (rule->index[mid].vid==vid && rule->index[mid].rule<first))
+             start=mid+1;
+          else
+             end=mid;
+         }
+
+       if(start<rule->nindex && rule->index[start].vid==vid && rule->index[start].rule<next)
+          next=rule->index[start].rule;
+      }
 
- if(match_k_copy) free(match_k_copy);
- if(match_v_copy) free(match_v_copy);
+ return(next);
 }
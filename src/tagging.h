@@ -3,7 +3,7 @@
 
  Part of the Routino routing software.
  ******************/ /******************
- This file Copyright 2010-2013 Andrew M. Bishop
+ This file Copyright 2010-2013, 2017 Andrew M. Bishop
 
  This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU Affero General Public License as published by
@@ -30,6 +30,15 @@
 typedef struct _TaggingRuleList TaggingRuleList;
 
 
+/*+ A structure to contain one entry in the index of a set of rules that test the same tag key. +*/
+typedef struct _TaggingRuleIndex
+{
+ int vid;                       /*+ The interned tag value tested by the rule. +*/
+ int rule;                      /*+ The position of the rule in the list. +*/
+}
+ TaggingRuleIndex;
+
+
 /*+ A structure to contain the tagging rule/action. +*/
 typedef struct _TaggingRule
 {
@@ -39,6 +48,12 @@ typedef struct _TaggingRule
  char *v;                       /*+ The tag value (or NULL). +*/
  char *message;                 /*+ The message string for logerror (or NULL). +*/
 
+ int kid;                       /*+ The interned tag key (or -1). +*/
+ int vid;                       /*+ The interned tag value (or -1). +*/
+
+ int nindex;                    /*+ The number of rules in the index (starting with this one). +*/
+ TaggingRuleIndex *index;       /*+ The index of the rules that test the same key, sorted by value (or NULL). +*/
+
  TaggingRuleList *rulelist;     /*+ The sub-rules belonging to this rule. +*/
 }
  TaggingRule;
@@ -57,8 +72,17 @@ typedef struct _TagList
 {
  int ntags;                     /*+ The number of tags. +*/
 
- char **k;                      /*+ The list of tag keys. +*/
- char **v;                      /*+ The list of tag values. +*/
+ char **k;                      /*+ The list of tag keys (interned or in the buffer, not to be freed). +*/
+ char **v;                      /*+ The list of tag values (interned or in the buffer, not to be freed). +*/
+
+ int *kid;                      /*+ The list of interned tag keys (or -1). +*/
+ int *vid;                      /*+ The list of interned tag values (or -1). +*/
+
+ int nallocated;                /*+ The number of tags allocated. +*/
+
+ char  *buffer;                 /*+ The latest block of memory holding the strings that are not interned. +*/
+ size_t buffer_size;            /*+ The size of the latest block of memory. +*/
+ size_t buffer_used;            /*+ The amount of the latest block of memory that is used. +*/
 }
  TagList;
 
@@ -71,7 +95,11 @@ void DeleteXMLTaggingRules(void);
 TagList *NewTagList(void);
 void DeleteTagList(TagList *tags);
 
+int InternTagKey(const char *k);
+int LookupTagValue(const char *v);
+
 void AppendTag(TagList *tags,const char *k,const char *v);
+void AppendTagIds(TagList *tags,const char *k,int kid,const char *v,int vid);
 void ModifyTag(TagList *tags,const char *k,const char *v);
 void DeleteTag(TagList *tags,const char *k);
 
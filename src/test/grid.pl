@@ -0,0 +1,200 @@
+#!/usr/bin/perl
+#
+# Large grid test file generator tool.
+#
+# Part of the Routino routing software.
+#
+# This file Copyright 2011-2014 Andrew M. Bishop
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+use strict;
+
+# Command line
+
+if($#ARGV<1 || $#ARGV>2 || $ARGV[0]!~/^[0-9]+$/ || ($#ARGV==2 && $ARGV[2]!~/^[0-9]+$/))
+  {
+   die "Usage: grid.pl <size> <filename.osm> [<highway-offset>]\n";
+  }
+
+my($size,$outfile,$offset)=@ARGV;
+
+# The highway types of the grid ways can be changed (to make a different
+# database with the same nodes)
+
+$offset=0 if(!defined $offset);
+
+# The ways are split into pieces of this many segments
+
+my $length=5;
+
+my @highways=("primary","secondary","tertiary","unclassified","residential");
+
+# There is a small tree of dead-end ways (with two levels of junctions) on a
+# regular pattern of grid nodes and some of them have a named waypoint at one
+# of the ends.  The tree nodes are positioned relative to the grid node (in
+# units of the grid spacing) and the tree ways list the tree nodes (with -1
+# for the grid node).
+
+my $treespacing=20;
+my $waypointspacing=40;
+
+my @treenodes=([0.25,0.25],[0.5,0.25],[0.75,0.25],[0.5,0.1],[0.25,0.5],[0.25,0.75],[0.1,0.5]);
+my @treeways=(["residential",-1,0,1,2],["service",1,3],["unclassified",0,4,5],["service",4,6]);
+my $treewaypoint=2;
+
+my @trees=();
+
+for(my $y=$treespacing/2;$y<$size;$y+=$treespacing)
+  {
+   for(my $x=$treespacing/2;$x<$size;$x+=$treespacing)
+     {
+      push(@trees,[$x,$y]);
+     }
+  }
+
+# The node and way ids are scrambled so that the data needs sorting and are
+# large so that the grid can be combined with the other test cases
+
+my $nnodes=$size*$size;
+my $nways=2*$size*int(($size+$length-2)/$length);
+
+sub node_id
+{
+ my($x,$y)=@_;
+
+ return 1000001+(($y*$size+$x)*7919)%$nnodes;
+}
+
+sub tree_node_id
+{
+ my($t,$n)=@_;
+
+ return 1000001+$nnodes+$t*($#treenodes+1)+$n;
+}
+
+sub jitter
+{
+ my($i)=@_;
+
+ return (((($i*1103515245+12345)%2147483648)>>16)%101-50)*0.000001;
+}
+
+sub way_id
+{
+ my($n)=@_;
+
+ return 1000001+($n*7919)%$nways;
+}
+
+open(FILE,">$outfile") || die "Cannot open '$outfile'\n";
+
+print FILE "<?xml version='1.0' encoding='UTF-8'?>\n";
+print FILE "<osm version='0.6' generator='grid.pl'>\n";
+
+# The nodes (moved by a small pseudo-random amount so that there is only one
+# shortest and one quickest route between any two nodes)
+
+foreach my $y (0..$size-1)
+  {
+   foreach my $x (0..$size-1)
+     {
+      my $id=node_id($x,$y);
+
+      printf FILE "  <node id='%d' version='1' visible='true' lat='%.7f' lon='%.7f' />\n",$id,-0.3+$y*0.0005+jitter(2*$id),-0.5+$x*0.0005+jitter(2*$id+1);
+     }
+  }
+
+# The nodes in the trees
+
+my $nwaypoints=0;
+
+foreach my $t (0..$#trees)
+  {
+   my($x,$y)=@{$trees[$t]};
+
+   foreach my $n (0..$#treenodes)
+     {
+      my($dx,$dy)=@{$treenodes[$n]};
+
+      printf FILE "  <node id='%d' version='1' visible='true' lat='%.7f' lon='%.7f'",tree_node_id($t,$n),-0.3+($y+$dy)*0.0005,-0.5+($x+$dx)*0.0005;
+
+      if($n==$treewaypoint && ($x%$waypointspacing)==$treespacing/2 && ($y%$waypointspacing)==$treespacing/2)
+        {
+         print  FILE ">\n";
+         printf FILE "    <tag k='name' v='WP%02d' />\n",++$nwaypoints;
+         print  FILE "  </node>\n";
+        }
+      else
+        {
+         print  FILE " />\n";
+        }
+     }
+  }
+
+# The ways (rows then columns)
+
+my $n=0;
+
+foreach my $dir (0..1)
+  {
+   foreach my $i (0..$size-1)
+     {
+      for(my $j=0;$j<$size-1;$j+=$length)
+        {
+         printf FILE "  <way id='%d' version='1' visible='true'>\n",way_id($n);
+
+         foreach my $k ($j..($j+$length<$size-1?$j+$length:$size-1))
+           {
+            printf FILE "    <nd ref='%d' />\n",($dir?node_id($i,$k):node_id($k,$i));
+           }
+
+         printf FILE "    <tag k='highway' v='%s' />\n",$highways[($i+$j+$offset)%($#highways+1)];
+         printf FILE "    <tag k='name' v='%s %d' />\n",($dir?"column":"row"),$i;
+         print  FILE "  </way>\n";
+
+         $n++;
+        }
+     }
+  }
+
+# The ways in the trees
+
+foreach my $t (0..$#trees)
+  {
+   my($x,$y)=@{$trees[$t]};
+
+   foreach my $w (0..$#treeways)
+     {
+      my($highway,@nodes)=@{$treeways[$w]};
+
+      printf FILE "  <way id='%d' version='1' visible='true'>\n",1000001+$nways+$t*($#treeways+1)+$w;
+
+      foreach my $n (@nodes)
+        {
+         printf FILE "    <nd ref='%d' />\n",($n<0?node_id($x,$y):tree_node_id($t,$n));
+        }
+
+      printf FILE "    <tag k='highway' v='%s' />\n",$highway;
+      printf FILE "    <tag k='name' v='tree %d' />\n",$t;
+      print  FILE "  </way>\n";
+     }
+  }
+
+print FILE "</osm>\n";
+
+close(FILE);
+
+exit 0;
@@ -0,0 +1,259 @@
+/***************************************
+ Test the isochrone function in the libroutino library.
+
+ Part of the Routino routing software.
+ ******************/ /******************
+ This file Copyright 2017 Andrew M. Bishop
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ***************************************/
+
+
+/* The isochrone is calculated for the limit and for twice the limit.  The
+   nodes that are reached within the limit must be exactly the ones from the
+   larger isochrone that have a value within the limit, with the same values.
+   The smaller isochrone is printed so that it can be compared with other
+   versions of the library. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "routino.h"
+
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/* Local functions */
+
+static int *sort_isochrone(Routino_Isochrone *isochrone);
+static int compare_points(const void *a,const void *b);
+
+
+/* Local variables */
+
+static Routino_Isochrone *sorting_isochrone;
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  The main program for the isochrone test.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int main(int argc,char** argv)
+{
+ Routino_Database  *database;
+ Routino_Profile   *profile;
+ Routino_Waypoint  *waypoint;
+ Routino_Isochrone *isochrone1,*isochrone2;
+ const char *dirname=NULL,*prefix=NULL,*profiles=NULL,*profilename="motorcar";
+ double lat=0,lon=0,distance=0,duration=0,limit;
+ int *order1,*order2;
+ int arg,i,j,errors=0;
+
+ for(arg=1;arg<argc;arg++)
+   {
+    if(!strncmp(argv[arg],"--dir=",6))
+       dirname=&argv[arg][6];
+    else if(!strncmp(argv[arg],"--prefix=",9))
+       prefix=&argv[arg][9];
+    else if(!strncmp(argv[arg],"--profiles=",11))
+       profiles=&argv[arg][11];
+    else if(!strncmp(argv[arg],"--profile=",10))
+       profilename=&argv[arg][10];
+    else if(!strncmp(argv[arg],"--lat=",6))
+       lat=atof(&argv[arg][6]);
+    else if(!strncmp(argv[arg],"--lon=",6))
+       lon=atof(&argv[arg][6]);
+    else if(!strncmp(argv[arg],"--distance=",11))
+       distance=atof(&argv[arg][11]);
+    else if(!strncmp(argv[arg],"--duration=",11))
+       duration=atof(&argv[arg][11]);
+    else
+       break;
+   }
+
+ if(arg<argc || !profiles || (distance<=0 && duration<=0))
+   {
+    fprintf(stderr,"Usage: isochrone-test [--dir=<dirname>] [--prefix=<name>] --profiles=<filename> [--profile=<name>]\n"
+                   "                      --lat=<latitude> --lon=<longitude> --distance=<km> | --duration=<minutes>\n");
+    exit(EXIT_FAILURE);
+   }
+
+ /* Load the database and profile and find the waypoint */
+
+ database=Routino_LoadDatabase(dirname,prefix);
+
+ if(!database)
+   {
+    fprintf(stderr,"Error: Cannot load the database (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ if(Routino_ParseXMLProfiles(profiles))
+   {
+    fprintf(stderr,"Error: Cannot read the profiles in the file '%s'.\n",profiles);
+    exit(EXIT_FAILURE);
+   }
+
+ profile=Routino_GetProfile(profilename);
+
+ if(!profile || Routino_ValidateProfile(database,profile)!=ROUTINO_ERROR_NONE)
+   {
+    fprintf(stderr,"Error: Profile '%s' is invalid or not compatible with database.\n",profilename);
+    exit(EXIT_FAILURE);
+   }
+
+ waypoint=Routino_FindWaypoint(database,profile,lat,lon);
+
+ if(!waypoint)
+   {
+    fprintf(stderr,"Error: Cannot find a node close to the waypoint.\n");
+    exit(EXIT_FAILURE);
+   }
+
+ /* Calculate the isochrones */
+
+ isochrone1=Routino_CalculateIsochrone(database,profile,waypoint,distance,duration);
+ isochrone2=Routino_CalculateIsochrone(database,profile,waypoint,2*distance,2*duration);
+
+ if(!isochrone1 || !isochrone2 || isochrone1->npoints==0)
+   {
+    fprintf(stderr,"Error: Cannot calculate the isochrone (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ limit=duration>0?duration:distance;
+
+ order1=sort_isochrone(isochrone1);
+ order2=sort_isochrone(isochrone2);
+
+ /* Check the smaller isochrone against the larger one */
+
+ for(i=0,j=0;j<isochrone2->npoints;j++)
+   {
+    int p2=order2[j];
+
+    if(isochrone2->value[p2]>limit)
+       continue;
+
+    if(i<isochrone1->npoints)
+      {
+       int p1=order1[i];
+
+       if(isochrone1->lat[p1]==isochrone2->lat[p2] && isochrone1->lon[p1]==isochrone2->lon[p2])
+         {
+          if(isochrone1->value[p1]!=isochrone2->value[p2])
+            {
+             fprintf(stderr,"Error: Different values %f and %f for the node at %.6f %.6f.\n",
+                     isochrone1->value[p1],isochrone2->value[p2],isochrone2->lat[p2]*180/M_PI,isochrone2->lon[p2]*180/M_PI);
+             errors++;
+            }
+
+          i++;
+          continue;
+         }
+      }
+
+    fprintf(stderr,"Error: The node at %.6f %.6f is missing from the smaller isochrone.\n",
+            isochrone2->lat[p2]*180/M_PI,isochrone2->lon[p2]*180/M_PI);
+    errors++;
+   }
+
+ if(i!=isochrone1->npoints)
+   {
+    fprintf(stderr,"Error: The smaller isochrone has %d nodes that are not in the larger one.\n",isochrone1->npoints-i);
+    errors++;
+   }
+
+ /* Print the smaller isochrone */
+
+ for(i=0;i<isochrone1->npoints;i++)
+    printf("%11.6f %11.6f %9.4f\n",isochrone1->lat[order1[i]]*180/M_PI,isochrone1->lon[order1[i]]*180/M_PI,isochrone1->value[order1[i]]);
+
+ /* Tidy up and exit */
+
+ free(order1);
+ free(order2);
+
+ Routino_DeleteIsochrone(isochrone1);
+ Routino_DeleteIsochrone(isochrone2);
+
+ free(waypoint);
+
+ Routino_UnloadDatabase(database);
+
+ Routino_FreeXMLProfiles();
+
+ if(errors)
+    exit(EXIT_FAILURE);
+
+ exit(EXIT_SUCCESS);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Sort the points in an isochrone into latitude and longitude order.
+
+  int *sort_isochrone Returns an allocated array of the point indexes in sorted order.
+
+  Routino_Isochrone *isochrone The isochrone to sort.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int *sort_isochrone(Routino_Isochrone *isochrone)
+{
+ int *order=(int*)malloc((isochrone->npoints+1)*sizeof(int));
+ int i;
+
+ for(i=0;i<isochrone->npoints;i++)
+    order[i]=i;
+
+ sorting_isochrone=isochrone;
+
+ qsort(order,isochrone->npoints,sizeof(int),compare_points);
+
+ return(order);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Compare two isochrone points by latitude and then longitude.
+
+  int compare_points Returns the comparison of the points.
+
+  const void *a The index of the first point.
+
+  const void *b The index of the second point.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int compare_points(const void *a,const void *b)
+{
+ int pa=*(const int*)a;
+ int pb=*(const int*)b;
+
+ if(sorting_isochrone->lat[pa]<sorting_isochrone->lat[pb])
+    return(-1);
+ else if(sorting_isochrone->lat[pa]>sorting_isochrone->lat[pb])
+    return(1);
+ else if(sorting_isochrone->lon[pa]<sorting_isochrone->lon[pb])
+    return(-1);
+ else if(sorting_isochrone->lon[pa]>sorting_isochrone->lon[pb])
+    return(1);
+ else
+    return(0);
+}
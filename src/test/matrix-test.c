@@ -0,0 +1,216 @@
+/***************************************
+ Test the matrix function in the libroutino library.
+
+ Part of the Routino routing software.
+ ******************/ /******************
+ This file Copyright 2017 Andrew M. Bishop
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ***************************************/
+
+
+/* The matrix of distances and durations is calculated between every pair of
+   waypoints.  Each cell must be the same as the distance and duration of the
+   route calculated separately between the same two waypoints (or both must
+   fail).  The matrix is printed so that it can be compared with other
+   versions of the library. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "routino.h"
+
+
+/*+ The maximum number of waypoints. +*/
+#define NWAYPOINTS 99
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  The main program for the matrix test.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int main(int argc,char** argv)
+{
+ Routino_Database    *database;
+ Routino_Profile     *profile;
+ Routino_Translation *translation;
+ Routino_Context     *context;
+ Routino_Matrix      *matrix;
+ Routino_Waypoint    *waypoints[NWAYPOINTS];
+ const char *dirname=NULL,*prefix=NULL,*profiles=NULL,*translations=NULL,*profilename="motorcar";
+ double lat[NWAYPOINTS+1],lon[NWAYPOINTS+1];
+ int quickest=0,nwaypoints=0;
+ int arg,i,j,errors=0;
+
+ for(arg=1;arg<argc;arg++)
+   {
+    int n;
+
+    if(!strncmp(argv[arg],"--dir=",6))
+       dirname=&argv[arg][6];
+    else if(!strncmp(argv[arg],"--prefix=",9))
+       prefix=&argv[arg][9];
+    else if(!strncmp(argv[arg],"--profiles=",11))
+       profiles=&argv[arg][11];
+    else if(!strncmp(argv[arg],"--translations=",15))
+       translations=&argv[arg][15];
+    else if(!strncmp(argv[arg],"--profile=",10))
+       profilename=&argv[arg][10];
+    else if(!strcmp(argv[arg],"--shortest"))
+       quickest=0;
+    else if(!strcmp(argv[arg],"--quickest"))
+       quickest=1;
+    else if(sscanf(argv[arg],"--lat%d=",&n)==1 && n>=1 && n<=NWAYPOINTS)
+      {
+       lat[n]=atof(strchr(argv[arg],'=')+1);
+       if(n>nwaypoints) nwaypoints=n;
+      }
+    else if(sscanf(argv[arg],"--lon%d=",&n)==1 && n>=1 && n<=NWAYPOINTS)
+      {
+       lon[n]=atof(strchr(argv[arg],'=')+1);
+       if(n>nwaypoints) nwaypoints=n;
+      }
+    else
+       break;
+   }
+
+ if(arg<argc || !profiles || !translations || nwaypoints<2)
+   {
+    fprintf(stderr,"Usage: matrix-test [--dir=<dirname>] [--prefix=<name>]\n"
+                   "                   --profiles=<filename> --translations=<filename> [--profile=<name>]\n"
+                   "                   [--shortest | --quickest]\n"
+                   "                   --lat1=<latitude> --lon1=<longitude> --lat2=<latitude> --lon2=<longitude> ...\n");
+    exit(EXIT_FAILURE);
+   }
+
+ /* Load the database, profile and translation and find the waypoints */
+
+ database=Routino_LoadDatabase(dirname,prefix);
+
+ if(!database)
+   {
+    fprintf(stderr,"Error: Cannot load the database (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ if(Routino_ParseXMLProfiles(profiles))
+   {
+    fprintf(stderr,"Error: Cannot read the profiles in the file '%s'.\n",profiles);
+    exit(EXIT_FAILURE);
+   }
+
+ if(Routino_ParseXMLTranslations(translations))
+   {
+    fprintf(stderr,"Error: Cannot read the translations in the file '%s'.\n",translations);
+    exit(EXIT_FAILURE);
+   }
+
+ profile=Routino_GetProfile(profilename);
+ translation=Routino_GetTranslation("");
+
+ if(!profile || !translation || Routino_ValidateProfile(database,profile)!=ROUTINO_ERROR_NONE)
+   {
+    fprintf(stderr,"Error: Profile '%s' is invalid or not compatible with database.\n",profilename);
+    exit(EXIT_FAILURE);
+   }
+
+ for(i=0;i<nwaypoints;i++)
+    if(!(waypoints[i]=Routino_FindWaypoint(database,profile,lat[i+1],lon[i+1])))
+      {
+       fprintf(stderr,"Error: Cannot find a node close to waypoint %d.\n",i+1);
+       exit(EXIT_FAILURE);
+      }
+
+ context=Routino_CreateContext(database);
+
+ /* Calculate the matrix */
+
+ matrix=Routino_CalculateMatrixContext(context,profile,waypoints,nwaypoints,waypoints,nwaypoints,
+                                       quickest?ROUTINO_ROUTE_QUICKEST:ROUTINO_ROUTE_SHORTEST,NULL);
+
+ if(!matrix)
+   {
+    fprintf(stderr,"Error: Cannot calculate the matrix (error %d).\n",Routino_ContextErrno(context));
+    exit(EXIT_FAILURE);
+   }
+
+ /* Check each cell of the matrix against a separate route */
+
+ for(i=0;i<nwaypoints;i++)
+    for(j=0;j<nwaypoints;j++)
+      {
+       Routino_Waypoint *route_waypoints[2];
+       Routino_Output *route,*last;
+       float dist=-1,time=-1;
+       int n=i*nwaypoints+j;
+
+       if(i==j)
+          continue;
+
+       route_waypoints[0]=waypoints[i];
+       route_waypoints[1]=waypoints[j];
+
+       route=Routino_CalculateRouteContext(context,profile,translation,route_waypoints,2,
+                                           (quickest?ROUTINO_ROUTE_QUICKEST:ROUTINO_ROUTE_SHORTEST)|ROUTINO_ROUTE_LIST_HTML,NULL);
+
+       if(route)
+         {
+          for(last=route;last->next;last=last->next)
+             ;
+
+          dist=last->dist;
+          time=last->time;
+
+          Routino_DeleteRoute(route);
+         }
+
+       if(dist!=matrix->dist[n] || time!=matrix->time[n])
+         {
+          fprintf(stderr,"Error: The matrix from waypoint %d to %d is %.4f km, %.4f min but the route is %.4f km, %.4f min.\n",
+                  i+1,j+1,matrix->dist[n],matrix->time[n],dist,time);
+          errors++;
+         }
+      }
+
+ /* Print the matrix */
+
+ for(i=0;i<nwaypoints;i++)
+   {
+    for(j=0;j<nwaypoints;j++)
+       printf("%s%.4f,%.4f",j?" ":"",matrix->dist[i*nwaypoints+j],matrix->time[i*nwaypoints+j]);
+
+    printf("\n");
+   }
+
+ /* Tidy up and exit */
+
+ Routino_DeleteMatrix(matrix);
+
+ Routino_DeleteContext(context);
+
+ for(i=0;i<nwaypoints;i++)
+    free(waypoints[i]);
+
+ Routino_UnloadDatabase(database);
+
+ Routino_FreeXMLProfiles();
+ Routino_FreeXMLTranslations();
+
+ if(errors)
+    exit(EXIT_FAILURE);
+
+ exit(EXIT_SUCCESS);
+}
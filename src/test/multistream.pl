@@ -0,0 +1,86 @@
+#!/usr/bin/perl
+#
+# Multiple stream bzip2 test file generator tool.
+#
+# Part of the Routino routing software.
+#
+# This file Copyright 2011-2014 Andrew M. Bishop
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+use strict;
+
+use IO::Compress::Bzip2 qw(bzip2 $Bzip2Error);
+
+# Command line
+
+if($#ARGV!=2 || ! -f $ARGV[0] || $ARGV[1]!~/^[0-3]$/)
+  {
+   die "Usage: multistream.pl <filename.osm> <0-3> <filename.osm.bz2>\n";
+  }
+
+my($infile,$offset,$outfile)=@ARGV;
+
+# The uncompressor reads the file in pieces of this size
+
+my $boundary=256*1024;
+
+# An empty bzip2 stream (header, end of stream magic number, CRC)
+
+my $empty="BZh9\x17\x72\x45\x38\x50\x90\x00\x00\x00\x00";
+
+# Read in the data
+
+open(FILE,"<$infile") || die "Cannot open '$infile'\n";
+
+my $data=do { local $/; <FILE> };
+
+close(FILE);
+
+# Add whitespace to the end of the data until the compressed data is the
+# right length for one of the empty streams that follow it to have the end
+# of stream magic number end $offset bytes before the boundary (with the
+# stream CRC after the boundary).
+
+my $extra="";
+my $seed=1;
+
+while(length($extra)<10000)
+  {
+   my $compressed;
+
+   bzip2 \($data.$extra) => \$compressed, BlockSize100K => 9 or die "Cannot compress the data: $Bzip2Error\n";
+
+   my $length=length($compressed);
+
+   if((($boundary-$offset-10-$length)%14)==0)
+     {
+      open(FILE,">$outfile") || die "Cannot open '$outfile'\n";
+
+      print FILE $compressed;
+
+      print FILE $empty x (($boundary-$offset-10-$length)/14+2);
+
+      close(FILE);
+
+      exit 0;
+     }
+
+   $seed=($seed*1103515245+12345)%2147483648;
+
+   $extra.=(" ","\n","\t")[int($seed/65536)%3];
+  }
+
+die "Cannot create the file\n";
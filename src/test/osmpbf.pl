@@ -0,0 +1,271 @@
+#!/usr/bin/perl
+#
+# PBF format test file generator tool.
+#
+# Part of the Routino routing software.
+#
+# This file Copyright 2017 Andrew M. Bishop
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+
+use strict;
+
+use Compress::Zlib;
+
+# Command line
+
+if($#ARGV!=1 || ! -f $ARGV[0])
+  {
+   die "Usage: osmpbf.pl <filename.osm> <filename.osm.pbf>\n";
+  }
+
+my($infile,$outfile)=@ARGV;
+
+# The nodes, ways and relations are split into blocks of this many items so
+# that there are several blocks to decode
+
+my $blocksize=8000;
+
+# Protocol buffer encoding functions
+
+sub varint
+{
+ my($n)=@_;
+ my $bytes="";
+
+ while($n>=128)
+   {
+    $bytes.=chr(($n&127)|128);
+    $n>>=7;
+   }
+
+ return $bytes.chr($n);
+}
+
+sub zigzag
+{
+ my($n)=@_;
+
+ return ($n<0 ? -2*$n-1 : 2*$n);
+}
+
+sub field_varint
+{
+ my($field,$n)=@_;
+
+ return varint($field<<3).varint($n);
+}
+
+sub field_bytes
+{
+ my($field,$bytes)=@_;
+
+ return varint(($field<<3)|2).varint(length($bytes)).$bytes;
+}
+
+sub packed
+{
+ my($field,@values)=@_;
+
+ return field_bytes($field,join("",map { varint($_) } @values));
+}
+
+sub packed_delta
+{
+ my($field,@values)=@_;
+ my($previous,$bytes)=(0,"");
+
+ foreach my $value (@values)
+   {
+    $bytes.=varint(zigzag($value-$previous));
+    $previous=$value;
+   }
+
+ return field_bytes($field,$bytes);
+}
+
+sub unescape
+{
+ my($string)=@_;
+
+ $string=~s/&lt;/</g;
+ $string=~s/&gt;/>/g;
+ $string=~s/&quot;/"/g;
+ $string=~s/&apos;/'/g;
+ $string=~s/&amp;/&/g;
+
+ return $string;
+}
+
+sub attribute
+{
+ my($line,$name)=@_;
+
+ return unescape($1) if($line=~/ $name=['"]([^'"]*)['"]/);
+
+ return undef;
+}
+
+# Read in the data (one XML element per line)
+
+my(@nodes,@ways,@relations);
+my $item;
+
+open(FILE,"<$infile") || die "Cannot open '$infile'\n";
+
+while(<FILE>)
+  {
+   if(/<node /)
+     {
+      my($lat,$lon)=(attribute($_,"lat"),attribute($_,"lon"));
+
+      $item={id => attribute($_,"id"), lat => sprintf("%.0f",$lat*1E7), lon => sprintf("%.0f",$lon*1E7), tags => []};
+      push(@nodes,$item);
+     }
+   elsif(/<way /)
+     {
+      $item={id => attribute($_,"id"), refs => [], tags => []};
+      push(@ways,$item);
+     }
+   elsif(/<relation /)
+     {
+      $item={id => attribute($_,"id"), members => [], tags => []};
+      push(@relations,$item);
+     }
+   elsif(/<nd /)
+     {
+      push(@{$item->{refs}},attribute($_,"ref"));
+     }
+   elsif(/<member /)
+     {
+      push(@{$item->{members}},[attribute($_,"type"),attribute($_,"ref"),attribute($_,"role")]);
+     }
+   elsif(/<tag /)
+     {
+      push(@{$item->{tags}},[attribute($_,"k"),attribute($_,"v")]);
+     }
+  }
+
+close(FILE);
+
+# Write a Blob (with its BlobHeader) containing compressed data
+
+sub write_blob
+{
+ my($type,$data)=@_;
+
+ my $blob=field_varint(2,length($data)).field_bytes(3,compress($data));
+
+ my $header=field_bytes(1,$type).field_varint(3,length($blob));
+
+ print FILE pack("N",length($header)),$header,$blob;
+}
+
+# Write a PrimitiveBlock with a string table and one PrimitiveGroup
+
+my(%strings,@strings);
+
+sub string
+{
+ my($string)=@_;
+
+ if(!defined $strings{$string})
+   {
+    $strings{$string}=$#strings+1;
+    push(@strings,$string);
+   }
+
+ return $strings{$string};
+}
+
+sub write_block
+{
+ my($group)=@_;
+
+ my $table=join("",map { field_bytes(1,$_) } @strings);
+
+ write_blob("OSMData",field_bytes(1,$table).field_bytes(2,$group));
+
+ %strings=();
+ @strings=();
+}
+
+open(FILE,">$outfile") || die "Cannot open '$outfile'\n";
+
+binmode(FILE);
+
+write_blob("OSMHeader",field_bytes(4,"OsmSchema-V0.6").field_bytes(4,"DenseNodes"));
+
+for(my $first=0;$first<=$#nodes;$first+=$blocksize)
+  {
+   my @block=@nodes[$first..($first+$blocksize-1<$#nodes?$first+$blocksize-1:$#nodes)];
+
+   string("");
+
+   my @keys_vals=map { ((map { (string($_->[0]),string($_->[1])) } @{$_->{tags}}),0) } @block;
+
+   my $dense=packed_delta(1,map { $_->{id} } @block).
+             packed_delta(8,map { $_->{lat} } @block).
+             packed_delta(9,map { $_->{lon} } @block).
+             packed(10,@keys_vals);
+
+   write_block(field_bytes(2,$dense));
+  }
+
+for(my $first=0;$first<=$#ways;$first+=$blocksize)
+  {
+   my $group="";
+
+   string("");
+
+   foreach my $way (@ways[$first..($first+$blocksize-1<$#ways?$first+$blocksize-1:$#ways)])
+     {
+      my $message=field_varint(1,$way->{id}).
+                  packed(2,map { string($_->[0]) } @{$way->{tags}}).
+                  packed(3,map { string($_->[1]) } @{$way->{tags}}).
+                  packed_delta(8,@{$way->{refs}});
+
+      $group.=field_bytes(3,$message);
+     }
+
+   write_block($group);
+  }
+
+my %types=(node => 0, way => 1, relation => 2);
+
+for(my $first=0;$first<=$#relations;$first+=$blocksize)
+  {
+   my $group="";
+
+   string("");
+
+   foreach my $relation (@relations[$first..($first+$blocksize-1<$#relations?$first+$blocksize-1:$#relations)])
+     {
+      my $message=field_varint(1,$relation->{id}).
+                  packed(2,map { string($_->[0]) } @{$relation->{tags}}).
+                  packed(3,map { string($_->[1]) } @{$relation->{tags}}).
+                  packed(8,map { string($_->[2]) } @{$relation->{members}}).
+                  packed_delta(9,map { $_->[1] } @{$relation->{members}}).
+                  packed(10,map { $types{$_->[0]} } @{$relation->{members}});
+
+      $group.=field_bytes(4,$message);
+     }
+
+   write_block($group);
+  }
+
+close(FILE);
+
+exit 0;
@@ -0,0 +1,293 @@
+/***************************************
+ Benchmark the priority queue implementations in queue.c.
+
+ Part of the Routino routing software.
+ ******************/ /******************
+ This file Copyright 2017 Andrew M. Bishop
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ***************************************/
+
+
+/* The operations that are timed are either read from a trace file or
+   generated by a shortest path search on a grid of nodes.  A trace file can
+   be recorded by compiling the router with -DQUEUE_TRACE=1 and saving the
+   output that it writes to stderr. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "types.h"
+#include "results.h"
+
+
+/* A single queue operation */
+
+typedef struct _Operation
+{
+ char    type;                  /* 'N' for a new queue, 'I' to insert, 'P' to pop. */
+ index_t node;                  /* The node of the result to insert. */
+ index_t segment;               /* The segment of the result to insert. */
+ score_t score;                 /* The score of the result to insert. */
+}
+ Operation;
+
+
+/* Local functions */
+
+static void add_operation(char type,index_t node,index_t segment,score_t score);
+static void read_trace(const char *filename);
+static void generate_trace(int size);
+static double replay_trace(void);
+
+
+/* Local variables */
+
+static Operation *operations=NULL;
+static size_t noperations=0,nallocated=0;
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  The main program for the queue benchmark.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int main(int argc,char** argv)
+{
+ int arg,repeat=10,size=500,i;
+ const char *filename=NULL;
+ double best=0;
+ size_t npops=0;
+
+ for(arg=1;arg<argc;arg++)
+   {
+    if(!strncmp(argv[arg],"--repeat=",9))
+       repeat=atoi(&argv[arg][9]);
+    else if(!strncmp(argv[arg],"--size=",7))
+       size=atoi(&argv[arg][7]);
+    else if(argv[arg][0]=='-')
+      {
+       fprintf(stderr,"Usage: queue-benchmark [--repeat=<number>] [--size=<grid-size>] [<trace-file>]\n");
+       exit(EXIT_FAILURE);
+      }
+    else
+       filename=argv[arg];
+   }
+
+ if(filename)
+    read_trace(filename);
+ else
+    generate_trace(size);
+
+ for(i=0;i<(int)noperations;i++)
+    if(operations[i].type=='P')
+       npops++;
+
+ for(i=0;i<repeat;i++)
+   {
+    double time=replay_trace();
+
+    if(i==0 || time<best)
+       best=time;
+   }
+
+ printf("%-24s %10lu operations %10lu pops %9.3f ms\n",argv[0],(unsigned long)noperations,(unsigned long)npops,best*1000);
+
+ exit(EXIT_SUCCESS);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Add an operation to the list.
+
+  char type The type of operation.
+
+  index_t node The node of the result.
+
+  index_t segment The segment of the result.
+
+  score_t score The score of the result.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void add_operation(char type,index_t node,index_t segment,score_t score)
+{
+ if(noperations==nallocated)
+   {
+    nallocated+=1024*1024;
+    operations=(Operation*)realloc(operations,nallocated*sizeof(Operation));
+   }
+
+ operations[noperations].type=type;
+ operations[noperations].node=node;
+ operations[noperations].segment=segment;
+ operations[noperations].score=score;
+
+ noperations++;
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Read the operations from a trace file.
+
+  const char *filename The name of the file.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void read_trace(const char *filename)
+{
+ FILE *file;
+ char line[256];
+
+ file=fopen(filename,"r");
+
+ if(!file)
+   {
+    fprintf(stderr,"Cannot open the trace file '%s'.\n",filename);
+    exit(EXIT_FAILURE);
+   }
+
+ while(fgets(line,sizeof(line),file))
+   {
+    unsigned long node,segment;
+    double score;
+
+    if(line[0]=='N' || line[0]=='P')
+       add_operation(line[0],0,0,0);
+    else if(sscanf(line,"I %lu %lu %lf",&node,&segment,&score)==3)
+       add_operation('I',(index_t)node,(index_t)segment,(score_t)score);
+   }
+
+ fclose(file);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Generate the operations for some shortest path searches on a square grid of nodes with random lengths between them.
+
+  int size The number of nodes along each side of the grid.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void generate_trace(int size)
+{
+ index_t nnodes=(index_t)size*size;
+ score_t *weights=(score_t*)malloc(2*nnodes*sizeof(score_t));
+ index_t i,start;
+
+ srand(1);
+
+ for(i=0;i<2*nnodes;i++)
+    weights[i]=(score_t)(1+rand()%1000)/100;
+
+ for(start=0;start<nnodes;start+=nnodes/4+1)
+   {
+    Results *results=NewResultsList(8);
+    Queue *queue=NewQueueList(8);
+    Result *result1;
+
+    add_operation('N',0,0,0);
+
+    result1=InsertResult(results,start,NO_SEGMENT);
+
+    InsertInQueue(queue,result1,0);
+    add_operation('I',start,NO_SEGMENT,0);
+
+    while((result1=PopFromQueue(queue)))
+      {
+       index_t node1=result1->node,x=node1%size,y=node1/size,edge=size-1;
+       index_t others[4];
+       score_t lengths[4];
+       int n=0,j;
+
+       add_operation('P',0,0,0);
+
+       if(x>0)    {others[n]=node1-1;    lengths[n++]=weights[2*(node1-1)];}
+       if(x<edge) {others[n]=node1+1;    lengths[n++]=weights[2*node1];}
+       if(y>0)    {others[n]=node1-size; lengths[n++]=weights[2*(node1-size)+1];}
+       if(y<edge) {others[n]=node1+size; lengths[n++]=weights[2*node1+1];}
+
+       for(j=0;j<n;j++)
+         {
+          score_t score=result1->score+lengths[j];
+          Result *result2=FindResult(results,others[j],0);
+
+          if(!result2)
+             result2=InsertResult(results,others[j],0);
+          else if(score>=result2->score)
+             continue;
+
+          result2->score=score;
+
+          InsertInQueue(queue,result2,score);
+          add_operation('I',others[j],0,score);
+         }
+      }
+
+    FreeQueueList(queue);
+    FreeResultsList(results);
+   }
+
+ free(weights);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Replay the operations and time them.
+
+  double replay_trace Returns the time taken in seconds.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static double replay_trace(void)
+{
+ Results *results=NULL;
+ Queue *queue=NULL;
+ clock_t start=clock();
+ size_t i;
+
+ for(i=0;i<noperations;i++)
+   {
+    Operation *operation=&operations[i];
+
+    if(operation->type=='N')
+      {
+       if(queue)
+         {
+          FreeQueueList(queue);
+          FreeResultsList(results);
+         }
+
+       results=NewResultsList(8);
+       queue=NewQueueList(8);
+      }
+    else if(operation->type=='I')
+      {
+       Result *result=FindResult(results,operation->node,operation->segment);
+
+       if(!result)
+          result=InsertResult(results,operation->node,operation->segment);
+
+       InsertInQueue(queue,result,operation->score);
+      }
+    else /* if(operation->type=='P') */
+       PopFromQueue(queue);
+   }
+
+ if(queue)
+   {
+    FreeQueueList(queue);
+    FreeResultsList(results);
+   }
+
+ return((double)(clock()-start)/CLOCKS_PER_SEC);
+}
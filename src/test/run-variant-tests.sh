@@ -0,0 +1,678 @@
+#!/bin/sh
+
+# Tests that process the test cases in a different way (input format or
+# program options) and check that the results are identical to the normal
+# way.  The same executables are used for both so any difference is a
+# failure (even when compiled with -ffast-math).
+
+# Run with a debugger or not?
+
+debugger=valgrind
+debugger=
+
+# Use the libroutino libraries in the parent directory
+
+LD_LIBRARY_PATH=$PWD/..:$LD_LIBRARY_PATH
+export LD_LIBRARY_PATH
+
+# Overall status
+
+status=true
+
+# Functions for running tests
+
+run_a_test ()
+{
+    test=$1
+    shift
+
+    if $test $@ ; then
+        echo "... passed"
+    else
+        echo "... FAILED"
+        status=false
+    fi
+}
+
+# Functions for the common parts of the tests
+
+run_planetsplitter ()
+{
+    outdir=$1
+    shift
+
+    [ -d $outdir ] || mkdir -p $outdir
+
+    echo ../planetsplitter$slim --dir=$outdir $option_planetsplitter $@ >> $log
+    $debugger ../planetsplitter$slim --dir=$outdir $option_planetsplitter $@ >> $log 2>&1
+}
+
+planetsplitter_has_option ()
+{
+    ../planetsplitter$slim --help 2>&1 | grep -q -e "$1"
+}
+
+make_normal_database ()
+{
+    name=$1
+    file=${2:-$name.osm}
+
+    [ -f $dir/normal/$name-nodes.mem ] || run_planetsplitter $dir/normal --prefix=$name $file
+}
+
+make_grid ()
+{
+    [ -f $dir/grid.osm ] || perl grid.pl 200 $dir/grid.osm
+}
+
+compare_databases ()
+{
+    for file in nodes segments ways relations; do
+        echo cmp $1/$3-$file.mem $2/$3-$file.mem >> $log
+        cmp $1/$3-$file.mem $2/$3-$file.mem >> $log 2>&1 || return 1
+    done
+}
+
+list_waypoints ()
+{
+    osm=$1
+    list=$2
+
+    if [ ! -f $list ]; then
+        for waypoint in `perl waypoints.pl $osm list`; do
+            echo $waypoint `perl waypoints.pl $osm $waypoint X` >> $list || return 1
+        done
+    fi
+}
+
+run_routes ()
+{
+    dbdir=$1
+    prefix=$2
+    osm=$3
+    outdir=$4
+    shift 4
+
+    name=`basename $osm .osm`
+
+    [ -d $outdir ] || mkdir -p $outdir
+
+    list_waypoints $osm $dir/$name-waypoints.txt || return 1
+
+    previous=""
+
+    while read waypoint position; do
+
+        if [ "$previous" ]; then
+
+            waypoint_a=`echo $previous_position | sed -e 's/X=/1=/g'`
+            waypoint_b=`echo $position | sed -e 's/X=/2=/g'`
+
+            for route in shortest quickest; do
+
+                output=$outdir/$name-$previous-$waypoint-$route.txt
+
+                echo ../$router$slim --dir=$dbdir --prefix=$prefix $option_router --$route $waypoint_a $waypoint_b $@ >> $log
+                $debugger ../$router$slim --dir=$dbdir --prefix=$prefix $option_router --$route $waypoint_a $waypoint_b $@ < /dev/null > $output 2>> $log || echo "No route" > $output
+            done
+        fi
+
+        previous=$waypoint
+        previous_position=$position
+
+    done < $dir/$name-waypoints.txt
+}
+
+compare_routes ()
+{
+    echo diff -r $1 $2 >> $log
+    diff -r $1 $2 >> $log 2>&1
+}
+
+
+# Multiple stream bzip2 file with the end of an empty stream at each position
+# around the boundary between two pieces of data read from the file.
+
+test_bzip2_multistream ()
+{
+    make_normal_database loops || return 1
+
+    for offset in 0 1 2 3; do
+
+        perl multistream.pl loops.osm $offset $dir/loops-$offset.osm.bz2 || return 1
+
+        run_planetsplitter $dir/multistream-$offset --prefix=loops $dir/loops-$offset.osm.bz2 || return 1
+
+        compare_databases $dir/normal $dir/multistream-$offset loops || return 1
+    done
+}
+
+
+# Sorting with too little RAM for the data so that temporary files are
+# written and merged, using one or several threads, compressed temporary
+# files and asynchronous I/O.
+
+test_sort_temporary_files ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    # The threaded variants can only be used when compiled with pthreads
+
+    variants=1
+
+    planetsplitter_has_option --sort-threads && variants="$variants 2"
+    planetsplitter_has_option --async-io     && variants="$variants 3"
+
+    for variant in $variants; do
+
+        case $variant in
+            1) options="--sort-ram-size=1" ;;
+            2) options="--sort-ram-size=1 --sort-threads=4" ;;
+            3) options="--sort-ram-size=1 --sort-threads=4 --sort-compress --async-io" ;;
+        esac
+
+        run_planetsplitter $dir/sort-$variant --prefix=grid $options $dir/grid.osm || return 1
+
+        compare_databases $dir/normal $dir/sort-$variant grid || return 1
+    done
+}
+
+
+# PBF format file with several blocks of nodes and ways (with coordinates
+# that are exact in both formats) decoded by one or several threads.
+
+test_pbf_parse_threads ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    [ -f $dir/grid.osm.pbf ] || perl osmpbf.pl $dir/grid.osm $dir/grid.osm.pbf || return 1
+
+    # The threaded variants can only be used when compiled with pthreads
+
+    if planetsplitter_has_option --parse-threads; then
+        variants="1 4"
+    else
+        variants="0"
+    fi
+
+    for threads in $variants; do
+
+        case $threads in
+            0) options="" ;;
+            *) options="--parse-threads=$threads" ;;
+        esac
+
+        run_planetsplitter $dir/pbf-$threads --prefix=grid $options $dir/grid.osm.pbf || return 1
+
+        compare_databases $dir/normal $dir/pbf-$threads grid || return 1
+    done
+}
+
+
+# Isochrones by distance and by journey time from the middle of the grid,
+# the test program checks that the nodes reached within a limit are the same
+# as the nodes within that limit when it is doubled.  The slim and non-slim
+# libraries must give the same isochrones.
+
+run_isochrone ()
+{
+    output=$1
+    shift
+
+    echo ./isochrone-test$slim --dir=$dir/normal --prefix=grid $option_isochrone $@ >> $log
+    $debugger ./isochrone-test$slim --dir=$dir/normal --prefix=grid $option_isochrone $@ > $dir/$output 2>> $log || return 1
+
+    if [ "$slim" ]; then
+        echo cmp fat-variants/$output $dir/$output >> $log
+        cmp fat-variants/$output $dir/$output >> $log 2>&1 || return 1
+    fi
+}
+
+test_isochrone ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    run_isochrone isochrone-distance.txt --distance=1.5 || return 1
+
+    run_isochrone isochrone-duration.txt --duration=2 || return 1
+}
+
+
+# Matrices of routes between the waypoints of the routing test cases and
+# between some of the waypoints in the grid, the test program checks that
+# each distance and duration is the same as a route calculated separately.
+# The slim and non-slim libraries must give the same matrices.
+
+run_matrix ()
+{
+    name=$1
+    osm=$2
+    count=$3
+
+    list_waypoints $osm $dir/$name-waypoints.txt || return 1
+
+    waypoints=`head -$count $dir/$name-waypoints.txt | awk '{n++; lat=$2; lon=$3; sub("X=",n"=",lat); sub("X=",n"=",lon); print lat, lon}'`
+
+    for route in shortest quickest; do
+
+        output=matrix-$name-$route.txt
+
+        echo ./matrix-test$slim --dir=$dir/normal --prefix=$name $option_matrix --$route $waypoints >> $log
+        $debugger ./matrix-test$slim --dir=$dir/normal --prefix=$name $option_matrix --$route $waypoints > $dir/$output 2>> $log || return 1
+
+        if [ "$slim" ]; then
+            echo cmp fat-variants/$output $dir/$output >> $log
+            cmp fat-variants/$output $dir/$output >> $log 2>&1 || return 1
+        fi
+    done
+}
+
+test_matrix ()
+{
+    for osm in $route_tests; do
+
+        name=`basename $osm .osm`
+
+        make_normal_database $name || return 1
+
+        run_matrix $name $osm 99 || return 1
+    done
+
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    run_matrix grid $dir/grid.osm 6
+}
+
+
+# Routes within one part of a database that has two unconnected parts, the
+# loops test case and the grid.  The routes must be the same as with a
+# database of only the loops test case (apart from the node numbers) and a
+# route between the two parts must be rejected without searching.
+
+test_components ()
+{
+    make_grid || return 1
+
+    make_normal_database loops || return 1
+
+    run_planetsplitter $dir/components --prefix=combined loops.osm $dir/grid.osm || return 1
+
+    run_routes $dir/normal loops loops.osm $dir/components-normal || return 1
+
+    run_routes $dir/components combined loops.osm $dir/components-combined || return 1
+
+    for file in `cd $dir/components-normal && echo *.txt`; do
+        cut -f1-2,4- $dir/components-normal/$file   > $dir/components-normal/$file.cut
+        cut -f1-2,4- $dir/components-combined/$file > $dir/components-combined/$file.cut
+
+        echo cmp $dir/components-normal/$file.cut $dir/components-combined/$file.cut >> $log
+        cmp $dir/components-normal/$file.cut $dir/components-combined/$file.cut >> $log 2>&1 || return 1
+    done
+
+    waypoint_a=`perl waypoints.pl loops.osm WPstart 1`
+
+    echo ../router$slim --dir=$dir/components --prefix=combined $option_router $waypoint_a --lat2=-0.25 --lon2=-0.45 >> $log
+    $debugger ../router$slim --dir=$dir/components --prefix=combined $option_router $waypoint_a --lat2=-0.25 --lon2=-0.45 > /dev/null 2> $dir/components.err && return 1
+
+    cat $dir/components.err >> $log
+
+    grep -q "are not connected" $dir/components.err
+}
+
+
+# Routes with a second level of super-nodes, the routes must be the same as
+# with one level.  The grid is processed with one iteration so that the trees
+# of super-nodes are not removed from the first level.
+
+test_super_levels ()
+{
+    make_grid || return 1
+
+    run_planetsplitter $dir/super-levels-1 --prefix=grid --max-iterations=1 $dir/grid.osm || return 1
+
+    run_planetsplitter $dir/super-levels-2 --prefix=grid --max-iterations=1 --super-levels=2 $dir/grid.osm || return 1
+
+    run_routes $dir/super-levels-1 grid $dir/grid.osm $dir/super-levels-1-routes || return 1
+
+    run_routes $dir/super-levels-2 grid $dir/grid.osm $dir/super-levels-2-routes || return 1
+
+    for osm in $route_tests; do
+
+        name=`basename $osm .osm`
+
+        make_normal_database $name || return 1
+
+        run_planetsplitter $dir/super-levels-2 --prefix=$name --super-levels=2 $osm || return 1
+
+        run_routes $dir/normal $name $osm $dir/super-levels-1-routes || return 1
+
+        run_routes $dir/super-levels-2 $name $osm $dir/super-levels-2-routes || return 1
+    done
+
+    compare_routes $dir/super-levels-1-routes $dir/super-levels-2-routes
+}
+
+
+# Processing and routing with a very small cache for the slim programs (so
+# that data is replaced in the cache), the database and the routes must be
+# the same as with the default cache size.
+
+test_cache_size ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    run_planetsplitter $dir/cache-size --prefix=grid --cache-size=1 $dir/grid.osm || return 1
+
+    compare_databases $dir/normal $dir/cache-size grid || return 1
+
+    for osm in $dir/grid.osm $route_tests; do
+
+        name=`basename $osm .osm`
+
+        [ "$name" = "grid" ] || make_normal_database $name || return 1
+
+        run_routes $dir/normal $name $osm $dir/cache-size-default-routes || return 1
+
+        run_routes $dir/normal $name $osm $dir/cache-size-small-routes --cache-size=1 || return 1
+    done
+
+    compare_routes $dir/cache-size-default-routes $dir/cache-size-small-routes
+}
+
+
+# Routing with the options for loading the database files into memory, using
+# the router and the library.  The routes must be the same as without them.
+
+test_load_options_router ()
+{
+    run_routes $dir/normal grid $dir/grid.osm $dir/load-$router-default || return 1
+
+    for variant in 1 2 3; do
+
+        case $variant in
+            1) options="--load-random --load-willneed --load-lock" ;;
+            2) options="--load-prefault" ;;
+            3) options="--load-hugepages" ;;
+        esac
+
+        run_routes $dir/normal grid $dir/grid.osm $dir/load-$router-$variant $options || return 1
+
+        compare_routes $dir/load-$router-default $dir/load-$router-$variant || return 1
+    done
+}
+
+test_load_options ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    router=router+lib
+
+    test_load_options_router
+    result=$?
+
+    router=router
+
+    [ $result = 0 ] && test_load_options_router
+}
+
+
+# Swapping the library database for one made from the grid with different
+# types of highway and back again (also while other threads are routing),
+# the test program checks that the routes are the same as with the databases
+# loaded separately.  The slim and non-slim libraries must give the same
+# routes.
+
+test_swap_database ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    [ -f $dir/grid2.osm ] || perl grid.pl 200 $dir/grid2.osm 1 || return 1
+
+    run_planetsplitter $dir/swap --prefix=grid $dir/grid2.osm || return 1
+
+    list_waypoints $dir/grid.osm $dir/grid-waypoints.txt || return 1
+
+    waypoint_a=`head -1 $dir/grid-waypoints.txt | cut -d' ' -f2- | sed -e 's/X=/1=/g'`
+    waypoint_b=`tail -1 $dir/grid-waypoints.txt | cut -d' ' -f2- | sed -e 's/X=/2=/g'`
+
+    for route in shortest quickest; do
+
+        output=swap-$route.txt
+
+        echo ./swap-test$slim --dir=$dir/normal --swap-dir=$dir/swap --prefix=grid $option_swap --$route $waypoint_a $waypoint_b >> $log
+        $debugger ./swap-test$slim --dir=$dir/normal --swap-dir=$dir/swap --prefix=grid $option_swap --$route $waypoint_a $waypoint_b > $dir/$output 2>> $log || return 1
+
+        if [ "$slim" ]; then
+            echo cmp fat-variants/$output $dir/$output >> $log
+            cmp fat-variants/$output $dir/$output >> $log 2>&1 || return 1
+        fi
+    done
+}
+
+
+# Writing the database into a single file, the separate files and the single
+# file must be the same for the slim and non-slim programs.  The filedumper
+# output and the routes with only the single file must be the same as with the
+# separate files (the slim programs always use the separate files) and a
+# database with a corrupted part must be rejected when it is checked.
+
+test_single_file ()
+{
+    make_grid || return 1
+
+    make_normal_database grid $dir/grid.osm || return 1
+
+    run_planetsplitter $dir/single-file --prefix=grid --single-file $dir/grid.osm || return 1
+
+    compare_databases $dir/normal $dir/single-file grid || return 1
+
+    if [ "$slim" ]; then
+        echo cmp fat-variants/single-file/grid-database.mem $dir/single-file/grid-database.mem >> $log
+        cmp fat-variants/single-file/grid-database.mem $dir/single-file/grid-database.mem >> $log 2>&1 || return 1
+
+        run_routes $dir/normal grid $dir/grid.osm $dir/single-file-normal-routes || return 1
+
+        run_routes $dir/single-file grid $dir/grid.osm $dir/single-file-routes || return 1
+
+        compare_routes $dir/single-file-normal-routes $dir/single-file-routes || return 1
+
+        return 0
+    fi
+
+    [ -d $dir/single-file-only ] || mkdir $dir/single-file-only
+
+    cp $dir/single-file/grid-database.mem $dir/single-file-only
+
+    for database in normal single-file-only; do
+        echo ../filedumper --dir=$dir/$database --prefix=grid --dump-osm >> $log
+        $debugger ../filedumper --dir=$dir/$database --prefix=grid --dump-osm > $dir/$database-dump.osm 2>> $log || return 1
+    done
+
+    echo cmp $dir/normal-dump.osm $dir/single-file-only-dump.osm >> $log
+    cmp $dir/normal-dump.osm $dir/single-file-only-dump.osm >> $log 2>&1 || return 1
+
+    rm -f $dir/normal-dump.osm $dir/single-file-only-dump.osm
+
+    run_routes $dir/normal grid $dir/grid.osm $dir/single-file-normal-routes || return 1
+
+    run_routes $dir/single-file-only grid $dir/grid.osm $dir/single-file-routes --verify-database || return 1
+
+    compare_routes $dir/single-file-normal-routes $dir/single-file-routes || return 1
+
+    [ -d $dir/single-file-corrupt ] || mkdir $dir/single-file-corrupt
+
+    cp $dir/single-file/grid-database.mem $dir/single-file-corrupt
+
+    size=`wc -c < $dir/single-file-corrupt/grid-database.mem`
+
+    perl -e 'open(F,"+<",$ARGV[0]); seek(F,$ARGV[1],0); read(F,$c,1); seek(F,$ARGV[1],0); print F chr(ord($c)^255);' $dir/single-file-corrupt/grid-database.mem `expr $size / 2` || return 1
+
+    echo ../filedumper --dir=$dir/single-file-corrupt --prefix=grid --statistics >> $log
+    $debugger ../filedumper --dir=$dir/single-file-corrupt --prefix=grid --statistics >> $log 2>&1 && return 1
+
+    waypoint_a=`head -1 $dir/grid-waypoints.txt | cut -d' ' -f2- | sed -e 's/X=/1=/g'`
+    waypoint_b=`tail -1 $dir/grid-waypoints.txt | cut -d' ' -f2- | sed -e 's/X=/2=/g'`
+
+    echo ../router --dir=$dir/single-file-corrupt --prefix=grid $option_router --verify-database $waypoint_a $waypoint_b >> $log
+    $debugger ../router --dir=$dir/single-file-corrupt --prefix=grid $option_router --verify-database $waypoint_a $waypoint_b > /dev/null 2>> $log && return 1
+
+    return 0
+}
+
+
+# A nodes file that does not match its header (like one written by a version
+# of planetsplitter with a different file format) must be rejected by the
+# router, the router using the library and the filedumper.
+
+test_bad_nodes_file ()
+{
+    make_normal_database loops || return 1
+
+    [ -d $dir/bad-nodes ] || mkdir $dir/bad-nodes
+
+    cp $dir/normal/loops-*.mem $dir/bad-nodes
+
+    printf 'XXXX' >> $dir/bad-nodes/loops-nodes.mem
+
+    waypoint_a=`perl waypoints.pl loops.osm WP01 1`
+    waypoint_b=`perl waypoints.pl loops.osm WP02 2`
+
+    for program in router router+lib; do
+
+        echo ../$program$slim --dir=$dir/bad-nodes --prefix=loops $option_router $waypoint_a $waypoint_b >> $log
+        $debugger ../$program$slim --dir=$dir/bad-nodes --prefix=loops $option_router $waypoint_a $waypoint_b > /dev/null 2> $dir/bad-nodes.err && return 1
+
+        cat $dir/bad-nodes.err >> $log
+
+        grep -q "not valid for this version" $dir/bad-nodes.err || return 1
+    done
+
+    echo ../filedumper$slim --dir=$dir/bad-nodes --prefix=loops --statistics >> $log
+    $debugger ../filedumper$slim --dir=$dir/bad-nodes --prefix=loops --statistics > /dev/null 2> $dir/bad-nodes.err && return 1
+
+    cat $dir/bad-nodes.err >> $log
+
+    grep -q "not valid for this version" $dir/bad-nodes.err
+}
+
+
+# Initial informational message
+
+echo ""
+echo "Running variant tests"
+
+
+# Loop round the slim and non-slim programs
+
+for type in 1 2; do
+
+    case $type in
+        1)
+            slim=""
+            dir="fat-variants"
+            description="non-slim"
+            ;;
+        2)
+            slim="-slim"
+            dir="slim-variants"
+            description="slim"
+            ;;
+    esac
+
+    rm -rf $dir
+    mkdir $dir
+
+    log=variants$slim.log
+
+    option_planetsplitter="--loggable --tagging=../../xml/routino-tagging.xml --prune-none"
+
+    option_router="--profile=motorcar --profiles=../../xml/routino-profiles.xml --translations=copyright.xml --output-text-all --output-stdout"
+
+    router=router
+
+    route_tests="loops.osm turns.osm dead-ends.osm node-restrictions.osm super-or-not.osm"
+
+    option_swap="--profiles=../../xml/routino-profiles.xml --translations=copyright.xml"
+
+    option_isochrone="--profiles=../../xml/routino-profiles.xml --lat=-0.25 --lon=-0.45"
+
+    option_matrix="--profiles=../../xml/routino-profiles.xml --translations=copyright.xml"
+
+    echo "" > $log
+
+    echo ""
+    echo "Testing: bzip2 multiple stream file ($description) ... "
+    run_a_test test_bzip2_multistream
+
+    echo ""
+    echo "Testing: sorting with temporary files ($description) ... "
+    run_a_test test_sort_temporary_files
+
+    echo ""
+    echo "Testing: PBF file parsing threads ($description) ... "
+    run_a_test test_pbf_parse_threads
+
+    echo ""
+    echo "Testing: isochrones ($description) ... "
+    run_a_test test_isochrone
+
+    echo ""
+    echo "Testing: nodes file with the wrong format ($description) ... "
+    run_a_test test_bad_nodes_file
+
+    echo ""
+    echo "Testing: route matrices ($description) ... "
+    run_a_test test_matrix
+
+    echo ""
+    echo "Testing: unconnected parts of the network ($description) ... "
+    run_a_test test_components
+
+    echo ""
+    echo "Testing: two levels of super-nodes ($description) ... "
+    run_a_test test_super_levels
+
+    if [ "$slim" ]; then
+        echo ""
+        echo "Testing: small cache size ($description) ... "
+        run_a_test test_cache_size
+    fi
+
+    echo ""
+    echo "Testing: database loading options ($description) ... "
+    run_a_test test_load_options
+
+    echo ""
+    echo "Testing: swapping the library database ($description) ... "
+    run_a_test test_swap_database
+
+    echo ""
+    echo "Testing: single file database ($description) ... "
+    run_a_test test_single_file
+
+done
+
+# Check results
+
+if $status; then
+    echo "Success: all variant tests passed"
+else
+    echo "Warning: Some variant tests FAILED"
+    exit 1
+fi
+
+exit 0
@@ -0,0 +1,432 @@
+/***************************************
+ Test swapping the database in the libroutino library.
+
+ Part of the Routino routing software.
+ ******************/ /******************
+ This file Copyright 2017 Andrew M. Bishop
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU Affero General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Affero General Public License for more details.
+
+ You should have received a copy of the GNU Affero General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ***************************************/
+
+
+/* A route is calculated with the first database, the database is swapped for
+   the second one and the same waypoints and profile are used again.  The route
+   must be the same as with the second database loaded separately and must be
+   the same as before when swapped back to the first database.  The database
+   is then swapped repeatedly while other threads calculate routes that must
+   match one of the two routes.  The two routes are printed so that they can
+   be compared with other versions of the library. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "routino.h"
+
+
+/*+ The number of times that the database is swapped while other threads are routing. +*/
+#define NSWAPS 10
+
+/*+ The number of threads that calculate routes while the database is swapped. +*/
+#define NTHREADS 2
+
+
+/* Local functions */
+
+static char *calculate_route(Routino_Context *context,Routino_Waypoint **waypoints);
+static int check_route(const char *name,const char *route,const char *expected);
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+static void *routing_thread(void *arg);
+#endif
+
+
+/* Local variables */
+
+static Routino_Profile     *profile;
+static Routino_Translation *translation;
+
+static int quickest=0;
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+static Routino_Database *swap_database;
+static Routino_Waypoint *swap_waypoints[2];
+
+static char *swap_route1,*swap_route2;
+
+static volatile int swap_finished=0;
+
+static int swap_errors=0,swap_routes=0;
+
+static pthread_mutex_t swap_mutex=PTHREAD_MUTEX_INITIALIZER;
+
+#endif
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  The main program for the database swap test.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+int main(int argc,char** argv)
+{
+ Routino_Database *database,*database2;
+ Routino_Context *context,*context2;
+ Routino_Waypoint *waypoints[2],*waypoints2[2];
+ const char *dirname=NULL,*swapdirname=NULL,*prefix=NULL,*profiles=NULL,*translations=NULL,*profilename="motorcar";
+ double lat[2]={0,0},lon[2]={0,0};
+ char *route1,*route2,*route;
+ int arg,i,errors=0;
+
+ for(arg=1;arg<argc;arg++)
+   {
+    if(!strncmp(argv[arg],"--dir=",6))
+       dirname=&argv[arg][6];
+    else if(!strncmp(argv[arg],"--swap-dir=",11))
+       swapdirname=&argv[arg][11];
+    else if(!strncmp(argv[arg],"--prefix=",9))
+       prefix=&argv[arg][9];
+    else if(!strncmp(argv[arg],"--profiles=",11))
+       profiles=&argv[arg][11];
+    else if(!strncmp(argv[arg],"--translations=",15))
+       translations=&argv[arg][15];
+    else if(!strncmp(argv[arg],"--profile=",10))
+       profilename=&argv[arg][10];
+    else if(!strcmp(argv[arg],"--shortest"))
+       quickest=0;
+    else if(!strcmp(argv[arg],"--quickest"))
+       quickest=1;
+    else if(!strncmp(argv[arg],"--lat1=",7))
+       lat[0]=atof(&argv[arg][7]);
+    else if(!strncmp(argv[arg],"--lon1=",7))
+       lon[0]=atof(&argv[arg][7]);
+    else if(!strncmp(argv[arg],"--lat2=",7))
+       lat[1]=atof(&argv[arg][7]);
+    else if(!strncmp(argv[arg],"--lon2=",7))
+       lon[1]=atof(&argv[arg][7]);
+    else
+       break;
+   }
+
+ if(arg<argc || !swapdirname || !profiles || !translations)
+   {
+    fprintf(stderr,"Usage: swap-test [--dir=<dirname>] --swap-dir=<dirname> [--prefix=<name>]\n"
+                   "                 --profiles=<filename> --translations=<filename> [--profile=<name>]\n"
+                   "                 [--shortest | --quickest]\n"
+                   "                 --lat1=<latitude> --lon1=<longitude> --lat2=<latitude> --lon2=<longitude>\n");
+    exit(EXIT_FAILURE);
+   }
+
+ /* Load the database, profile and translation and find the waypoints */
+
+ database=Routino_LoadDatabase(dirname,prefix);
+
+ if(!database)
+   {
+    fprintf(stderr,"Error: Cannot load the database (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ if(Routino_ParseXMLProfiles(profiles))
+   {
+    fprintf(stderr,"Error: Cannot read the profiles in the file '%s'.\n",profiles);
+    exit(EXIT_FAILURE);
+   }
+
+ if(Routino_ParseXMLTranslations(translations))
+   {
+    fprintf(stderr,"Error: Cannot read the translations in the file '%s'.\n",translations);
+    exit(EXIT_FAILURE);
+   }
+
+ profile=Routino_GetProfile(profilename);
+ translation=Routino_GetTranslation("");
+
+ if(!profile || !translation || Routino_ValidateProfile(database,profile)!=ROUTINO_ERROR_NONE)
+   {
+    fprintf(stderr,"Error: Profile '%s' is invalid or not compatible with database.\n",profilename);
+    exit(EXIT_FAILURE);
+   }
+
+ for(i=0;i<2;i++)
+    if(!(waypoints[i]=Routino_FindWaypoint(database,profile,lat[i],lon[i])))
+      {
+       fprintf(stderr,"Error: Cannot find a node close to waypoint %d.\n",i+1);
+       exit(EXIT_FAILURE);
+      }
+
+ context=Routino_CreateContext(database);
+
+ /* Calculate the route with the first database */
+
+ route1=calculate_route(context,waypoints);
+
+ if(!route1)
+    exit(EXIT_FAILURE);
+
+ /* Swap to the second database and calculate the route with the old waypoints and profile */
+
+ if(Routino_SwapDatabase(database,swapdirname,prefix,ROUTINO_LOAD_DEFAULT)!=ROUTINO_ERROR_NONE)
+   {
+    fprintf(stderr,"Error: Cannot swap to the second database (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ route2=calculate_route(context,waypoints);
+
+ /* Calculate the route with the second database loaded separately */
+
+ database2=Routino_LoadDatabase(swapdirname,prefix);
+
+ if(!database2)
+   {
+    fprintf(stderr,"Error: Cannot load the second database (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ for(i=0;i<2;i++)
+    waypoints2[i]=Routino_FindWaypoint(database2,profile,lat[i],lon[i]);
+
+ context2=Routino_CreateContext(database2);
+
+ route=calculate_route(context2,waypoints2);
+
+ errors+=check_route("second database loaded separately",route,route2);
+
+ free(route);
+
+ for(i=0;i<2;i++)
+    free(waypoints2[i]);
+
+ Routino_DeleteContext(context2);
+
+ Routino_UnloadDatabase(database2);
+
+ if(!route2 || !strcmp(route1,route2))
+   {
+    fprintf(stderr,"Error: The route with the swapped database is the same as before.\n");
+    exit(EXIT_FAILURE);
+   }
+
+ /* Validate the profile with the swapped database and calculate the route again */
+
+ if(Routino_ValidateProfile(database,profile)!=ROUTINO_ERROR_NONE)
+   {
+    fprintf(stderr,"Error: Profile '%s' is not compatible with the second database.\n",profilename);
+    exit(EXIT_FAILURE);
+   }
+
+ route=calculate_route(context,waypoints);
+
+ errors+=check_route("second database with validated profile",route,route2);
+
+ free(route);
+
+ /* Swap back to the first database and calculate the route again */
+
+ if(Routino_SwapDatabase(database,dirname,prefix,ROUTINO_LOAD_DEFAULT)!=ROUTINO_ERROR_NONE)
+   {
+    fprintf(stderr,"Error: Cannot swap back to the first database (error %d).\n",Routino_errno);
+    exit(EXIT_FAILURE);
+   }
+
+ route=calculate_route(context,waypoints);
+
+ errors+=check_route("first database swapped back",route,route1);
+
+ free(route);
+
+ /* Swap the database while other threads are calculating routes */
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+ {
+  pthread_t threads[NTHREADS];
+  struct timespec delay={0,20000000};
+
+  swap_database=database;
+  swap_waypoints[0]=waypoints[0];
+  swap_waypoints[1]=waypoints[1];
+  swap_route1=route1;
+  swap_route2=route2;
+
+  for(i=0;i<NTHREADS;i++)
+     pthread_create(&threads[i],NULL,routing_thread,NULL);
+
+  for(i=0;i<NSWAPS;i++)
+    {
+     nanosleep(&delay,NULL);
+
+     if(Routino_SwapDatabase(database,(i%2)?dirname:swapdirname,prefix,(i%4)<2?ROUTINO_LOAD_DEFAULT:ROUTINO_LOAD_PREFAULT)!=ROUTINO_ERROR_NONE)
+       {
+        fprintf(stderr,"Error: Cannot swap the database while routing (error %d).\n",Routino_errno);
+        errors++;
+       }
+    }
+
+  swap_finished=1;
+
+  for(i=0;i<NTHREADS;i++)
+     pthread_join(threads[i],NULL);
+
+  if(swap_routes==0)
+    {
+     fprintf(stderr,"Error: No routes were calculated while swapping the database.\n");
+     errors++;
+    }
+
+  errors+=swap_errors;
+ }
+
+#endif
+
+ /* Print the routes */
+
+ printf("%s\n%s",route1,route2);
+
+ /* Tidy up and exit */
+
+ free(route1);
+ free(route2);
+
+ for(i=0;i<2;i++)
+    free(waypoints[i]);
+
+ Routino_DeleteContext(context);
+
+ Routino_UnloadDatabase(database);
+
+ Routino_FreeXMLProfiles();
+ Routino_FreeXMLTranslations();
+
+ if(errors)
+    exit(EXIT_FAILURE);
+
+ exit(EXIT_SUCCESS);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate a route and convert it into text.
+
+  char *calculate_route Returns an allocated string with one line for each point or NULL in case of an error.
+
+  Routino_Context *context The routing context (for the database) to use.
+
+  Routino_Waypoint **waypoints The start and finish waypoints.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static char *calculate_route(Routino_Context *context,Routino_Waypoint **waypoints)
+{
+ Routino_Output *route,*point;
+ char *text;
+ size_t length=0;
+
+ route=Routino_CalculateRouteContext(context,profile,translation,waypoints,2,
+                                     (quickest?ROUTINO_ROUTE_QUICKEST:ROUTINO_ROUTE_SHORTEST)|ROUTINO_ROUTE_LIST_TEXT_ALL,NULL);
+
+ if(!route)
+   {
+    fprintf(stderr,"Error: Cannot calculate the route (error %d).\n",Routino_ContextErrno(context));
+    return(NULL);
+   }
+
+ for(point=route;point;point=point->next)
+    length+=80+strlen(point->name?point->name:"");
+
+ text=(char*)malloc(length+1);
+
+ length=0;
+
+ for(point=route;point;point=point->next)
+    length+=sprintf(text+length,"%11.6f %11.6f %8.3f %8.1f %4.0f %d %s\n",
+                    point->lat*180/3.14159265358979323846,point->lon*180/3.14159265358979323846,
+                    point->dist,point->time,point->speed,point->type,point->name?point->name:"");
+
+ text[length]=0;
+
+ Routino_DeleteRoute(route);
+
+ return(text);
+}
+
+
+/*++++++++++++++++++++++++++++++++++++++
+  Check that a route is the same as the expected one.
+
+  int check_route Returns 1 if it is different or 0 if it is the same.
+
+  const char *name The name of the check.
+
+  const char *route The route.
+
+  const char *expected The expected route.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static int check_route(const char *name,const char *route,const char *expected)
+{
+ if(route && expected && !strcmp(route,expected))
+    return(0);
+
+ fprintf(stderr,"Error: The route with the %s is different.\n",name);
+
+ return(1);
+}
+
+
+#if defined(USE_PTHREADS) && USE_PTHREADS
+
+/*++++++++++++++++++++++++++++++++++++++
+  Calculate routes until the database swapping is finished, each one must match one of the two routes.
+
+  void *routing_thread Returns NULL.
+
+  void *arg Not used.
+  ++++++++++++++++++++++++++++++++++++++*/
+
+static void *routing_thread(void *arg)
+{
+ Routino_Context *context=Routino_CreateContext(swap_database);
+
+ while(!swap_finished)
+   {
+    char *route=calculate_route(context,swap_waypoints);
+
+    pthread_mutex_lock(&swap_mutex);
+
+    if(!route || (strcmp(route,swap_route1) && strcmp(route,swap_route2)))
+      {
+       fprintf(stderr,"Error: A route calculated while swapping the database is different.\n");
+       swap_errors++;
+      }
+
+    swap_routes++;
+
+    pthread_mutex_unlock(&swap_mutex);
+
+    free(route);
+   }
+
+ Routino_DeleteContext(context);
+
+ return(NULL);
+}
+
+#endif
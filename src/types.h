@@ -33,11 +33,28 @@
 #endif
 
 
+/* Storage class for the variables that hold the state of a route calculation;
+   in the library these are per-thread so that routes can be calculated in parallel. */
+
+#if defined(LIBROUTINO) && defined(USE_PTHREADS) && USE_PTHREADS
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+#else
+#define THREAD_LOCAL
+#endif
+
+
 /* Constants and macros for handling them */
 
 /*+ The number of waypoints allowed to be specified. +*/
 #define NWAYPOINTS 99
 
+/*+ The maximum number of landmarks that distances can be stored for. +*/
+#define MAX_LANDMARKS 16
+
 
 /*+ An undefined waypoint index. +*/
 #define NO_WAYPOINT    ((waypoint_t)~0)
@@ -90,6 +107,9 @@
 /*+ A flag to mark a node as deleted. +*/
 #define NODE_DELETED     ((nodeflags_t)0x0400)
 
+/*+ A flag to mark a node as a second level super-node. +*/
+#define NODE_SUPER2      ((nodeflags_t)0x0200)
+
 
 /*+ A flag to mark a segment as being part of an area (must be the highest valued flag). +*/
 #define SEGMENT_AREA   ((distance_t)0x80000000)
@@ -205,6 +225,9 @@ typedef float score_t;
 /*+ Conversion from duration_t to minutes. +*/
 #define duration_to_minutes(xx) ((double)(xx)/600.0)
 
+/*+ Conversion from minutes to duration_t. +*/
+#define minutes_to_duration(xx) ((duration_t)((double)(xx)*600.0))
+
 /*+ Conversion from duration_t to hours. +*/
 #define duration_to_hours(xx)   ((double)(xx)/36000.0)
 
@@ -214,6 +237,9 @@ typedef float score_t;
 /*+ Conversion from distance_t and speed_t to duration_t. +*/
 #define distance_speed_to_duration(xx,yy) ((duration_t)(((double)(xx)/(double)(yy))*(36000.0/1000.0)))
 
+/*+ Conversion from duration_t and speed_t to distance_t. +*/
+#define duration_speed_to_distance(xx,yy) ((distance_t)(((double)(xx)*(double)(yy))*(1000.0/36000.0)))
+
 
 /*+ The type of a highway. +*/
 typedef uint8_t highway_t;